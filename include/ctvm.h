@@ -5,64 +5,425 @@
 #include <boost/numeric/ublas/io.hpp>
 #include <boost/numeric/ublas/matrix.hpp>
 #include "ctvm_util.h"
+#include "ctvm_operator.h"
 
 
 
 /* Gradient Operations */
+// Routines with a trailing output argument write into preallocated storage
+// (resizing it only if its dimensions differ) instead of returning a copy.
 #define HORZ 0
 #define VERT 1
-BoostDoubleVector PixelGradient(BoostDoubleVector X, unsigned long Index,
-	unsigned int SideLength);
-BoostDoubleMatrix AllPixelGradients(BoostDoubleVector X, unsigned long SideLength);
-BoostDoubleVector PixelGradientAdjointSum(BoostDoubleMatrix G, unsigned long SideLength);
+#define AXIAL 2
+BoostDoubleVector PixelGradient(const BoostDoubleVector &X, unsigned long Index,
+	unsigned long SideLength);
+BoostGradientMatrix AllPixelGradients(const BoostDoubleVector &X, unsigned long SideLength);
+void AllPixelGradients(const BoostDoubleVector &X, unsigned long SideLength,
+	BoostGradientMatrix &AllGradients);
+BoostDoubleVector PixelGradientAdjointSum(const BoostGradientMatrix &G, unsigned long SideLength);
+void PixelGradientAdjointSum(const BoostGradientMatrix &G, unsigned long SideLength,
+	BoostDoubleVector &ImageVector);
+// Stencil kernels on a contiguous column-major image and the horizontal and
+// vertical planes of its gradient field.
+void ForwardDifference(const double *X, unsigned long SideLength, double *Dh, double *Dv);
+void ForwardDifferenceAdjoint(const double *Gh, const double *Gv, unsigned long SideLength,
+	double *X);
+// The same over a slab of Columns consecutive columns of an image with Rows
+// rows, given the neighbouring column of the image on either side (NULL at
+// the image boundary), as for a distributed image.
+void ForwardDifferenceSlab(const double *X, const double *NextColumn, unsigned long Rows,
+	unsigned long Columns, double *Dh, double *Dv);
+void ForwardDifferenceAdjointSlab(const double *Gh, const double *Gv, const double *PreviousGh,
+	unsigned long Rows, unsigned long Columns, double *X);
 
 // TODO: Implement the following
 // 2D Gradients...
 // BoostDoubleVector PixelGradientAdjoint(BoostDoubleVector g, unsigned long index,
 //                                        unsigned int SideLength);
-// 3D Gradients...
-BoostDoubleVector VoxelGradient(BoostDoubleVector g, unsigned long index,
-	unsigned int SideLength);
-BoostDoubleMatrix AllVoxelGradients(BoostDoubleVector X, unsigned int SideLength);
-BoostDoubleVector VoxelGradientAdjointSum(BoostDoubleVector X, unsigned long index,
-	unsigned int SideLength);
 // ENDTODO
 
+// 3D Gradients...
+// Volumes are stacks of (L x L) column-major slices, rasterized slice by
+// slice: voxel (i, j, k) is at index k*L^2 + j*L + i, so N = L^2 * Depth
+// and the depth is implied by the vector length. Gradient fields have three
+// planes (HORZ, VERT and AXIAL).
+BoostDoubleVector VoxelGradient(const BoostDoubleVector &X, unsigned long Index,
+	unsigned long SideLength);
+BoostGradientMatrix AllVoxelGradients(const BoostDoubleVector &X, unsigned long SideLength);
+void AllVoxelGradients(const BoostDoubleVector &X, unsigned long SideLength,
+	BoostGradientMatrix &AllGradients);
+BoostDoubleVector VoxelGradientAdjointSum(const BoostGradientMatrix &G, unsigned long SideLength);
+void VoxelGradientAdjointSum(const BoostGradientMatrix &G, unsigned long SideLength,
+	BoostDoubleVector &VolumeVector);
+void ForwardDifference3D(const double *X, unsigned long SideLength, unsigned long Depth,
+	double *Dh, double *Dv, double *Da);
+void ForwardDifferenceAdjoint3D(const double *Gh, const double *Gv, const double *Ga,
+	unsigned long SideLength, unsigned long Depth, double *X);
+
 
 /* Shrinkage-like Operators */
 enum TVType { ISOTROPIC, ANISOTROPIC };
-BoostDoubleVector ShrikeIsotropic(BoostDoubleVector W, BoostDoubleVector Nu,
+BoostDoubleVector ShrikeIsotropic(const BoostDoubleVector &W, const BoostDoubleVector &Nu,
 	double beta);
-BoostDoubleVector ShrikeAnisotropic(BoostDoubleVector W, BoostDoubleVector Nu,
+BoostDoubleVector ShrikeAnisotropic(const BoostDoubleVector &W, const BoostDoubleVector &Nu,
 	double beta);
-BoostDoubleMatrix ApplyShrike(BoostDoubleMatrix AllW, BoostDoubleMatrix AllNu,
+BoostGradientMatrix ApplyShrike(const BoostGradientMatrix &AllW, const BoostGradientMatrix &AllNu,
 	double beta, TVType ShrikeMode);
+void ApplyShrike(const BoostGradientMatrix &AllW, const BoostGradientMatrix &AllNu,
+	double beta, TVType ShrikeMode, BoostGradientMatrix &AllWShriked);
+void ApplyGradientShrike(const BoostDoubleVector &U, const BoostGradientMatrix &Nu,
+	double beta, TVType ShrikeMode, unsigned long SideLength, BoostGradientMatrix &W);
+// Batch shrinkage kernels on planar gradient fields (see ForwardDifference).
+void ShrikePlanes(const double *W, const double *Nu, unsigned long N, unsigned long d,
+	double beta, TVType ShrikeMode, double *WShriked);
+void ForwardDifferenceShrike(const double *X, const double *NuH, const double *NuV,
+	unsigned long SideLength, double beta, TVType ShrikeMode, double *WH, double *WV);
+
+/* Solver Progress */
+/*
+* Struct: TVAL3Progress
+* ---------------------
+* A progress report passed to TVAL3Options::Progress. Iteration counters
+* start at 1; counters of enclosing loops are set, inner ones left at 0.
+*
+* OUTER_ITERATION: after the multiplier update. Objective is the augmented
+*                  Lagrangian at the new U, Stop is ||U - U(k-1)||.
+* INNER_ITERATION: after each alternating minimisation step. Objective is
+*                  the u-subproblem value at the accepted step, StepSize the
+*                  accepted alpha and Stop ||U - U(k-1)||.
+* ARMIJO_TRIAL:    after each line search trial. Objective is the trial
+*                  value, StepSize the trial alpha and Stop the Armijo bound.
+*/
+enum TVAL3Stage { OUTER_ITERATION, INNER_ITERATION, ARMIJO_TRIAL };
+struct TVAL3Progress {
+	TVAL3Stage Stage;
+	unsigned int OuterIteration, InnerIteration, ArmijoIteration;
+	double Objective, StepSize, Stop;
+	// Wall-clock seconds since the reconstruction started
+	double ElapsedSeconds;
+};
+typedef void (*TVAL3ProgressCallback)(const TVAL3Progress &Progress, void *UserData);
+
+/* Solver Profile */
+/*
+* Struct: TVAL3Profile
+* --------------------
+* Per-phase wall time and work counters, filled in through
+* TVAL3Options::Profile. Recording is compiled in only when the library is
+* built with CTVM_PROFILE defined; otherwise the profile is left untouched
+* and Enabled stays false.
+*
+* SETUP_PHASE:             initial back-projection, shrinkage and the
+*                          projections at the start of each inner loop
+* W_STEP_PHASE:            the w sub-problem (shrinkage)
+* DIRECTION_PHASE:         the u sub-problem descent direction and step
+* LINE_SEARCH_PHASE:       the Armijo line search and accepting the step
+* MULTIPLIER_UPDATE_PHASE: the Nu and Lambda updates of the outer loop
+*
+* Phase times of a batch reconstruction are summed over its slices, and may
+* therefore exceed TotalSeconds when the slices run in parallel.
+*/
+enum TVAL3Phase {
+	SETUP_PHASE, W_STEP_PHASE, DIRECTION_PHASE, LINE_SEARCH_PHASE, MULTIPLIER_UPDATE_PHASE,
+	TVAL3_PHASE_COUNT
+};
+struct TVAL3Profile {
+	TVAL3Profile();
+	// Accumulate the phase times and counters of another profile
+	void Add(const TVAL3Profile &Other);
+
+	bool Enabled;
+	double TotalSeconds;
+	double PhaseSeconds[TVAL3_PHASE_COUNT];
+	unsigned long PhaseCalls[TVAL3_PHASE_COUNT];
+	// Applications of A and A^T, counting each column of a block product
+	unsigned long Applications, TransposeApplications;
+	// Armijo trials beyond the first of each line search are backtracks
+	unsigned long OuterIterations, InnerIterations, ArmijoTrials, ArmijoBacktracks;
+	// Conjugate-gradient iterations of PCG_U_STEP
+	unsigned long CGIterations;
+};
+const char *TVAL3PhaseName(TVAL3Phase Phase);
+void WriteProfileJSON(const TVAL3Profile &Profile, std::ostream &Out);
+
+/* Step Size */
+// The first trial step of each line search, from the Barzilai-Borwein
+// quotients of Sk = U - U(k-1) and Yk, the change in the descent direction:
+// DAMPED_BB_STEP:      Rho * <Sk,Yk>/<Yk,Yk> (the original behaviour)
+// SHORT_BB_STEP:       <Sk,Yk>/<Yk,Yk>
+// LONG_BB_STEP:        <Sk,Sk>/<Sk,Yk>
+// ALTERNATING_BB_STEP: long on odd and short on even inner iterations
+// Undamped steps that are not positive and finite fall back to the short
+// quotient. Every rule is followed by the same non-monotone Armijo search,
+// which becomes monotone for Eta = 0.
+enum TVAL3StepSize { DAMPED_BB_STEP, SHORT_BB_STEP, LONG_BB_STEP, ALTERNATING_BB_STEP };
+
+/* U-Step */
+// How each inner iteration minimises the u-subproblem,
+//
+//       (beta*D^T*D + mu*A^T*A) U = D^T*(beta*W + Nu) + A^T*(mu*b + Lambda)
+//
+// GRADIENT_U_STEP: one steepest-descent step with the Armijo line search
+//                  (the original behaviour)
+// EXACT_U_STEP:    the exact solution, by one 2D DCT pair, for operators
+//                  whose A^T*A the DCT diagonalises (D^T*D, with the zero
+//                  boundary differences of ForwardDifference, always is);
+//                  see ProjectionOperator::CosineDiagonal. Other operators,
+//                  and volumes, fall back to GRADIENT_U_STEP
+// PCG_U_STEP:      up to MaxCGIterations of conjugate gradients from the
+//                  current U, for any operator, preconditioned when
+//                  JacobiPreconditioner is set by the diagonal of the system
+//                  matrix (recomputed by each call of Alternating_Minimisation,
+//                  as beta and mu change between outer iterations); operators
+//                  without ProjectionOperator::SquaredColumnNorms run
+//                  unpreconditioned
+enum TVAL3UStep { GRADIENT_U_STEP, EXACT_U_STEP, PCG_U_STEP };
+
+/* Solver State */
+/*
+* Struct: TVAL3State
+* ------------------
+* The solver variables between two outer iterations: the image, the
+* shrunken gradients W, the multipliers Nu (of W = D*U) and Lambda (of
+* A*U = b), and the penalties the next outer iteration would use. Returned
+* through TVAL3Options::FinalState and accepted through
+* TVAL3Options::InitialState, so that a correlated problem (the next slice,
+* or a repeated scan) starts where a previous one stopped. Resuming a
+* problem from its own final state continues the same iterations.
+*/
+struct TVAL3State {
+	TVAL3State();
+
+	BoostDoubleVector U;          // (N x 1)
+	BoostGradientMatrix W, Nu;    // (N x d), d gradient planes
+	BoostDoubleVector Lambda;     // (M x 1)
+	double Beta, Mu;
+	// Outer iterations run since the state was last initialised cold
+	unsigned int OuterIterations;
+};
+
+/* Solver Options */
+struct TVAL3Workspace;
+/*
+* Struct: TVAL3Options
+* --------------------
+* Parameters of tval3_reconstruction and Alternating_Minimisation. The
+* default-constructed options reproduce the original hard-coded settings.
+*/
+struct TVAL3Options {
+	TVAL3Options();
+
+	// Initial penalties on W = D*U and A*U = b, and the factor by which both
+	// are multiplied after every outer iteration (continuation)
+	double Mu, Beta, Coefficient;
+	// Outer (multiplier update) loop: stop once ||U - U(k-1)|| <= OuterTolerance
+	double OuterTolerance;
+	unsigned int MaxOuterIterations;
+	// Inner (alternating minimisation) loop, with the same stopping test
+	double InnerTolerance;
+	unsigned int MaxInnerIterations;
+	// Divide the changes compared with OuterTolerance, InnerTolerance and
+	// TileTolerance by ||U||, so that the tolerances do not depend on the
+	// scale of the image
+	bool RelativeTolerance;
+	// Active set (GRADIENT_U_STEP, images only): when ActiveTileSize is not 0
+	// the image is split into square tiles of that side, and a tile whose
+	// change ||U - U(k-1)|| over an outer iteration falls to its share of
+	// TileTolerance stops being updated for the rest of the reconstruction
+	// (the share is the tolerance times the square root of the fraction of
+	// the pixels in the tile, so a step that freezes every tile would also
+	// pass OuterTolerance = TileTolerance). Its shrinkage,
+	// direction and projections are then skipped; once every tile is frozen
+	// the reconstruction stops
+	unsigned long ActiveTileSize;
+	double TileTolerance;
+	// Non-monotone Armijo line search: step reduction Rho, sufficient decrease
+	// Delta, averaging weight Eta and the number of trial steps
+	double Rho, Delta, Eta;
+	unsigned int MaxArmijoIterations;
+	// The first trial step of each line search
+	TVAL3StepSize StepSize;
+	// The u-subproblem solver of the inner loop
+	TVAL3UStep UStep;
+	// PCG_U_STEP: stop each solve after MaxCGIterations, or once the system
+	// residual has fallen by the factor CGTolerance. The Jacobi preconditioner
+	// pays off once the start is well scaled; from the back-projection, plain
+	// CG can reduce the residual faster in the first iterations
+	unsigned int MaxCGIterations;
+	double CGTolerance;
+	bool JacobiPreconditioner;
+	// Isotropic or anisotropic total variation
+	TVType GradNorm;
+	// Starting image (N x 1); when empty, the back-projection A^T*y is used
+	BoostDoubleVector InitialImage;
+	// Warm start: each member of the state whose size matches the problem
+	// replaces its cold start (U replaces InitialImage, W the first
+	// shrinkage, Nu and Lambda zero), and Beta and Mu, when positive,
+	// replace the penalties above. NULL starts cold.
+	const TVAL3State *InitialState;
+	// Filled in with the state on return; may be the same object as
+	// InitialState. NULL records nothing
+	TVAL3State *FinalState;
+	// Project U onto U >= 0 after every step
+	bool Nonnegative;
+	// Called with each progress report, and ProgressData; NULL is silent
+	TVAL3ProgressCallback Progress;
+	void *ProgressData;
+	// Reset and filled in by each reconstruction (see TVAL3Profile), and
+	// accumulated by Alternating_Minimisation; NULL records nothing
+	TVAL3Profile *Profile;
+	// Storage reused by successive single and volume reconstructions, and
+	// resized only when the problem size changes; NULL allocates per call
+	TVAL3Workspace *Workspace;
+};
+
+/* Solver Workspace */
+/*
+* Struct: TVAL3Workspace
+* ----------------------
+* Preallocated temporaries for an (M x N) reconstruction. Passing the same
+* workspace to every call of Alternating_Minimisation means the solver
+* iterations run without heap allocation after setup. GradientPlanes is 2
+* for images and 3 for volumes.
+*
+* A workspace passed through TVAL3Options::Workspace also holds the outer
+* loop variables, so a long-running process reconstructing one problem
+* size after another reuses the same buffers instead of fragmenting the
+* heap. A workspace must not be used by two reconstructions at once.
+*/
+struct TVAL3Workspace {
+	TVAL3Workspace(unsigned long M, unsigned long N, unsigned long GradientPlanes = 2);
+	// Reallocate only the buffers whose size changes
+	void Resize(unsigned long M, unsigned long N, unsigned long GradientPlanes);
+
+	// Image space, (N x 1)
+	BoostDoubleVector Uk_1, Sk, Dk, Yk, U_alphad;
+	BoostDoubleVector DataDirection, DataDirectionk_1;
+	// Gradient space, (N x GradientPlanes): scratch, and D*U and D*U(k-1)
+	// carried across inner iterations
+	BoostGradientMatrix Du, GradU, GradUk_1;
+	// Measurement space, (M x 1)
+	BoostDoubleVector Residual, ADk, TrialResidual, DataResidual;
+	// EXACT_U_STEP: the DCT-domain eigenvalues of A^T*A and of D^T*D, sized
+	// on first use
+	BoostDoubleVector GramDiagonal, LaplacianDiagonal;
+	// PCG_U_STEP: the inverse of the Jacobi preconditioner, sized on first use
+	BoostDoubleVector Preconditioner;
+	// ActiveTileSize: one flag per tile (column-major), the pixels of the
+	// active tiles and the tiles whose shrinkage they change, both in
+	// ascending order; cleared by tval3_reconstruction, so that every tile
+	// starts active
+	std::vector<unsigned char> ActiveTiles;
+	std::vector<unsigned long> ActiveColumns, ShrinkTiles;
+	// Outer loop: the previous outer iterate, multipliers and shrunken gradients
+	BoostDoubleVector OuterUk_1, Lambda;
+	BoostGradientMatrix Nu, W;
+	// Progress bookkeeping, maintained by tval3_reconstruction
+	unsigned int OuterIteration;
+	boost::posix_time::ptime StartTime;
+};
 
 /* Optimization */
-double Lagrangian(BoostDoubleMatrix A, BoostDoubleVector U,
-	BoostDoubleVector B, BoostDoubleMatrix W,
-	BoostDoubleMatrix Nu, BoostDoubleVector Lambda,
+// Pieces of the quadratic cost and descent direction, split so that callers
+// which track the residual A*U - B need not re-apply the projection.
+// Gradient fields W and Nu with two planes select 2D (pixel) TV and with
+// three planes 3D (voxel) TV, where U is a volume of slices of side
+// SideLength.
+double TV_Subfunction(const BoostDoubleVector &U, const BoostGradientMatrix &W,
+	const BoostGradientMatrix &Nu, double beta, unsigned long SideLength);
+double TV_Subfunction(const BoostDoubleVector &U, const BoostGradientMatrix &W,
+	const BoostGradientMatrix &Nu, double beta, unsigned long SideLength,
+	BoostGradientMatrix &Du);
+double TV_Norm(const BoostGradientMatrix &W, TVType GradNorm);
+double Residual_Subfunction(const BoostDoubleVector &Residual, const BoostDoubleVector &Lambda,
+	double mu);
+BoostDoubleVector TV_Direction(const BoostDoubleVector &U, const BoostGradientMatrix &W,
+	const BoostGradientMatrix &Nu, double beta, unsigned long SideLength);
+void TV_Direction(const BoostDoubleVector &U, const BoostGradientMatrix &W,
+	const BoostGradientMatrix &Nu, double beta, unsigned long SideLength,
+	BoostGradientMatrix &Du, BoostDoubleVector &Direction);
+
+// Each solver routine accepts any ProjectionOperator; the BoostDoubleMatrix
+// overloads wrap the dense matrix in a DenseProjection.
+double Lagrangian(const ProjectionOperator &A, const BoostDoubleVector &U,
+	const BoostDoubleVector &B, const BoostGradientMatrix &W,
+	const BoostGradientMatrix &Nu, const BoostDoubleVector &Lambda,
+	double beta, double mu,
+	unsigned long SideLength, TVType GradNorm);
+double Lagrangian(const BoostDoubleMatrix &A, const BoostDoubleVector &U,
+	const BoostDoubleVector &B, const BoostGradientMatrix &W,
+	const BoostGradientMatrix &Nu, const BoostDoubleVector &Lambda,
 	double beta, double mu,
 	unsigned long SideLength, TVType GradNorm);
 
-BoostDoubleVector Onestep_Direction(BoostDoubleMatrix A, BoostDoubleVector Uk,
-	BoostDoubleVector B, BoostDoubleMatrix Wk,
-	BoostDoubleMatrix Nu, BoostDoubleVector Lambda,
+BoostDoubleVector Onestep_Direction(const ProjectionOperator &A, const BoostDoubleVector &Uk,
+	const BoostDoubleVector &B, const BoostGradientMatrix &Wk,
+	const BoostGradientMatrix &Nu, const BoostDoubleVector &Lambda,
+	double beta, double mu,
+	unsigned long SideLength);
+BoostDoubleVector Onestep_Direction(const BoostDoubleMatrix &A, const BoostDoubleVector &Uk,
+	const BoostDoubleVector &B, const BoostGradientMatrix &Wk,
+	const BoostGradientMatrix &Nu, const BoostDoubleVector &Lambda,
 	double beta, double mu,
 	unsigned long SideLength);
 
-double U_Subfunction(BoostDoubleMatrix A, BoostDoubleVector U,
-	BoostDoubleVector B, BoostDoubleMatrix Wk,
-	BoostDoubleMatrix Nu, BoostDoubleVector Lambda,
+double U_Subfunction(const ProjectionOperator &A, const BoostDoubleVector &U,
+	const BoostDoubleVector &B, const BoostGradientMatrix &Wk,
+	const BoostGradientMatrix &Nu, const BoostDoubleVector &Lambda,
+	double beta, double mu, unsigned long SideLength);
+double U_Subfunction(const BoostDoubleMatrix &A, const BoostDoubleVector &U,
+	const BoostDoubleVector &B, const BoostGradientMatrix &Wk,
+	const BoostGradientMatrix &Nu, const BoostDoubleVector &Lambda,
 	double beta, double mu, unsigned long SideLength);
 
-void Alternating_Minimisation(BoostDoubleMatrix A, BoostDoubleVector &U,
-	BoostDoubleVector B, BoostDoubleMatrix &W,
-	BoostDoubleMatrix Nu, BoostDoubleVector Lambda,
+void Alternating_Minimisation(const ProjectionOperator &A, BoostDoubleVector &U,
+	const BoostDoubleVector &B, BoostGradientMatrix &W,
+	const BoostGradientMatrix &Nu, const BoostDoubleVector &Lambda,
+	double beta, double mu,
+	unsigned long SideLength, const TVAL3Options &Options, TVAL3Workspace &Work);
+void Alternating_Minimisation(const ProjectionOperator &A, BoostDoubleVector &U,
+	const BoostDoubleVector &B, BoostGradientMatrix &W,
+	const BoostGradientMatrix &Nu, const BoostDoubleVector &Lambda,
+	double beta, double mu,
+	unsigned long SideLength);
+void Alternating_Minimisation(const BoostDoubleMatrix &A, BoostDoubleVector &U,
+	const BoostDoubleVector &B, BoostGradientMatrix &W,
+	const BoostGradientMatrix &Nu, const BoostDoubleVector &Lambda,
 	double beta, double mu,
 	unsigned long SideLength);
 
-BoostDoubleMatrix tval3_reconstruction(BoostDoubleMatrix A, BoostDoubleVector y,
+BoostDoubleMatrix tval3_reconstruction(const ProjectionOperator &A, const BoostDoubleVector &y,
+	unsigned long SideLength);
+BoostDoubleMatrix tval3_reconstruction(const ProjectionOperator &A, const BoostDoubleVector &y,
+	unsigned long SideLength, const TVAL3Options &Options);
+BoostDoubleMatrix tval3_reconstruction(const BoostDoubleMatrix &A, const BoostDoubleVector &y,
 	unsigned long SideLength);
+BoostDoubleMatrix tval3_reconstruction(const BoostDoubleMatrix &A, const BoostDoubleVector &y,
+	unsigned long SideLength, const TVAL3Options &Options);
+// Parallel-beam reconstruction of an (L x O) sinogram, coarse to fine over
+// Levels resolutions (L/4, L/2 and L for three levels).
+BoostDoubleMatrix tval3_pyramid_reconstruction(const BoostDoubleMatrix &Sinogram,
+	const BoostDoubleVector &TiltAngles, unsigned int Levels);
+BoostDoubleMatrix tval3_pyramid_reconstruction(const BoostDoubleMatrix &Sinogram,
+	const BoostDoubleVector &TiltAngles, unsigned int Levels, const TVAL3Options &Options);
+// Batch of K slices sharing one geometry; column k of Y holds slice k. No
+// progress is reported, as the slices are solved on separate threads.
+std::vector<BoostDoubleMatrix> tval3_batch_reconstruction(const ProjectionOperator &A,
+	const BoostDoubleMatrix &Y, unsigned long SideLength);
+std::vector<BoostDoubleMatrix> tval3_batch_reconstruction(const ProjectionOperator &A,
+	const BoostDoubleMatrix &Y, unsigned long SideLength, const TVAL3Options &Options);
+std::vector<BoostDoubleMatrix> tval3_batch_reconstruction(const BoostDoubleMatrix &A,
+	const BoostDoubleMatrix &Y, unsigned long SideLength);
+std::vector<BoostDoubleMatrix> tval3_batch_reconstruction(const BoostDoubleMatrix &A,
+	const BoostDoubleMatrix &Y, unsigned long SideLength, const TVAL3Options &Options);
+// Volume of K slices sharing one geometry, with TV coupling adjacent slices.
+std::vector<BoostDoubleMatrix> tval3_volume_reconstruction(const ProjectionOperator &A,
+	const BoostDoubleMatrix &Y, unsigned long SideLength);
+std::vector<BoostDoubleMatrix> tval3_volume_reconstruction(const ProjectionOperator &A,
+	const BoostDoubleMatrix &Y, unsigned long SideLength, const TVAL3Options &Options);
+std::vector<BoostDoubleMatrix> tval3_volume_reconstruction(const BoostDoubleMatrix &A,
+	const BoostDoubleMatrix &Y, unsigned long SideLength);
+std::vector<BoostDoubleMatrix> tval3_volume_reconstruction(const BoostDoubleMatrix &A,
+	const BoostDoubleMatrix &Y, unsigned long SideLength, const TVAL3Options &Options);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,85 @@
+#ifndef CTVM_MPI_H
+#define CTVM_MPI_H
+
+#include "ctvm.h"
+
+// The MPI solver is built only when CTVM_MPI is defined
+#ifdef CTVM_MPI
+#include <mpi.h>
+
+/* Domain Decomposition */
+/*
+* Struct: MPIPartition
+* --------------------
+* The share of one rank of a distributed (L x L) reconstruction from O tilt
+* angles: the tilt angles AngleBegin .. AngleEnd-1, whose L*(AngleEnd -
+* AngleBegin) measurements it projects, and the image columns ColumnBegin ..
+* ColumnEnd-1, the slab of U, W and Nu it updates. Both are split as evenly
+* as possible, in rank order.
+*/
+struct MPIPartition {
+	unsigned long AngleBegin, AngleEnd;
+	unsigned long ColumnBegin, ColumnEnd;
+};
+MPIPartition PartitionReconstruction(unsigned long SideLength, unsigned long Angles, int Rank,
+	int Ranks);
+
+/*
+* Class: MPISession
+* -----------------
+* Initialises MPI on construction and finalises it on destruction, unless
+* it was already initialised, so that a program may return from anywhere.
+*/
+class MPISession {
+public:
+	MPISession(int &argc, char **&argv);
+	~MPISession();
+
+	int Rank() const;
+	int Ranks() const;
+
+private:
+	MPISession(const MPISession &);
+	MPISession &operator=(const MPISession &);
+
+	bool Owned;
+};
+
+/* Distributed Reconstruction */
+// One reconstruction spread over the ranks of a communicator, the TVAL3
+// gradient u-step of Alternating_Minimisation run on distributed data:
+//
+// measurements: each rank holds the rows of A (and of y, Lambda and the
+//               residual) of its own measurements, so the products of A and
+//               A^T, the bulk of the work, are split between the ranks;
+//               A*U gathers U to every rank (MPI_Allgatherv) and A^T*r sums
+//               the ranks' contributions onto the slabs (MPI_Reduce_scatter)
+// image:        each rank holds a slab of consecutive columns of U, W and
+//               Nu; the gradient and its adjoint exchange one column with
+//               each neighbouring slab (MPI_Sendrecv)
+// scalars:      the inner products and sums of the Barzilai-Borwein step,
+//               the Armijo test and the stopping tests are summed over the
+//               ranks a few at a time (MPI_Reduce and MPI_Bcast), so that
+//               every rank takes the same steps
+//
+// The operator form takes this rank's rows of A (an (M_r x L^2) operator,
+// the measurements being split between the ranks in any way) and the
+// matching observations; the sinogram form builds the parallel-beam rows
+// of this rank's tilt angles (see PartitionReconstruction) from an (L x O)
+// sinogram present on every rank. Every rank must call with the same
+// options and SideLength; each returns the whole (L x L) reconstruction.
+//
+// Of TVAL3Options only the penalties, tolerances, iteration limits, line
+// search, step size rule, TV norm, nonnegativity, InitialImage (the whole
+// image, on every rank) and Progress (outer iterations, with the same
+// values on every rank that sets it) are used; the u-step is always
+// GRADIENT_U_STEP, and there is no active set, state, profile or
+// workspace. Every rank needs at least one image column.
+BoostDoubleMatrix tval3_mpi_reconstruction(const ProjectionOperator &LocalA,
+	const BoostDoubleVector &LocalY, unsigned long SideLength, const TVAL3Options &Options,
+	MPI_Comm Comm);
+BoostDoubleMatrix tval3_mpi_reconstruction(const BoostDoubleMatrix &Sinogram,
+	const BoostDoubleVector &TiltAngles, const TVAL3Options &Options, MPI_Comm Comm);
+#endif
+
+#endif
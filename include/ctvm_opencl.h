@@ -0,0 +1,82 @@
+#ifndef CTVM_OPENCL_H
+#define CTVM_OPENCL_H
+
+#include "ctvm_operator.h"
+
+// The OpenCL backend is built only when CTVM_OPENCL is defined
+#ifdef CTVM_OPENCL
+#include <mutex>
+#include <string>
+#ifndef CL_TARGET_OPENCL_VERSION
+#define CL_TARGET_OPENCL_VERSION 120
+#endif
+#ifdef __APPLE__
+#include <OpenCL/opencl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+/* Device Projection Operators */
+/*
+* Class: OpenCLProjection
+* -----------------------
+* A SparseProjection evaluated on an OpenCL device: a sparse matrix-vector
+* product only. The CSR arrays of the matrix and of its transpose are
+* uploaded once, on construction, with 32-bit indices and single-precision
+* values.
+*
+* The solver itself stays on the host: the gradient stencils, shrinkage,
+* reductions and the state (U, W, Nu, Lambda) are not offloaded. Each
+* product therefore converts its input to float, uploads it, and waits to
+* read the output back, at least twice per inner iteration; the operator
+* only pays off where a product costs much more than these transfers.
+*
+* Products are accumulated in single precision on the device. Calls are
+* serialised, so the operator may be shared by the slices of
+* tval3_batch_reconstruction; the device runs one product at a time.
+*
+* Errors raised by the OpenCL runtime (no platform or device, a failed
+* kernel build, out of device memory, ...) are thrown as
+* std::runtime_error.
+*/
+class OpenCLProjection : public ProjectionOperator {
+public:
+	explicit OpenCLProjection(const SparseProjection &A, unsigned int PlatformIndex = 0,
+		unsigned int DeviceIndex = 0);
+	~OpenCLProjection();
+
+	unsigned long Rows() const;
+	unsigned long Cols() const;
+	unsigned long NonZeros() const;
+	void Apply(const BoostDoubleVector &X, BoostDoubleVector &Y) const;
+	void ApplyTranspose(const BoostDoubleVector &Y, BoostDoubleVector &X) const;
+	std::string DeviceName() const;
+
+private:
+	// Device resources are owned, so the operator cannot be copied
+	OpenCLProjection(const OpenCLProjection &);
+	OpenCLProjection &operator=(const OpenCLProjection &);
+
+	void Multiply(cl_kernel Kernel, cl_mem In, cl_mem Out, const BoostDoubleVector &X,
+		unsigned long OutLength, BoostDoubleVector &Y) const;
+	void Release();
+
+	unsigned long M;
+	unsigned long N;
+	unsigned long NNZ;
+
+	cl_device_id Device;
+	cl_context Context;
+	cl_command_queue Queue;
+	cl_program Program;
+	cl_kernel ForwardKernel, TransposeKernel;
+	// CSR arrays of A and of A^T, and the (N x 1) and (M x 1) device vectors
+	cl_mem RowPtr, ColIndex, Values, ColPtr, RowIndex, ColValues;
+	cl_mem XBuffer, YBuffer;
+
+	mutable std::mutex Lock;
+	mutable std::vector<float> Staging;
+};
+#endif
+
+#endif
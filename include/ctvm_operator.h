@@ -0,0 +1,314 @@
+#ifndef CTVM_OPERATOR_H
+#define CTVM_OPERATOR_H
+
+#include <vector>
+#include <mutex>
+#include "ctvm_util.h"
+
+/* Projection Operators */
+/*
+* Class: ProjectionOperator
+* -------------------------
+* Abstract (M x N) linear map from the space of rasterized images (N = L^2)
+* to the space of measurements (M). The solver only ever needs the action of
+* the map and of its transpose, so implementations are free to compute these
+* on-the-fly (ray-driven projectors, sparse system matrices, ...) rather than
+* storing a dense matrix.
+*
+* Apply:          Y = A * X     (X is N x 1, Y is resized to M x 1)
+* ApplyTranspose: X = A^T * Y   (Y is M x 1, X is resized to N x 1)
+*
+* The block forms act on K right-hand sides at once, one per column of X
+* (N x K) or Y (M x K). The default implementations loop over the columns;
+* operators override them to traverse A once for the whole block.
+*
+* SquaredColumnNorms: operators which can list the squared norms of their
+* columns (the diagonal of A^T * A) cheaply return true and set Norms to
+* them (N x 1); the solver uses them to precondition its u-subproblem. The
+* default returns false.
+*
+* ApplyColumns / ApplyTransposeColumns: the products restricted to a sorted
+* list of Columns (pixels), for solvers that update only part of the image.
+* ApplyColumns computes Y = A * X on the assumption that X is zero outside
+* Columns; ApplyTransposeColumns computes the entries of X = A^T * Y listed
+* in Columns and leaves the others unspecified. The defaults evaluate the
+* full products; operators override them when the restricted products are
+* cheaper.
+*
+* CosineDiagonal: operators whose normal matrix A^T * A is diagonal in the
+* basis of the (L x L) 2D DCT-II (see CosineTransform2D) return true and
+* set Diagonal to its (N x 1) eigenvalues, in coefficient order; the solver
+* can then solve its u-subproblem exactly. The default returns false.
+*/
+class ProjectionOperator {
+public:
+	virtual ~ProjectionOperator() {}
+
+	virtual unsigned long Rows() const = 0;
+	virtual unsigned long Cols() const = 0;
+	virtual void Apply(const BoostDoubleVector &X, BoostDoubleVector &Y) const = 0;
+	virtual void ApplyTranspose(const BoostDoubleVector &Y, BoostDoubleVector &X) const = 0;
+	virtual void ApplyBlock(const BoostDoubleMatrix &X, BoostDoubleMatrix &Y) const;
+	virtual void ApplyTransposeBlock(const BoostDoubleMatrix &Y, BoostDoubleMatrix &X) const;
+	virtual void ApplyColumns(const BoostDoubleVector &X, const std::vector<unsigned long> &Columns,
+		BoostDoubleVector &Y) const;
+	virtual void ApplyTransposeColumns(const BoostDoubleVector &Y,
+		const std::vector<unsigned long> &Columns, BoostDoubleVector &X) const;
+	virtual bool SquaredColumnNorms(BoostDoubleVector &Norms) const;
+	virtual bool CosineDiagonal(unsigned long SideLength, BoostDoubleVector &Diagonal) const;
+
+	BoostDoubleVector Project(const BoostDoubleVector &X) const;
+	BoostDoubleVector BackProject(const BoostDoubleVector &Y) const;
+};
+
+/*
+* Class: DenseProjection
+* ----------------------
+* Wraps an explicit (M x N) BoostDoubleMatrix as a ProjectionOperator. The
+* matrix is held by reference and must outlive the operator.
+*/
+class DenseProjection : public ProjectionOperator {
+public:
+	explicit DenseProjection(const BoostDoubleMatrix &AMatrix);
+
+	unsigned long Rows() const;
+	unsigned long Cols() const;
+	void Apply(const BoostDoubleVector &X, BoostDoubleVector &Y) const;
+	void ApplyTranspose(const BoostDoubleVector &Y, BoostDoubleVector &X) const;
+	void ApplyBlock(const BoostDoubleMatrix &X, BoostDoubleMatrix &Y) const;
+	void ApplyTransposeBlock(const BoostDoubleMatrix &Y, BoostDoubleMatrix &X) const;
+	bool SquaredColumnNorms(BoostDoubleVector &Norms) const;
+
+private:
+	const BoostDoubleMatrix &A;
+};
+
+/*
+* Class: BasicSparseProjection
+* ----------------------------
+* An (M x N) projection matrix held in compressed sparse row (CSR) format.
+* Row r holds the entries Values[RowPtr[r] .. RowPtr[r+1]-1] located at the
+* columns ColIndex[RowPtr[r] .. RowPtr[r+1]-1]. RowPtr therefore has M+1
+* entries with RowPtr[0] = 0 and RowPtr[M] = number of non-zeros.
+*
+* A transposed copy (the CSC form of the matrix) is built on construction so
+* that both Apply and ApplyTranspose are row-parallel gathers with no write
+* conflicts between threads, at the cost of storing the non-zeros twice.
+*
+* Scalar is the storage type of the non-zeros. The products stream every
+* non-zero once, so float storage reduces the memory traffic that dominates
+* their cost; the images and measurements stay double, and every row sum is
+* accumulated in double. Operators of either type convert to one another.
+*/
+template <typename Scalar>
+class BasicSparseProjection : public ProjectionOperator {
+public:
+	BasicSparseProjection(unsigned long Rows, unsigned long Cols,
+		const std::vector<unsigned long> &RowPointers,
+		const std::vector<unsigned long> &ColumnIndices,
+		const std::vector<Scalar> &NonZeroValues);
+	template <typename OtherScalar>
+	explicit BasicSparseProjection(const BasicSparseProjection<OtherScalar> &Other);
+
+	unsigned long Rows() const;
+	unsigned long Cols() const;
+	unsigned long NonZeros() const;
+	void Apply(const BoostDoubleVector &X, BoostDoubleVector &Y) const;
+	void ApplyTranspose(const BoostDoubleVector &Y, BoostDoubleVector &X) const;
+	void ApplyBlock(const BoostDoubleMatrix &X, BoostDoubleMatrix &Y) const;
+	void ApplyTransposeBlock(const BoostDoubleMatrix &Y, BoostDoubleMatrix &X) const;
+	void ApplyColumns(const BoostDoubleVector &X, const std::vector<unsigned long> &Columns,
+		BoostDoubleVector &Y) const;
+	void ApplyTransposeColumns(const BoostDoubleVector &Y, const std::vector<unsigned long> &Columns,
+		BoostDoubleVector &X) const;
+	bool SquaredColumnNorms(BoostDoubleVector &Norms) const;
+
+	// The CSR arrays of the matrix, and of its transpose (the CSC arrays)
+	const std::vector<unsigned long> &RowPointers() const;
+	const std::vector<unsigned long> &ColumnIndices() const;
+	const std::vector<Scalar> &NonZeroValues() const;
+	const std::vector<unsigned long> &ColumnPointers() const;
+	const std::vector<unsigned long> &RowIndices() const;
+	const std::vector<Scalar> &ColumnValues() const;
+
+private:
+	template <typename OtherScalar> friend class BasicSparseProjection;
+
+	unsigned long M;
+	unsigned long N;
+	std::vector<unsigned long> RowPtr;
+	std::vector<unsigned long> ColIndex;
+	std::vector<Scalar> Values;
+
+	// Transposed (CSC) copy used by ApplyTranspose
+	std::vector<unsigned long> ColPtr;
+	std::vector<unsigned long> RowIndex;
+	std::vector<Scalar> ColValues;
+};
+typedef BasicSparseProjection<double> SparseProjection;
+typedef BasicSparseProjection<float> FloatSparseProjection;
+
+/*
+* Class: SliceStackProjection
+* ---------------------------
+* The block-diagonal operator applying one (M x N) slice operator to each
+* of Depth slices of a volume: an (M*Depth x N*Depth) map from volumes
+* rasterized slice by slice (slice k at X(k*N .. k*N+N-1)) to measurements
+* stacked the same way. Products are evaluated as one block product of the
+* slice operator over all slices. The slice operator is held by reference
+* and must outlive the stack.
+*
+* The gathered blocks are kept between products, so that the solver loop
+* does not allocate; calls are serialised to share them.
+*/
+class SliceStackProjection : public ProjectionOperator {
+public:
+	SliceStackProjection(const ProjectionOperator &Slice, unsigned long Depth);
+
+	unsigned long Rows() const;
+	unsigned long Cols() const;
+	void Apply(const BoostDoubleVector &X, BoostDoubleVector &Y) const;
+	void ApplyTranspose(const BoostDoubleVector &Y, BoostDoubleVector &X) const;
+	bool SquaredColumnNorms(BoostDoubleVector &Norms) const;
+
+private:
+	const ProjectionOperator &Slice;
+	unsigned long Depth;
+
+	mutable std::mutex Lock;
+	// (N x Depth) image and (M x Depth) measurement blocks
+	mutable BoostDoubleMatrix ImageBlock, MeasurementBlock;
+};
+
+/*
+* Class: StructuredProjection
+* ---------------------------
+* A fast compressive-sensing operator for images with N a power of two:
+*
+*       A = R * T * P
+*
+* P scrambles the N pixels by a random permutation, T is an orthonormal
+* transform of length N and R keeps M of its N outputs: the first (the DC
+* term) and M-1 others chosen at random. The rows of A are orthonormal.
+* Both products cost O(N log N); only the permutation and the M kept rows
+* are stored. The same Seed always gives the same operator.
+*
+* WALSH_HADAMARD_TRANSFORM: the Walsh-Hadamard transform (natural order)
+* DCT_TRANSFORM:            the DCT-II, evaluated with a radix-2 FFT
+*
+* Dimensions that are not valid (N not a power of two, M > N) are thrown
+* as std::invalid_argument.
+*/
+enum StructuredTransform { WALSH_HADAMARD_TRANSFORM, DCT_TRANSFORM };
+
+class StructuredProjection : public ProjectionOperator {
+public:
+	StructuredProjection(StructuredTransform Transform, unsigned long Rows, unsigned long Cols,
+		unsigned int Seed = 0);
+
+	unsigned long Rows() const;
+	unsigned long Cols() const;
+	void Apply(const BoostDoubleVector &X, BoostDoubleVector &Y) const;
+	void ApplyTranspose(const BoostDoubleVector &Y, BoostDoubleVector &X) const;
+	bool SquaredColumnNorms(BoostDoubleVector &Norms) const;
+
+	// The pixel permutation P (pixel Permutation[i] goes to position i), and
+	// the transform outputs kept by R, in row order
+	const std::vector<unsigned long> &Permutation() const;
+	const std::vector<unsigned long> &SampledRows() const;
+
+private:
+	StructuredTransform Transform;
+	unsigned long M;
+	unsigned long N;
+	std::vector<unsigned long> Scramble;
+	std::vector<unsigned long> Sampled;
+};
+
+/*
+* Class: PartialCosineProjection
+* ------------------------------
+* Compressive sampling of an (L x L) image, L a power of two, in the 2D
+* DCT-II domain: A keeps M of the N = L^2 coefficients of CosineTransform2D,
+* the first (the DC term) and M-1 others chosen at random by Seed, in
+* coefficient order. The rows of A are orthonormal and A^T * A is diagonal
+* in the DCT basis, so CosineDiagonal is supported.
+*
+* Dimensions that are not valid (L not a power of two, M > N) are thrown
+* as std::invalid_argument.
+*/
+class PartialCosineProjection : public ProjectionOperator {
+public:
+	PartialCosineProjection(unsigned long SideLength, unsigned long Rows, unsigned int Seed = 0);
+
+	unsigned long Rows() const;
+	unsigned long Cols() const;
+	void Apply(const BoostDoubleVector &X, BoostDoubleVector &Y) const;
+	void ApplyTranspose(const BoostDoubleVector &Y, BoostDoubleVector &X) const;
+	bool CosineDiagonal(unsigned long SideLength, BoostDoubleVector &Diagonal) const;
+
+	const std::vector<unsigned long> &SampledRows() const;
+
+private:
+	unsigned long L;
+	unsigned long M;
+	std::vector<unsigned long> Sampled;
+};
+
+/*
+* Class: GaussianProjection
+* -------------------------
+* An implicit (M x N) compressive-sensing matrix of independent normal
+* entries, never stored: entry (r, c) is Scale times position r*N + c of
+* the Gaussian stream of Seed (see GenerateGaussian), so the operator equals
+* Scale * CreateRandomMatrix(M, N, Seed), and each product regenerates the
+* entries it needs, a block at a time, on the thread that uses them. Apply
+* splits the rows and ApplyTranspose the columns between the threads, and
+* both sum in the order DenseProjection does, so that with Scale = 1 the
+* products equal those of the stored matrix exactly.
+*
+* Memory use does not depend on M*N; each product costs M*N normals, which
+* is slower than streaming a stored matrix that fits in memory.
+*/
+class GaussianProjection : public ProjectionOperator {
+public:
+	GaussianProjection(unsigned long Rows, unsigned long Cols, uint64_t Seed, double Scale = 1.0);
+
+	unsigned long Rows() const;
+	unsigned long Cols() const;
+	void Apply(const BoostDoubleVector &X, BoostDoubleVector &Y) const;
+	void ApplyTranspose(const BoostDoubleVector &Y, BoostDoubleVector &X) const;
+	bool SquaredColumnNorms(BoostDoubleVector &Norms) const;
+
+	// Row r of the matrix, generated on demand (N x 1)
+	void Row(unsigned long r, BoostDoubleVector &Values) const;
+	uint64_t Seed() const;
+
+private:
+	void Generate(unsigned long r, unsigned long Begin, unsigned long Count, double *Values) const;
+
+	unsigned long M;
+	unsigned long N;
+	uint64_t Stream;
+	double Scale;
+};
+
+/* Fast Transforms */
+// In-place orthonormal 2D DCT-II of a column-major (L x L) image, L a power
+// of two, or with Inverse set its inverse (and transpose). Coefficient
+// (i, j) is the product of vertical frequency i and horizontal frequency j.
+void CosineTransform2D(double *X, unsigned long SideLength, bool Inverse);
+
+/* Projection Builders */
+SparseProjection BuildParallelBeamProjection(const BoostDoubleVector &TiltAngles,
+	unsigned long SideLength);
+// The L rows of BuildParallelBeamProjection for a single tilt angle, appended
+// to CSR arrays, so that larger matrices can be built one angle at a time
+void AppendParallelBeamRows(double TiltAngle, unsigned long SideLength,
+	std::vector<unsigned long> &RowPtr, std::vector<unsigned long> &ColIndex,
+	std::vector<double> &Values);
+// The (L/2 x O) sinogram that BuildParallelBeamProjection(TiltAngles, L/2)
+// would measure of the same object, from an (L x O) sinogram with L even
+BoostDoubleMatrix HalveSinogram(const BoostDoubleMatrix &Sinogram);
+
+#endif
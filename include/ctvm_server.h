@@ -0,0 +1,122 @@
+#ifndef CTVM_SERVER_H
+#define CTVM_SERVER_H
+
+#include <list>
+#include "ctvm.h"
+
+/* Projection Cache */
+/*
+* Struct: ProjectionCacheEntry
+* ----------------------------
+* A parallel-beam projection built for one tilt-angle set and side length,
+* and the solver workspace sized for it, so that a reconstruction with the
+* cached operator allocates nothing beyond its result.
+*/
+struct ProjectionCacheEntry {
+	ProjectionCacheEntry(const BoostDoubleVector &TiltAngles, unsigned long SideLength);
+
+	BoostDoubleVector TiltAngles;
+	unsigned long SideLength;
+	SparseProjection Projection;
+	TVAL3Workspace Workspace;
+};
+
+/*
+* Class: ProjectionCache
+* ----------------------
+* The Capacity most recently used parallel-beam projections, keyed by their
+* tilt angles (compared exactly) and side length. Acquire builds a missing
+* operator, evicting the least recently used one when the cache is full.
+* Entries stay valid until they are evicted or the cache is cleared. The
+* cache is not thread-safe, and the workspace of an entry must not be used
+* by two reconstructions at once.
+*/
+class ProjectionCache {
+public:
+	explicit ProjectionCache(unsigned long Capacity = 4);
+
+	// The entry for (TiltAngles, SideLength); Hit, when given, is set to
+	// whether it was already cached
+	ProjectionCacheEntry &Acquire(const BoostDoubleVector &TiltAngles, unsigned long SideLength,
+		bool *Hit = NULL);
+	void Clear();
+
+	unsigned long Capacity() const;
+	unsigned long Size() const;
+	unsigned long Hits() const;
+	unsigned long Misses() const;
+
+private:
+	ProjectionCache(const ProjectionCache &);
+	ProjectionCache &operator=(const ProjectionCache &);
+
+	// Most recently used first
+	std::list<ProjectionCacheEntry> Entries;
+	unsigned long MaximumEntries, HitCount, MissCount;
+};
+
+/* Reconstruction Server */
+// A long-running process serving reconstructions over a local (Unix
+// domain) stream socket, so that interactive clients pay neither process
+// startup nor operator construction per sinogram: operators and solver
+// workspaces come from a ProjectionCache, and the OpenMP threads persist
+// between requests. Requests are served one at a time, in the order the
+// connections are accepted, each with all of the solver threads; a
+// connection may send any number of requests.
+//
+// Each message is a fixed header and float64 values, in the byte order of
+// the machine (the socket is local):
+//
+// request:  ServerRequest, then Cols tilt angles, then the (Rows x Cols)
+//           sinogram column by column (its MatrixToVector); a request with
+//           Rows = Cols = 0 stops the server
+// reply:    ServerReply, then Rows*Cols values of the (L x L)
+//           reconstruction column by column, or, when Status is not 0,
+//           MessageBytes bytes of error message
+//
+// A malformed request, or one beyond the server's size budget (a sinogram
+// of 2^26 values, an image of 4096 x 4096 and L^2 * O <= 2^27), is
+// answered with an error and its connection closed, as is a failed
+// reconstruction; the server carries on with the next connection. A
+// connection that stalls for 30 seconds is dropped, so that one idle client
+// cannot hold up the others, including one left open between requests. The
+// timeout applies to each recv and send call, not to a whole request: a
+// client trickling a byte every 29 seconds still holds the server, which
+// serves a single connection at a time.
+const uint32_t ServerProtocolVersion = 1;
+
+struct ServerRequest {
+	char Magic[8];          // "CTVMREQ" and a terminating null
+	uint32_t ByteOrder;     // 0x01020304 as written
+	uint32_t Version;       // ServerProtocolVersion
+	uint64_t Rows, Cols;    // the detector bins L and the tilt angles O
+};
+
+struct ServerReply {
+	char Magic[8];          // "CTVMREP" and a terminating null
+	uint32_t ByteOrder;     // 0x01020304 as written
+	uint32_t Version;       // ServerProtocolVersion
+	uint32_t Status;        // 0 on success
+	uint32_t CacheHit;      // 1 if the operator was already cached
+	uint64_t Rows, Cols;    // L and L, or 0 and 0 on failure
+	uint64_t MessageBytes;  // the length of the error message
+	double Seconds;         // the time spent reconstructing
+};
+
+// Serve reconstructions with Options (apart from Workspace, taken from the
+// cache, and InitialImage, InitialState and FinalState, which belong to
+// one problem) on a socket created at SocketPath, replacing a stale socket
+// left there, until a stop request arrives; the socket is removed on return.
+// Log, when given, receives one line per request. Errors creating the
+// socket are thrown as std::runtime_error; sockets are not supported on
+// Windows.
+void ServeReconstructions(const char* SocketPath, ProjectionCache &Cache,
+	const TVAL3Options &Options, std::ostream *Log = NULL);
+// Send one (L x O) sinogram to the server at SocketPath and return its
+// (L x L) reconstruction. Errors, including those reported by the server,
+// are thrown as std::runtime_error
+BoostDoubleMatrix RequestReconstruction(const char* SocketPath, const BoostDoubleMatrix &Sinogram,
+	const BoostDoubleVector &TiltAngles, bool *CacheHit = NULL);
+void StopReconstructionServer(const char* SocketPath);
+
+#endif
@@ -0,0 +1,147 @@
+#ifndef CTVM_TILED_H
+#define CTVM_TILED_H
+
+#include <string>
+#include "ctvm_operator.h"
+
+/* Tiled Projection Files */
+// A tiled projection file holds an (M x N) sparse system matrix on disk in
+// blocks of consecutive rows, followed by its transpose in blocks of
+// consecutive columns, so that A*x and A^T*y are both block-parallel
+// gathers, as for SparseProjection. Each row (column) of a block is stored
+// as its number of non-zeros (a varint), its values and its indices, in
+// the order they were written. The storage can be compressed:
+//
+// TILED_FLOAT64, TILED_FLOAT32, TILED_FLOAT16: values stored in 8, 4 or 2
+//               bytes; float16 keeps about three significant digits
+// DeltaIndices: each index stored as its signed difference from the
+//               previous index of the row (from 0, for the first), zigzag
+//               varint-encoded; the short steps of a ray take one or two
+//               bytes, rather than the four of a 32-bit index
+//
+// All fields are in the byte order of the writing machine; readers reject
+// the other.
+enum TiledValueType { TILED_FLOAT16 = 2, TILED_FLOAT32 = 4, TILED_FLOAT64 = 8 };
+const uint32_t TiledFormatVersion = 1;
+
+struct TiledHeader {
+	char Magic[8];            // "CTVMTIL" and a terminating null
+	uint32_t ByteOrder;       // 0x01020304 as written
+	uint32_t Version;         // TiledFormatVersion
+	uint32_t ValueType;       // a TiledValueType, the size of one value in bytes
+	uint32_t DeltaIndices;    // 1 for delta-encoded indices, 0 for 32-bit ones
+	uint64_t Rows, Cols, NonZeros;
+	uint64_t RowBlocks, ColumnBlocks;
+	uint64_t DirectoryOffset; // RowBlocks then ColumnBlocks TiledBlock entries
+};
+
+struct TiledBlock {
+	uint64_t First, Count;    // the first row (column) and the number of them
+	uint64_t Offset, Bytes;   // the position and size of the encoded block
+};
+
+/*
+* Class: TiledProjectionWriter
+* ----------------------------
+* Writes a tiled projection file from rows supplied in order, a few at a
+* time, so that a matrix larger than memory can be built and stored one
+* piece at a time. Rows are encoded in blocks of BlockRows. Close() then
+* writes the transposed copy, in blocks holding about as many non-zeros as
+* a row block, with as few passes over the row blocks already written as
+* TransposeBytes of buffer allow; memory use is therefore bounded by the
+* buffer, one block, and four bytes per column.
+*
+* Errors (an unwritable file, rows past the declared count, columns out of
+* range) are thrown as std::runtime_error.
+*/
+class TiledProjectionWriter {
+public:
+	TiledProjectionWriter(const char* FileName, unsigned long Rows, unsigned long Cols,
+		unsigned long BlockRows, TiledValueType ValueType = TILED_FLOAT32, bool DeltaIndices = true,
+		unsigned long TransposeBytes = 268435456UL);
+	~TiledProjectionWriter();
+
+	// Append rows given as CSR arrays (row r holds the entries
+	// RowPointers[r] .. RowPointers[r+1]-1, RowPointers[0] = 0)
+	void AppendRows(const std::vector<unsigned long> &RowPointers,
+		const std::vector<unsigned long> &ColumnIndices, const std::vector<double> &Values);
+	void Close();
+
+private:
+	TiledProjectionWriter(const TiledProjectionWriter &);
+	TiledProjectionWriter &operator=(const TiledProjectionWriter &);
+
+	void WriteBlock(uint64_t First, uint64_t Count, std::vector<TiledBlock> &Blocks);
+	void WriteTranspose();
+	void Fail(const char* Problem);
+
+	std::string FileName;
+	FILE *Output;
+	TiledHeader Header;
+	unsigned long BlockRows, TransposeBytes, Appended;
+	uint64_t Position;
+	// The rows of the block being filled, and its encoding
+	std::vector<uint64_t> PendingPtr;
+	std::vector<uint32_t> PendingIndex;
+	std::vector<double> PendingValues;
+	std::vector<unsigned char> Encoded;
+	std::vector<uint32_t> ColumnCounts;
+	std::vector<TiledBlock> RowDirectory, ColumnDirectory;
+};
+
+void WriteTiledProjection(const char* FileName, const SparseProjection &A, unsigned long BlockRows,
+	TiledValueType ValueType = TILED_FLOAT32, bool DeltaIndices = true);
+// BuildParallelBeamProjection(TiltAngles, SideLength) written one block of
+// AnglesPerBlock tilt angles at a time, without building it in memory
+void WriteParallelBeamProjection(const char* FileName, const BoostDoubleVector &TiltAngles,
+	unsigned long SideLength, unsigned long AnglesPerBlock, TiledValueType ValueType = TILED_FLOAT32,
+	bool DeltaIndices = true);
+
+/* Out-of-core Projection Operators */
+/*
+* Class: TiledSparseProjection
+* ----------------------------
+* A ProjectionOperator reading its matrix from a tiled projection file
+* mapped into memory (see MappedFile), so that matrices larger than memory
+* can be used by the solver. Each product streams the blocks of A (A^T)
+* through the threads, decoding them as they are read into doubles; a
+* thread starting a block asks the OS to read ahead the block one thread
+* count further on, so that disk reads overlap the arithmetic. Pages are
+* left to the OS page cache, which keeps as much of the file resident as
+* memory allows between products.
+*
+* Products of a TILED_FLOAT64 file equal those of the SparseProjection it
+* was written from.
+*
+* Errors (missing file, bad header or block directory) are thrown as
+* std::runtime_error; the encoded blocks themselves are trusted.
+*/
+class TiledSparseProjection : public ProjectionOperator {
+public:
+	explicit TiledSparseProjection(const char* FileName);
+
+	unsigned long Rows() const;
+	unsigned long Cols() const;
+	unsigned long NonZeros() const;
+	void Apply(const BoostDoubleVector &X, BoostDoubleVector &Y) const;
+	void ApplyTranspose(const BoostDoubleVector &Y, BoostDoubleVector &X) const;
+	bool SquaredColumnNorms(BoostDoubleVector &Norms) const;
+
+	TiledValueType ValueType() const;
+	bool DeltaIndices() const;
+	unsigned long RowBlocks() const;
+	unsigned long ColumnBlocks() const;
+
+private:
+	TiledSparseProjection(const TiledSparseProjection &);
+	TiledSparseProjection &operator=(const TiledSparseProjection &);
+
+	void Multiply(const std::vector<TiledBlock> &Blocks, const BoostDoubleVector &In,
+		BoostDoubleVector &Out, bool Squares) const;
+
+	MappedFile Mapping;
+	TiledHeader Header;
+	std::vector<TiledBlock> RowDirectory, ColumnDirectory;
+};
+
+#endif
@@ -4,6 +4,11 @@
 #include <fstream>
 #include <algorithm>
 #include <limits>
+#include <vector>
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <stdint.h>
 #include <boost/numeric/ublas/io.hpp>
 #include <boost/numeric/ublas/matrix.hpp>
 #include <boost/numeric/ublas/matrix_proxy.hpp>
@@ -11,6 +16,9 @@
 #include <boost/random/normal_distribution.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
 #include <Magick++.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 /* UBLAS Typecasts */
 typedef boost::numeric::ublas::matrix<double> BoostDoubleMatrix;
@@ -19,41 +27,117 @@ typedef boost::numeric::ublas::zero_matrix<double> BoostZeroMatrix;
 typedef boost::numeric::ublas::vector<double> BoostDoubleVector;
 typedef boost::numeric::ublas::scalar_vector<double> BoostScalarDoubleVector;
 typedef boost::numeric::ublas::zero_vector<double> BoostZeroVector;
+// (N x d) per-pixel gradient fields are stored column-major, so that each of
+// the d gradient components occupies one contiguous plane of N values.
+typedef boost::numeric::ublas::matrix<double, boost::numeric::ublas::column_major> BoostGradientMatrix;
 
 /* Matrix Manipulation */
-BoostDoubleVector GetRow(BoostDoubleMatrix AMatrix, unsigned int row);
-BoostDoubleVector GetCol(BoostDoubleMatrix AMatrix, unsigned int col);
-void SetRow(BoostDoubleMatrix &AMatrix, BoostDoubleVector RowVect, unsigned int row);
-void SetCol(BoostDoubleMatrix &AMatrix, BoostDoubleVector ColVect, unsigned int col);
-BoostDoubleVector MatrixToVector(BoostDoubleMatrix AMatrix);
-BoostDoubleMatrix VectorToMatrix(BoostDoubleVector AVector, unsigned long rows, unsigned long cols);
+BoostDoubleVector GetRow(const BoostDoubleMatrix &AMatrix, unsigned int row);
+BoostDoubleVector GetCol(const BoostDoubleMatrix &AMatrix, unsigned int col);
+void SetRow(BoostDoubleMatrix &AMatrix, const BoostDoubleVector &RowVect, unsigned int row);
+void SetCol(BoostDoubleMatrix &AMatrix, const BoostDoubleVector &ColVect, unsigned int col);
+BoostDoubleVector GetRow(const BoostGradientMatrix &AMatrix, unsigned int row);
+BoostDoubleVector GetCol(const BoostGradientMatrix &AMatrix, unsigned int col);
+void SetRow(BoostGradientMatrix &AMatrix, const BoostDoubleVector &RowVect, unsigned int row);
+void SetCol(BoostGradientMatrix &AMatrix, const BoostDoubleVector &ColVect, unsigned int col);
+BoostDoubleVector MatrixToVector(const BoostDoubleMatrix &AMatrix);
+BoostDoubleMatrix VectorToMatrix(const BoostDoubleVector &AVector, unsigned long rows, unsigned long cols);
+BoostDoubleMatrix ResizeMatrix(const BoostDoubleMatrix &AMatrix, unsigned long rows, unsigned long cols);
 
 /* Matrix Search */
-double MaximumEntry(BoostDoubleMatrix AMatrix);
-double MaximumEntry(BoostDoubleVector AVector);
-double MinimumEntry(BoostDoubleMatrix AMatrix);
-double MinimumEntry(BoostDoubleVector AVector);
+double MaximumEntry(const BoostDoubleMatrix &AMatrix);
+double MaximumEntry(const BoostDoubleVector &AVector);
+double MinimumEntry(const BoostDoubleMatrix &AMatrix);
+double MinimumEntry(const BoostDoubleVector &AVector);
 
 /* Linear Operations */
-BoostDoubleVector HadamardProduct(BoostDoubleVector A, BoostDoubleVector B);
-BoostDoubleVector SignVector(BoostDoubleVector AVector);
-BoostDoubleVector AbsoluteValueVector(BoostDoubleVector AVector);
-BoostDoubleVector MaxVector(BoostDoubleVector A, BoostDoubleVector B);
-BoostDoubleVector MaxVector(BoostDoubleVector A, double B);
-BoostDoubleMatrix NormalizeMatrix(BoostDoubleMatrix AMatrix);
-double SquareNorm(BoostDoubleVector AVector);
+BoostDoubleVector HadamardProduct(const BoostDoubleVector &A, const BoostDoubleVector &B);
+BoostDoubleVector SignVector(const BoostDoubleVector &AVector);
+BoostDoubleVector AbsoluteValueVector(const BoostDoubleVector &AVector);
+BoostDoubleVector MaxVector(const BoostDoubleVector &A, const BoostDoubleVector &B);
+BoostDoubleVector MaxVector(const BoostDoubleVector &A, double B);
+BoostDoubleMatrix NormalizeMatrix(const BoostDoubleMatrix &AMatrix);
+double SquareNorm(const BoostDoubleVector &AVector);
 
 // TODO: 
-double SumVector(BoostDoubleVector AVector);
-BoostDoubleVector SquareElements(BoostDoubleVector AVector);
-BoostDoubleMatrix SquareElements(BoostDoubleMatrix AMatrix);
+double SumVector(const BoostDoubleVector &AVector);
+BoostDoubleVector SquareElements(const BoostDoubleVector &AVector);
+BoostDoubleMatrix SquareElements(const BoostDoubleMatrix &AMatrix);
 
 /* Linear Algebra */
-BoostDoubleVector MakeUnitVector(BoostDoubleVector AVector);
+BoostDoubleVector MakeUnitVector(const BoostDoubleVector &AVector);
 
 /* Matrix Generation */
+// Entries are standard normal. Without a Seed each call draws a fresh one,
+// so that no two calls return the same data; with a Seed the result is
+// GenerateGaussian(Seed, 0, ...) in storage (row-major) order, the same on
+// every run and for every thread count.
 BoostDoubleMatrix CreateRandomMatrix(int rows, int cols);
+BoostDoubleMatrix CreateRandomMatrix(int rows, int cols, uint64_t Seed);
 BoostDoubleVector CreateRandomVector(int length);
+BoostDoubleVector CreateRandomVector(int length, uint64_t Seed);
+
+/* Counter-Based Random Numbers */
+// Philox4x32-10 (Salmon et al., "Parallel Random Numbers: As Easy as 1, 2,
+// 3"), a keyed bijection of 128-bit counters: output block c of the stream
+// with key k depends only on (c, k), so any part of a random array can be
+// generated on its own, in any order and on any thread.
+//
+// A Gaussian stream of seed S holds, at positions 2c and 2c+1, the two
+// Box-Muller normals of counter block c (c in the low 64 bits) under key S.
+// GenerateGaussian fills positions First .. First+Count-1 on the calling
+// thread; FillGaussian splits them across the threads, with the same result.
+void Philox4x32(const uint32_t Counter[4], const uint32_t Key[2], uint32_t Output[4]);
+void GenerateGaussian(uint64_t Seed, uint64_t First, unsigned long Count, double *Values);
+void FillGaussian(uint64_t Seed, uint64_t First, unsigned long Count, double *Values);
+
+/* Parallel Execution */
+// Loops over pixels, columns and measurements are split across OpenMP
+// threads when the library is built with OpenMP, and run serially otherwise.
+// SetThreadCount(0) restores the OpenMP default (OMP_NUM_THREADS or all cores).
+// Loops with fewer than ParallelMinimumWork elements always run serially.
+const unsigned long ParallelMinimumWork = 16384;
+void SetThreadCount(int Threads);
+int GetThreadCount();
+double ParallelInnerProduct(const BoostDoubleVector &A, const BoostDoubleVector &B);
+
+template <class PartialSumFunction>
+double DeterministicSum(unsigned long Length, PartialSumFunction PartialSum) {
+	/*
+	* Function: DeterministicSum
+	* --------------------------
+	* Parallel reduction sum_{i=0:Length-1} f(i) whose result does not depend
+	* on the thread count. [0, Length) is cut into at most MaxChunks chunks of
+	* a size depending only on Length. PartialSum(Begin, End) sums each chunk
+	* serially, and the chunk sums are then added in order.
+	*
+	* Input --
+	* Length: the number of terms
+	* PartialSum: a callable (Begin, End) -> double summing terms [Begin, End)
+	*
+	* Output -- the sum.
+	*/
+	const long MaxChunks = 256;
+	const unsigned long MinChunk = 4096;
+	unsigned long Chunk = std::max(MinChunk, (Length + MaxChunks - 1) / MaxChunks);
+	long Chunks = static_cast<long>((Length + Chunk - 1) / Chunk);
+	if (Chunks <= 1) {
+		return PartialSum(0, Length);
+	}
+
+	double Partials[MaxChunks];
+	#pragma omp parallel for num_threads(GetThreadCount()) schedule(static)
+	for (long c = 0; c < Chunks; ++c) {
+		unsigned long Begin = c * Chunk;
+		Partials[c] = PartialSum(Begin, std::min(Begin + Chunk, Length));
+	}
+
+	double Sum = 0.0;
+	for (long c = 0; c < Chunks; ++c) {
+		Sum += Partials[c];
+	}
+	return Sum;
+}
 
 /* Image Operations */
 int RightNeighbor(unsigned int index, unsigned long SideLength);
@@ -61,11 +145,153 @@ int DownNeighbor(unsigned int index, unsigned long SideLength);
 
 /* File I/O */
 // Image
+// Images are read as their gray intensity in [0, 1], at the full precision
+// of the file, and written from values in [0, 1] with Depth bits per pixel,
+// 8 unless the caller asks for IMAGE_DEPTH_16 or IMAGE_DEPTH_FLOAT (32-bit
+// floating point, where the format has it).
+// Netpbm files (".pgm" and ".pfm", see below) are converted directly, and
+// resized with ResizeMatrix when LoadImage is given new dimensions; other
+// formats go through Magick++, one whole image per conversion.
+enum ImageDepth { IMAGE_DEPTH_8 = 8, IMAGE_DEPTH_16 = 16, IMAGE_DEPTH_FLOAT = 32 };
 BoostDoubleMatrix ImageToMatrix(Magick::Image AnImage);
 BoostDoubleMatrix LoadImage(const char* ImageFileName);
 BoostDoubleMatrix LoadImage(const char* ImageFileName, int newRows, int newCols);
-void WriteImage(BoostDoubleMatrix AMatrix, const char* OutputFile);
+void WriteImage(const BoostDoubleMatrix &AMatrix, const char* OutputFile,
+	ImageDepth Depth = IMAGE_DEPTH_8);
+// Netpbm: binary PGM ("P5", 8 or 16 bits) and grayscale PFM ("Pf", float32,
+// stored unscaled, so values outside [0, 1] survive). WriteNetpbm writes
+// PFM for IMAGE_DEPTH_FLOAT and PGM otherwise. Errors (missing file, bad
+// header, truncated data) are thrown as std::runtime_error
+BoostDoubleMatrix ReadNetpbm(const char* ImageFileName);
+void WriteNetpbm(const char* ImageFileName, const BoostDoubleMatrix &AMatrix,
+	ImageDepth Depth = IMAGE_DEPTH_8);
+bool IsNetpbmFileName(const char* FileName);
 // Raw Data
-BoostDoubleVector ReadTiltAngles(char* TiltAngleFile);
+BoostDoubleVector ReadTiltAngles(const char* TiltAngleFile);
+
+/* Raw Binary Format */
+// A raw file is a RawHeader, then Angles tilt angles (float64), then
+// Rows*Cols*Slices values of the given type. Each slice is stored column by
+// column, as rasterized by MatrixToVector, and slices follow each other, so a
+// stored (L x O) sinogram slice is directly a measurement vector and a stack
+// of (L x L) slices is a volume for tval3_volume_reconstruction. All fields
+// are in the byte order of the writing machine; readers reject the other.
+enum RawDataType {RAW_FLOAT32 = 4, RAW_FLOAT64 = 8};
+const uint32_t RawFormatVersion = 1;
+
+struct RawHeader {
+	char Magic[8];          // "CTVMRAW" and a terminating null
+	uint32_t ByteOrder;     // 0x01020304 as written
+	uint32_t Version;       // RawFormatVersion
+	uint32_t DataType;      // a RawDataType, the size of one value in bytes
+	uint32_t Reserved;
+	uint64_t Rows, Cols, Slices;
+	uint64_t Angles;        // the number of tilt angles, possibly 0
+	uint64_t DataOffset;    // the byte offset of the first value
+};
+
+/*
+* Class: MappedFile
+* -----------------
+* A read-only mapping of a whole file (mmap, or a file mapping on Windows).
+* Pages are loaded by the OS as Data() is touched; WillNeed asks it to start
+* loading a range ahead of use. Errors are thrown as std::runtime_error,
+* with messages starting with Description and the file name.
+*/
+class MappedFile {
+public:
+	MappedFile(const char* FileName, const char* Description);
+	~MappedFile();
+
+	// The Size() bytes of the file; NULL for an empty file
+	const unsigned char *Data() const;
+	size_t Size() const;
+	void WillNeed(size_t Offset, size_t Count) const;
+
+private:
+	// The mapping is owned, so it cannot be copied
+	MappedFile(const MappedFile &);
+	MappedFile &operator=(const MappedFile &);
+	void Release();
+
+	const unsigned char *Base;
+	size_t Length;
+#ifdef _WIN32
+	void *FileHandle, *MappingHandle;
+#endif
+};
+
+/*
+* Class: RawFile
+* --------------
+* A read-only view of a raw file mapped into memory with MappedFile.
+* Nothing is read on construction beyond the header; pages are loaded by the
+* OS as Data() is touched, so slices of multi-gigabyte stacks can be used
+* without copying the file. Errors (missing file, bad header, truncated
+* data) are thrown as std::runtime_error.
+*/
+class RawFile {
+public:
+	explicit RawFile(const char* RawFileName);
+
+	unsigned long Rows() const;
+	unsigned long Cols() const;
+	unsigned long Slices() const;
+	RawDataType DataType() const;
+	BoostDoubleVector TiltAngles() const;
+
+	// Zero-copy access to the Rows*Cols*Slices stored values
+	const void *Data() const;
+	const float *FloatData() const;
+	const double *DoubleData() const;
+
+	// Slice k converted to double, as a matrix or as its rasterized vector
+	BoostDoubleMatrix Slice(unsigned long k) const;
+	BoostDoubleVector SliceVector(unsigned long k) const;
+
+private:
+	// The mapping is owned, so the view cannot be copied
+	RawFile(const RawFile &);
+	RawFile &operator=(const RawFile &);
+
+	MappedFile Mapping;
+	RawHeader Header;
+	const unsigned char *Base;
+};
+
+/*
+* Class: RawWriter
+* ----------------
+* Writes a raw file one slice at a time, so that a stack can be written as
+* it is produced without holding it in memory. The header, with the final
+* slice count, is written on construction and each WriteSlice appends one
+* slice with a single write. Close() reports write errors and missing
+* slices as std::runtime_error.
+*/
+class RawWriter {
+public:
+	RawWriter(const char* RawFileName, unsigned long Rows, unsigned long Cols, unsigned long Slices,
+		const BoostDoubleVector &TiltAngles, RawDataType DataType = RAW_FLOAT32);
+	~RawWriter();
+
+	void WriteSlice(const BoostDoubleMatrix &AMatrix);
+	void Close();
+
+private:
+	RawWriter(const RawWriter &);
+	RawWriter &operator=(const RawWriter &);
+
+	std::string FileName;
+	FILE *Output;
+	unsigned long Rows, Cols, Slices, Written;
+	RawDataType DataType;
+	std::vector<unsigned char> Buffer;
+};
+
+void WriteRaw(const char* RawFileName, const BoostDoubleMatrix &AMatrix,
+	const BoostDoubleVector &TiltAngles, RawDataType DataType = RAW_FLOAT32);
+void WriteRaw(const char* RawFileName, const std::vector<BoostDoubleMatrix> &Slices,
+	const BoostDoubleVector &TiltAngles, RawDataType DataType = RAW_FLOAT32);
+bool IsRawFileName(const char* FileName);
 
 #endif
\ No newline at end of file
@@ -1,7 +1,8 @@
+#include <chrono>
 #include "ctvm.h"
 
 
-BoostDoubleVector PixelGradient(BoostDoubleVector X, unsigned long Index,
+BoostDoubleVector PixelGradient(const BoostDoubleVector &X, unsigned long Index,
 	unsigned long SideLength) {
 	/*
 	* Function: PixelGradient
@@ -31,7 +32,178 @@ BoostDoubleVector PixelGradient(BoostDoubleVector X, unsigned long Index,
 	return Gradient;
 }
 
-BoostDoubleMatrix AllPixelGradients(BoostDoubleVector X, unsigned long SideLength) {
+void ForwardDifference(const double *X, unsigned long SideLength, double *Dh, double *Dv) {
+	/*
+	* Function: ForwardDifference
+	* ---------------------------
+	* Forward-difference gradient of a column-major (L x L) image, written as
+	* two contiguous planes. Matches PixelGradient at every pixel:
+	*
+	*       Dh[p] = X[p] - X[p+L]   (zero on the last column)
+	*       Dv[p] = X[p] - X[p+1]   (zero on the last row)
+	*
+	* The image is walked one column at a time with the boundary rows and
+	* columns peeled off, so the inner loops are unit-stride and branch-free.
+	*
+	* Input --
+	* X: an (N x 1) column-major image, N = SideLength^2
+	* SideLength: the length of the image side
+	* Dh, Dv: (N x 1) output planes for the horizontal and vertical components
+	*
+	* Output -- None.
+	*/
+	ForwardDifferenceSlab(X, NULL, SideLength, SideLength, Dh, Dv);
+}
+
+void ForwardDifferenceSlab(const double *X, const double *NextColumn, unsigned long Rows,
+	unsigned long Columns, double *Dh, double *Dv) {
+	/*
+	* Function: ForwardDifferenceSlab
+	* -------------------------------
+	* ForwardDifference over a slab of consecutive columns of an image with
+	* Rows rows, given the column to the right of the slab.
+	*
+	* Input --
+	* X: a (Rows x Columns) column-major slab
+	* NextColumn: the (Rows x 1) column after the slab, or NULL when the slab
+	*             ends the image
+	* Dh, Dv: (Rows*Columns x 1) output planes
+	*
+	* Output -- None.
+	*/
+	unsigned long L = Rows;
+	if (L == 0) {
+		return;
+	}
+
+	// Columns are independent
+	long Count = static_cast<long>(Columns);
+	#pragma omp parallel for num_threads(GetThreadCount()) schedule(static) if(L*Columns >= ParallelMinimumWork)
+	for (long Column = 0; Column < Count; ++Column) {
+		unsigned long j = Column;
+		const double *Col = X + j*L;
+		double *ColDh = Dh + j*L;
+		double *ColDv = Dv + j*L;
+
+		const double *NextCol = (j + 1 < Columns) ? Col + L : NextColumn;
+		if (NextCol) {
+			for (unsigned long i = 0; i < L; ++i) {
+				ColDh[i] = Col[i] - NextCol[i];
+			}
+		}
+		else {
+			for (unsigned long i = 0; i < L; ++i) {
+				ColDh[i] = 0.0;
+			}
+		}
+
+		for (unsigned long i = 0; i + 1 < L; ++i) {
+			ColDv[i] = Col[i] - Col[i + 1];
+		}
+		ColDv[L - 1] = 0.0;
+	}
+}
+
+void ForwardDifferenceAdjoint(const double *Gh, const double *Gv, unsigned long SideLength,
+	double *X) {
+	/*
+	* Function: ForwardDifferenceAdjoint
+	* ----------------------------------
+	* Adjoint of ForwardDifference (a negative divergence), evaluated as a
+	* gather so that every output pixel is written exactly once:
+	*
+	*       X[p] = (-Gh[p-L] - Gv[p-1]) + (Gh[p] + Gv[p])
+	*
+	* with the terms reaching outside the image dropped on the first column
+	* and first row. The summation order matches the scatter loop of the
+	* original PixelGradientAdjointSum, so results are bit-identical.
+	*
+	* Input --
+	* Gh, Gv: (N x 1) horizontal and vertical gradient planes, N = SideLength^2
+	* SideLength: the length of the image side
+	* X: the (N x 1) column-major output image; must not alias Gh or Gv
+	*
+	* Output -- None.
+	*/
+	ForwardDifferenceAdjointSlab(Gh, Gv, NULL, SideLength, SideLength, X);
+}
+
+static inline void AdjointColumn(const double *ColGh, const double *ColGv, const double *PrevColGh,
+	unsigned long L, double *ColX) {
+	ColX[0] = -PrevColGh[0] + (ColGh[0] + ColGv[0]);
+	for (unsigned long i = 1; i < L; ++i) {
+		ColX[i] = (-PrevColGh[i] + -ColGv[i - 1]) + (ColGh[i] + ColGv[i]);
+	}
+}
+
+void ForwardDifferenceAdjointSlab(const double *Gh, const double *Gv, const double *PreviousGh,
+	unsigned long Rows, unsigned long Columns, double *X) {
+	/*
+	* Function: ForwardDifferenceAdjointSlab
+	* --------------------------------------
+	* ForwardDifferenceAdjoint over a slab of consecutive columns of an image
+	* with Rows rows, given the horizontal gradient of the column to the left
+	* of the slab.
+	*
+	* Input --
+	* Gh, Gv: (Rows*Columns x 1) gradient planes of the slab
+	* PreviousGh: the (Rows x 1) horizontal gradient of the column before the
+	*             slab, or NULL when the slab starts the image
+	* X: the (Rows x Columns) output slab; must not alias Gh or Gv
+	*
+	* Output -- None.
+	*/
+	unsigned long L = Rows;
+	if (L == 0 || Columns == 0) {
+		return;
+	}
+
+	if (PreviousGh) {
+		AdjointColumn(Gh, Gv, PreviousGh, L, X);
+	}
+	else {
+		// First column: no left neighbour
+		X[0] = Gh[0] + Gv[0];
+		for (unsigned long i = 1; i < L; ++i) {
+			X[i] = -Gv[i - 1] + (Gh[i] + Gv[i]);
+		}
+	}
+
+	long Count = static_cast<long>(Columns);
+	#pragma omp parallel for num_threads(GetThreadCount()) schedule(static) if(L*Columns >= ParallelMinimumWork)
+	for (long Column = 1; Column < Count; ++Column) {
+		unsigned long j = Column;
+		AdjointColumn(Gh + j*L, Gv + j*L, Gh + (j - 1)*L, L, X + j*L);
+	}
+}
+
+void AllPixelGradients(const BoostDoubleVector &X, unsigned long SideLength,
+	BoostGradientMatrix &AllGradients) {
+	/*
+	* Function: AllPixelGradients
+	* ---------------------------
+	* Given a rasterized image vector, calculate the gradient vectors at every pixel
+	* and store the entire set of gradients in a preallocated matrix.
+	*
+	* Input --
+	* X: a (N x 1) vector representing a rasterized image
+	* SideLength: assuming square image dimensions, the length of the image side.
+	*             I.e. N = SideLength^2.
+	* AllGradients: the (N x 2) output matrix, resized only if necessary.
+	*
+	* Output -- None.
+	*/
+	unsigned long N = X.size();
+	AllGradients.resize(N, 2, false);
+	if (N == 0) {
+		return;
+	}
+
+	double *G = AllGradients.data().begin();
+	ForwardDifference(X.data().begin(), SideLength, G + HORZ*N, G + VERT*N);
+}
+
+BoostGradientMatrix AllPixelGradients(const BoostDoubleVector &X, unsigned long SideLength) {
 	/*
 	* Function: AllPixelGradients
 	* ---------------------------
@@ -45,17 +217,30 @@ BoostDoubleMatrix AllPixelGradients(BoostDoubleVector X, unsigned long SideLengt
 	*
 	* Output -- A (N x 2) pixel gradient vector.
 	*/
-	unsigned long N = X.size();
-	BoostDoubleMatrix AllGradients(N, 2);
+	BoostGradientMatrix AllGradients(X.size(), 2);
+	AllPixelGradients(X, SideLength, AllGradients);
+	return AllGradients;
+}
 
-	for (unsigned long i = 0; i < N; ++i) {
-		SetRow(AllGradients, PixelGradient(X, i, SideLength), i);
+void PixelGradientAdjointSum(const BoostGradientMatrix &G, unsigned long SideLength,
+	BoostDoubleVector &ImageVector) {
+	/*
+	* Function: PixelGradientAdjointSum
+	* ---------------------------------
+	* Output-parameter form of PixelGradientAdjointSum below. ImageVector is
+	* resized only if necessary and must not alias G.
+	*/
+	unsigned long N = G.size1();
+	ImageVector.resize(N, false);
+	if (N == 0) {
+		return;
 	}
 
-	return AllGradients;
+	const double *GData = G.data().begin();
+	ForwardDifferenceAdjoint(GData + HORZ*N, GData + VERT*N, SideLength, ImageVector.data().begin());
 }
 
-BoostDoubleVector PixelGradientAdjointSum(BoostDoubleMatrix G, unsigned long SideLength) {
+BoostDoubleVector PixelGradientAdjointSum(const BoostGradientMatrix &G, unsigned long SideLength) {
 	/*
 	* Function: PixelGradientAdjointSum
 	* ---------------------------------
@@ -75,26 +260,301 @@ BoostDoubleVector PixelGradientAdjointSum(BoostDoubleMatrix G, unsigned long Sid
 	*
 	* Output -- A (N x 1) rasterized image vector.
 	*/
-	unsigned long N = G.size1();
-	BoostDoubleVector ImageVector = BoostZeroVector(N);
-	for (unsigned long i = 0; i < N; ++i) {
-		int thisRightNeighbor = RightNeighbor(i, SideLength);
-		int thisDownNeighbor = DownNeighbor(i, SideLength);
-		BoostDoubleVector thisGradient = GetRow(G, i);
+	BoostDoubleVector ImageVector(G.size1());
+	PixelGradientAdjointSum(G, SideLength, ImageVector);
+	return ImageVector;
+}
+
+BoostDoubleVector VoxelGradient(const BoostDoubleVector &X, unsigned long Index,
+	unsigned long SideLength) {
+	/*
+	* Function: VoxelGradient
+	* -----------------------
+	* Given a rasterized volume vector, calculate the three-dimensional
+	* gradient vector at the specified index. Like PixelGradient, each
+	* component is a forward difference, zero where the neighbour lies outside
+	* the volume.
+	*
+	* Input --
+	* X: an (N x 1) vector representing a rasterized volume of (L x L) slices,
+	*    N = SideLength^2 * Depth
+	* Index: the voxel at which to calculate the gradient
+	* SideLength: the side length of each slice
+	*
+	* Output -- A (3 x 1) voxel gradient vector.
+	*/
+	unsigned long L = SideLength;
+	unsigned long S = L * L;
+	unsigned long Depth = X.size() / S;
+	unsigned long i = Index % L, j = (Index / L) % L, k = Index / S;
+	BoostDoubleVector Gradient = BoostZeroVector(3);
+
+	Gradient(HORZ) = (j + 1 < L) ? (X[Index] - X[Index + L]) : 0.0;
+	Gradient(VERT) = (i + 1 < L) ? (X[Index] - X[Index + 1]) : 0.0;
+	Gradient(AXIAL) = (k + 1 < Depth) ? (X[Index] - X[Index + S]) : 0.0;
 
-		ImageVector(i) += thisGradient(HORZ) + thisGradient(VERT);
-		if (thisRightNeighbor > 0) {
-			ImageVector(thisRightNeighbor) += -1 * thisGradient(HORZ);
+	return Gradient;
+}
+
+// Volume stencils walk tiles of whole columns, all slices of one tile before
+// the next, so each slice's axial neighbour was read (at most) one tile ago
+// instead of one full slice ago: a tile of one slice holds at most
+// VolumeTileElements values. Tiles are also the unit of parallel work.
+static const unsigned long VolumeTileElements = 8192;
+
+static unsigned long VolumeTileColumns(unsigned long SideLength) {
+	// At least 8 tiles per slice where possible, to share between threads
+	unsigned long Columns = std::min(VolumeTileElements / SideLength, SideLength / 8);
+	return std::max(Columns, 1UL);
+}
+
+void ForwardDifference3D(const double *X, unsigned long SideLength, unsigned long Depth,
+	double *Dh, double *Dv, double *Da) {
+	/*
+	* Function: ForwardDifference3D
+	* -----------------------------
+	* Forward-difference gradient of a volume of Depth column-major (L x L)
+	* slices, written as three contiguous planes. Matches VoxelGradient at
+	* every voxel:
+	*
+	*       Dh[p] = X[p] - X[p+L]     (zero on the last column of each slice)
+	*       Dv[p] = X[p] - X[p+1]     (zero on the last row of each slice)
+	*       Da[p] = X[p] - X[p+L^2]   (zero on the last slice)
+	*
+	* Input --
+	* X: an (N x 1) volume, N = SideLength^2 * Depth
+	* SideLength: the side length of each slice
+	* Depth: the number of slices
+	* Dh, Dv, Da: (N x 1) output planes for the three components
+	*
+	* Output -- None.
+	*/
+	unsigned long L = SideLength;
+	unsigned long S = L * L;
+	if (L == 0 || Depth == 0) {
+		return;
+	}
+
+	unsigned long TileColumns = VolumeTileColumns(L);
+	long Tiles = static_cast<long>((L + TileColumns - 1) / TileColumns);
+	#pragma omp parallel for num_threads(GetThreadCount()) schedule(static) if(S*Depth >= ParallelMinimumWork)
+	for (long Tile = 0; Tile < Tiles; ++Tile) {
+		unsigned long FirstColumn = Tile * TileColumns;
+		unsigned long EndColumn = std::min(L, FirstColumn + TileColumns);
+		for (unsigned long k = 0; k < Depth; ++k) {
+			for (unsigned long j = FirstColumn; j < EndColumn; ++j) {
+				unsigned long Offset = k*S + j*L;
+				const double *Col = X + Offset;
+				double *ColDh = Dh + Offset;
+				double *ColDv = Dv + Offset;
+				double *ColDa = Da + Offset;
+
+				if (j + 1 < L) {
+					const double *NextCol = Col + L;
+					for (unsigned long i = 0; i < L; ++i) {
+						ColDh[i] = Col[i] - NextCol[i];
+					}
+				}
+				else {
+					for (unsigned long i = 0; i < L; ++i) {
+						ColDh[i] = 0.0;
+					}
+				}
+
+				for (unsigned long i = 0; i + 1 < L; ++i) {
+					ColDv[i] = Col[i] - Col[i + 1];
+				}
+				ColDv[L - 1] = 0.0;
+
+				if (k + 1 < Depth) {
+					const double *NextSliceCol = Col + S;
+					for (unsigned long i = 0; i < L; ++i) {
+						ColDa[i] = Col[i] - NextSliceCol[i];
+					}
+				}
+				else {
+					for (unsigned long i = 0; i < L; ++i) {
+						ColDa[i] = 0.0;
+					}
+				}
+			}
 		}
-		if (thisDownNeighbor > 0) {
-			ImageVector(thisDownNeighbor) += -1 * thisGradient(VERT);
+	}
+}
+
+template <bool PrevColumn, bool PrevSlice>
+static inline void AdjointColumn3D(const double *ColGh, const double *ColGv, const double *ColGa,
+	unsigned long L, unsigned long S, double *ColX) {
+	/*
+	* Function: AdjointColumn3D
+	* -------------------------
+	* One column of ForwardDifferenceAdjoint3D. A neighbour outside the volume
+	* contributes -0.0, which leaves every sum unchanged, so its term is
+	* dropped at compile time.
+	*/
+	const double *PrevColGh = ColGh - L;
+	const double *PrevSliceGa = ColGa - S;
+	double Left = PrevColumn ? -PrevColGh[0] : -0.0;
+	double Back = PrevSlice ? -PrevSliceGa[0] : -0.0;
+	ColX[0] = (Left + Back) + ((ColGh[0] + ColGv[0]) + ColGa[0]);
+	for (unsigned long i = 1; i < L; ++i) {
+		Left = PrevColumn ? -PrevColGh[i] : -0.0;
+		Back = PrevSlice ? -PrevSliceGa[i] : -0.0;
+		ColX[i] = ((Left + -ColGv[i - 1]) + Back) + ((ColGh[i] + ColGv[i]) + ColGa[i]);
+	}
+}
+
+void ForwardDifferenceAdjoint3D(const double *Gh, const double *Gv, const double *Ga,
+	unsigned long SideLength, unsigned long Depth, double *X) {
+	/*
+	* Function: ForwardDifferenceAdjoint3D
+	* ------------------------------------
+	* Adjoint of ForwardDifference3D, evaluated as a gather with the same
+	* tiling:
+	*
+	*       X[p] = (-Gh[p-L] - Gv[p-1] - Ga[p-L^2]) + (Gh[p] + Gv[p] + Ga[p])
+	*
+	* with the terms reaching outside the volume dropped. For a single slice
+	* with Ga = 0 this is bit-identical to ForwardDifferenceAdjoint.
+	*
+	* Input --
+	* Gh, Gv, Ga: (N x 1) gradient planes, N = SideLength^2 * Depth
+	* SideLength: the side length of each slice
+	* Depth: the number of slices
+	* X: the (N x 1) output volume; must not alias the gradient planes
+	*
+	* Output -- None.
+	*/
+	unsigned long L = SideLength;
+	unsigned long S = L * L;
+	if (L == 0 || Depth == 0) {
+		return;
+	}
+
+	unsigned long TileColumns = VolumeTileColumns(L);
+	long Tiles = static_cast<long>((L + TileColumns - 1) / TileColumns);
+	#pragma omp parallel for num_threads(GetThreadCount()) schedule(static) if(S*Depth >= ParallelMinimumWork)
+	for (long Tile = 0; Tile < Tiles; ++Tile) {
+		unsigned long FirstColumn = Tile * TileColumns;
+		unsigned long EndColumn = std::min(L, FirstColumn + TileColumns);
+		for (unsigned long k = 0; k < Depth; ++k) {
+			for (unsigned long j = FirstColumn; j < EndColumn; ++j) {
+				unsigned long Offset = k*S + j*L;
+				if (j > 0 && k > 0) {
+					AdjointColumn3D<true, true>(Gh + Offset, Gv + Offset, Ga + Offset, L, S, X + Offset);
+				}
+				else if (j > 0) {
+					AdjointColumn3D<true, false>(Gh + Offset, Gv + Offset, Ga + Offset, L, S, X + Offset);
+				}
+				else if (k > 0) {
+					AdjointColumn3D<false, true>(Gh + Offset, Gv + Offset, Ga + Offset, L, S, X + Offset);
+				}
+				else {
+					AdjointColumn3D<false, false>(Gh + Offset, Gv + Offset, Ga + Offset, L, S, X + Offset);
+				}
+			}
 		}
 	}
+}
 
-	return ImageVector;
+void AllVoxelGradients(const BoostDoubleVector &X, unsigned long SideLength,
+	BoostGradientMatrix &AllGradients) {
+	/*
+	* Function: AllVoxelGradients
+	* ---------------------------
+	* Given a rasterized volume vector, calculate the gradient vectors at every
+	* voxel and store them in a preallocated matrix.
+	*
+	* Input --
+	* X: an (N x 1) vector representing a rasterized volume
+	* SideLength: the side length of each slice; N = SideLength^2 * Depth
+	* AllGradients: the (N x 3) output matrix, resized only if necessary.
+	*
+	* Output -- None.
+	*/
+	unsigned long N = X.size();
+	AllGradients.resize(N, 3, false);
+	if (N == 0) {
+		return;
+	}
+
+	double *G = AllGradients.data().begin();
+	ForwardDifference3D(X.data().begin(), SideLength, N / (SideLength * SideLength),
+		G + HORZ*N, G + VERT*N, G + AXIAL*N);
+}
+
+BoostGradientMatrix AllVoxelGradients(const BoostDoubleVector &X, unsigned long SideLength) {
+	/*
+	* Function: AllVoxelGradients
+	* ---------------------------
+	* Allocating form of AllVoxelGradients.
+	*
+	* Output -- A (N x 3) voxel gradient matrix.
+	*/
+	BoostGradientMatrix AllGradients(X.size(), 3);
+	AllVoxelGradients(X, SideLength, AllGradients);
+	return AllGradients;
+}
+
+void VoxelGradientAdjointSum(const BoostGradientMatrix &G, unsigned long SideLength,
+	BoostDoubleVector &VolumeVector) {
+	/*
+	* Function: VoxelGradientAdjointSum
+	* ---------------------------------
+	* Output-parameter form of VoxelGradientAdjointSum below. VolumeVector is
+	* resized only if necessary and must not alias G.
+	*/
+	unsigned long N = G.size1();
+	VolumeVector.resize(N, false);
+	if (N == 0) {
+		return;
+	}
+
+	const double *GData = G.data().begin();
+	ForwardDifferenceAdjoint3D(GData + HORZ*N, GData + VERT*N, GData + AXIAL*N, SideLength,
+		N / (SideLength * SideLength), VolumeVector.data().begin());
+}
+
+BoostDoubleVector VoxelGradientAdjointSum(const BoostGradientMatrix &G, unsigned long SideLength) {
+	/*
+	* Function: VoxelGradientAdjointSum
+	* ---------------------------------
+	* The three-dimensional counterpart of PixelGradientAdjointSum: the map
+	* X = sum_{i=1:N} D_i^T * G_i from voxel gradients back to the volume.
+	*
+	* Input --
+	* G: an (N x 3) matrix of voxel gradients
+	* SideLength: the side length of each slice; N = SideLength^2 * Depth
+	*
+	* Output -- A (N x 1) rasterized volume vector.
+	*/
+	BoostDoubleVector VolumeVector(G.size1());
+	VoxelGradientAdjointSum(G, SideLength, VolumeVector);
+	return VolumeVector;
+}
+
+// The solver's gradient and adjoint: pixel (2 planes) or voxel (3 planes)
+static void GradientField(const BoostDoubleVector &U, unsigned long SideLength,
+	unsigned long Planes, BoostGradientMatrix &Du) {
+	if (Planes == 3) {
+		AllVoxelGradients(U, SideLength, Du);
+	}
+	else {
+		AllPixelGradients(U, SideLength, Du);
+	}
+}
+
+static void GradientFieldAdjointSum(const BoostGradientMatrix &G, unsigned long SideLength,
+	BoostDoubleVector &X) {
+	if (G.size2() == 3) {
+		VoxelGradientAdjointSum(G, SideLength, X);
+	}
+	else {
+		PixelGradientAdjointSum(G, SideLength, X);
+	}
 }
 
-BoostDoubleVector ShrikeAnisotropic(BoostDoubleVector W, BoostDoubleVector Nu,
+BoostDoubleVector ShrikeAnisotropic(const BoostDoubleVector &W, const BoostDoubleVector &Nu,
 	double beta) {
 	/*
 	* Function: Shrike Anisotropic
@@ -110,13 +570,14 @@ BoostDoubleVector ShrikeAnisotropic(BoostDoubleVector W, BoostDoubleVector Nu,
 	*
 	* Output -- a (d x 1) "shriked" version of the gradient vector
 	*/
-	unsigned long d = W.size();
-	BoostDoubleVector WShifted = W - Nu / beta;
-	BoostDoubleVector WShriked = AbsoluteValueVector(WShifted) - BoostScalarDoubleVector(d, 1 / beta);
-	return HadamardProduct(MaxVector(WShriked, 0.0), SignVector(WShifted));
+	// A single (d x 1) vector is a gradient field of one pixel with d planes
+	BoostDoubleVector WShriked(W.size());
+	ShrikePlanes(W.data().begin(), Nu.data().begin(), 1, W.size(), beta, ANISOTROPIC,
+		WShriked.data().begin());
+	return WShriked;
 }
 
-BoostDoubleVector ShrikeIsotropic(BoostDoubleVector W, BoostDoubleVector Nu,
+BoostDoubleVector ShrikeIsotropic(const BoostDoubleVector &W, const BoostDoubleVector &Nu,
 	double beta) {
 	/*
 	* Function: Shrike Isotropic
@@ -132,169 +593,589 @@ BoostDoubleVector ShrikeIsotropic(BoostDoubleVector W, BoostDoubleVector Nu,
 	*
 	* Output -- a (d x 1) "shriked" version of the gradient vector
 	*/
-	BoostDoubleVector WShifted = W - Nu / beta;
-	double WShiftedNorm = norm_2(WShifted);
-	BoostDoubleVector result;
+	BoostDoubleVector WShriked(W.size());
+	ShrikePlanes(W.data().begin(), Nu.data().begin(), 1, W.size(), beta, ISOTROPIC,
+		WShriked.data().begin());
+	return WShriked;
+}
 
-	if (WShiftedNorm < 0.000000000001) {
-		result = BoostZeroVector(2);
-	}
-	else {
-		result = (fmax(WShiftedNorm - 1 / beta, 0.0) * (WShifted / WShiftedNorm));
-	}
+static inline double ShrikeScale(double WShifted, double WShiftedNorm, double InvBeta) {
+	// One component of the isotropic shrinkage, max(||w|| - 1/beta, 0) * w/||w||,
+	// with the near-zero norm case selected rather than branched on.
+	const double NormTol = 0.000000000001;
+	double Shrink = WShiftedNorm - InvBeta;
+	Shrink = (Shrink > 0.0) ? Shrink : 0.0;
+	double Scaled = Shrink * (WShifted / ((WShiftedNorm < NormTol) ? 1.0 : WShiftedNorm));
+	return (WShiftedNorm < NormTol) ? 0.0 : Scaled;
+}
 
-	return result;
+static inline void ShrikeIsotropicPair(double WShiftedH, double WShiftedV, double InvBeta,
+	double &WH, double &WV) {
+	double WShiftedNorm = sqrt(WShiftedH*WShiftedH + WShiftedV*WShiftedV);
+	WH = ShrikeScale(WShiftedH, WShiftedNorm, InvBeta);
+	WV = ShrikeScale(WShiftedV, WShiftedNorm, InvBeta);
 }
 
-BoostDoubleMatrix ApplyShrike(BoostDoubleMatrix AllW, BoostDoubleMatrix AllNu,
-	double beta, TVType ShrikeMode) {
+static inline double ShrikeAnisotropicValue(double WShifted, double InvBeta) {
+	// max(|w| - 1/beta, 0) * sign(w), with sign(0) = 1
+	double Shrink = std::abs(WShifted) - InvBeta;
+	Shrink = (Shrink > 0.0) ? Shrink : 0.0;
+	return (WShifted < 0.0) ? -Shrink : Shrink;
+}
+
+void ShrikePlanes(const double *W, const double *Nu, unsigned long N, unsigned long d,
+	double beta, TVType ShrikeMode, double *WShriked) {
 	/*
-	* Function: ApplyShrike
-	* ---------------------
-	* Applies the Shrinkage-like operator to every gradient in W.
+	* Function: ShrikePlanes
+	* ----------------------
+	* Batch shrinkage over a planar gradient field: component k of pixel i is
+	* stored at W[k*N + i]. Equivalent to applying ShrikeIsotropic or
+	* ShrikeAnisotropic at every pixel, but without any temporaries.
+	*
+	* Pixels are processed in fixed-size blocks; within a block every loop is
+	* unit-stride and the zero-norm and sign cases are selects rather than
+	* branches, so the compiler can vectorize both modes.
 	*
 	* Input --
-	*  W:    a (N x d) matrix of gradients (i.e. for 2-d images, d=2)
-	*  Nu:   a (N x d) set of multipliers
+	*  W:    (N x d) planar gradients
+	*  Nu:   (N x d) planar multipliers
+	*  N:    number of pixels
+	*  d:    number of gradient components (i.e. for 2-d images, d=2)
 	*  beta: a scalar scaling term
-	*  ShrikeMode: an Enum value of TVType whic specifies whether we use the
-	*              isotropic or anisotropic Shrike operator.
+	*  ShrikeMode: isotropic or anisotropic shrinkage
+	*  WShriked: (N x d) planar output; may alias W
 	*
-	* Output -- a (N x d) "shriked" version of the gradient matrix
+	* Output -- None.
 	*/
-	/* Problem Dimensions */
-	unsigned long N = AllW.size1();
+	const unsigned long Block = 256;
+	double InvBeta = 1 / beta;
 
-	for (unsigned long i = 0; i < N; ++i) {
-		BoostDoubleVector thisW = GetRow(AllW, i);
-		BoostDoubleVector thisNu = GetRow(AllNu, i);
-		BoostDoubleVector thisWShriked;
+	switch (ShrikeMode) {
+	case ISOTROPIC:
+	{
+		long Blocks = static_cast<long>((N + Block - 1) / Block);
+		#pragma omp parallel for num_threads(GetThreadCount()) schedule(static) if(N >= ParallelMinimumWork)
+		for (long b = 0; b < Blocks; ++b) {
+			unsigned long Start = b * Block;
+			unsigned long Count = std::min(Block, N - Start);
+			double Norm[Block];
 
-		switch (ShrikeMode) {
-		case ISOTROPIC:
-			thisWShriked = ShrikeIsotropic(thisW, thisNu, beta);
-			break;
-		case ANISOTROPIC:
-			thisWShriked = ShrikeAnisotropic(thisW, thisNu, beta);
-			break;
+			for (unsigned long i = 0; i < Count; ++i) {
+				Norm[i] = 0.0;
+			}
+			for (unsigned long k = 0; k < d; ++k) {
+				const double *Wk = W + k*N + Start;
+				const double *Nuk = Nu + k*N + Start;
+				for (unsigned long i = 0; i < Count; ++i) {
+					double WShifted = Wk[i] - Nuk[i] / beta;
+					Norm[i] += WShifted*WShifted;
+				}
+			}
+			for (unsigned long i = 0; i < Count; ++i) {
+				Norm[i] = sqrt(Norm[i]);
+			}
+
+			// W is only read in the passes above, so the output may alias it
+			for (unsigned long k = 0; k < d; ++k) {
+				const double *Wk = W + k*N + Start;
+				const double *Nuk = Nu + k*N + Start;
+				double *Outk = WShriked + k*N + Start;
+				for (unsigned long i = 0; i < Count; ++i) {
+					Outk[i] = ShrikeScale(Wk[i] - Nuk[i] / beta, Norm[i], InvBeta);
+				}
+			}
 		}
-		SetRow(AllW, thisWShriked, i);
+		break;
+	}
+	case ANISOTROPIC:
+		for (unsigned long k = 0; k < d; ++k) {
+			const double *Wk = W + k*N;
+			const double *Nuk = Nu + k*N;
+			double *Outk = WShriked + k*N;
+			long Pixels = static_cast<long>(N);
+			#pragma omp parallel for num_threads(GetThreadCount()) schedule(static) if(N >= ParallelMinimumWork)
+			for (long i = 0; i < Pixels; ++i) {
+				Outk[i] = ShrikeAnisotropicValue(Wk[i] - Nuk[i] / beta, InvBeta);
+			}
+		}
+		break;
 	}
-	return AllW;
 }
 
-double Lagrangian(BoostDoubleMatrix A, BoostDoubleVector U,
-	BoostDoubleVector B, BoostDoubleMatrix W,
-	BoostDoubleMatrix Nu, BoostDoubleVector Lambda,
-	double beta, double mu,
-	unsigned long SideLength, TVType GradNorm) {
+static inline void ForwardDifferenceShrikeColumn(const double *X, const double *NuH,
+	const double *NuV, unsigned long L, unsigned long j, unsigned long Begin, unsigned long End,
+	double beta, double InvBeta, TVType ShrikeMode, double *WH, double *WV) {
 	/*
-	* Function: Lagrangian
-	* --------------------
-	* Calculate the Lagrangian cost function for the give problem state.
-	*
-	* Input --
-	* A: an (M x N) projection matrix
-	* U: an (N x 1) vector representing a rasterized image prediction
-	* B: an (M x 1) set of observations
-	* W: an (N x 2) set of dual variables corresponding to per-pixel (-voxel) gradients
-	* Nu: an (N x 2) set of Lagrangian multipliers
-	* Lambda: an (M x 1) set of Lagrangian multiplies
-	* beta: scaling term on the matching between W and the true gradients
-	* mu: scaling term on the matching between A*u and b
-	* SideLength: the side length for the target image, i.e. N = SideLength^2
-	* GradNorm: which TV norm to use on the gradients (Iso- or Anisotropic)
-	*
-	* Output -- a decimal value for the cost.
+	* Function: ForwardDifferenceShrikeColumn
+	* ---------------------------------------
+	* ForwardDifferenceShrike over the rows Begin .. End-1 of column j of an
+	* (L x L) image.
 	*/
-	double L = 0.0;
+	const double *Col = X + j*L;
+	const double *NextCol = (j + 1 < L) ? Col + L : Col;
+	const double *ColNuH = NuH + j*L, *ColNuV = NuV + j*L;
+	double *ColWH = WH + j*L, *ColWV = WV + j*L;
+	unsigned long Last = L - 1;
+	unsigned long Stop = std::min(End, Last);
 
-	// Get all Gradients
-	BoostDoubleMatrix Du = AllPixelGradients(U, SideLength);
-
-	// Loop over pixels
-	BoostDoubleVector Dui;
-	BoostDoubleVector Wi;
-	BoostDoubleVector Nui;
-	for (unsigned long i = 0; i < U.size(); ++i) {
-		Dui = GetRow(Du, i);
-		Wi = GetRow(W, i);
-		Nui = GetRow(Nu, i);
-
-		BoostDoubleVector GradDiff = Dui - Wi;
-		L += -inner_prod(Nui, GradDiff) + (beta / 2) * SquareNorm(GradDiff);
-
-		switch (GradNorm) {
-		case ISOTROPIC:
-			L += norm_2(Wi);
-			break;
-		case ANISOTROPIC:
-			L += norm_1(Wi);
-			break;
+	switch (ShrikeMode) {
+	case ISOTROPIC:
+		for (unsigned long i = Begin; i < Stop; ++i) {
+			ShrikeIsotropicPair((Col[i] - NextCol[i]) - ColNuH[i] / beta,
+				(Col[i] - Col[i + 1]) - ColNuV[i] / beta, InvBeta, ColWH[i], ColWV[i]);
+		}
+		// The last row has no down neighbour
+		if (End == L) {
+			ShrikeIsotropicPair((Col[Last] - NextCol[Last]) - ColNuH[Last] / beta,
+				0.0 - ColNuV[Last] / beta, InvBeta, ColWH[Last], ColWV[Last]);
 		}
+		break;
+	case ANISOTROPIC:
+		for (unsigned long i = Begin; i < Stop; ++i) {
+			ColWH[i] = ShrikeAnisotropicValue((Col[i] - NextCol[i]) - ColNuH[i] / beta, InvBeta);
+			ColWV[i] = ShrikeAnisotropicValue((Col[i] - Col[i + 1]) - ColNuV[i] / beta, InvBeta);
+		}
+		if (End == L) {
+			ColWH[Last] = ShrikeAnisotropicValue((Col[Last] - NextCol[Last]) - ColNuH[Last] / beta,
+				InvBeta);
+			ColWV[Last] = ShrikeAnisotropicValue(0.0 - ColNuV[Last] / beta, InvBeta);
+		}
+		break;
 	}
-
-	// Residual Contribution
-	BoostDoubleVector Residual = prod(A, U) - B;
-	L += -inner_prod(Lambda, Residual) + (mu / 2)*SquareNorm(Residual);
-
-	return L;
 }
 
-BoostDoubleVector Onestep_Direction(BoostDoubleMatrix A, BoostDoubleVector U,
-	BoostDoubleVector B, BoostDoubleMatrix W,
-	BoostDoubleMatrix Nu, BoostDoubleVector Lambda,
-	double beta, double mu,
-	unsigned long SideLength) {
+void ForwardDifferenceShrike(const double *X, const double *NuH, const double *NuV,
+	unsigned long SideLength, double beta, TVType ShrikeMode, double *WH, double *WV) {
 	/*
-	* Function: Onestep_Direction
-	* ---------------------------
-	* Calculate the direction for the gradient in the one-step steepest descent method.
-	* To understand this following command, one can separate it in two steps
-	* (that is, the sum over all the pixels) Du = AllPixelGradients(U,SideLength)
-	*										 Dk = -PixelGradientAdjointSum(beta*Du + beta*W + Nu) + mu*A'*(A*u - b) - A'*lambda
+	* Function: ForwardDifferenceShrike
+	* ---------------------------------
+	* Fused ForwardDifference and ShrikePlanes for a 2-d image,
+	*
+	*       W = shrike(D*X - Nu/beta)
+	*
+	* in a single pass over memory, without materialising D*X. Each column of
+	* the image is differenced against its right neighbour (itself, for the
+	* last column, which yields exact zeros) and shrunk immediately.
 	*
 	* Input --
-	* A: an (M x N) projection matrix
-	* U: an (N x 1) vector representing a rasterized image prediction
-	* B: an (M x 1) set of observations
-	* W: an (N x 2) set of dual variables corresponding to per-pixel (-voxel) gradients
-	* Nu: an (N x 2) set of Lagrangian multipliers
-	* Lambda: an (M x 1) set of Lagrangian multiplies
-	* beta: scaling term on the matching between W and the true gradients
-	* mu: scaling term on the matching between A*u and b
-	* SideLength: the side length for the target image, i.e. N = SideLength^2
+	* X: an (N x 1) column-major image, N = SideLength^2
+	* NuH, NuV: (N x 1) planes of multipliers
+	* SideLength: the length of the image side
+	* beta: a scalar scaling term
+	* ShrikeMode: isotropic or anisotropic shrinkage
+	* WH, WV: (N x 1) output planes
 	*
-	* Output -- a decimal value for the cost.
+	* Output -- None.
 	*/
-	BoostDoubleVector Dk = BoostZeroVector(U.size());
-
-	// BoostDoubleVector NegAdjSum = -PixelGradientAdjointSum(beta*AllPixelGradients(U, SideLength) + beta*W + NU, SideLength);
-	// BoostDoubleVector TermTwo = mu*prod(trans(A), prod(A, U) - B);
-	// BoostDoubleVector TermThree = - prod(trans(A), LAMBDA);
-	// BoostDoubleMatrix grads  = AllPixelGradients(U,SideLength);
-
-	// using namespace std;
-	// cout<<" > Inside Onestep_Direction():"<<endl;
-	// cout<<"    * PixelGradients: "<<grads<<endl;
-	// cout<<"    * beta: "<<beta<<endl;
-	// cout<<"    * W: "<<W<<endl;
-	// cout<<"    * Nu: "<<NU<<endl;
-	// cout<<"    * NegAdjSum :"<<NegAdjSum<<endl;
-	// cout<<"    * Term2 :"<<TermTwo<<endl;
-	// cout<<"    * Term3 :"<<TermThree<<endl;
-
+	unsigned long L = SideLength;
+	double InvBeta = 1 / beta;
 
-	Dk = -PixelGradientAdjointSum(beta*AllPixelGradients(U, SideLength) + beta*W + Nu, SideLength) + mu*prod(trans(A), prod(A, U) - B) - prod(trans(A), Lambda);
-
-	return Dk;
+	long Columns = static_cast<long>(L);
+	#pragma omp parallel for num_threads(GetThreadCount()) schedule(static) if(L*L >= ParallelMinimumWork)
+	for (long Column = 0; Column < Columns; ++Column) {
+		ForwardDifferenceShrikeColumn(X, NuH, NuV, L, Column, 0, L, beta, InvBeta, ShrikeMode, WH, WV);
+	}
 }
 
-double U_Subfunction(BoostDoubleMatrix A, BoostDoubleVector U,
-	BoostDoubleVector B, BoostDoubleMatrix W,
-	BoostDoubleMatrix Nu, BoostDoubleVector Lambda,
-	double beta, double mu,
-	unsigned long SideLength)
+void ApplyShrike(const BoostGradientMatrix &AllW, const BoostGradientMatrix &AllNu,
+	double beta, TVType ShrikeMode, BoostGradientMatrix &AllWShriked) {
+	/*
+	* Function: ApplyShrike
+	* ---------------------
+	* Output-parameter form of ApplyShrike below, evaluated by ShrikePlanes
+	* directly on the gradient planes. AllWShriked is resized only if
+	* necessary and may alias AllW.
+	*/
+	unsigned long N = AllW.size1();
+	unsigned long d = AllW.size2();
+	AllWShriked.resize(N, d, false);
+	if (N == 0) {
+		return;
+	}
+
+	ShrikePlanes(AllW.data().begin(), AllNu.data().begin(), N, d, beta, ShrikeMode,
+		AllWShriked.data().begin());
+}
+
+void ApplyGradientShrike(const BoostDoubleVector &U, const BoostGradientMatrix &Nu,
+	double beta, TVType ShrikeMode, unsigned long SideLength, BoostGradientMatrix &W) {
+	/*
+	* Function: ApplyGradientShrike
+	* -----------------------------
+	* The w-subproblem of the alternating minimisation in one pass,
+	*
+	*       W = ApplyShrike(AllPixelGradients(U), Nu, beta, ShrikeMode)
+	*
+	* For volumes (Nu with three planes) the gradients are computed into W
+	* and shrunk in place.
+	*
+	* Input --
+	* U: an (N x 1) vector representing a rasterized image prediction
+	* Nu: an (N x d) set of Lagrangian multipliers, d = 2 or 3
+	* beta: a scalar scaling term
+	* ShrikeMode: isotropic or anisotropic shrinkage
+	* SideLength: the side length for the target image, i.e. N = SideLength^2
+	*             (times the depth, for volumes)
+	* W: the (N x d) output, resized only if necessary
+	*
+	* Output -- None.
+	*/
+	unsigned long N = U.size();
+	if (Nu.size2() == 3) {
+		AllVoxelGradients(U, SideLength, W);
+		ShrikePlanes(W.data().begin(), Nu.data().begin(), N, 3, beta, ShrikeMode, W.data().begin());
+		return;
+	}
+	W.resize(N, 2, false);
+	if (N == 0) {
+		return;
+	}
+
+	const double *NuData = Nu.data().begin();
+	double *WData = W.data().begin();
+	ForwardDifferenceShrike(U.data().begin(), NuData + HORZ*N, NuData + VERT*N, SideLength,
+		beta, ShrikeMode, WData + HORZ*N, WData + VERT*N);
+}
+
+BoostGradientMatrix ApplyShrike(const BoostGradientMatrix &AllW, const BoostGradientMatrix &AllNu,
+	double beta, TVType ShrikeMode) {
+	/*
+	* Function: ApplyShrike
+	* ---------------------
+	* Applies the Shrinkage-like operator to every gradient in W.
+	*
+	* Input --
+	*  W:    a (N x d) matrix of gradients (i.e. for 2-d images, d=2)
+	*  Nu:   a (N x d) set of multipliers
+	*  beta: a scalar scaling term
+	*  ShrikeMode: an Enum value of TVType whic specifies whether we use the
+	*              isotropic or anisotropic Shrike operator.
+	*
+	* Output -- a (N x d) "shriked" version of the gradient matrix
+	*/
+	BoostGradientMatrix AllWShriked(AllW.size1(), AllW.size2());
+	ApplyShrike(AllW, AllNu, beta, ShrikeMode, AllWShriked);
+	return AllWShriked;
+}
+
+double TV_Subfunction(const BoostDoubleVector &U, const BoostGradientMatrix &W,
+	const BoostGradientMatrix &Nu, double beta, unsigned long SideLength,
+	BoostGradientMatrix &Du) {
+	/*
+	* Function: TV_Subfunction
+	* ------------------------
+	* Calculate the gradient-matching part of the quadratic cost function,
+	*
+	*       sum_{i=1:N} -Nu_i^T (D_i U - W_i) + (beta/2) ||D_i U - W_i||^2
+	*
+	* Input --
+	* U: an (N x 1) vector representing a rasterized image prediction
+	* W: an (N x d) set of dual variables corresponding to per-pixel (-voxel) gradients
+	* Nu: an (N x d) set of Lagrangian multipliers
+	* beta: scaling term on the matching between W and the true gradients
+	* SideLength: the side length for the target image, i.e. N = SideLength^2
+	* Du: (N x d) scratch storage for the gradients of U
+	*
+	* Output -- a decimal value for the cost.
+	*/
+	// Get all Gradients
+	GradientField(U, SideLength, W.size2(), Du);
+
+	// Loop over pixels, walking the gradient planes contiguously
+	unsigned long N = U.size();
+	const double *DuH = Du.data().begin() + HORZ*N, *DuV = Du.data().begin() + VERT*N;
+	const double *WH = W.data().begin() + HORZ*N, *WV = W.data().begin() + VERT*N;
+	const double *NuH = Nu.data().begin() + HORZ*N, *NuV = Nu.data().begin() + VERT*N;
+	if (W.size2() == 3) {
+		const double *DuA = Du.data().begin() + AXIAL*N;
+		const double *WA = W.data().begin() + AXIAL*N;
+		const double *NuA = Nu.data().begin() + AXIAL*N;
+		return DeterministicSum(N, [=](unsigned long Begin, unsigned long End) {
+			double Sum = 0.0;
+			for (unsigned long i = Begin; i < End; ++i) {
+				double GradDiffH = DuH[i] - WH[i];
+				double GradDiffV = DuV[i] - WV[i];
+				double GradDiffA = DuA[i] - WA[i];
+
+				Sum += -(NuH[i]*GradDiffH + NuV[i]*GradDiffV + NuA[i]*GradDiffA)
+					+ (beta / 2) * (GradDiffH*GradDiffH + GradDiffV*GradDiffV + GradDiffA*GradDiffA);
+			}
+			return Sum;
+		});
+	}
+
+	double Q = DeterministicSum(N, [=](unsigned long Begin, unsigned long End) {
+		double Sum = 0.0;
+		for (unsigned long i = Begin; i < End; ++i) {
+			double GradDiffH = DuH[i] - WH[i];
+			double GradDiffV = DuV[i] - WV[i];
+
+			Sum += -(NuH[i]*GradDiffH + NuV[i]*GradDiffV)
+				+ (beta / 2) * (GradDiffH*GradDiffH + GradDiffV*GradDiffV);
+		}
+		return Sum;
+	});
+
+	return Q;
+}
+
+double TV_Subfunction(const BoostDoubleVector &U, const BoostGradientMatrix &W,
+	const BoostGradientMatrix &Nu, double beta, unsigned long SideLength) {
+	/*
+	* Allocating form of TV_Subfunction.
+	*/
+	BoostGradientMatrix Du(U.size(), W.size2());
+	return TV_Subfunction(U, W, Nu, beta, SideLength, Du);
+}
+
+double TV_Norm(const BoostGradientMatrix &W, TVType GradNorm) {
+	/*
+	* Function: TV_Norm
+	* -----------------
+	* Calculate the total variation sum_{i=1:N} ||W_i|| of a set of gradients.
+	*
+	* Input --
+	* W: an (N x d) set of per-pixel (-voxel) gradients, d = 2 or 3
+	* GradNorm: which TV norm to use on the gradients (Iso- or Anisotropic)
+	*
+	* Output -- a decimal value for the total variation.
+	*/
+	unsigned long N = W.size1();
+	const double *WH = W.data().begin() + HORZ*N;
+	const double *WV = W.data().begin() + VERT*N;
+	if (W.size2() == 3) {
+		const double *WA = W.data().begin() + AXIAL*N;
+		return DeterministicSum(N, [=](unsigned long Begin, unsigned long End) {
+			double TV = 0.0;
+			for (unsigned long i = Begin; i < End; ++i) {
+				switch (GradNorm) {
+				case ISOTROPIC:
+					TV += sqrt(WH[i]*WH[i] + WV[i]*WV[i] + WA[i]*WA[i]);
+					break;
+				case ANISOTROPIC:
+					TV += std::abs(WH[i]) + std::abs(WV[i]) + std::abs(WA[i]);
+					break;
+				}
+			}
+			return TV;
+		});
+	}
+
+	return DeterministicSum(N, [=](unsigned long Begin, unsigned long End) {
+		double TV = 0.0;
+		for (unsigned long i = Begin; i < End; ++i) {
+			switch (GradNorm) {
+			case ISOTROPIC:
+				TV += sqrt(WH[i]*WH[i] + WV[i]*WV[i]);
+				break;
+			case ANISOTROPIC:
+				TV += std::abs(WH[i]) + std::abs(WV[i]);
+				break;
+			}
+		}
+		return TV;
+	});
+}
+
+double Residual_Subfunction(const BoostDoubleVector &Residual, const BoostDoubleVector &Lambda,
+	double mu) {
+	/*
+	* Function: Residual_Subfunction
+	* ------------------------------
+	* Calculate the data-fidelity part of the quadratic cost function,
+	*
+	*       -Lambda^T (A*U - B) + (mu/2) ||A*U - B||^2
+	*
+	* given the residual A*U - B. Taking the residual rather than A lets
+	* callers which already track A*U avoid another projection.
+	*
+	* Input --
+	* Residual: an (M x 1) residual vector A*U - B
+	* Lambda: an (M x 1) set of Lagrangian multiplies
+	* mu: scaling term on the matching between A*u and b
+	*
+	* Output -- a decimal value for the cost.
+	*/
+	return -ParallelInnerProduct(Lambda, Residual) + (mu / 2) * ParallelInnerProduct(Residual, Residual);
+}
+
+static void TVDirectionFromGradient(const BoostGradientMatrix &GradU, const BoostGradientMatrix &W,
+	const BoostGradientMatrix &Nu, double beta, unsigned long SideLength,
+	BoostGradientMatrix &Du, BoostDoubleVector &Direction) {
+	/*
+	* Function: TVDirectionFromGradient
+	* ---------------------------------
+	* TV_Direction given the gradient field GradU of U. Du is (N x d) scratch
+	* storage and may alias GradU.
+	*/
+	Du.resize(GradU.size1(), GradU.size2(), false);
+
+	// Du = beta*GradU + beta*W + Nu over all gradient planes
+	const double *GradData = GradU.data().begin();
+	double *DuData = Du.data().begin();
+	const double *WData = W.data().begin();
+	const double *NuData = Nu.data().begin();
+	unsigned long Entries = Du.data().size();
+	#pragma omp parallel for num_threads(GetThreadCount()) schedule(static) if(Entries >= ParallelMinimumWork)
+	for (long p = 0; p < static_cast<long>(Entries); ++p) {
+		DuData[p] = beta*GradData[p] + beta*WData[p] + NuData[p];
+	}
+	GradientFieldAdjointSum(Du, SideLength, Direction);
+	Direction *= -1.0;
+}
+
+static void TVDirectionChange(const BoostGradientMatrix &GradU, const BoostGradientMatrix &GradUk_1,
+	double beta, unsigned long SideLength, BoostGradientMatrix &Du, BoostDoubleVector &Change) {
+	/*
+	* Function: TVDirectionChange
+	* ---------------------------
+	* The difference TV_Direction(U) - TV_Direction(U(k-1)) for the same W and
+	* Nu, which cancel by linearity,
+	*
+	*       -PixelGradientAdjointSum(beta*(Du - Du(k-1)))
+	*
+	* given the gradient fields of U and U(k-1). Du is (N x d) scratch storage.
+	*/
+	Du.resize(GradU.size1(), GradU.size2(), false);
+	const double *GradData = GradU.data().begin();
+	const double *GradDatak_1 = GradUk_1.data().begin();
+	double *DuData = Du.data().begin();
+	unsigned long Entries = Du.data().size();
+	#pragma omp parallel for num_threads(GetThreadCount()) schedule(static) if(Entries >= ParallelMinimumWork)
+	for (long p = 0; p < static_cast<long>(Entries); ++p) {
+		DuData[p] = beta*(GradData[p] - GradDatak_1[p]);
+	}
+	GradientFieldAdjointSum(Du, SideLength, Change);
+	Change *= -1.0;
+}
+
+void TV_Direction(const BoostDoubleVector &U, const BoostGradientMatrix &W,
+	const BoostGradientMatrix &Nu, double beta, unsigned long SideLength,
+	BoostGradientMatrix &Du, BoostDoubleVector &Direction) {
+	/*
+	* Function: TV_Direction
+	* ----------------------
+	* Output-parameter form of TV_Direction below. Du is (N x d) scratch
+	* storage; Direction is resized only if necessary.
+	*/
+	GradientField(U, SideLength, W.size2(), Du);
+	TVDirectionFromGradient(Du, W, Nu, beta, SideLength, Du, Direction);
+}
+
+BoostDoubleVector TV_Direction(const BoostDoubleVector &U, const BoostGradientMatrix &W,
+	const BoostGradientMatrix &Nu, double beta, unsigned long SideLength) {
+	/*
+	* Function: TV_Direction
+	* ----------------------
+	* Calculate the gradient-matching part of the one-step steepest descent
+	* direction,
+	*
+	*       -PixelGradientAdjointSum(beta*Du + beta*W + Nu)
+	*
+	* Input --
+	* U: an (N x 1) vector representing a rasterized image prediction
+	* W: an (N x d) set of dual variables corresponding to per-pixel (-voxel) gradients
+	* Nu: an (N x d) set of Lagrangian multipliers
+	* beta: scaling term on the matching between W and the true gradients
+	* SideLength: the side length for the target image, i.e. N = SideLength^2
+	*
+	* Output -- an (N x 1) direction vector.
+	*/
+	BoostGradientMatrix Du(U.size(), W.size2());
+	BoostDoubleVector Direction(U.size());
+	TV_Direction(U, W, Nu, beta, SideLength, Du, Direction);
+	return Direction;
+}
+
+double Lagrangian(const ProjectionOperator &A, const BoostDoubleVector &U,
+	const BoostDoubleVector &B, const BoostGradientMatrix &W,
+	const BoostGradientMatrix &Nu, const BoostDoubleVector &Lambda,
+	double beta, double mu,
+	unsigned long SideLength, TVType GradNorm) {
+	/*
+	* Function: Lagrangian
+	* --------------------
+	* Calculate the Lagrangian cost function for the give problem state.
+	*
+	* Input --
+	* A: an (M x N) projection operator
+	* U: an (N x 1) vector representing a rasterized image prediction
+	* B: an (M x 1) set of observations
+	* W: an (N x 2) set of dual variables corresponding to per-pixel (-voxel) gradients
+	* Nu: an (N x 2) set of Lagrangian multipliers
+	* Lambda: an (M x 1) set of Lagrangian multiplies
+	* beta: scaling term on the matching between W and the true gradients
+	* mu: scaling term on the matching between A*u and b
+	* SideLength: the side length for the target image, i.e. N = SideLength^2
+	* GradNorm: which TV norm to use on the gradients (Iso- or Anisotropic)
+	*
+	* Output -- a decimal value for the cost.
+	*/
+	BoostDoubleVector Residual = A.Project(U) - B;
+
+	return TV_Subfunction(U, W, Nu, beta, SideLength) + TV_Norm(W, GradNorm)
+		+ Residual_Subfunction(Residual, Lambda, mu);
+}
+
+double Lagrangian(const BoostDoubleMatrix &A, const BoostDoubleVector &U,
+	const BoostDoubleVector &B, const BoostGradientMatrix &W,
+	const BoostGradientMatrix &Nu, const BoostDoubleVector &Lambda,
+	double beta, double mu,
+	unsigned long SideLength, TVType GradNorm) {
+	/*
+	* Dense (M x N) projection matrix form of Lagrangian.
+	*/
+	return Lagrangian(DenseProjection(A), U, B, W, Nu, Lambda, beta, mu, SideLength, GradNorm);
+}
+
+BoostDoubleVector Onestep_Direction(const ProjectionOperator &A, const BoostDoubleVector &U,
+	const BoostDoubleVector &B, const BoostGradientMatrix &W,
+	const BoostGradientMatrix &Nu, const BoostDoubleVector &Lambda,
+	double beta, double mu,
+	unsigned long SideLength) {
+	/*
+	* Function: Onestep_Direction
+	* ---------------------------
+	* Calculate the direction for the gradient in the one-step steepest descent method.
+	* To understand this following command, one can separate it in two steps
+	* (that is, the sum over all the pixels) Du = AllPixelGradients(U,SideLength)
+	*										 Dk = -PixelGradientAdjointSum(beta*Du + beta*W + Nu) + mu*A'*(A*u - b) - A'*lambda
+	* The two data terms share a single back-projection, A'*(mu*(A*u - b) - lambda).
+	*
+	* Input --
+	* A: an (M x N) projection operator
+	* U: an (N x 1) vector representing a rasterized image prediction
+	* B: an (M x 1) set of observations
+	* W: an (N x 2) set of dual variables corresponding to per-pixel (-voxel) gradients
+	* Nu: an (N x 2) set of Lagrangian multipliers
+	* Lambda: an (M x 1) set of Lagrangian multiplies
+	* beta: scaling term on the matching between W and the true gradients
+	* mu: scaling term on the matching between A*u and b
+	* SideLength: the side length for the target image, i.e. N = SideLength^2
+	*
+	* Output -- an (N x 1) direction vector.
+	*/
+	BoostDoubleVector Residual = A.Project(U) - B;
+
+	return TV_Direction(U, W, Nu, beta, SideLength) + A.BackProject(mu*Residual - Lambda);
+}
+
+BoostDoubleVector Onestep_Direction(const BoostDoubleMatrix &A, const BoostDoubleVector &U,
+	const BoostDoubleVector &B, const BoostGradientMatrix &W,
+	const BoostGradientMatrix &Nu, const BoostDoubleVector &Lambda,
+	double beta, double mu,
+	unsigned long SideLength) {
+	/*
+	* Dense (M x N) projection matrix form of Onestep_Direction.
+	*/
+	return Onestep_Direction(DenseProjection(A), U, B, W, Nu, Lambda, beta, mu, SideLength);
+}
+
+double U_Subfunction(const ProjectionOperator &A, const BoostDoubleVector &U,
+	const BoostDoubleVector &B, const BoostGradientMatrix &W,
+	const BoostGradientMatrix &Nu, const BoostDoubleVector &Lambda,
+	double beta, double mu,
+	unsigned long SideLength)
 {
 	/*
 	* Function: U_Subfunction
@@ -302,7 +1183,7 @@ double U_Subfunction(BoostDoubleMatrix A, BoostDoubleVector U,
 	* Calculate the quadratic cost function for the give problem state.
 	*
 	* Input --
-	* A: an (M x N) projection matrix
+	* A: an (M x N) projection operator
 	* U: an (N x 1) vector representing a rasterized image prediction
 	* B: an (M x 1) set of observations
 	* W: an (N x 2) set of dual variables corresponding to per-pixel (-voxel) gradients
@@ -314,190 +1195,1244 @@ double U_Subfunction(BoostDoubleMatrix A, BoostDoubleVector U,
 	*
 	* Output -- a decimal value for the cost.
 	*/
-	double Q = 0.0;
+	BoostDoubleVector Residual = A.Project(U) - B;
 
-	// Get all Gradients
-	BoostDoubleMatrix Du = AllPixelGradients(U, SideLength);
+	return TV_Subfunction(U, W, Nu, beta, SideLength) + Residual_Subfunction(Residual, Lambda, mu);
+}
+
+double U_Subfunction(const BoostDoubleMatrix &A, const BoostDoubleVector &U,
+	const BoostDoubleVector &B, const BoostGradientMatrix &W,
+	const BoostGradientMatrix &Nu, const BoostDoubleVector &Lambda,
+	double beta, double mu,
+	unsigned long SideLength) {
+	/*
+	* Dense (M x N) projection matrix form of U_Subfunction.
+	*/
+	return U_Subfunction(DenseProjection(A), U, B, W, Nu, Lambda, beta, mu, SideLength);
+}
 
-	// Loop over pixels
-	BoostDoubleVector Dui;
-	BoostDoubleVector Wi;
-	BoostDoubleVector Nui;
-	for (unsigned long i = 0; i < U.size(); ++i) {
-		Dui = GetRow(Du, i);
-		Wi = GetRow(W, i);
-		Nui = GetRow(Nu, i);
+TVAL3Options::TVAL3Options()
+	: Mu(1024.0), Beta(1024.0), Coefficient(1.0),
+	OuterTolerance(0.001), MaxOuterIterations(5),
+	InnerTolerance(0.001), MaxInnerIterations(5),
+	RelativeTolerance(false), ActiveTileSize(0), TileTolerance(0.001),
+	Rho(0.6), Delta(0.00001), Eta(0.9995), MaxArmijoIterations(5), StepSize(DAMPED_BB_STEP),
+	UStep(GRADIENT_U_STEP), MaxCGIterations(10), CGTolerance(0.01),
+	JacobiPreconditioner(true), GradNorm(ISOTROPIC), InitialState(NULL), FinalState(NULL),
+	Nonnegative(false), Progress(NULL), ProgressData(NULL), Profile(NULL), Workspace(NULL) {
+}
+
+TVAL3State::TVAL3State()
+	: Beta(0.0), Mu(0.0), OuterIterations(0) {
+}
 
-		BoostDoubleVector GradDiff = Dui - Wi;
-		Q += -inner_prod(Nui, GradDiff) + (beta / 2) * SquareNorm(GradDiff);
+TVAL3Profile::TVAL3Profile()
+	: Enabled(false), TotalSeconds(0.0),
+	Applications(0), TransposeApplications(0),
+	OuterIterations(0), InnerIterations(0), ArmijoTrials(0), ArmijoBacktracks(0),
+	CGIterations(0) {
+	for (int Phase = 0; Phase < TVAL3_PHASE_COUNT; ++Phase) {
+		PhaseSeconds[Phase] = 0.0;
+		PhaseCalls[Phase] = 0;
 	}
+}
 
-	// Residual Contribution
-	BoostDoubleVector Residual = prod(A, U) - B;
-	Q += -inner_prod(Lambda, Residual) + (mu / 2) * SquareNorm(Residual);
+void TVAL3Profile::Add(const TVAL3Profile &Other) {
+	Enabled = Enabled || Other.Enabled;
+	TotalSeconds += Other.TotalSeconds;
+	for (int Phase = 0; Phase < TVAL3_PHASE_COUNT; ++Phase) {
+		PhaseSeconds[Phase] += Other.PhaseSeconds[Phase];
+		PhaseCalls[Phase] += Other.PhaseCalls[Phase];
+	}
+	Applications += Other.Applications;
+	TransposeApplications += Other.TransposeApplications;
+	OuterIterations += Other.OuterIterations;
+	InnerIterations += Other.InnerIterations;
+	ArmijoTrials += Other.ArmijoTrials;
+	ArmijoBacktracks += Other.ArmijoBacktracks;
+	CGIterations += Other.CGIterations;
+}
 
-	return Q;
+const char *TVAL3PhaseName(TVAL3Phase Phase) {
+	/*
+	* Function: TVAL3PhaseName
+	* ------------------------
+	* Output -- the lower-case name of the phase, as used in WriteProfileJSON.
+	*/
+	switch (Phase) {
+	case SETUP_PHASE: return "setup";
+	case W_STEP_PHASE: return "w_step";
+	case DIRECTION_PHASE: return "direction";
+	case LINE_SEARCH_PHASE: return "line_search";
+	case MULTIPLIER_UPDATE_PHASE: return "multiplier_update";
+	default: return "unknown";
+	}
+}
+
+void WriteProfileJSON(const TVAL3Profile &Profile, std::ostream &Out) {
+	/*
+	* Function: WriteProfileJSON
+	* --------------------------
+	* Write the profile to the stream as a single JSON object, e.g.
+	* {"enabled": true, "total_seconds": 0.5, ..., "phases": {"setup":
+	* {"seconds": 0.1, "calls": 6}, ...}}
+	*/
+	std::ios::fmtflags Flags = Out.flags();
+	std::streamsize Precision = Out.precision(9);
+	Out.unsetf(std::ios::floatfield);
+	Out << "{\"enabled\": " << (Profile.Enabled ? "true" : "false")
+		<< ", \"total_seconds\": " << Profile.TotalSeconds
+		<< ", \"applications\": " << Profile.Applications
+		<< ", \"transpose_applications\": " << Profile.TransposeApplications
+		<< ", \"outer_iterations\": " << Profile.OuterIterations
+		<< ", \"inner_iterations\": " << Profile.InnerIterations
+		<< ", \"armijo_trials\": " << Profile.ArmijoTrials
+		<< ", \"armijo_backtracks\": " << Profile.ArmijoBacktracks
+		<< ", \"cg_iterations\": " << Profile.CGIterations
+		<< ", \"phases\": {";
+	for (int Phase = 0; Phase < TVAL3_PHASE_COUNT; ++Phase) {
+		Out << (Phase ? ", " : "") << "\"" << TVAL3PhaseName(static_cast<TVAL3Phase>(Phase))
+			<< "\": {\"seconds\": " << Profile.PhaseSeconds[Phase]
+			<< ", \"calls\": " << Profile.PhaseCalls[Phase] << "}";
+	}
+	Out << "}}";
+	Out.precision(Precision);
+	Out.flags(Flags);
+}
+
+// Profiling hooks. With CTVM_PROFILE undefined they expand to nothing, so the
+// solver carries no instrumentation at all; otherwise each is a NULL check
+// on Options.Profile plus, for the phase timers, a steady clock read.
+#ifdef CTVM_PROFILE
+typedef std::chrono::steady_clock ProfileClock;
+
+static inline void RecordPhase(TVAL3Profile *Profile, TVAL3Phase Phase,
+	ProfileClock::time_point Start) {
+	Profile->PhaseSeconds[Phase] +=
+		std::chrono::duration<double>(ProfileClock::now() - Start).count();
+	Profile->PhaseCalls[Phase]++;
+}
+
+#define PROFILE_START(Options, Mark) \
+	ProfileClock::time_point Mark; \
+	if (Options.Profile) { Options.Profile->Enabled = true; Mark = ProfileClock::now(); }
+#define PROFILE_STOP(Options, Mark, Phase) \
+	if (Options.Profile) { RecordPhase(Options.Profile, Phase, Mark); }
+#define PROFILE_COUNT(Options, Counter, Increment) \
+	if (Options.Profile) { Options.Profile->Counter += (Increment); }
+#define PROFILE_RESET(Options) \
+	if (Options.Profile) { *Options.Profile = TVAL3Profile(); }
+#define PROFILE_TOTAL(Options, Mark) \
+	if (Options.Profile) { Options.Profile->TotalSeconds = \
+		std::chrono::duration<double>(ProfileClock::now() - Mark).count(); }
+#else
+#define PROFILE_START(Options, Mark)
+#define PROFILE_STOP(Options, Mark, Phase)
+#define PROFILE_COUNT(Options, Counter, Increment)
+#define PROFILE_RESET(Options)
+#define PROFILE_TOTAL(Options, Mark)
+#endif
+
+TVAL3Workspace::TVAL3Workspace(unsigned long M, unsigned long N, unsigned long GradientPlanes)
+	: Uk_1(N), Sk(N), Dk(N), Yk(N), U_alphad(N),
+	DataDirection(N), DataDirectionk_1(N),
+	Du(N, GradientPlanes), GradU(N, GradientPlanes), GradUk_1(N, GradientPlanes),
+	Residual(M), ADk(M), TrialResidual(M), DataResidual(M),
+	OuterUk_1(N), Lambda(M), Nu(N, GradientPlanes), W(N, GradientPlanes),
+	OuterIteration(0), StartTime(boost::posix_time::microsec_clock::universal_time()) {
+}
+
+void TVAL3Workspace::Resize(unsigned long M, unsigned long N, unsigned long GradientPlanes) {
+	/*
+	* Function: TVAL3Workspace::Resize
+	* --------------------------------
+	* Make the workspace fit an (M x N) problem with GradientPlanes gradient
+	* planes. Buffers already of the right size keep their storage; contents
+	* are not preserved.
+	*/
+	BoostDoubleVector *ImageBuffers[8] = { &Uk_1, &Sk, &Dk, &Yk, &U_alphad,
+		&DataDirection, &DataDirectionk_1, &OuterUk_1 };
+	for (int b = 0; b < 8; ++b) {
+		ImageBuffers[b]->resize(N, false);
+	}
+	BoostDoubleVector *MeasurementBuffers[5] = { &Residual, &ADk, &TrialResidual, &DataResidual,
+		&Lambda };
+	for (int b = 0; b < 5; ++b) {
+		MeasurementBuffers[b]->resize(M, false);
+	}
+	BoostGradientMatrix *GradientBuffers[5] = { &Du, &GradU, &GradUk_1, &Nu, &W };
+	for (int b = 0; b < 5; ++b) {
+		GradientBuffers[b]->resize(N, GradientPlanes, false);
+	}
+}
+
+static void ReportProgress(const TVAL3Options &Options, const TVAL3Workspace &Work,
+	TVAL3Stage Stage, unsigned int InnerIteration, unsigned int ArmijoIteration,
+	double Objective, double StepSize, double Stop) {
+	/*
+	* Function: ReportProgress
+	* ------------------------
+	* Fill in a TVAL3Progress and pass it to Options.Progress, which must be set.
+	*/
+	TVAL3Progress Progress;
+	Progress.Stage = Stage;
+	Progress.OuterIteration = Work.OuterIteration;
+	Progress.InnerIteration = InnerIteration;
+	Progress.ArmijoIteration = ArmijoIteration;
+	Progress.Objective = Objective;
+	Progress.StepSize = StepSize;
+	Progress.Stop = Stop;
+	Progress.ElapsedSeconds = 1e-6 * (boost::posix_time::microsec_clock::universal_time()
+		- Work.StartTime).total_microseconds();
+	Options.Progress(Progress, Options.ProgressData);
+}
+
+static double StepChange(const BoostDoubleVector &U, const BoostDoubleVector &Uk_1,
+	const TVAL3Options &Options) {
+	/*
+	* Function: StepChange
+	* --------------------
+	* The change ||U - U(k-1)|| tested against the stopping tolerances,
+	* relative to ||U|| when Options.RelativeTolerance is set.
+	*/
+	double Change = norm_2(U - Uk_1);
+	if (Options.RelativeTolerance) {
+		double Norm = norm_2(U);
+		if (Norm > 0) {
+			Change /= Norm;
+		}
+	}
+	return Change;
+}
+
+/* Active Set */
+// The (L x L) image is split into T x T tiles (smaller at the last row and
+// column of tiles when T does not divide L); tile (a, b) covers the rows
+// a*T .. and the columns b*T .., and is stored at b*Tiles + a.
+
+static void CollectActiveTiles(unsigned long L, unsigned long T, TVAL3Workspace &Work) {
+	/*
+	* Function: CollectActiveTiles
+	* ----------------------------
+	* List the pixels of the active tiles, and the tiles whose shrinkage an
+	* update of those pixels changes: the active tiles and those above or to
+	* the left of one, through the differences across their last row and
+	* column.
+	*/
+	unsigned long Tiles = (L + T - 1) / T;
+	const std::vector<unsigned char> &Active = Work.ActiveTiles;
+	Work.ActiveColumns.clear();
+	Work.ShrinkTiles.clear();
+	for (unsigned long b = 0; b < Tiles; ++b) {
+		for (unsigned long a = 0; a < Tiles; ++a) {
+			bool Changed = Active[b*Tiles + a] || (a + 1 < Tiles && Active[b*Tiles + a + 1])
+				|| (b + 1 < Tiles && Active[(b + 1)*Tiles + a]);
+			if (Changed) {
+				Work.ShrinkTiles.push_back(b*Tiles + a);
+			}
+		}
+	}
+	for (unsigned long j = 0; j < L; ++j) {
+		for (unsigned long a = 0; a < Tiles; ++a) {
+			if (Active[(j / T)*Tiles + a]) {
+				for (unsigned long i = a*T; i < std::min(L, (a + 1)*T); ++i) {
+					Work.ActiveColumns.push_back(j*L + i);
+				}
+			}
+		}
+	}
+}
+
+static void ZeroFrozenTiles(unsigned long L, unsigned long T,
+	const std::vector<unsigned char> &Active, BoostDoubleVector &X) {
+	/*
+	* Function: ZeroFrozenTiles
+	* -------------------------
+	* Set the pixels of X outside the active tiles to zero.
+	*/
+	unsigned long Tiles = (L + T - 1) / T;
+	for (unsigned long j = 0; j < L; ++j) {
+		for (unsigned long a = 0; a < Tiles; ++a) {
+			if (!Active[(j / T)*Tiles + a]) {
+				for (unsigned long i = a*T; i < std::min(L, (a + 1)*T); ++i) {
+					X(j*L + i) = 0.0;
+				}
+			}
+		}
+	}
+}
+
+static void FreezeConvergedTiles(const BoostDoubleVector &U, const BoostDoubleVector &Uk_1,
+	unsigned long L, const TVAL3Options &Options, TVAL3Workspace &Work) {
+	/*
+	* Function: FreezeConvergedTiles
+	* ------------------------------
+	* Freeze the active tiles whose change over an outer iteration, from
+	* U(k-1) to U, is at most their
+	* share of Options.TileTolerance (times ||U||, for relative tolerances):
+	* the tolerance scaled by the square root of the fraction of the pixels
+	* they hold, so that a step which freezes every tile also passes a global
+	* test with the same tolerance. The inner iterations list the tiles that
+	* remain.
+	*/
+	unsigned long T = Options.ActiveTileSize;
+	unsigned long Tiles = (L + T - 1) / T;
+	double Tolerance = Options.TileTolerance / L;
+	if (Options.RelativeTolerance) {
+		Tolerance *= norm_2(U);
+	}
+
+	for (unsigned long b = 0; b < Tiles; ++b) {
+		for (unsigned long a = 0; a < Tiles; ++a) {
+			if (!Work.ActiveTiles[b*Tiles + a]) {
+				continue;
+			}
+			unsigned long Rows = std::min(L, (a + 1)*T) - a*T, Cols = std::min(L, (b + 1)*T) - b*T;
+			double Change = 0.0;
+			for (unsigned long j = b*T; j < b*T + Cols; ++j) {
+				for (unsigned long i = a*T; i < a*T + Rows; ++i) {
+					double Step = U(j*L + i) - Uk_1(j*L + i);
+					Change += Step*Step;
+				}
+			}
+			if (Change <= Tolerance*Tolerance*Rows*Cols) {
+				Work.ActiveTiles[b*Tiles + a] = 0;
+			}
+		}
+	}
 }
 
-void Alternating_Minimisation(BoostDoubleMatrix A, BoostDoubleVector &U,
-	BoostDoubleVector B, BoostDoubleMatrix &W,
-	BoostDoubleMatrix Nu, BoostDoubleVector Lambda,
+static void ShrinkActiveTiles(const BoostDoubleVector &U, const BoostGradientMatrix &Nu,
+	double beta, TVType ShrikeMode, unsigned long L, unsigned long T,
+	const std::vector<unsigned long> &ShrinkTiles, BoostGradientMatrix &W) {
+	/*
+	* Function: ShrinkActiveTiles
+	* ---------------------------
+	* ApplyGradientShrike over the listed tiles only; W is unchanged elsewhere.
+	*/
+	unsigned long N = U.size();
+	unsigned long Tiles = (L + T - 1) / T;
+	double InvBeta = 1 / beta;
+	const double *NuData = Nu.data().begin();
+	double *WData = W.data().begin();
+
+	long Count = static_cast<long>(ShrinkTiles.size());
+	#pragma omp parallel for num_threads(GetThreadCount()) schedule(static) if(Count*T*T >= ParallelMinimumWork)
+	for (long k = 0; k < Count; ++k) {
+		unsigned long a = ShrinkTiles[k] % Tiles, b = ShrinkTiles[k] / Tiles;
+		for (unsigned long j = b*T; j < std::min(L, (b + 1)*T); ++j) {
+			ForwardDifferenceShrikeColumn(U.data().begin(), NuData + HORZ*N, NuData + VERT*N, L, j,
+				a*T, std::min(L, (a + 1)*T), beta, InvBeta, ShrikeMode, WData + HORZ*N, WData + VERT*N);
+		}
+	}
+}
+
+static void ExactMinimisation(const ProjectionOperator &A, BoostDoubleVector &U,
+	const BoostDoubleVector &B, BoostGradientMatrix &W,
+	const BoostGradientMatrix &Nu, const BoostDoubleVector &Lambda,
 	double beta, double mu,
-	unsigned long SideLength)
+	unsigned long SideLength, const TVAL3Options &Options, TVAL3Workspace &Work) {
+	/*
+	* Function: ExactMinimisation
+	* ---------------------------
+	* Alternating_Minimisation with EXACT_U_STEP, for a 2D problem whose
+	* Work.GramDiagonal holds the DCT-domain eigenvalues of A^T*A. Each u-step
+	* solves the normal equations
+	*
+	*       (beta*D^T*D + mu*A^T*A) U = D^T*(beta*W + Nu) + A^T*(mu*b + Lambda)
+	*
+	* by dividing the 2D DCT of the right-hand side by the eigenvalues of the
+	* left, which needs no line search. The data part of the right-hand side
+	* is fixed within the inner loop, so an iteration costs one application
+	* of A (for the residual returned in Work) and two DCTs.
+	*/
+	unsigned long N = U.size();
+	unsigned long L = SideLength;
+	unsigned int LoopCounter = 0;
+	double innerstop;
+	BoostDoubleVector &Uk_1 = Work.Uk_1;
+	BoostGradientMatrix &Du = Work.Du;
+	BoostDoubleVector &Residual = Work.Residual;
+	const BoostDoubleVector &Gram = Work.GramDiagonal;
+	BoostDoubleVector &Laplacian = Work.LaplacianDiagonal;
+
+	PROFILE_START(Options, SetupStart);
+	noalias(Work.DataResidual) = mu*B + Lambda;
+	A.ApplyTranspose(Work.DataResidual, Work.DataDirection);
+	if (Laplacian.size() != N) {
+		// D^T*D has the eigenvalue 4 sin^2(pi i/2L) + 4 sin^2(pi j/2L) at
+		// coefficient (i, j); the 1D terms are tabulated in Sk
+		const double Pi = 3.14159265358979323846;
+		Laplacian.resize(N, false);
+		for (unsigned long k = 0; k < L; ++k) {
+			double Sine = sin(Pi * k / (2.0 * L));
+			Work.Sk(k) = 4.0 * Sine * Sine;
+		}
+		for (unsigned long j = 0; j < L; ++j) {
+			for (unsigned long i = 0; i < L; ++i) {
+				Laplacian(j*L + i) = Work.Sk(i) + Work.Sk(j);
+			}
+		}
+	}
+	PROFILE_COUNT(Options, TransposeApplications, 1);
+	PROFILE_STOP(Options, SetupStart, SETUP_PHASE);
+
+	do
+	{
+		//*************************** "w sub-problem" ***************************
+		PROFILE_START(Options, WStepStart);
+		ApplyGradientShrike(U, Nu, beta, Options.GradNorm, SideLength, W);
+		PROFILE_STOP(Options, WStepStart, W_STEP_PHASE);
+		//*************************** "u sub-problem" ***************************
+		PROFILE_START(Options, DirectionStart);
+		noalias(Du) = beta*W + Nu;
+		GradientFieldAdjointSum(Du, SideLength, Work.Dk);
+		noalias(Uk_1) = U;
+		noalias(U) = Work.Dk + Work.DataDirection;
+		CosineTransform2D(U.data().begin(), L, false);
+		for (unsigned long p = 0; p < N; ++p) {
+			// Unobserved constant images are left at zero
+			double Eigenvalue = beta*Laplacian(p) + mu*Gram(p);
+			U(p) = (Eigenvalue > 0) ? U(p) / Eigenvalue : 0.0;
+		}
+		CosineTransform2D(U.data().begin(), L, true);
+		if (Options.Nonnegative) {
+			for (unsigned long i = 0; i < N; ++i) {
+				if (U(i) < 0) { U(i) = 0; }
+			}
+		}
+		PROFILE_STOP(Options, DirectionStart, DIRECTION_PHASE);
+
+		PROFILE_START(Options, LineSearchStart);
+		A.Apply(U, Residual);
+		noalias(Residual) -= B;
+		double Qk = 0.0;
+		if (Options.Progress) {
+			Qk = TV_Subfunction(U, W, Nu, beta, SideLength, Work.GradU)
+				+ Residual_Subfunction(Residual, Lambda, mu);
+		}
+		else {
+			GradientField(U, SideLength, W.size2(), Work.GradU);
+		}
+		innerstop = StepChange(U, Uk_1, Options);
+		PROFILE_COUNT(Options, Applications, 1);
+		PROFILE_COUNT(Options, InnerIterations, 1);
+		PROFILE_STOP(Options, LineSearchStart, LINE_SEARCH_PHASE);
+		LoopCounter++;
+		if (Options.Progress) {
+			ReportProgress(Options, Work, INNER_ITERATION, LoopCounter, 0, Qk, 1.0, innerstop);
+		}
+	} while ((innerstop > Options.InnerTolerance) && (LoopCounter < Options.MaxInnerIterations));
+}
+
+static void ConjugateGradientMinimisation(const ProjectionOperator &A, BoostDoubleVector &U,
+	const BoostDoubleVector &B, BoostGradientMatrix &W,
+	const BoostGradientMatrix &Nu, const BoostDoubleVector &Lambda,
+	double beta, double mu,
+	unsigned long SideLength, const TVAL3Options &Options, TVAL3Workspace &Work) {
+	/*
+	* Function: ConjugateGradientMinimisation
+	* ---------------------------------------
+	* Alternating_Minimisation with PCG_U_STEP. Each u-step runs preconditioned
+	* conjugate gradients on the normal equations
+	*
+	*       (beta*D^T*D + mu*A^T*A) U = D^T*(beta*W + Nu) + A^T*(mu*b + Lambda)
+	*
+	* from the current U, with the Jacobi preconditioner
+	* beta*diag(D^T*D) + mu*diag(A^T*A). A*U - B and D*U are updated along
+	* with U, so the system residual at the start of each solve,
+	*
+	*       D^T*(beta*(W - D*U) + Nu) - A^T*(mu*(A*U - B) - Lambda)
+	*
+	* costs one application of A^T, and each CG iteration one of A and one of
+	* A^T. The CG vectors live in the buffers of the gradient step.
+	*/
+	unsigned long N = U.size();
+	unsigned long L = SideLength;
+	unsigned long Planes = W.size2();
+	unsigned int LoopCounter = 0;
+	double innerstop, alpha = 0.0;
+	BoostDoubleVector &Uk_1 = Work.Uk_1;
+	BoostDoubleVector &R = Work.Sk;        // system residual
+	BoostDoubleVector &Z = Work.Yk;        // preconditioned residual, and scratch
+	BoostDoubleVector &P = Work.Dk;        // search direction
+	BoostDoubleVector &HP = Work.U_alphad; // system matrix times P
+	BoostGradientMatrix &Du = Work.Du;     // D*P, and scratch
+	BoostDoubleVector &AP = Work.ADk;
+	BoostDoubleVector &Residual = Work.Residual;
+	BoostGradientMatrix &GradU = Work.GradU;
+	BoostDoubleVector &Preconditioner = Work.Preconditioner;
+
+	PROFILE_START(Options, SetupStart);
+	A.Apply(U, Residual);
+	noalias(Residual) -= B;
+	GradientField(U, SideLength, Planes, GradU);
+	if (Options.JacobiPreconditioner && A.SquaredColumnNorms(Preconditioner)) {
+		// D^T*D has on its diagonal the number of differences each pixel
+		// (voxel) takes part in
+		unsigned long S = L * L, Depth = (S > 0) ? N / S : 0;
+		for (unsigned long p = 0; p < N; ++p) {
+			unsigned long i = p % L, j = (p / L) % L, k = p / S;
+			double Differences = (i > 0) + (i + 1 < L) + (j > 0) + (j + 1 < L);
+			if (Planes == 3) {
+				Differences += (k > 0) + (k + 1 < Depth);
+			}
+			double Diagonal = beta*Differences + mu*Preconditioner(p);
+			Preconditioner(p) = (Diagonal > 0) ? 1.0 / Diagonal : 1.0;
+		}
+	}
+	else {
+		Preconditioner.resize(N, false);
+		std::fill(Preconditioner.begin(), Preconditioner.end(), 1.0);
+	}
+	PROFILE_COUNT(Options, Applications, 1);
+	PROFILE_STOP(Options, SetupStart, SETUP_PHASE);
+
+	do
+	{
+		//*************************** "w sub-problem" ***************************
+		PROFILE_START(Options, WStepStart);
+		ApplyGradientShrike(U, Nu, beta, Options.GradNorm, SideLength, W);
+		PROFILE_STOP(Options, WStepStart, W_STEP_PHASE);
+		//*************************** "u sub-problem" ***************************
+		PROFILE_START(Options, DirectionStart);
+		noalias(Uk_1) = U;
+		noalias(Du) = beta*(W - GradU) + Nu;
+		GradientFieldAdjointSum(Du, SideLength, R);
+		noalias(Work.DataResidual) = mu*Residual - Lambda;
+		A.ApplyTranspose(Work.DataResidual, HP);
+		noalias(R) -= HP;
+		noalias(Z) = element_prod(Preconditioner, R);
+		noalias(P) = Z;
+		double RZ = ParallelInnerProduct(R, Z);
+		double Target = Options.CGTolerance * norm_2(R);
+
+		unsigned int CGCounter = 0;
+		while (CGCounter < Options.MaxCGIterations && RZ > 0) {
+			// HP = beta*D^T*D*P + mu*A^T*A*P
+			GradientField(P, SideLength, Planes, Du);
+			A.Apply(P, AP);
+			A.ApplyTranspose(AP, HP);
+			GradientFieldAdjointSum(Du, SideLength, Z);
+			noalias(HP) = mu*HP + beta*Z;
+			double PHP = ParallelInnerProduct(P, HP);
+			if (!(PHP > 0)) {
+				break;
+			}
+			alpha = RZ / PHP;
+			noalias(U) += alpha*P;
+			noalias(Residual) += alpha*AP;
+			noalias(GradU) += alpha*Du;
+			noalias(R) -= alpha*HP;
+			CGCounter++;
+			if (norm_2(R) <= Target) {
+				break;
+			}
+			noalias(Z) = element_prod(Preconditioner, R);
+			double RZNext = ParallelInnerProduct(R, Z);
+			noalias(P) = Z + (RZNext / RZ)*P;
+			RZ = RZNext;
+		}
+		if (Options.Nonnegative) {
+			// Projecting onto U >= 0 invalidates the tracked residual and gradients
+			for (unsigned long i = 0; i < N; ++i) {
+				if (U(i) < 0) { U(i) = 0; }
+			}
+			A.Apply(U, Residual);
+			noalias(Residual) -= B;
+			GradientField(U, SideLength, Planes, GradU);
+			PROFILE_COUNT(Options, Applications, 1);
+		}
+		innerstop = StepChange(U, Uk_1, Options);
+		PROFILE_COUNT(Options, Applications, CGCounter);
+		PROFILE_COUNT(Options, TransposeApplications, 1 + CGCounter);
+		PROFILE_COUNT(Options, CGIterations, CGCounter);
+		PROFILE_COUNT(Options, InnerIterations, 1);
+		PROFILE_STOP(Options, DirectionStart, DIRECTION_PHASE);
+		LoopCounter++;
+		if (Options.Progress) {
+			double Qk = TV_Subfunction(U, W, Nu, beta, SideLength, Du)
+				+ Residual_Subfunction(Residual, Lambda, mu);
+			ReportProgress(Options, Work, INNER_ITERATION, LoopCounter, 0, Qk, alpha, innerstop);
+		}
+	} while ((innerstop > Options.InnerTolerance) && (LoopCounter < Options.MaxInnerIterations));
+}
+
+void Alternating_Minimisation(const ProjectionOperator &A, BoostDoubleVector &U,
+	const BoostDoubleVector &B, BoostGradientMatrix &W,
+	const BoostGradientMatrix &Nu, const BoostDoubleVector &Lambda,
+	double beta, double mu,
+	unsigned long SideLength, const TVAL3Options &Options, TVAL3Workspace &Work)
 {
 	/*
 	* Function: Alternating_Minimisation
 	* ----------------------------------
 	* Calculate the minima U* and Wi* of the augmented Lagrangian function.
 	*
+	* Projections are carried across iterations rather than recomputed: every
+	* Armijo trial point lies on U - alpha*Dk, so its residual is
+	* (A*U - B) - alpha*A*Dk, and the data term of the direction at U(k-1) is
+	* the one already computed at U on the previous iteration (B and Lambda
+	* are fixed within this routine). Each iteration therefore costs one
+	* application of A and one of A^T.
+	*
+	* The same holds for the gradient field: D*U is the one computed by the
+	* last Armijo trial, and the change of the TV part of the direction from
+	* U(k-1) to U does not depend on W or Nu, so it follows from D*U and
+	* D*U(k-1) without evaluating the direction at U(k-1).
+	*
+	* All temporaries live in the workspace, so provided the projection
+	* operator does not allocate, an iteration performs no heap allocation.
+	*
 	* Input --
-	* A: an (M x N) projection matrix
+	* A: an (M x N) projection operator
 	* U: an (N x 1) vector representing a rasterized image prediction
 	* B: an (M x 1) set of observations
-	* W: an (N x 2) set of dual variables corresponding to per-pixel (-voxel) gradients
-	* Nu: an (N x 2) set of Lagrangian multipliers
+	* W: an (N x d) set of dual variables corresponding to per-pixel (-voxel) gradients
+	* Nu: an (N x d) set of Lagrangian multipliers
 	* Lambda: an (M x 1) set of Lagrangian multiplies
 	* beta: scaling term on the matching between W and the true gradients
 	* mu: scaling term on the matching between A*u and b
 	* SideLength: the side length for the target image, i.e. N = SideLength^2
+	* Options: the inner loop, u-step, line search and active set settings, TV
+	*          norm and nonnegativity (the penalties and outer loop settings
+	*          are unused)
+	* Work: buffers for an (M x N) problem; on return Work.Residual = A*U - B
+	*       and Work.GradU = D*U. With an active set, only the tiles still
+	*       active in Work.ActiveTiles are updated (all of them, when its size
+	*       does not match the image)
 	*
 	* Output -- None.
 	*/
+	if (Options.UStep == EXACT_U_STEP && W.size2() == 2
+		&& A.CosineDiagonal(SideLength, Work.GramDiagonal)) {
+		ExactMinimisation(A, U, B, W, Nu, Lambda, beta, mu, SideLength, Options, Work);
+		return;
+	}
+	if (Options.UStep == PCG_U_STEP) {
+		ConjugateGradientMinimisation(A, U, B, W, Nu, Lambda, beta, mu, SideLength, Options, Work);
+		return;
+	}
 
-	using namespace std;
-
-	unsigned long N = U.size();
-	double delta = 0.00001;
-	double rho = 0.6;
-	double eta = 0.9995;
+	double delta = Options.Delta;
+	double rho = Options.Rho;
+	double eta = Options.Eta;
 	double Pk = 1;
-	double C = Lagrangian(A, U, B, W, Nu, Lambda, beta, mu, SideLength, ISOTROPIC);
 
 	double armijo_tol, Qk, innerstop;
-	double tol = 0.001;
+	double tol = Options.InnerTolerance;
 
 	unsigned int LoopCounter = 0;
-	unsigned int MaxIterations = 5;
+	unsigned int MaxIterations = Options.MaxInnerIterations;
 
 	unsigned int ArmijoLoopCounter = 0;
-	unsigned int MaxArmijoIterations = 5;
+	unsigned int MaxArmijoIterations = Options.MaxArmijoIterations;
+	TVType GradNorm = Options.GradNorm;
 
-	BoostDoubleVector Uk_1 = BoostZeroVector(N);
+	BoostDoubleVector &Uk_1 = Work.Uk_1;
+	BoostDoubleVector &Sk = Work.Sk;
+	BoostDoubleVector &Dk = Work.Dk;
+	BoostDoubleVector &Yk = Work.Yk;
+	BoostDoubleVector &U_alphad = Work.U_alphad;
+	BoostGradientMatrix &Du = Work.Du;
+	BoostGradientMatrix &GradU = Work.GradU;
+	BoostGradientMatrix &GradUk_1 = Work.GradUk_1;
+	BoostDoubleVector &Residual = Work.Residual;
+	BoostDoubleVector &ADk = Work.ADk;
+	unsigned long TileSize = Options.ActiveTileSize;
+	bool ActiveSet = (TileSize > 0 && W.size2() == 2);
+	if (ActiveSet) {
+		unsigned long Tiles = (SideLength + TileSize - 1) / TileSize;
+		if (Work.ActiveTiles.size() != Tiles*Tiles) {
+			Work.ActiveTiles.assign(Tiles*Tiles, 1);
+		}
+		CollectActiveTiles(SideLength, TileSize, Work);
+	}
+	Uk_1.clear();
+	GradUk_1.resize(U.size(), W.size2(), false);
+	GradUk_1.clear();
+
+	// Cached projections: Residual = A*U - B and ADk = A*Dk. DataDirection
+	// holds A'*(mu*(A*u - b) - lambda) at U(k-1), starting from U(k-1) = 0.
+	PROFILE_START(Options, SetupStart);
+	A.Apply(U, Residual);
+	noalias(Residual) -= B;
+	noalias(Work.DataResidual) = -mu*B - Lambda;
+	if (ActiveSet) {
+		A.ApplyTransposeColumns(Work.DataResidual, Work.ActiveColumns, Work.DataDirection);
+	}
+	else {
+		A.ApplyTranspose(Work.DataResidual, Work.DataDirection);
+	}
+
+	double C = TV_Subfunction(U, W, Nu, beta, SideLength, GradU) + TV_Norm(W, GradNorm)
+		+ Residual_Subfunction(Residual, Lambda, mu);
+	PROFILE_COUNT(Options, Applications, 1);
+	PROFILE_COUNT(Options, TransposeApplications, 1);
+	PROFILE_STOP(Options, SetupStart, SETUP_PHASE);
 
 	do
 	{
-		std::cout << "   * AM Loop Iter [" << LoopCounter + 1 << "]" << flush << endl;
-		//cout << "     U(k) = [" << U << "]" << endl;
 		//*************************** "w sub-problem" ***************************
-		W = ApplyShrike(AllPixelGradients(U, SideLength), Nu, beta, ISOTROPIC);
-		//cout << "     W(" << LoopCounter + 1 << ") = [" << W << "]" << endl;
+		PROFILE_START(Options, WStepStart);
+		// Nu and beta are fixed within this routine, so after the first pass
+		// only the tiles next to an update need shrinking again
+		if (ActiveSet && LoopCounter > 0) {
+			ShrinkActiveTiles(U, Nu, beta, GradNorm, SideLength, TileSize, Work.ShrinkTiles, W);
+		}
+		else {
+			ApplyGradientShrike(U, Nu, beta, GradNorm, SideLength, W);
+		}
+		PROFILE_STOP(Options, WStepStart, W_STEP_PHASE);
+		if (ActiveSet && Work.ActiveColumns.empty()) {
+			// Every tile has converged: U, and with it Residual and GradU, stay
+			innerstop = 0.0;
+			break;
+		}
 		//*************************** "u sub-problem" ***************************
-		BoostDoubleVector Sk = U - Uk_1;
-		BoostDoubleVector Dk = Onestep_Direction(A, U, B, W, Nu, Lambda, beta, mu, SideLength);
-		BoostDoubleVector Yk = Dk - Onestep_Direction(A, Uk_1, B, W, Nu, Lambda, beta, mu, SideLength);
+		PROFILE_START(Options, DirectionStart);
+		Work.DataDirectionk_1.swap(Work.DataDirection);
+		noalias(Work.DataResidual) = mu*Residual - Lambda;
+		if (ActiveSet) {
+			A.ApplyTransposeColumns(Work.DataResidual, Work.ActiveColumns, Work.DataDirection);
+		}
+		else {
+			A.ApplyTranspose(Work.DataResidual, Work.DataDirection);
+		}
+
+		noalias(Sk) = U - Uk_1;
+		TVDirectionFromGradient(GradU, W, Nu, beta, SideLength, Du, Dk);
+		noalias(Dk) += Work.DataDirection;
+		TVDirectionChange(GradU, GradUk_1, beta, SideLength, Du, Yk);
+		noalias(Yk) += Work.DataDirection - Work.DataDirectionk_1;
+		if (ActiveSet) {
+			// Minimise over the active pixels only; the data term of the
+			// direction is not computed elsewhere
+			ZeroFrozenTiles(SideLength, TileSize, Work.ActiveTiles, Sk);
+			ZeroFrozenTiles(SideLength, TileSize, Work.ActiveTiles, Dk);
+			ZeroFrozenTiles(SideLength, TileSize, Work.ActiveTiles, Yk);
+		}
 
 		//******** alpha = onestep_gradient ********
+		double SkYk = ParallelInnerProduct(Sk, Yk);
+		double alpha = SkYk / ParallelInnerProduct(Yk, Yk);
+		bool LongStep = (Options.StepSize == LONG_BB_STEP)
+			|| (Options.StepSize == ALTERNATING_BB_STEP && LoopCounter % 2 == 0);
+		if (LongStep) {
+			double LongAlpha = ParallelInnerProduct(Sk, Sk) / SkYk;
+			if (LongAlpha > 0 && LongAlpha < std::numeric_limits<double>::infinity()) {
+				alpha = LongAlpha;
+			}
+		}
+		if (Options.StepSize == DAMPED_BB_STEP) {
+			alpha = rho * alpha;
+		}
+		PROFILE_COUNT(Options, TransposeApplications, 1);
+		PROFILE_STOP(Options, DirectionStart, DIRECTION_PHASE);
 
-		//std::cout << "   * U(k) - U(k-1) ="<<Sk<<std::endl;
-		//std::cout << "   * D(k) ="<<Dk<<std::endl;
-		//std::cout << "   * D(k) - D(k-1) ="<<Yk<<std::endl;
-		double numerator = inner_prod(Sk, Yk);
-		double denominator = inner_prod(Yk, Yk);
-		double alpha = numerator / denominator;
+		PROFILE_START(Options, LineSearchStart);
+		if (ActiveSet) {
+			A.ApplyColumns(Dk, Work.ActiveColumns, ADk);
+		}
+		else {
+			A.Apply(Dk, ADk);
+		}
+		double DkSquareNorm = ParallelInnerProduct(Dk, Dk);
 
-		//cout << " alpha = [" << numerator << " / " << denominator << " = " << alpha << "]" << endl;
 		ArmijoLoopCounter = 0;
 		do
 		{
-			alpha = rho * alpha;
-			BoostDoubleVector U_alphad = U - alpha*Dk;
-			Qk = U_Subfunction(A, U_alphad, B, W, Nu, Lambda, beta, mu, SideLength);
-			armijo_tol = C - delta*alpha*inner_prod(Dk, Dk);
-			cout << "         > Armijo Iter [" << ArmijoLoopCounter + 1 << "]" << endl;
-			//cout << "           U - alpha *d: " << U_alphad << endl;
-			cout << " alpha: [" << alpha << "]" << flush << endl;
-			//cout << " Q(k): [" << Qk << "]" << flush << endl;
-			//cout << " armijo tol: [" << armijo_tol << "]" << flush << endl;
+			if (ArmijoLoopCounter > 0) {
+				alpha = rho * alpha;
+			}
+			noalias(U_alphad) = U - alpha*Dk;
+			noalias(Work.TrialResidual) = Residual - alpha*ADk;
+			Qk = TV_Subfunction(U_alphad, W, Nu, beta, SideLength, Du)
+				+ Residual_Subfunction(Work.TrialResidual, Lambda, mu);
+			armijo_tol = C - delta*alpha*DkSquareNorm;
 			ArmijoLoopCounter++;
+			if (Options.Progress) {
+				ReportProgress(Options, Work, ARMIJO_TRIAL, LoopCounter + 1, ArmijoLoopCounter,
+					Qk, alpha, armijo_tol);
+			}
 		} while ((Qk > armijo_tol) && (ArmijoLoopCounter < MaxArmijoIterations));
 
-		Uk_1 = U;
-		U -= alpha * Dk;
-		/*for (unsigned long i = 0; i < U.size(); ++i) {
-		if (U(i) < 0) { U(i) = 0; }
-		}*/
-		//cout << "     U(k+1) = [" << U << "]" << endl;
-		innerstop = norm_2(U - Uk_1);
-		//cout << " innerstop: [" << innerstop << "]" << flush << endl;
+		noalias(Uk_1) = U;
+		noalias(U) -= alpha * Dk;
+		// The last trial left the gradient field of the accepted U in Du
+		GradUk_1.swap(GradU);
+		GradU.swap(Du);
+		if (Options.Nonnegative) {
+			// Projecting onto U >= 0 invalidates the tracked residual and gradients
+			for (unsigned long i = 0; i < U.size(); ++i) {
+				if (U(i) < 0) { U(i) = 0; }
+			}
+			A.Apply(U, Residual);
+			noalias(Residual) -= B;
+			GradientField(U, SideLength, W.size2(), GradU);
+			PROFILE_COUNT(Options, Applications, 1);
+		}
+		else {
+			noalias(Residual) -= alpha * ADk;
+		}
+		innerstop = StepChange(U, Uk_1, Options);
+		PROFILE_COUNT(Options, Applications, 1);
+		PROFILE_COUNT(Options, ArmijoTrials, ArmijoLoopCounter);
+		PROFILE_COUNT(Options, ArmijoBacktracks, ArmijoLoopCounter - 1);
+		PROFILE_COUNT(Options, InnerIterations, 1);
+		PROFILE_STOP(Options, LineSearchStart, LINE_SEARCH_PHASE);
 		//************************ Implement coefficents ************************
+		// The last Armijo trial was evaluated at exactly the accepted U (before
+		// any nonnegativity projection).
 		double Pk1 = eta*Pk + 1;
-		C = (eta*Pk*C + U_Subfunction(A, U, B, W, Nu, Lambda, beta, mu, SideLength)) / Pk1;
+		C = (eta*Pk*C + Qk) / Pk1;
 		Pk = Pk1;
 		LoopCounter++;
+		if (Options.Progress) {
+			ReportProgress(Options, Work, INNER_ITERATION, LoopCounter, 0, Qk, alpha, innerstop);
+		}
 	} while ((innerstop > tol) && (LoopCounter < MaxIterations));
 }
 
-BoostDoubleMatrix tval3_reconstruction(BoostDoubleMatrix A, BoostDoubleVector y,
-	unsigned long SideLength)
-{
+void Alternating_Minimisation(const ProjectionOperator &A, BoostDoubleVector &U,
+	const BoostDoubleVector &B, BoostGradientMatrix &W,
+	const BoostGradientMatrix &Nu, const BoostDoubleVector &Lambda,
+	double beta, double mu,
+	unsigned long SideLength) {
 	/*
-	* Function: tval3_reconstruction
-	* ------------------------------
-	* Calculate the reconstructed image of the sample by the TVAL3 method.
+	* Form of Alternating_Minimisation which allocates its own workspace.
+	*/
+	TVAL3Workspace Work(B.size(), U.size());
+	Alternating_Minimisation(A, U, B, W, Nu, Lambda, beta, mu, SideLength, TVAL3Options(), Work);
+}
+
+void Alternating_Minimisation(const BoostDoubleMatrix &A, BoostDoubleVector &U,
+	const BoostDoubleVector &B, BoostGradientMatrix &W,
+	const BoostGradientMatrix &Nu, const BoostDoubleVector &Lambda,
+	double beta, double mu,
+	unsigned long SideLength) {
+	/*
+	* Dense (M x N) projection matrix form of Alternating_Minimisation.
+	*/
+	Alternating_Minimisation(DenseProjection(A), U, B, W, Nu, Lambda, beta, mu, SideLength);
+}
+
+static void TVAL3Iterate(const ProjectionOperator &A, const BoostDoubleVector &y,
+	unsigned long SideLength, const TVAL3Options &Options, BoostDoubleVector &U,
+	TVAL3Workspace &Work) {
+	/*
+	* Function: TVAL3Iterate
+	* ----------------------
+	* The outer TVAL3 loop, starting from the image U, which is overwritten by
+	* the reconstruction. Shared by the single, batch and volume entry points.
 	*
 	* Input --
-	* A: an (M x N) projection matrix
+	* A: an (M x N) projection operator
 	* y: an (M x 1) set of observations
 	* SideLength: the side length for the target image, i.e. N = SideLength^2
+	*             (times the depth, for volumes)
+	* Options: solver settings
+	* U: the (N x 1) initial image on entry, the reconstruction on return
+	* Work: a workspace for an (M x N) problem; a workspace with three
+	*       gradient planes reconstructs U as a volume with 3D TV
 	*
-	* Output -- an (L x L) reconstructed matrix.
+	* Output -- None.
 	*/
-	using namespace std;
-
 	// unsigned long L = Sinogram.size1(); // Size of the sample (in pixels)
 	// unsigned long O = Sinogram.size2(); // Numbers of tilt angles
 	// unsigned long M = L * O; // Numbers of measurements
 	// unsigned long N = L * L; // Size of rasterized Image vector
-	unsigned long M = A.size1();
-	unsigned long N = A.size2();
+	unsigned long M = A.Rows();
+	unsigned long N = A.Cols();
 	unsigned long L = SideLength; // allowing truncation
 
-	double mu = 1024.0;
-	double beta = 1024.0;
-	double coef = 1.0;
+	double mu = Options.Mu;
+	double beta = Options.Beta;
+	double coef = Options.Coefficient;
 	double outerstop;
-	double tol = 0.001;
+	double tol = Options.OuterTolerance;
 	unsigned int LoopCounter = 0;
-	unsigned int MaxIterations = 5;
+	unsigned int MaxIterations = Options.MaxOuterIterations;
 
-	// BoostDoubleVector U = BoostZeroVector(N); // U(0) = 0 for all i
-	BoostDoubleVector U = prod(trans(A), y);
-	BoostDoubleVector Uk_1 = BoostZeroVector(N);
-	BoostDoubleVector Lambda = BoostZeroVector(M);
-	// BoostDoubleVector B = MatrixToVector(Sinogram);
-
-	BoostDoubleMatrix Nu = BoostZeroMatrix(N, 2);
-	BoostDoubleMatrix W = ApplyShrike(AllPixelGradients(U, L), Nu, beta, ISOTROPIC);
-	// BoostDoubleMatrix A = CreateRandomMatrix(M, N);
-
-	//cout << "W(0): [" << W << "]" << endl;
+	unsigned long Planes = Work.Du.size2();
+	Work.ActiveTiles.clear();
+	BoostDoubleVector &Uk_1 = Work.OuterUk_1;
+	BoostDoubleVector &Lambda = Work.Lambda;
+	BoostGradientMatrix &Nu = Work.Nu;
+	BoostGradientMatrix &W = Work.W;
+	Uk_1.clear();
+	Lambda.clear();
+	Nu.clear();
+	bool WarmW = false;
+	unsigned int PriorIterations = 0;
+	if (const TVAL3State *Initial = Options.InitialState) {
+		if (Initial->Lambda.size() == M) { noalias(Lambda) = Initial->Lambda; }
+		if (Initial->Nu.size1() == N && Initial->Nu.size2() == Planes) { noalias(Nu) = Initial->Nu; }
+		WarmW = (Initial->W.size1() == N && Initial->W.size2() == Planes);
+		if (WarmW) { noalias(W) = Initial->W; }
+		if (Initial->Beta > 0) { beta = Initial->Beta; }
+		if (Initial->Mu > 0) { mu = Initial->Mu; }
+		PriorIterations = Initial->OuterIterations;
+	}
+	PROFILE_START(Options, SetupStart);
+	if (!WarmW) {
+		ApplyGradientShrike(U, Nu, beta, Options.GradNorm, L, W);
+	}
+	PROFILE_STOP(Options, SetupStart, SETUP_PHASE);
+	Work.StartTime = boost::posix_time::microsec_clock::universal_time();
 
 	do
 	{
-		cout << "Outer Iter [" << LoopCounter + 1 << "]" << endl;
-		//cout << " U* = [" << U << "]" << endl;
-		Uk_1 = U;
-		Alternating_Minimisation(A, U, y, W, Nu, Lambda, beta, mu, L);
-		BoostDoubleMatrix Du = AllPixelGradients(U, L);
-		Nu = Nu - beta*(Du - W);
-		Lambda = Lambda - mu*(prod(A, U) - y);
+		Work.OuterIteration = LoopCounter + 1;
+		noalias(Uk_1) = U;
+		Alternating_Minimisation(A, U, y, W, Nu, Lambda, beta, mu, L, Options, Work);
+		PROFILE_START(Options, MultiplierStart);
+		// Alternating_Minimisation leaves D*U in the workspace
+		noalias(Nu) -= beta*(Work.GradU - W);
+		// Alternating_Minimisation leaves A*U - y in the workspace
+		noalias(Lambda) -= mu*Work.Residual;
+		PROFILE_COUNT(Options, OuterIterations, 1);
+		PROFILE_STOP(Options, MultiplierStart, MULTIPLIER_UPDATE_PHASE);
 
 		beta = coef*beta;
-		mu = coef*beta;
+		mu = coef*mu;
 
-		outerstop = norm_2(U - Uk_1);
+		outerstop = StepChange(U, Uk_1, Options);
+		if (Options.ActiveTileSize > 0 && Planes == 2) {
+			FreezeConvergedTiles(U, Uk_1, L, Options, Work);
+		}
 		LoopCounter++;
+		if (Options.Progress) {
+			// Work.Residual is still A*U - y
+			double Objective = TV_Subfunction(U, W, Nu, beta, L, Work.Du)
+				+ TV_Norm(W, Options.GradNorm) + Residual_Subfunction(Work.Residual, Lambda, mu);
+			ReportProgress(Options, Work, OUTER_ITERATION, 0, 0, Objective, 0.0, outerstop);
+		}
 	} while (outerstop > tol && LoopCounter < MaxIterations);
 
-	return VectorToMatrix(U, L, L);
-}
\ No newline at end of file
+	if (TVAL3State *Final = Options.FinalState) {
+		Final->U = U;
+		Final->W = W;
+		Final->Nu = Nu;
+		Final->Lambda = Lambda;
+		Final->Beta = beta;
+		Final->Mu = mu;
+		Final->OuterIterations = PriorIterations + LoopCounter;
+	}
+}
+
+static BoostDoubleVector TVAL3Solve(const ProjectionOperator &A, const BoostDoubleVector &y,
+	unsigned long SideLength, unsigned long GradientPlanes, const TVAL3Options &Options) {
+	/*
+	* Function: TVAL3Solve
+	* --------------------
+	* Set up and run a single reconstruction, returning the (N x 1) vector U.
+	* GradientPlanes is 2 for an image and 3 for a volume.
+	*/
+	PROFILE_RESET(Options);
+	PROFILE_START(Options, TotalStart);
+	PROFILE_START(Options, SetupStart);
+	// All per-iteration storage is allocated here, once, unless the caller
+	// supplied a workspace.
+	TVAL3Workspace LocalWork(Options.Workspace ? 0 : A.Rows(), Options.Workspace ? 0 : A.Cols(),
+		GradientPlanes);
+	TVAL3Workspace &Work = Options.Workspace ? *Options.Workspace : LocalWork;
+	Work.Resize(A.Rows(), A.Cols(), GradientPlanes);
+
+	// BoostDoubleVector U = BoostZeroVector(N); // U(0) = 0 for all i
+	const TVAL3State *Initial = Options.InitialState;
+	bool WarmState = (Initial && Initial->U.size() == A.Cols());
+	bool WarmStart = WarmState || (Options.InitialImage.size() == A.Cols());
+	BoostDoubleVector U = WarmState ? Initial->U
+		: (WarmStart ? Options.InitialImage : A.BackProject(y));
+	PROFILE_COUNT(Options, TransposeApplications, WarmStart ? 0 : 1);
+	PROFILE_STOP(Options, SetupStart, SETUP_PHASE);
+	TVAL3Iterate(A, y, SideLength, Options, U, Work);
+	PROFILE_TOTAL(Options, TotalStart);
+
+	return U;
+}
+
+BoostDoubleMatrix tval3_reconstruction(const ProjectionOperator &A, const BoostDoubleVector &y,
+	unsigned long SideLength, const TVAL3Options &Options)
+{
+	/*
+	* Function: tval3_reconstruction
+	* ------------------------------
+	* Calculate the reconstructed image of the sample by the TVAL3 method.
+	*
+	* Input --
+	* A: an (M x N) projection operator
+	* y: an (M x 1) set of observations
+	* SideLength: the side length for the target image, i.e. N = SideLength^2
+	* Options: solver settings
+	*
+	* Output -- an (L x L) reconstructed matrix.
+	*/
+	return VectorToMatrix(TVAL3Solve(A, y, SideLength, 2, Options), SideLength, SideLength);
+}
+
+BoostDoubleMatrix tval3_reconstruction(const ProjectionOperator &A, const BoostDoubleVector &y,
+	unsigned long SideLength) {
+	/*
+	* Form of tval3_reconstruction with the default TVAL3Options.
+	*/
+	return tval3_reconstruction(A, y, SideLength, TVAL3Options());
+}
+
+BoostDoubleMatrix tval3_reconstruction(const BoostDoubleMatrix &A, const BoostDoubleVector &y,
+	unsigned long SideLength) {
+	/*
+	* Dense (M x N) projection matrix form of tval3_reconstruction.
+	*/
+	return tval3_reconstruction(DenseProjection(A), y, SideLength);
+}
+
+BoostDoubleMatrix tval3_reconstruction(const BoostDoubleMatrix &A, const BoostDoubleVector &y,
+	unsigned long SideLength, const TVAL3Options &Options) {
+	/*
+	* Dense (M x N) projection matrix form of tval3_reconstruction.
+	*/
+	return tval3_reconstruction(DenseProjection(A), y, SideLength, Options);
+}
+BoostDoubleMatrix tval3_pyramid_reconstruction(const BoostDoubleMatrix &Sinogram,
+	const BoostDoubleVector &TiltAngles, unsigned int Levels, const TVAL3Options &Options) {
+	/*
+	* Function: tval3_pyramid_reconstruction
+	* --------------------------------------
+	* Reconstruct a parallel-beam sinogram coarse to fine. Level l of the
+	* pyramid, for l = Levels-1, ..., 1, 0, reconstructs the image at side
+	* L/2^l from the sinogram binned to L/2^l detectors (see HalveSinogram).
+	* Every level after the first starts from the previous result, resized
+	* up by bilinear interpolation, instead of from the back-projection. The
+	* coarse levels are cheap, and they settle the low frequencies, so the
+	* full-resolution level starts near the solution.
+	*
+	* Levels is reduced until L is divisible by 2^(Levels-1), and until the
+	* coarsest side is at least 8 pixels.
+	*
+	* Input --
+	* Sinogram: an (L x O) sinogram, one column of L detector bins per angle
+	* TiltAngles: the (O x 1) tilt angles, in degrees
+	* Levels: the number of resolutions; 1 is a plain reconstruction
+	* Options: settings for every level; InitialImage and InitialState are
+	*          used only by the coarsest level, and FinalState, when set,
+	*          receives the state of the full-resolution level. The profile
+	*          sums the levels
+	*
+	* Output -- the (L x L) reconstructed matrix.
+	*/
+	unsigned long L = Sinogram.size1();
+	while (Levels > 1 && ((L % (1UL << (Levels - 1))) != 0 || (L >> (Levels - 1)) < 8)) {
+		--Levels;
+	}
+	if (Levels == 0) {
+		Levels = 1;
+	}
+
+	// Bin the sinogram down, finest first
+	std::vector<BoostDoubleMatrix> Sinograms(Levels);
+	Sinograms[0] = Sinogram;
+	for (unsigned int Level = 1; Level < Levels; ++Level) {
+		Sinograms[Level] = HalveSinogram(Sinograms[Level - 1]);
+	}
+
+	PROFILE_RESET(Options);
+	PROFILE_START(Options, TotalStart);
+	TVAL3Options LevelOptions(Options);
+	TVAL3Profile LevelProfile;
+	LevelOptions.Profile = Options.Profile ? &LevelProfile : NULL;
+	BoostDoubleMatrix Reconstruction;
+	for (int Level = static_cast<int>(Levels) - 1; Level >= 0; --Level) {
+		unsigned long LevelSide = Sinograms[Level].size1();
+		if (Level < static_cast<int>(Levels) - 1) {
+			LevelOptions.InitialImage = MatrixToVector(ResizeMatrix(Reconstruction, LevelSide, LevelSide));
+			LevelOptions.InitialState = NULL;
+		}
+		LevelOptions.FinalState = (Level == 0) ? Options.FinalState : NULL;
+		SparseProjection Projection = BuildParallelBeamProjection(TiltAngles, LevelSide);
+		Reconstruction = tval3_reconstruction(Projection, MatrixToVector(Sinograms[Level]),
+			LevelSide, LevelOptions);
+		if (Options.Profile) {
+			Options.Profile->Add(LevelProfile);
+		}
+	}
+	PROFILE_TOTAL(Options, TotalStart);
+
+	return Reconstruction;
+}
+
+BoostDoubleMatrix tval3_pyramid_reconstruction(const BoostDoubleMatrix &Sinogram,
+	const BoostDoubleVector &TiltAngles, unsigned int Levels) {
+	/*
+	* Form of tval3_pyramid_reconstruction with the default TVAL3Options.
+	*/
+	return tval3_pyramid_reconstruction(Sinogram, TiltAngles, Levels, TVAL3Options());
+}
+
+std::vector<BoostDoubleMatrix> tval3_batch_reconstruction(const ProjectionOperator &A,
+	const BoostDoubleMatrix &Y, unsigned long SideLength, const TVAL3Options &Options) {
+	/*
+	* Function: tval3_batch_reconstruction
+	* ------------------------------------
+	* Reconstruct K slices sharing the same geometry, equivalent to calling
+	* tval3_reconstruction on each column of Y.
+	*
+	* The initial back-projection of every slice is a single block product
+	* over A. The slices are then solved on separate threads, all reading the
+	* same operator; within a slice the kernels run single-threaded, as
+	* nested parallel regions are inactive by default.
+	*
+	* Input --
+	* A: an (M x N) projection operator
+	* Y: an (M x K) set of observations, one slice per column
+	* SideLength: the side length for the target images, i.e. N = SideLength^2
+	* Options: solver settings shared by every slice; InitialImage,
+	*          InitialState, FinalState, Workspace and Progress are ignored,
+	*          and each slice starts from its own back-projection
+	*
+	* Output -- the K (L x L) reconstructed matrices, in slice order.
+	*/
+	unsigned long M = A.Rows();
+	unsigned long N = A.Cols();
+	unsigned long K = Y.size2();
+
+	PROFILE_RESET(Options);
+	PROFILE_START(Options, TotalStart);
+	PROFILE_START(Options, SetupStart);
+	BoostDoubleMatrix U0;
+	A.ApplyTransposeBlock(Y, U0);
+	PROFILE_COUNT(Options, TransposeApplications, K);
+	PROFILE_STOP(Options, SetupStart, SETUP_PHASE);
+
+	// Slices start cold and return no state, as they share the options, and
+	// report no progress, as the callback would run on several threads at once
+	TVAL3Options SliceOptions(Options);
+	SliceOptions.InitialImage.resize(0);
+	SliceOptions.InitialState = NULL;
+	SliceOptions.FinalState = NULL;
+	SliceOptions.Workspace = NULL;
+	SliceOptions.Progress = NULL;
+	SliceOptions.ProgressData = NULL;
+#ifdef CTVM_PROFILE
+	// Each slice records into its own profile, merged in slice order below
+	std::vector<TVAL3Profile> SliceProfiles(Options.Profile ? K : 0);
+#endif
+
+	std::vector<BoostDoubleMatrix> Reconstructions(K);
+	#pragma omp parallel for num_threads(GetThreadCount()) schedule(dynamic, 1) if(K > 1)
+	for (long Slice = 0; Slice < static_cast<long>(K); ++Slice) {
+		TVAL3Workspace Work(M, N);
+		BoostDoubleVector y = boost::numeric::ublas::column(Y, Slice);
+		BoostDoubleVector U = boost::numeric::ublas::column(U0, Slice);
+#ifdef CTVM_PROFILE
+		TVAL3Options ThisSliceOptions(SliceOptions);
+		ThisSliceOptions.Profile = Options.Profile ? &SliceProfiles[Slice] : NULL;
+		TVAL3Iterate(A, y, SideLength, ThisSliceOptions, U, Work);
+#else
+		TVAL3Iterate(A, y, SideLength, SliceOptions, U, Work);
+#endif
+		Reconstructions[Slice] = VectorToMatrix(U, SideLength, SideLength);
+	}
+
+#ifdef CTVM_PROFILE
+	for (unsigned long Slice = 0; Slice < SliceProfiles.size(); ++Slice) {
+		Options.Profile->Add(SliceProfiles[Slice]);
+	}
+#endif
+	PROFILE_TOTAL(Options, TotalStart);
+
+	return Reconstructions;
+}
+
+std::vector<BoostDoubleMatrix> tval3_batch_reconstruction(const ProjectionOperator &A,
+	const BoostDoubleMatrix &Y, unsigned long SideLength) {
+	/*
+	* Form of tval3_batch_reconstruction with the default TVAL3Options.
+	*/
+	return tval3_batch_reconstruction(A, Y, SideLength, TVAL3Options());
+}
+
+std::vector<BoostDoubleMatrix> tval3_batch_reconstruction(const BoostDoubleMatrix &A,
+	const BoostDoubleMatrix &Y, unsigned long SideLength) {
+	/*
+	* Dense (M x N) projection matrix form of tval3_batch_reconstruction.
+	*/
+	return tval3_batch_reconstruction(DenseProjection(A), Y, SideLength);
+}
+
+std::vector<BoostDoubleMatrix> tval3_batch_reconstruction(const BoostDoubleMatrix &A,
+	const BoostDoubleMatrix &Y, unsigned long SideLength, const TVAL3Options &Options) {
+	/*
+	* Dense (M x N) projection matrix form of tval3_batch_reconstruction.
+	*/
+	return tval3_batch_reconstruction(DenseProjection(A), Y, SideLength, Options);
+}
+
+std::vector<BoostDoubleMatrix> tval3_volume_reconstruction(const ProjectionOperator &A,
+	const BoostDoubleMatrix &Y, unsigned long SideLength, const TVAL3Options &Options) {
+	/*
+	* Function: tval3_volume_reconstruction
+	* -------------------------------------
+	* Reconstruct K slices sharing the same geometry as one volume, with 3D
+	* total variation: unlike tval3_batch_reconstruction, the gradient
+	* between each slice and the next is regularised too.
+	*
+	* The volume operator is the SliceStackProjection of A, so each product
+	* is a single block product over A for all slices.
+	*
+	* Input --
+	* A: an (M x N) projection operator for one slice
+	* Y: an (M x K) set of observations, one slice per column
+	* SideLength: the side length for each slice, i.e. N = SideLength^2
+	* Options: solver settings; InitialImage, if set, is the (N*K x 1) volume
+	*          rasterized slice by slice, and so is the state, over 3 planes
+	*
+	* Output -- the K (L x L) reconstructed slices, in order.
+	*/
+	unsigned long M = A.Rows();
+	unsigned long N = A.Cols();
+	unsigned long K = Y.size2();
+
+	SliceStackProjection Volume(A, K);
+	BoostDoubleVector y(M * K);
+	for (unsigned long k = 0; k < K; ++k) {
+		for (unsigned long r = 0; r < M; ++r) {
+			y(k*M + r) = Y(r, k);
+		}
+	}
+	BoostDoubleVector U = TVAL3Solve(Volume, y, SideLength, 3, Options);
+
+	std::vector<BoostDoubleMatrix> Reconstructions(K);
+	BoostDoubleVector Slice(N);
+	for (unsigned long k = 0; k < K; ++k) {
+		std::copy(U.begin() + k*N, U.begin() + (k + 1)*N, Slice.begin());
+		Reconstructions[k] = VectorToMatrix(Slice, SideLength, SideLength);
+	}
+
+	return Reconstructions;
+}
+
+std::vector<BoostDoubleMatrix> tval3_volume_reconstruction(const ProjectionOperator &A,
+	const BoostDoubleMatrix &Y, unsigned long SideLength) {
+	/*
+	* Form of tval3_volume_reconstruction with the default TVAL3Options.
+	*/
+	return tval3_volume_reconstruction(A, Y, SideLength, TVAL3Options());
+}
+
+std::vector<BoostDoubleMatrix> tval3_volume_reconstruction(const BoostDoubleMatrix &A,
+	const BoostDoubleMatrix &Y, unsigned long SideLength) {
+	/*
+	* Dense (M x N) projection matrix form of tval3_volume_reconstruction.
+	*/
+	return tval3_volume_reconstruction(DenseProjection(A), Y, SideLength);
+}
+
+std::vector<BoostDoubleMatrix> tval3_volume_reconstruction(const BoostDoubleMatrix &A,
+	const BoostDoubleMatrix &Y, unsigned long SideLength, const TVAL3Options &Options) {
+	/*
+	* Dense (M x N) projection matrix form of tval3_volume_reconstruction.
+	*/
+	return tval3_volume_reconstruction(DenseProjection(A), Y, SideLength, Options);
+}
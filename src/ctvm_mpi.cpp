@@ -0,0 +1,505 @@
+#include "ctvm_mpi.h"
+
+#ifdef CTVM_MPI
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+static unsigned long ShareBegin(unsigned long Count, int Rank, int Ranks) {
+	// The first item of rank Rank when Count items are split evenly in order
+	return static_cast<unsigned long>(static_cast<unsigned long long>(Count) * Rank / Ranks);
+}
+
+MPIPartition PartitionReconstruction(unsigned long SideLength, unsigned long Angles, int Rank,
+	int Ranks) {
+	/*
+	* Function: PartitionReconstruction
+	* ---------------------------------
+	* Split the tilt angles and the image columns of an (L x L) reconstruction
+	* between Ranks ranks.
+	*
+	* Input --
+	* SideLength: the side length L of the image
+	* Angles: the number of tilt angles O
+	* Rank: the rank, 0 .. Ranks-1
+	* Ranks: the number of ranks
+	*
+	* Output -- the share of Rank.
+	*/
+	MPIPartition Partition;
+	Partition.AngleBegin = ShareBegin(Angles, Rank, Ranks);
+	Partition.AngleEnd = ShareBegin(Angles, Rank + 1, Ranks);
+	Partition.ColumnBegin = ShareBegin(SideLength, Rank, Ranks);
+	Partition.ColumnEnd = ShareBegin(SideLength, Rank + 1, Ranks);
+	return Partition;
+}
+
+MPISession::MPISession(int &argc, char **&argv) {
+	int Initialized = 0;
+	MPI_Initialized(&Initialized);
+	Owned = !Initialized;
+	if (Owned) {
+		MPI_Init(&argc, &argv);
+	}
+}
+
+MPISession::~MPISession() {
+	int Finalized = 0;
+	MPI_Finalized(&Finalized);
+	if (Owned && !Finalized) {
+		MPI_Finalize();
+	}
+}
+
+int MPISession::Rank() const {
+	int Rank = 0;
+	MPI_Comm_rank(MPI_COMM_WORLD, &Rank);
+	return Rank;
+}
+
+int MPISession::Ranks() const {
+	int Ranks = 1;
+	MPI_Comm_size(MPI_COMM_WORLD, &Ranks);
+	return Ranks;
+}
+
+/* Distributed Operations */
+// The rows of A held by this rank, the image slab it updates, and the
+// buffers for the communication of the distributed products and stencils.
+// Sums over the ranks are of at most four values at a time.
+struct DistributedProblem {
+	DistributedProblem(const ProjectionOperator &A, unsigned long SideLength, MPI_Comm Comm);
+
+	const ProjectionOperator &A;
+	MPI_Comm Comm;
+	int Rank, Ranks;
+	// The ranks holding the slabs to the left and right (or MPI_PROC_NULL)
+	int Left, Right;
+	// The slab: Columns columns of L rows, starting at column ColumnBegin
+	unsigned long L, ColumnBegin, Columns, Pixels;
+	// The slab pixels of every rank, and where they start in the image
+	std::vector<int> Counts, Offsets;
+	// The whole image, for A*U, and the partial A^T*r of this rank
+	BoostDoubleVector Image, Transposed;
+	// The neighbouring column of U, for D*U, and of the horizontal gradient,
+	// for D^T*G
+	BoostDoubleVector Halo, HaloGh;
+};
+
+DistributedProblem::DistributedProblem(const ProjectionOperator &A, unsigned long SideLength,
+	MPI_Comm Comm)
+	: A(A), Comm(Comm), L(SideLength) {
+	MPI_Comm_rank(Comm, &Rank);
+	MPI_Comm_size(Comm, &Ranks);
+	Left = (Rank > 0) ? Rank - 1 : MPI_PROC_NULL;
+	Right = (Rank + 1 < Ranks) ? Rank + 1 : MPI_PROC_NULL;
+
+	if (L < static_cast<unsigned long>(Ranks)) {
+		throw std::invalid_argument("tval3_mpi_reconstruction: every rank needs an image column");
+	}
+	if (L * L > static_cast<unsigned long>(std::numeric_limits<int>::max())) {
+		throw std::invalid_argument("tval3_mpi_reconstruction: image too large for MPI counts");
+	}
+	Counts.resize(Ranks);
+	Offsets.resize(Ranks);
+	for (int r = 0; r < Ranks; ++r) {
+		MPIPartition Share = PartitionReconstruction(L, 0, r, Ranks);
+		Counts[r] = static_cast<int>(L * (Share.ColumnEnd - Share.ColumnBegin));
+		Offsets[r] = static_cast<int>(L * Share.ColumnBegin);
+	}
+	MPIPartition Own = PartitionReconstruction(L, 0, Rank, Ranks);
+	ColumnBegin = Own.ColumnBegin;
+	Columns = Own.ColumnEnd - Own.ColumnBegin;
+	Pixels = L * Columns;
+	Image.resize(L * L, false);
+	Halo.resize(L, false);
+	HaloGh.resize(L, false);
+}
+
+static void SumOverRanks(DistributedProblem &P, double *Values, int Count) {
+	/*
+	* Function: SumOverRanks
+	* ----------------------
+	* Replace the Count values of every rank by their sums over the ranks.
+	* The sums steer the line search and the stopping tests, so they are
+	* formed once, on rank 0, and broadcast: MPI_Allreduce need not give
+	* every rank the same rounding, and ranks taking different branches
+	* would deadlock.
+	*/
+	double Sums[4];
+	MPI_Reduce(Values, Sums, Count, MPI_DOUBLE, MPI_SUM, 0, P.Comm);
+	if (P.Rank == 0) {
+		std::copy(Sums, Sums + Count, Values);
+	}
+	MPI_Bcast(Values, Count, MPI_DOUBLE, 0, P.Comm);
+}
+
+static void GatherImage(DistributedProblem &P, const BoostDoubleVector &U) {
+	// Every rank's slab into P.Image, on every rank
+	MPI_Allgatherv(U.data().begin(), static_cast<int>(P.Pixels), MPI_DOUBLE, P.Image.data().begin(),
+		&P.Counts[0], &P.Offsets[0], MPI_DOUBLE, P.Comm);
+}
+
+static void Project(DistributedProblem &P, const BoostDoubleVector &U, BoostDoubleVector &Y) {
+	/*
+	* Function: Project
+	* -----------------
+	* This rank's rows of A*U, for the slabs U of every rank.
+	*/
+	GatherImage(P, U);
+	P.A.Apply(P.Image, Y);
+}
+
+static void BackProject(DistributedProblem &P, const BoostDoubleVector &R, BoostDoubleVector &X) {
+	/*
+	* Function: BackProject
+	* ---------------------
+	* This rank's slab of A^T*R, for the rows R of every rank.
+	*/
+	P.A.ApplyTranspose(R, P.Transposed);
+	X.resize(P.Pixels, false);
+	MPI_Reduce_scatter(P.Transposed.data().begin(), X.data().begin(), &P.Counts[0], MPI_DOUBLE,
+		MPI_SUM, P.Comm);
+}
+
+static void Gradient(DistributedProblem &P, const BoostDoubleVector &U, BoostGradientMatrix &G) {
+	/*
+	* Function: Gradient
+	* ------------------
+	* The slab of D*U: each rank sends its first column to the left and
+	* receives the first column of the slab to its right.
+	*/
+	unsigned long L = P.L;
+	G.resize(P.Pixels, 2, false);
+	MPI_Sendrecv(U.data().begin(), static_cast<int>(L), MPI_DOUBLE, P.Left, 0,
+		P.Halo.data().begin(), static_cast<int>(L), MPI_DOUBLE, P.Right, 0, P.Comm, MPI_STATUS_IGNORE);
+	double *GData = G.data().begin();
+	ForwardDifferenceSlab(U.data().begin(), (P.Right != MPI_PROC_NULL) ? P.Halo.data().begin() : NULL,
+		L, P.Columns, GData + HORZ*P.Pixels, GData + VERT*P.Pixels);
+}
+
+static void GradientAdjoint(DistributedProblem &P, const BoostGradientMatrix &G, BoostDoubleVector &X) {
+	/*
+	* Function: GradientAdjoint
+	* -------------------------
+	* The slab of D^T*G: each rank sends the horizontal gradient of its last
+	* column to the right and receives that of the slab to its left.
+	*/
+	unsigned long L = P.L;
+	X.resize(P.Pixels, false);
+	const double *Gh = G.data().begin() + HORZ*P.Pixels;
+	const double *Gv = G.data().begin() + VERT*P.Pixels;
+	MPI_Sendrecv(Gh + (P.Columns - 1)*L, static_cast<int>(L), MPI_DOUBLE, P.Right, 1,
+		P.HaloGh.data().begin(), static_cast<int>(L), MPI_DOUBLE, P.Left, 1, P.Comm, MPI_STATUS_IGNORE);
+	ForwardDifferenceAdjointSlab(Gh, Gv, (P.Left != MPI_PROC_NULL) ? P.HaloGh.data().begin() : NULL,
+		L, P.Columns, X.data().begin());
+}
+
+static double GradientMatching(const BoostGradientMatrix &Du, const BoostGradientMatrix &W,
+	const BoostGradientMatrix &Nu, double beta) {
+	/*
+	* Function: GradientMatching
+	* --------------------------
+	* This slab's part of TV_Subfunction, given the gradients Du of U.
+	*/
+	unsigned long N = Du.size1();
+	const double *DuH = Du.data().begin() + HORZ*N, *DuV = Du.data().begin() + VERT*N;
+	const double *WH = W.data().begin() + HORZ*N, *WV = W.data().begin() + VERT*N;
+	const double *NuH = Nu.data().begin() + HORZ*N, *NuV = Nu.data().begin() + VERT*N;
+	return DeterministicSum(N, [=](unsigned long Begin, unsigned long End) {
+		double Sum = 0.0;
+		for (unsigned long i = Begin; i < End; ++i) {
+			double GradDiffH = DuH[i] - WH[i];
+			double GradDiffV = DuV[i] - WV[i];
+
+			Sum += -(NuH[i]*GradDiffH + NuV[i]*GradDiffV)
+				+ (beta / 2) * (GradDiffH*GradDiffH + GradDiffV*GradDiffV);
+		}
+		return Sum;
+	});
+}
+
+static double StepChange(DistributedProblem &P, const BoostDoubleVector &U,
+	const BoostDoubleVector &Uk_1, const TVAL3Options &Options) {
+	/*
+	* Function: StepChange
+	* --------------------
+	* ||U - U(k-1)|| over the whole image, relative to ||U|| when
+	* Options.RelativeTolerance is set.
+	*/
+	const double *UData = U.data().begin(), *Uk_1Data = Uk_1.data().begin();
+	double Squares[2];
+	Squares[0] = DeterministicSum(U.size(), [=](unsigned long Begin, unsigned long End) {
+		double Sum = 0.0;
+		for (unsigned long i = Begin; i < End; ++i) {
+			Sum += (UData[i] - Uk_1Data[i]) * (UData[i] - Uk_1Data[i]);
+		}
+		return Sum;
+	});
+	Squares[1] = ParallelInnerProduct(U, U);
+	SumOverRanks(P, Squares, 2);
+
+	double Change = sqrt(Squares[0]);
+	if (Options.RelativeTolerance && Squares[1] > 0) {
+		Change /= sqrt(Squares[1]);
+	}
+	return Change;
+}
+
+/* Distributed Solver */
+static void DistributedMinimisation(DistributedProblem &P, BoostDoubleVector &U,
+	const BoostDoubleVector &B, BoostGradientMatrix &W, const BoostGradientMatrix &Nu,
+	const BoostDoubleVector &Lambda, double beta, double mu, const TVAL3Options &Options,
+	TVAL3Workspace &Work) {
+	/*
+	* Function: DistributedMinimisation
+	* ---------------------------------
+	* Alternating_Minimisation with the gradient u-step, on this rank's slab
+	* of U, W and Nu and its rows of B and Lambda. The projections and
+	* gradient fields are carried across iterations in the same way, so each
+	* iteration applies A and A^T once, and sums four inner products over
+	* the ranks for its step and one value for each Armijo trial.
+	*
+	* On return Work.Residual holds this rank's rows of A*U - B and
+	* Work.GradU the slab of D*U.
+	*/
+	double delta = Options.Delta;
+	double rho = Options.Rho;
+	double eta = Options.Eta;
+	double Pk = 1;
+	double armijo_tol, Qk, innerstop;
+	unsigned int LoopCounter = 0;
+	unsigned int ArmijoLoopCounter = 0;
+	TVType GradNorm = Options.GradNorm;
+
+	BoostDoubleVector &Uk_1 = Work.Uk_1;
+	BoostDoubleVector &Sk = Work.Sk;
+	BoostDoubleVector &Dk = Work.Dk;
+	BoostDoubleVector &Yk = Work.Yk;
+	BoostDoubleVector &U_alphad = Work.U_alphad;
+	BoostGradientMatrix &Du = Work.Du;
+	BoostGradientMatrix &GradU = Work.GradU;
+	BoostGradientMatrix &GradUk_1 = Work.GradUk_1;
+	BoostDoubleVector &Residual = Work.Residual;
+	BoostDoubleVector &ADk = Work.ADk;
+	Uk_1.clear();
+	GradUk_1.resize(P.Pixels, 2, false);
+	GradUk_1.clear();
+
+	// Residual = A*U - B; DataDirection = A'*(mu*(A*u - b) - lambda) at
+	// U(k-1), starting from U(k-1) = 0
+	Project(P, U, Residual);
+	noalias(Residual) -= B;
+	noalias(Work.DataResidual) = -mu*B - Lambda;
+	BackProject(P, Work.DataResidual, Work.DataDirection);
+	Gradient(P, U, GradU);
+	double C = GradientMatching(GradU, W, Nu, beta) + TV_Norm(W, GradNorm)
+		+ Residual_Subfunction(Residual, Lambda, mu);
+	SumOverRanks(P, &C, 1);
+
+	do
+	{
+		//*************************** "w sub-problem" ***************************
+		// D*U is already in GradU, so the slabs shrink independently
+		ShrikePlanes(GradU.data().begin(), Nu.data().begin(), P.Pixels, 2, beta, GradNorm,
+			W.data().begin());
+
+		//*************************** "u sub-problem" ***************************
+		Work.DataDirectionk_1.swap(Work.DataDirection);
+		noalias(Work.DataResidual) = mu*Residual - Lambda;
+		BackProject(P, Work.DataResidual, Work.DataDirection);
+
+		noalias(Sk) = U - Uk_1;
+		noalias(Du) = beta*GradU + beta*W + Nu;
+		GradientAdjoint(P, Du, Dk);
+		noalias(Dk) = Work.DataDirection - Dk;
+		noalias(Du) = beta*(GradU - GradUk_1);
+		GradientAdjoint(P, Du, Yk);
+		noalias(Yk) = (Work.DataDirection - Work.DataDirectionk_1) - Yk;
+
+		//******** alpha = onestep_gradient ********
+		double Products[4] = { ParallelInnerProduct(Sk, Yk), ParallelInnerProduct(Yk, Yk),
+			ParallelInnerProduct(Sk, Sk), ParallelInnerProduct(Dk, Dk) };
+		SumOverRanks(P, Products, 4);
+		double SkYk = Products[0];
+		double alpha = SkYk / Products[1];
+		bool LongStep = (Options.StepSize == LONG_BB_STEP)
+			|| (Options.StepSize == ALTERNATING_BB_STEP && LoopCounter % 2 == 0);
+		if (LongStep) {
+			double LongAlpha = Products[2] / SkYk;
+			if (LongAlpha > 0 && LongAlpha < std::numeric_limits<double>::infinity()) {
+				alpha = LongAlpha;
+			}
+		}
+		if (Options.StepSize == DAMPED_BB_STEP) {
+			alpha = rho * alpha;
+		}
+		double DkSquareNorm = Products[3];
+
+		Project(P, Dk, ADk);
+		ArmijoLoopCounter = 0;
+		do
+		{
+			if (ArmijoLoopCounter > 0) {
+				alpha = rho * alpha;
+			}
+			noalias(U_alphad) = U - alpha*Dk;
+			noalias(Work.TrialResidual) = Residual - alpha*ADk;
+			Gradient(P, U_alphad, Du);
+			Qk = GradientMatching(Du, W, Nu, beta) + Residual_Subfunction(Work.TrialResidual, Lambda, mu);
+			SumOverRanks(P, &Qk, 1);
+			armijo_tol = C - delta*alpha*DkSquareNorm;
+			ArmijoLoopCounter++;
+		} while ((Qk > armijo_tol) && (ArmijoLoopCounter < Options.MaxArmijoIterations));
+
+		noalias(Uk_1) = U;
+		noalias(U) -= alpha * Dk;
+		// The last trial left the gradient field of the accepted U in Du
+		GradUk_1.swap(GradU);
+		GradU.swap(Du);
+		if (Options.Nonnegative) {
+			for (unsigned long i = 0; i < U.size(); ++i) {
+				if (U(i) < 0) { U(i) = 0; }
+			}
+			Project(P, U, Residual);
+			noalias(Residual) -= B;
+			Gradient(P, U, GradU);
+		}
+		else {
+			noalias(Residual) -= alpha * ADk;
+		}
+		innerstop = StepChange(P, U, Uk_1, Options);
+
+		double Pk1 = eta*Pk + 1;
+		C = (eta*Pk*C + Qk) / Pk1;
+		Pk = Pk1;
+		LoopCounter++;
+	} while ((innerstop > Options.InnerTolerance) && (LoopCounter < Options.MaxInnerIterations));
+}
+
+BoostDoubleMatrix tval3_mpi_reconstruction(const ProjectionOperator &LocalA,
+	const BoostDoubleVector &LocalY, unsigned long SideLength, const TVAL3Options &Options,
+	MPI_Comm Comm) {
+	/*
+	* Function: tval3_mpi_reconstruction
+	* ----------------------------------
+	* Calculate the reconstructed image of the sample by the TVAL3 method,
+	* distributed over the ranks of Comm.
+	*
+	* Input --
+	* LocalA: this rank's (M_r x N) rows of the projection operator
+	* LocalY: the (M_r x 1) observations of those rows
+	* SideLength: the side length for the target image, i.e. N = SideLength^2
+	* Options: solver settings, the same on every rank
+	* Comm: the communicator of the ranks sharing the reconstruction
+	*
+	* Output -- the (L x L) reconstructed matrix, on every rank.
+	*/
+	unsigned long L = SideLength;
+	if (LocalA.Cols() != L * L || LocalY.size() != LocalA.Rows()) {
+		throw std::invalid_argument("tval3_mpi_reconstruction: operator and observations do not match");
+	}
+	DistributedProblem P(LocalA, L, Comm);
+	TVAL3Workspace Work(LocalA.Rows(), P.Pixels, 2);
+
+	BoostDoubleVector U(P.Pixels);
+	if (Options.InitialImage.size() == L * L) {
+		for (unsigned long i = 0; i < P.Pixels; ++i) {
+			U(i) = Options.InitialImage(P.ColumnBegin * L + i);
+		}
+	}
+	else {
+		BackProject(P, LocalY, U);
+	}
+
+	double mu = Options.Mu;
+	double beta = Options.Beta;
+	double outerstop;
+	unsigned int LoopCounter = 0;
+	BoostDoubleVector &Uk_1 = Work.OuterUk_1;
+	BoostDoubleVector &Lambda = Work.Lambda;
+	BoostGradientMatrix &Nu = Work.Nu;
+	BoostGradientMatrix &W = Work.W;
+	Uk_1.clear();
+	Lambda.clear();
+	Nu.clear();
+	Gradient(P, U, Work.Du);
+	ShrikePlanes(Work.Du.data().begin(), Nu.data().begin(), P.Pixels, 2, beta, Options.GradNorm,
+		W.data().begin());
+	double StartTime = MPI_Wtime();
+
+	do
+	{
+		noalias(Uk_1) = U;
+		DistributedMinimisation(P, U, LocalY, W, Nu, Lambda, beta, mu, Options, Work);
+		// The inner loop leaves D*U and A*U - y in the workspace
+		noalias(Nu) -= beta*(Work.GradU - W);
+		noalias(Lambda) -= mu*Work.Residual;
+
+		beta = Options.Coefficient*beta;
+		mu = Options.Coefficient*mu;
+
+		outerstop = StepChange(P, U, Uk_1, Options);
+		LoopCounter++;
+		// Summed on every rank, so that ranks may differ in reporting progress
+		double Objective = GradientMatching(Work.GradU, W, Nu, beta) + TV_Norm(W, Options.GradNorm)
+			+ Residual_Subfunction(Work.Residual, Lambda, mu);
+		SumOverRanks(P, &Objective, 1);
+		if (Options.Progress) {
+			TVAL3Progress Report;
+			Report.Stage = OUTER_ITERATION;
+			Report.OuterIteration = LoopCounter;
+			Report.InnerIteration = 0;
+			Report.ArmijoIteration = 0;
+			Report.Objective = Objective;
+			Report.StepSize = 0.0;
+			Report.Stop = outerstop;
+			Report.ElapsedSeconds = MPI_Wtime() - StartTime;
+			Options.Progress(Report, Options.ProgressData);
+		}
+	} while (outerstop > Options.OuterTolerance && LoopCounter < Options.MaxOuterIterations);
+
+	GatherImage(P, U);
+	return VectorToMatrix(P.Image, L, L);
+}
+
+BoostDoubleMatrix tval3_mpi_reconstruction(const BoostDoubleMatrix &Sinogram,
+	const BoostDoubleVector &TiltAngles, const TVAL3Options &Options, MPI_Comm Comm) {
+	/*
+	* Function: tval3_mpi_reconstruction
+	* ----------------------------------
+	* Parallel-beam form: each rank builds the rows of A for its share of the
+	* tilt angles, so the whole matrix is never held by one rank.
+	*
+	* Input --
+	* Sinogram: the (L x O) sinogram, the same on every rank
+	* TiltAngles: the (O x 1) tilt angles, in degrees
+	* Options: solver settings, the same on every rank
+	* Comm: the communicator of the ranks sharing the reconstruction
+	*
+	* Output -- the (L x L) reconstructed matrix, on every rank.
+	*/
+	unsigned long L = Sinogram.size1(), O = Sinogram.size2();
+	if (TiltAngles.size() != O) {
+		throw std::invalid_argument("tval3_mpi_reconstruction: one tilt angle per sinogram column expected");
+	}
+	int Rank = 0, Ranks = 1;
+	MPI_Comm_rank(Comm, &Rank);
+	MPI_Comm_size(Comm, &Ranks);
+	MPIPartition Share = PartitionReconstruction(L, O, Rank, Ranks);
+	unsigned long Angles = Share.AngleEnd - Share.AngleBegin;
+
+	std::vector<unsigned long> RowPtr(1, 0);
+	std::vector<unsigned long> ColIndex;
+	std::vector<double> Values;
+	BoostDoubleVector LocalY(L * Angles);
+	for (unsigned long a = 0; a < Angles; ++a) {
+		AppendParallelBeamRows(TiltAngles(Share.AngleBegin + a), L, RowPtr, ColIndex, Values);
+		for (unsigned long d = 0; d < L; ++d) {
+			LocalY(a * L + d) = Sinogram(d, Share.AngleBegin + a);
+		}
+	}
+	SparseProjection LocalA(L * Angles, L * L, RowPtr, ColIndex, Values);
+	return tval3_mpi_reconstruction(LocalA, LocalY, L, Options, Comm);
+}
+#endif
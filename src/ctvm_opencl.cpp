@@ -0,0 +1,251 @@
+#include "ctvm_opencl.h"
+
+#ifdef CTVM_OPENCL
+#include <algorithm>
+#include <stdexcept>
+#include <sstream>
+
+// One work-item per output entry: a gather over the non-zeros of its row.
+// A^T is applied by running the same kernel over the transposed (CSC) arrays.
+static const char *SparseGatherSource =
+	"__kernel void SparseGather(const unsigned int Rows,\n"
+	"	__global const unsigned int *Pointers, __global const unsigned int *Indices,\n"
+	"	__global const float *Values, __global const float *X, __global float *Y) {\n"
+	"	unsigned int r = get_global_id(0);\n"
+	"	if (r >= Rows) { return; }\n"
+	"	float Sum = 0.0f;\n"
+	"	for (unsigned int k = Pointers[r]; k < Pointers[r + 1]; ++k) {\n"
+	"		Sum += Values[k] * X[Indices[k]];\n"
+	"	}\n"
+	"	Y[r] = Sum;\n"
+	"}\n";
+
+static void CheckOpenCL(cl_int Status, const char *Call) {
+	/*
+	* Function: CheckOpenCL
+	* ---------------------
+	* Throw a std::runtime_error naming the call if Status is an error code.
+	*/
+	if (Status != CL_SUCCESS) {
+		std::ostringstream Message;
+		Message << "OpenCL: " << Call << " failed with error " << Status;
+		throw std::runtime_error(Message.str());
+	}
+}
+
+template <typename Source, typename Target>
+static cl_mem UploadArray(cl_context Context, const std::vector<Source> &Data) {
+	/*
+	* Function: UploadArray
+	* ---------------------
+	* Copy the array, converted to Target, into a new read-only device buffer.
+	* Empty arrays get a one-element buffer, as OpenCL has no empty buffers.
+	*/
+	std::vector<Target> Converted(Data.begin(), Data.end());
+	if (Converted.empty()) {
+		Converted.push_back(Target());
+	}
+	cl_int Status;
+	cl_mem Buffer = clCreateBuffer(Context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+		Converted.size() * sizeof(Target), &Converted[0], &Status);
+	CheckOpenCL(Status, "clCreateBuffer");
+	return Buffer;
+}
+
+static void SetGatherArguments(cl_kernel Kernel, unsigned long Rows, cl_mem Pointers,
+	cl_mem Indices, cl_mem Values, cl_mem X, cl_mem Y) {
+	/*
+	* Function: SetGatherArguments
+	* ----------------------------
+	* Bind a SparseGather kernel to the CSR arrays of a (Rows x ...) matrix,
+	* reading from the device vector X and writing to Y.
+	*/
+	cl_uint DeviceRows = static_cast<cl_uint>(Rows);
+	CheckOpenCL(clSetKernelArg(Kernel, 0, sizeof(cl_uint), &DeviceRows), "clSetKernelArg");
+	CheckOpenCL(clSetKernelArg(Kernel, 1, sizeof(cl_mem), &Pointers), "clSetKernelArg");
+	CheckOpenCL(clSetKernelArg(Kernel, 2, sizeof(cl_mem), &Indices), "clSetKernelArg");
+	CheckOpenCL(clSetKernelArg(Kernel, 3, sizeof(cl_mem), &Values), "clSetKernelArg");
+	CheckOpenCL(clSetKernelArg(Kernel, 4, sizeof(cl_mem), &X), "clSetKernelArg");
+	CheckOpenCL(clSetKernelArg(Kernel, 5, sizeof(cl_mem), &Y), "clSetKernelArg");
+}
+
+OpenCLProjection::OpenCLProjection(const SparseProjection &A, unsigned int PlatformIndex,
+	unsigned int DeviceIndex)
+	: M(A.Rows()), N(A.Cols()), NNZ(A.NonZeros()),
+	Device(NULL), Context(NULL), Queue(NULL), Program(NULL),
+	ForwardKernel(NULL), TransposeKernel(NULL),
+	RowPtr(NULL), ColIndex(NULL), Values(NULL), ColPtr(NULL), RowIndex(NULL), ColValues(NULL),
+	XBuffer(NULL), YBuffer(NULL) {
+	/*
+	* Function: OpenCLProjection::OpenCLProjection
+	* --------------------------------------------
+	* Create a context and queue on the given device of the given platform,
+	* build the kernel and upload the matrix and its transpose.
+	*/
+	const unsigned long MaxIndex = 4294967295UL;
+	if (M > MaxIndex || N > MaxIndex || NNZ > MaxIndex) {
+		throw std::runtime_error("OpenCL: projection too large for 32-bit indices");
+	}
+
+	try {
+		cl_uint PlatformCount = 0;
+		CheckOpenCL(clGetPlatformIDs(0, NULL, &PlatformCount), "clGetPlatformIDs");
+		if (PlatformIndex >= PlatformCount) {
+			throw std::runtime_error("OpenCL: no platform with the requested index");
+		}
+		std::vector<cl_platform_id> Platforms(PlatformCount);
+		CheckOpenCL(clGetPlatformIDs(PlatformCount, &Platforms[0], NULL), "clGetPlatformIDs");
+
+		cl_uint DeviceCount = 0;
+		CheckOpenCL(clGetDeviceIDs(Platforms[PlatformIndex], CL_DEVICE_TYPE_ALL, 0, NULL,
+			&DeviceCount), "clGetDeviceIDs");
+		if (DeviceIndex >= DeviceCount) {
+			throw std::runtime_error("OpenCL: no device with the requested index");
+		}
+		std::vector<cl_device_id> Devices(DeviceCount);
+		CheckOpenCL(clGetDeviceIDs(Platforms[PlatformIndex], CL_DEVICE_TYPE_ALL, DeviceCount,
+			&Devices[0], NULL), "clGetDeviceIDs");
+		Device = Devices[DeviceIndex];
+
+		cl_int Status;
+		Context = clCreateContext(NULL, 1, &Device, NULL, NULL, &Status);
+		CheckOpenCL(Status, "clCreateContext");
+		Queue = clCreateCommandQueue(Context, Device, 0, &Status);
+		CheckOpenCL(Status, "clCreateCommandQueue");
+
+		Program = clCreateProgramWithSource(Context, 1, &SparseGatherSource, NULL, &Status);
+		CheckOpenCL(Status, "clCreateProgramWithSource");
+		if (clBuildProgram(Program, 1, &Device, "", NULL, NULL) != CL_SUCCESS) {
+			size_t LogSize = 0;
+			clGetProgramBuildInfo(Program, Device, CL_PROGRAM_BUILD_LOG, 0, NULL, &LogSize);
+			std::string Log(LogSize, '\0');
+			if (LogSize > 0) {
+				clGetProgramBuildInfo(Program, Device, CL_PROGRAM_BUILD_LOG, LogSize, &Log[0], NULL);
+			}
+			throw std::runtime_error("OpenCL: kernel build failed: " + Log);
+		}
+		ForwardKernel = clCreateKernel(Program, "SparseGather", &Status);
+		CheckOpenCL(Status, "clCreateKernel");
+		TransposeKernel = clCreateKernel(Program, "SparseGather", &Status);
+		CheckOpenCL(Status, "clCreateKernel");
+
+		RowPtr = UploadArray<unsigned long, cl_uint>(Context, A.RowPointers());
+		ColIndex = UploadArray<unsigned long, cl_uint>(Context, A.ColumnIndices());
+		Values = UploadArray<double, cl_float>(Context, A.NonZeroValues());
+		ColPtr = UploadArray<unsigned long, cl_uint>(Context, A.ColumnPointers());
+		RowIndex = UploadArray<unsigned long, cl_uint>(Context, A.RowIndices());
+		ColValues = UploadArray<double, cl_float>(Context, A.ColumnValues());
+		XBuffer = clCreateBuffer(Context, CL_MEM_READ_WRITE, (N > 0 ? N : 1) * sizeof(cl_float),
+			NULL, &Status);
+		CheckOpenCL(Status, "clCreateBuffer");
+		YBuffer = clCreateBuffer(Context, CL_MEM_READ_WRITE, (M > 0 ? M : 1) * sizeof(cl_float),
+			NULL, &Status);
+		CheckOpenCL(Status, "clCreateBuffer");
+
+		SetGatherArguments(ForwardKernel, M, RowPtr, ColIndex, Values, XBuffer, YBuffer);
+		SetGatherArguments(TransposeKernel, N, ColPtr, RowIndex, ColValues, YBuffer, XBuffer);
+	}
+	catch (...) {
+		Release();
+		throw;
+	}
+}
+
+OpenCLProjection::~OpenCLProjection() {
+	Release();
+}
+
+void OpenCLProjection::Release() {
+	/*
+	* Function: OpenCLProjection::Release
+	* -----------------------------------
+	* Release every device resource created so far, in reverse order.
+	*/
+	cl_mem *Buffers[8] = { &YBuffer, &XBuffer, &ColValues, &RowIndex, &ColPtr,
+		&Values, &ColIndex, &RowPtr };
+	for (int b = 0; b < 8; ++b) {
+		if (*Buffers[b]) { clReleaseMemObject(*Buffers[b]); *Buffers[b] = NULL; }
+	}
+	if (TransposeKernel) { clReleaseKernel(TransposeKernel); TransposeKernel = NULL; }
+	if (ForwardKernel) { clReleaseKernel(ForwardKernel); ForwardKernel = NULL; }
+	if (Program) { clReleaseProgram(Program); Program = NULL; }
+	if (Queue) { clReleaseCommandQueue(Queue); Queue = NULL; }
+	if (Context) { clReleaseContext(Context); Context = NULL; }
+}
+
+unsigned long OpenCLProjection::Rows() const {
+	return M;
+}
+
+unsigned long OpenCLProjection::Cols() const {
+	return N;
+}
+
+unsigned long OpenCLProjection::NonZeros() const {
+	return NNZ;
+}
+
+std::string OpenCLProjection::DeviceName() const {
+	size_t NameSize = 0;
+	CheckOpenCL(clGetDeviceInfo(Device, CL_DEVICE_NAME, 0, NULL, &NameSize), "clGetDeviceInfo");
+	std::string Name(NameSize, '\0');
+	if (NameSize > 0) {
+		CheckOpenCL(clGetDeviceInfo(Device, CL_DEVICE_NAME, NameSize, &Name[0], NULL),
+			"clGetDeviceInfo");
+	}
+	// Drop the terminating null returned by the runtime
+	return Name.c_str();
+}
+
+void OpenCLProjection::Multiply(cl_kernel Kernel, cl_mem In, cl_mem Out,
+	const BoostDoubleVector &X, unsigned long OutLength, BoostDoubleVector &Y) const {
+	/*
+	* Function: OpenCLProjection::Multiply
+	* ------------------------------------
+	* Upload X to the device buffer In, run the kernel over OutLength rows and
+	* read the result back from Out into Y.
+	*/
+	std::lock_guard<std::mutex> Guard(Lock);
+	unsigned long InLength = X.size();
+	Staging.resize(std::max(std::max(InLength, OutLength), 1UL));
+
+	for (unsigned long i = 0; i < InLength; ++i) {
+		Staging[i] = static_cast<float>(X(i));
+	}
+	if (InLength > 0) {
+		CheckOpenCL(clEnqueueWriteBuffer(Queue, In, CL_TRUE, 0, InLength * sizeof(cl_float),
+			&Staging[0], 0, NULL, NULL), "clEnqueueWriteBuffer");
+	}
+
+	Y.resize(OutLength, false);
+	if (OutLength == 0) {
+		return;
+	}
+	size_t GlobalSize = OutLength;
+	CheckOpenCL(clEnqueueNDRangeKernel(Queue, Kernel, 1, NULL, &GlobalSize, NULL, 0, NULL, NULL),
+		"clEnqueueNDRangeKernel");
+	CheckOpenCL(clEnqueueReadBuffer(Queue, Out, CL_TRUE, 0, OutLength * sizeof(cl_float),
+		&Staging[0], 0, NULL, NULL), "clEnqueueReadBuffer");
+	for (unsigned long i = 0; i < OutLength; ++i) {
+		Y(i) = Staging[i];
+	}
+}
+
+void OpenCLProjection::Apply(const BoostDoubleVector &X, BoostDoubleVector &Y) const {
+	/*
+	* Function: OpenCLProjection::Apply
+	* ---------------------------------
+	* Y = A*X on the device.
+	*/
+	Multiply(ForwardKernel, XBuffer, YBuffer, X, M, Y);
+}
+
+void OpenCLProjection::ApplyTranspose(const BoostDoubleVector &Y, BoostDoubleVector &X) const {
+	/*
+	* Function: OpenCLProjection::ApplyTranspose
+	* ------------------------------------------
+	* X = A^T*Y on the device, using the uploaded transpose.
+	*/
+	Multiply(TransposeKernel, YBuffer, XBuffer, Y, N, X);
+}
+#endif
@@ -0,0 +1,1243 @@
+#include "ctvm_operator.h"
+#include <complex>
+#include <stdexcept>
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/uniform_int_distribution.hpp>
+
+
+BoostDoubleVector ProjectionOperator::Project(const BoostDoubleVector &X) const {
+	/*
+	* Function: ProjectionOperator::Project
+	* -------------------------------------
+	* Convenience form of Apply which allocates and returns the result.
+	*
+	* Input --
+	* X: an (N x 1) vector representing a rasterized image
+	*
+	* Output -- the (M x 1) vector A*X.
+	*/
+	BoostDoubleVector Y(Rows());
+	Apply(X, Y);
+	return Y;
+}
+
+BoostDoubleVector ProjectionOperator::BackProject(const BoostDoubleVector &Y) const {
+	/*
+	* Function: ProjectionOperator::BackProject
+	* -----------------------------------------
+	* Convenience form of ApplyTranspose which allocates and returns the result.
+	*
+	* Input --
+	* Y: an (M x 1) vector of measurements
+	*
+	* Output -- the (N x 1) vector A^T*Y.
+	*/
+	BoostDoubleVector X(Cols());
+	ApplyTranspose(Y, X);
+	return X;
+}
+
+void ProjectionOperator::ApplyBlock(const BoostDoubleMatrix &X, BoostDoubleMatrix &Y) const {
+	/*
+	* Function: ProjectionOperator::ApplyBlock
+	* ----------------------------------------
+	* Y = A * X for an (N x K) block of images, one per column. This default
+	* applies the operator column by column.
+	*
+	* Input --
+	* X: an (N x K) block of rasterized images
+	* Y: the (M x K) output block, resized only if necessary
+	*
+	* Output -- None.
+	*/
+	unsigned long K = X.size2();
+	Y.resize(Rows(), K, false);
+	BoostDoubleVector XColumn(Cols()), YColumn(Rows());
+	for (unsigned long k = 0; k < K; ++k) {
+		noalias(XColumn) = boost::numeric::ublas::column(X, k);
+		Apply(XColumn, YColumn);
+		boost::numeric::ublas::column(Y, k) = YColumn;
+	}
+}
+
+void ProjectionOperator::ApplyTransposeBlock(const BoostDoubleMatrix &Y, BoostDoubleMatrix &X) const {
+	/*
+	* Function: ProjectionOperator::ApplyTransposeBlock
+	* -------------------------------------------------
+	* X = A^T * Y for an (M x K) block of measurements, one per column. This
+	* default applies the transpose column by column.
+	*
+	* Input --
+	* Y: an (M x K) block of measurements
+	* X: the (N x K) output block, resized only if necessary
+	*
+	* Output -- None.
+	*/
+	unsigned long K = Y.size2();
+	X.resize(Cols(), K, false);
+	BoostDoubleVector YColumn(Rows()), XColumn(Cols());
+	for (unsigned long k = 0; k < K; ++k) {
+		noalias(YColumn) = boost::numeric::ublas::column(Y, k);
+		ApplyTranspose(YColumn, XColumn);
+		boost::numeric::ublas::column(X, k) = XColumn;
+	}
+}
+
+void ProjectionOperator::ApplyColumns(const BoostDoubleVector &X,
+	const std::vector<unsigned long> &Columns, BoostDoubleVector &Y) const {
+	/*
+	* Function: ProjectionOperator::ApplyColumns
+	* ------------------------------------------
+	* Y = A * X for X zero outside Columns. This default applies the full
+	* operator, which gives the same product.
+	*/
+	Apply(X, Y);
+}
+
+void ProjectionOperator::ApplyTransposeColumns(const BoostDoubleVector &Y,
+	const std::vector<unsigned long> &Columns, BoostDoubleVector &X) const {
+	/*
+	* Function: ProjectionOperator::ApplyTransposeColumns
+	* ---------------------------------------------------
+	* The Columns entries of X = A^T * Y. This default computes every entry.
+	*/
+	ApplyTranspose(Y, X);
+}
+
+bool ProjectionOperator::SquaredColumnNorms(BoostDoubleVector &Norms) const {
+	/*
+	* Function: ProjectionOperator::SquaredColumnNorms
+	* ------------------------------------------------
+	* The column norms are not known without N applications of A.
+	*/
+	return false;
+}
+
+bool ProjectionOperator::CosineDiagonal(unsigned long SideLength, BoostDoubleVector &Diagonal) const {
+	/*
+	* Function: ProjectionOperator::CosineDiagonal
+	* --------------------------------------------
+	* A^T * A is not known to be diagonal in the DCT basis.
+	*/
+	return false;
+}
+
+DenseProjection::DenseProjection(const BoostDoubleMatrix &AMatrix) : A(AMatrix) {
+}
+
+unsigned long DenseProjection::Rows() const {
+	return A.size1();
+}
+
+unsigned long DenseProjection::Cols() const {
+	return A.size2();
+}
+
+void DenseProjection::Apply(const BoostDoubleVector &X, BoostDoubleVector &Y) const {
+	/*
+	* Function: DenseProjection::Apply
+	* --------------------------------
+	* Dense matrix-vector product, Y = A*X.
+	*/
+	unsigned long M = A.size1(), N = A.size2();
+	Y.resize(M, false);
+	const double *AData = A.data().begin();
+	const double *XData = X.data().begin();
+
+	// A is row-major, so each row is a contiguous inner product
+	#pragma omp parallel for num_threads(GetThreadCount()) schedule(static) if(M*N >= ParallelMinimumWork)
+	for (long Row = 0; Row < static_cast<long>(M); ++Row) {
+		const double *ARow = AData + Row*N;
+		double Sum = 0.0;
+		for (unsigned long c = 0; c < N; ++c) {
+			Sum += ARow[c] * XData[c];
+		}
+		Y(Row) = Sum;
+	}
+}
+
+bool DenseProjection::SquaredColumnNorms(BoostDoubleVector &Norms) const {
+	/*
+	* Function: DenseProjection::SquaredColumnNorms
+	* ---------------------------------------------
+	* Norms(c) = sum_r A(r, c)^2, accumulated row by row.
+	*/
+	unsigned long M = A.size1(), N = A.size2();
+	const double *AData = A.data().begin();
+	Norms.resize(N, false);
+	Norms.clear();
+	for (unsigned long r = 0; r < M; ++r) {
+		const double *ARow = AData + r*N;
+		for (unsigned long c = 0; c < N; ++c) {
+			Norms(c) += ARow[c] * ARow[c];
+		}
+	}
+	return true;
+}
+
+void DenseProjection::ApplyTranspose(const BoostDoubleVector &Y, BoostDoubleVector &X) const {
+	/*
+	* Function: DenseProjection::ApplyTranspose
+	* -----------------------------------------
+	* Dense transposed matrix-vector product, X = A^T*Y.
+	*/
+	const unsigned long Block = 256;
+	unsigned long M = A.size1(), N = A.size2();
+	X.resize(N, false);
+	const double *AData = A.data().begin();
+	double *XData = X.data().begin();
+
+	// Each thread owns a block of columns of X and sweeps the rows of A in
+	// order over it, keeping memory access unit-stride and the per-entry
+	// summation order fixed.
+	long Blocks = static_cast<long>((N + Block - 1) / Block);
+	#pragma omp parallel for num_threads(GetThreadCount()) schedule(static) if(M*N >= ParallelMinimumWork)
+	for (long b = 0; b < Blocks; ++b) {
+		unsigned long Begin = b * Block;
+		unsigned long End = std::min(Begin + Block, N);
+		for (unsigned long c = Begin; c < End; ++c) {
+			XData[c] = 0.0;
+		}
+		for (unsigned long r = 0; r < M; ++r) {
+			const double *ARow = AData + r*N;
+			double thisY = Y(r);
+			for (unsigned long c = Begin; c < End; ++c) {
+				XData[c] += ARow[c] * thisY;
+			}
+		}
+	}
+}
+
+void DenseProjection::ApplyBlock(const BoostDoubleMatrix &X, BoostDoubleMatrix &Y) const {
+	/*
+	* Function: DenseProjection::ApplyBlock
+	* -------------------------------------
+	* Dense matrix-matrix product (GEMM), Y = A*X. Each row of Y accumulates
+	* the rows of X scaled by one row of A, so every entry of A is read once
+	* for all K columns.
+	*/
+	unsigned long M = A.size1(), N = A.size2(), K = X.size2();
+	Y.resize(M, K, false);
+	const double *AData = A.data().begin();
+	const double *XData = X.data().begin();
+	double *YData = Y.data().begin();
+
+	#pragma omp parallel for num_threads(GetThreadCount()) schedule(static) if(M*N >= ParallelMinimumWork)
+	for (long Row = 0; Row < static_cast<long>(M); ++Row) {
+		const double *ARow = AData + Row*N;
+		double *YRow = YData + Row*K;
+		for (unsigned long j = 0; j < K; ++j) {
+			YRow[j] = 0.0;
+		}
+		for (unsigned long c = 0; c < N; ++c) {
+			const double *XRow = XData + c*K;
+			double thisA = ARow[c];
+			for (unsigned long j = 0; j < K; ++j) {
+				YRow[j] += thisA * XRow[j];
+			}
+		}
+	}
+}
+
+void DenseProjection::ApplyTransposeBlock(const BoostDoubleMatrix &Y, BoostDoubleMatrix &X) const {
+	/*
+	* Function: DenseProjection::ApplyTransposeBlock
+	* ----------------------------------------------
+	* Dense transposed matrix-matrix product, X = A^T*Y, blocked over the
+	* columns of A as in ApplyTranspose.
+	*/
+	const unsigned long Block = 256;
+	unsigned long M = A.size1(), N = A.size2(), K = Y.size2();
+	X.resize(N, K, false);
+	const double *AData = A.data().begin();
+	const double *YData = Y.data().begin();
+	double *XData = X.data().begin();
+
+	long Blocks = static_cast<long>((N + Block - 1) / Block);
+	#pragma omp parallel for num_threads(GetThreadCount()) schedule(static) if(M*N >= ParallelMinimumWork)
+	for (long b = 0; b < Blocks; ++b) {
+		unsigned long Begin = b * Block;
+		unsigned long End = std::min(Begin + Block, N);
+		for (unsigned long p = Begin*K; p < End*K; ++p) {
+			XData[p] = 0.0;
+		}
+		for (unsigned long r = 0; r < M; ++r) {
+			const double *ARow = AData + r*N;
+			const double *YRow = YData + r*K;
+			for (unsigned long c = Begin; c < End; ++c) {
+				double *XRow = XData + c*K;
+				double thisA = ARow[c];
+				for (unsigned long j = 0; j < K; ++j) {
+					XRow[j] += thisA * YRow[j];
+				}
+			}
+		}
+	}
+}
+
+template <typename Scalar>
+BasicSparseProjection<Scalar>::BasicSparseProjection(unsigned long Rows, unsigned long Cols,
+	const std::vector<unsigned long> &RowPointers,
+	const std::vector<unsigned long> &ColumnIndices,
+	const std::vector<Scalar> &NonZeroValues)
+	: M(Rows), N(Cols), RowPtr(RowPointers), ColIndex(ColumnIndices), Values(NonZeroValues) {
+	/*
+	* Function: BasicSparseProjection::BasicSparseProjection
+	* ------------------------------------------------------
+	* Store the CSR arrays and build the transposed copy by a counting sort
+	* over the column indices. Within each column the entries keep their row
+	* order, so ApplyTranspose sums them in the same order as a serial
+	* scatter over the rows would.
+	*/
+	unsigned long NonZeros = Values.size();
+	ColPtr.assign(N + 1, 0);
+	RowIndex.resize(NonZeros);
+	ColValues.resize(NonZeros);
+
+	for (unsigned long k = 0; k < NonZeros; ++k) {
+		ColPtr[ColIndex[k] + 1]++;
+	}
+	for (unsigned long c = 0; c < N; ++c) {
+		ColPtr[c + 1] += ColPtr[c];
+	}
+
+	std::vector<unsigned long> Next(ColPtr.begin(), ColPtr.end() - 1);
+	for (unsigned long r = 0; r < M; ++r) {
+		for (unsigned long k = RowPtr[r]; k < RowPtr[r + 1]; ++k) {
+			unsigned long Slot = Next[ColIndex[k]]++;
+			RowIndex[Slot] = r;
+			ColValues[Slot] = Values[k];
+		}
+	}
+}
+
+template <typename Scalar>
+template <typename OtherScalar>
+BasicSparseProjection<Scalar>::BasicSparseProjection(const BasicSparseProjection<OtherScalar> &Other)
+	: M(Other.M), N(Other.N), RowPtr(Other.RowPtr), ColIndex(Other.ColIndex),
+	Values(Other.Values.begin(), Other.Values.end()),
+	ColPtr(Other.ColPtr), RowIndex(Other.RowIndex),
+	ColValues(Other.ColValues.begin(), Other.ColValues.end()) {
+	/*
+	* Function: BasicSparseProjection::BasicSparseProjection
+	* ------------------------------------------------------
+	* Copy an operator with a different storage type, rounding each non-zero
+	* to Scalar. The sparsity pattern and transposed copy are reused as-is.
+	*/
+}
+
+template <typename Scalar>
+unsigned long BasicSparseProjection<Scalar>::Rows() const {
+	return M;
+}
+
+template <typename Scalar>
+unsigned long BasicSparseProjection<Scalar>::Cols() const {
+	return N;
+}
+
+template <typename Scalar>
+unsigned long BasicSparseProjection<Scalar>::NonZeros() const {
+	return Values.size();
+}
+
+template <typename Scalar>
+const std::vector<unsigned long> &BasicSparseProjection<Scalar>::RowPointers() const {
+	return RowPtr;
+}
+
+template <typename Scalar>
+const std::vector<unsigned long> &BasicSparseProjection<Scalar>::ColumnIndices() const {
+	return ColIndex;
+}
+
+template <typename Scalar>
+const std::vector<Scalar> &BasicSparseProjection<Scalar>::NonZeroValues() const {
+	return Values;
+}
+
+template <typename Scalar>
+const std::vector<unsigned long> &BasicSparseProjection<Scalar>::ColumnPointers() const {
+	return ColPtr;
+}
+
+template <typename Scalar>
+const std::vector<unsigned long> &BasicSparseProjection<Scalar>::RowIndices() const {
+	return RowIndex;
+}
+
+template <typename Scalar>
+const std::vector<Scalar> &BasicSparseProjection<Scalar>::ColumnValues() const {
+	return ColValues;
+}
+
+template <typename Scalar>
+void BasicSparseProjection<Scalar>::Apply(const BoostDoubleVector &X, BoostDoubleVector &Y) const {
+	/*
+	* Function: BasicSparseProjection::Apply
+	* --------------------------------------
+	* Sparse matrix-vector product (SpMV), Y = A*X. Each row is a gather over
+	* its non-zero columns, so the cost is O(nnz) rather than O(M*N).
+	*/
+	Y.resize(M, false);
+	#pragma omp parallel for num_threads(GetThreadCount()) schedule(dynamic, 64) if(NonZeros() >= ParallelMinimumWork)
+	for (long Row = 0; Row < static_cast<long>(M); ++Row) {
+		unsigned long r = Row;
+		double Sum = 0.0;
+		for (unsigned long k = RowPtr[r]; k < RowPtr[r + 1]; ++k) {
+			Sum += Values[k] * X(ColIndex[k]);
+		}
+		Y(r) = Sum;
+	}
+}
+
+template <typename Scalar>
+void BasicSparseProjection<Scalar>::ApplyTranspose(const BoostDoubleVector &Y, BoostDoubleVector &X) const {
+	/*
+	* Function: BasicSparseProjection::ApplyTranspose
+	* -----------------------------------------------
+	* Transposed sparse matrix-vector product, X = A^T*Y, evaluated as a
+	* gather over the columns of the transposed copy.
+	*/
+	X.resize(N, false);
+	#pragma omp parallel for num_threads(GetThreadCount()) schedule(dynamic, 64) if(NonZeros() >= ParallelMinimumWork)
+	for (long Col = 0; Col < static_cast<long>(N); ++Col) {
+		unsigned long c = Col;
+		double Sum = 0.0;
+		for (unsigned long k = ColPtr[c]; k < ColPtr[c + 1]; ++k) {
+			Sum += ColValues[k] * Y(RowIndex[k]);
+		}
+		X(c) = Sum;
+	}
+}
+
+template <typename Scalar>
+void BasicSparseProjection<Scalar>::ApplyBlock(const BoostDoubleMatrix &X, BoostDoubleMatrix &Y) const {
+	/*
+	* Function: BasicSparseProjection::ApplyBlock
+	* -------------------------------------------
+	* Sparse matrix-matrix product (SpMM), Y = A*X. Each non-zero is loaded
+	* once and applied to a contiguous row of K values of X.
+	*/
+	unsigned long K = X.size2();
+	Y.resize(M, K, false);
+	const double *XData = X.data().begin();
+	double *YData = Y.data().begin();
+
+	#pragma omp parallel for num_threads(GetThreadCount()) schedule(dynamic, 64) if(NonZeros() >= ParallelMinimumWork)
+	for (long Row = 0; Row < static_cast<long>(M); ++Row) {
+		unsigned long r = Row;
+		double *YRow = YData + r*K;
+		for (unsigned long j = 0; j < K; ++j) {
+			YRow[j] = 0.0;
+		}
+		for (unsigned long k = RowPtr[r]; k < RowPtr[r + 1]; ++k) {
+			const double *XRow = XData + ColIndex[k]*K;
+			double thisValue = Values[k];
+			for (unsigned long j = 0; j < K; ++j) {
+				YRow[j] += thisValue * XRow[j];
+			}
+		}
+	}
+}
+
+template <typename Scalar>
+void BasicSparseProjection<Scalar>::ApplyTransposeBlock(const BoostDoubleMatrix &Y, BoostDoubleMatrix &X) const {
+	/*
+	* Function: BasicSparseProjection::ApplyTransposeBlock
+	* ----------------------------------------------------
+	* Transposed SpMM, X = A^T*Y, as a gather over the transposed copy.
+	*/
+	unsigned long K = Y.size2();
+	X.resize(N, K, false);
+	const double *YData = Y.data().begin();
+	double *XData = X.data().begin();
+
+	#pragma omp parallel for num_threads(GetThreadCount()) schedule(dynamic, 64) if(NonZeros() >= ParallelMinimumWork)
+	for (long Col = 0; Col < static_cast<long>(N); ++Col) {
+		unsigned long c = Col;
+		double *XRow = XData + c*K;
+		for (unsigned long j = 0; j < K; ++j) {
+			XRow[j] = 0.0;
+		}
+		for (unsigned long k = ColPtr[c]; k < ColPtr[c + 1]; ++k) {
+			const double *YRow = YData + RowIndex[k]*K;
+			double thisValue = ColValues[k];
+			for (unsigned long j = 0; j < K; ++j) {
+				XRow[j] += thisValue * YRow[j];
+			}
+		}
+	}
+}
+
+template <typename Scalar>
+void BasicSparseProjection<Scalar>::ApplyColumns(const BoostDoubleVector &X,
+	const std::vector<unsigned long> &Columns, BoostDoubleVector &Y) const {
+	/*
+	* Function: BasicSparseProjection::ApplyColumns
+	* ---------------------------------------------
+	* Y = A*X for X zero outside Columns. The listed columns of the
+	* transposed copy are scattered into Y, which costs O(M) plus their
+	* non-zeros but runs on one thread, so the row-parallel Apply is used
+	* instead unless the listed columns hold a small share of the non-zeros.
+	*/
+	unsigned long ColumnNonZeros = 0;
+	for (unsigned long k = 0; k < Columns.size(); ++k) {
+		ColumnNonZeros += ColPtr[Columns[k] + 1] - ColPtr[Columns[k]];
+	}
+	if (ColumnNonZeros * GetThreadCount() >= NonZeros()) {
+		Apply(X, Y);
+		return;
+	}
+
+	Y.resize(M, false);
+	Y.clear();
+	for (unsigned long k = 0; k < Columns.size(); ++k) {
+		unsigned long c = Columns[k];
+		double thisValue = X(c);
+		for (unsigned long n = ColPtr[c]; n < ColPtr[c + 1]; ++n) {
+			Y(RowIndex[n]) += ColValues[n] * thisValue;
+		}
+	}
+}
+
+template <typename Scalar>
+void BasicSparseProjection<Scalar>::ApplyTransposeColumns(const BoostDoubleVector &Y,
+	const std::vector<unsigned long> &Columns, BoostDoubleVector &X) const {
+	/*
+	* Function: BasicSparseProjection::ApplyTransposeColumns
+	* ------------------------------------------------------
+	* The gather of ApplyTranspose over the listed columns only.
+	*/
+	X.resize(N, false);
+	long Count = static_cast<long>(Columns.size());
+	#pragma omp parallel for num_threads(GetThreadCount()) schedule(dynamic, 64) if(NonZeros() >= ParallelMinimumWork)
+	for (long k = 0; k < Count; ++k) {
+		unsigned long c = Columns[k];
+		double Sum = 0.0;
+		for (unsigned long n = ColPtr[c]; n < ColPtr[c + 1]; ++n) {
+			Sum += ColValues[n] * Y(RowIndex[n]);
+		}
+		X(c) = Sum;
+	}
+}
+
+template <typename Scalar>
+bool BasicSparseProjection<Scalar>::SquaredColumnNorms(BoostDoubleVector &Norms) const {
+	/*
+	* Function: BasicSparseProjection::SquaredColumnNorms
+	* ---------------------------------------------------
+	* Sum the squared non-zeros of each column of the transposed copy.
+	*/
+	Norms.resize(N, false);
+	#pragma omp parallel for num_threads(GetThreadCount()) schedule(static) if(NonZeros() >= ParallelMinimumWork)
+	for (long Col = 0; Col < static_cast<long>(N); ++Col) {
+		unsigned long c = Col;
+		double Sum = 0.0;
+		for (unsigned long k = ColPtr[c]; k < ColPtr[c + 1]; ++k) {
+			Sum += static_cast<double>(ColValues[k]) * ColValues[k];
+		}
+		Norms(c) = Sum;
+	}
+	return true;
+}
+
+// The storage types built into the library
+template class BasicSparseProjection<double>;
+template class BasicSparseProjection<float>;
+template BasicSparseProjection<float>::BasicSparseProjection(const BasicSparseProjection<double> &);
+template BasicSparseProjection<double>::BasicSparseProjection(const BasicSparseProjection<float> &);
+
+SliceStackProjection::SliceStackProjection(const ProjectionOperator &SliceOperator,
+	unsigned long SliceCount) : Slice(SliceOperator), Depth(SliceCount) {
+}
+
+unsigned long SliceStackProjection::Rows() const {
+	return Slice.Rows() * Depth;
+}
+
+unsigned long SliceStackProjection::Cols() const {
+	return Slice.Cols() * Depth;
+}
+
+void SliceStackProjection::Apply(const BoostDoubleVector &X, BoostDoubleVector &Y) const {
+	/*
+	* Function: SliceStackProjection::Apply
+	* -------------------------------------
+	* Y = A*X slice by slice, gathering the slices into the columns of one
+	* (N x Depth) block so the slice operator is traversed once.
+	*/
+	unsigned long M = Slice.Rows();
+	unsigned long N = Slice.Cols();
+	std::lock_guard<std::mutex> Guard(Lock);
+	ImageBlock.resize(N, Depth, false);
+	for (unsigned long p = 0; p < N; ++p) {
+		for (unsigned long k = 0; k < Depth; ++k) {
+			ImageBlock(p, k) = X(k*N + p);
+		}
+	}
+	Slice.ApplyBlock(ImageBlock, MeasurementBlock);
+
+	Y.resize(M * Depth, false);
+	for (unsigned long r = 0; r < M; ++r) {
+		for (unsigned long k = 0; k < Depth; ++k) {
+			Y(k*M + r) = MeasurementBlock(r, k);
+		}
+	}
+}
+
+void SliceStackProjection::ApplyTranspose(const BoostDoubleVector &Y, BoostDoubleVector &X) const {
+	/*
+	* Function: SliceStackProjection::ApplyTranspose
+	* ----------------------------------------------
+	* X = A^T*Y slice by slice, as one transposed block product.
+	*/
+	unsigned long M = Slice.Rows();
+	unsigned long N = Slice.Cols();
+	std::lock_guard<std::mutex> Guard(Lock);
+	MeasurementBlock.resize(M, Depth, false);
+	for (unsigned long r = 0; r < M; ++r) {
+		for (unsigned long k = 0; k < Depth; ++k) {
+			MeasurementBlock(r, k) = Y(k*M + r);
+		}
+	}
+	Slice.ApplyTransposeBlock(MeasurementBlock, ImageBlock);
+
+	X.resize(N * Depth, false);
+	for (unsigned long p = 0; p < N; ++p) {
+		for (unsigned long k = 0; k < Depth; ++k) {
+			X(k*N + p) = ImageBlock(p, k);
+		}
+	}
+}
+
+bool SliceStackProjection::SquaredColumnNorms(BoostDoubleVector &Norms) const {
+	/*
+	* Function: SliceStackProjection::SquaredColumnNorms
+	* --------------------------------------------------
+	* The column norms of the slice operator, repeated for every slice.
+	*/
+	unsigned long N = Slice.Cols();
+	if (!Slice.SquaredColumnNorms(Norms)) {
+		return false;
+	}
+	Norms.resize(N * Depth, true);
+	for (unsigned long k = 1; k < Depth; ++k) {
+		std::copy(Norms.begin(), Norms.begin() + N, Norms.begin() + k*N);
+	}
+	return true;
+}
+
+static void WalshHadamardTransform(double *X, unsigned long N) {
+	/*
+	* Function: WalshHadamardTransform
+	* --------------------------------
+	* In-place orthonormal Walsh-Hadamard transform of length N = 2^k. It is
+	* its own inverse (and transpose).
+	*/
+	for (unsigned long Half = 1; Half < N; Half *= 2) {
+		for (unsigned long Block = 0; Block < N; Block += 2 * Half) {
+			for (unsigned long i = Block; i < Block + Half; ++i) {
+				double a = X[i], b = X[i + Half];
+				X[i] = a + b;
+				X[i + Half] = a - b;
+			}
+		}
+	}
+	double Scale = 1.0 / sqrt(static_cast<double>(N));
+	for (unsigned long i = 0; i < N; ++i) {
+		X[i] *= Scale;
+	}
+}
+
+static void FourierTransform(std::complex<double> *X, unsigned long N, bool Inverse) {
+	/*
+	* Function: FourierTransform
+	* --------------------------
+	* In-place unnormalised radix-2 FFT of length N = 2^k, with the kernel
+	* exp(-2 pi i jk/N), or exp(+2 pi i jk/N) when Inverse is set.
+	*/
+	for (unsigned long i = 1, j = 0; i < N; ++i) {
+		unsigned long Bit = N >> 1;
+		for (; j & Bit; Bit >>= 1) {
+			j ^= Bit;
+		}
+		j ^= Bit;
+		if (i < j) {
+			std::swap(X[i], X[j]);
+		}
+	}
+	const double Pi = 3.14159265358979323846;
+	for (unsigned long Length = 2; Length <= N; Length *= 2) {
+		// Twiddles by recurrence, so there is one sine and cosine per stage
+		std::complex<double> Step = std::polar(1.0, (Inverse ? 2.0 : -2.0) * Pi / Length);
+		std::complex<double> Twiddle = 1.0;
+		for (unsigned long i = 0; i < Length / 2; ++i) {
+			for (unsigned long Block = 0; Block < N; Block += Length) {
+				std::complex<double> a = X[Block + i];
+				std::complex<double> b = X[Block + i + Length / 2] * Twiddle;
+				X[Block + i] = a + b;
+				X[Block + i + Length / 2] = a - b;
+			}
+			Twiddle *= Step;
+		}
+	}
+}
+
+// Per-thread scratch of the structured transforms, grown as needed so that
+// shared operators need neither locks nor allocation after the first use
+static thread_local std::vector<double> TransformScratch;
+static thread_local std::vector<std::complex<double> > FourierScratch;
+
+static void CosineTransform(double *X, unsigned long N, bool Inverse) {
+	/*
+	* Function: CosineTransform
+	* -------------------------
+	* In-place orthonormal DCT-II of length N = 2^k, or its inverse (and
+	* transpose) the DCT-III, through one complex FFT of length N by
+	* reordering the even and odd samples (Makhoul, 1980).
+	*/
+	const double Pi = 3.14159265358979323846;
+	if (FourierScratch.size() < N) {
+		FourierScratch.resize(N);
+	}
+	std::complex<double> *V = &FourierScratch[0];
+	double Scale0 = sqrt(1.0 / N), ScaleK = sqrt(2.0 / N);
+
+	if (!Inverse) {
+		for (unsigned long n = 0; n < N / 2; ++n) {
+			V[n] = X[2 * n];
+			V[N - 1 - n] = X[2 * n + 1];
+		}
+		if (N == 1) {
+			V[0] = X[0];
+		}
+		FourierTransform(V, N, false);
+		std::complex<double> Step = std::polar(1.0, -Pi / (2.0 * N)), Twiddle = 1.0;
+		for (unsigned long k = 0; k < N; ++k) {
+			X[k] = (k == 0 ? Scale0 : ScaleK) * std::real(Twiddle * V[k]);
+			Twiddle *= Step;
+		}
+		return;
+	}
+
+	// With c(k) = X(k)/Scale(k) and c(N) = 0, V(k) = exp(i pi k/2N)(c(k) - i c(N-k))
+	std::complex<double> Step = std::polar(1.0, Pi / (2.0 * N)), Twiddle = 1.0;
+	for (unsigned long k = 0; k < N; ++k) {
+		double Ck = X[k] / (k == 0 ? Scale0 : ScaleK);
+		double CNk = (k == 0) ? 0.0 : X[N - k] / ScaleK;
+		V[k] = Twiddle * std::complex<double>(Ck, -CNk);
+		Twiddle *= Step;
+	}
+	FourierTransform(V, N, true);
+	for (unsigned long n = 0; n < N / 2; ++n) {
+		X[2 * n] = std::real(V[n]) / N;
+		X[2 * n + 1] = std::real(V[N - 1 - n]) / N;
+	}
+	if (N == 1) {
+		X[0] = std::real(V[0]);
+	}
+}
+
+// Rows of the image being transformed by CosineTransform2D, one per thread
+static thread_local std::vector<double> RowScratch;
+
+void CosineTransform2D(double *X, unsigned long SideLength, bool Inverse) {
+	/*
+	* Function: CosineTransform2D
+	* ---------------------------
+	* Separable 2D DCT-II (or DCT-III, its inverse): a 1D transform of every
+	* column, which is contiguous, then of every row.
+	*
+	* Input --
+	* X: an (N x 1) column-major image, N = SideLength^2, overwritten by its
+	*    coefficients
+	* SideLength: the length of the image side, a power of two
+	* Inverse: apply the inverse transform instead
+	*
+	* Output -- None.
+	*/
+	long L = static_cast<long>(SideLength);
+	#pragma omp parallel for num_threads(GetThreadCount()) schedule(static) if(SideLength*SideLength >= ParallelMinimumWork)
+	for (long j = 0; j < L; ++j) {
+		CosineTransform(X + j*L, L, Inverse);
+	}
+	#pragma omp parallel for num_threads(GetThreadCount()) schedule(static) if(SideLength*SideLength >= ParallelMinimumWork)
+	for (long i = 0; i < L; ++i) {
+		if (RowScratch.size() < SideLength) {
+			RowScratch.resize(SideLength);
+		}
+		double *Row = &RowScratch[0];
+		for (long j = 0; j < L; ++j) {
+			Row[j] = X[j*L + i];
+		}
+		CosineTransform(Row, L, Inverse);
+		for (long j = 0; j < L; ++j) {
+			X[j*L + i] = Row[j];
+		}
+	}
+}
+
+static void SampleRows(boost::mt19937 &RNG, unsigned long N, std::vector<unsigned long> &Sampled) {
+	/*
+	* Function: SampleRows
+	* --------------------
+	* Fill Sampled with distinct indices below N: 0 first, then the others
+	* drawn at random by a partial Fisher-Yates shuffle.
+	*/
+	std::vector<unsigned long> Order(N);
+	for (unsigned long i = 0; i < N; ++i) {
+		Order[i] = i;
+	}
+	for (unsigned long i = 1; i < Sampled.size(); ++i) {
+		boost::random::uniform_int_distribution<unsigned long> Pick(i, N - 1);
+		std::swap(Order[i], Order[Pick(RNG)]);
+	}
+	std::copy(Order.begin(), Order.begin() + Sampled.size(), Sampled.begin());
+}
+
+StructuredProjection::StructuredProjection(StructuredTransform TransformType, unsigned long Rows,
+	unsigned long Cols, unsigned int Seed)
+	: Transform(TransformType), M(Rows), N(Cols), Scramble(Cols), Sampled(Rows) {
+	/*
+	* Function: StructuredProjection::StructuredProjection
+	* ----------------------------------------------------
+	* Draw the pixel permutation and the kept rows from a Mersenne twister
+	* seeded with Seed.
+	*/
+	if (N == 0 || (N & (N - 1)) != 0) {
+		throw std::invalid_argument("StructuredProjection: Cols must be a power of two");
+	}
+	if (M > N) {
+		throw std::invalid_argument("StructuredProjection: Rows must not exceed Cols");
+	}
+
+	boost::mt19937 RNG(Seed);
+	for (unsigned long i = 0; i < N; ++i) {
+		Scramble[i] = i;
+	}
+	// Fisher-Yates shuffle
+	for (unsigned long i = N - 1; i > 0; --i) {
+		boost::random::uniform_int_distribution<unsigned long> Pick(0, i);
+		std::swap(Scramble[i], Scramble[Pick(RNG)]);
+	}
+	SampleRows(RNG, N, Sampled);
+}
+
+unsigned long StructuredProjection::Rows() const {
+	return M;
+}
+
+unsigned long StructuredProjection::Cols() const {
+	return N;
+}
+
+const std::vector<unsigned long> &StructuredProjection::Permutation() const {
+	return Scramble;
+}
+
+const std::vector<unsigned long> &StructuredProjection::SampledRows() const {
+	return Sampled;
+}
+
+bool StructuredProjection::SquaredColumnNorms(BoostDoubleVector &Norms) const {
+	/*
+	* Function: StructuredProjection::SquaredColumnNorms
+	* --------------------------------------------------
+	* Every Walsh-Hadamard entry is +-1/sqrt(N), so each column has squared
+	* norm M/N; the DCT norms depend on the kept rows and are not listed.
+	*/
+	if (Transform != WALSH_HADAMARD_TRANSFORM) {
+		return false;
+	}
+	Norms.resize(N, false);
+	std::fill(Norms.begin(), Norms.end(), static_cast<double>(M) / N);
+	return true;
+}
+
+void StructuredProjection::Apply(const BoostDoubleVector &X, BoostDoubleVector &Y) const {
+	/*
+	* Function: StructuredProjection::Apply
+	* -------------------------------------
+	* Y = R*T*P*X.
+	*/
+	if (TransformScratch.size() < N) {
+		TransformScratch.resize(N);
+	}
+	double *T = &TransformScratch[0];
+	for (unsigned long i = 0; i < N; ++i) {
+		T[i] = X(Scramble[i]);
+	}
+	if (Transform == WALSH_HADAMARD_TRANSFORM) {
+		WalshHadamardTransform(T, N);
+	}
+	else {
+		CosineTransform(T, N, false);
+	}
+	Y.resize(M, false);
+	for (unsigned long r = 0; r < M; ++r) {
+		Y(r) = T[Sampled[r]];
+	}
+}
+
+void StructuredProjection::ApplyTranspose(const BoostDoubleVector &Y, BoostDoubleVector &X) const {
+	/*
+	* Function: StructuredProjection::ApplyTranspose
+	* ----------------------------------------------
+	* X = P^T*T^T*R^T*Y, where T^T is the inverse transform.
+	*/
+	if (TransformScratch.size() < N) {
+		TransformScratch.resize(N);
+	}
+	double *T = &TransformScratch[0];
+	std::fill(T, T + N, 0.0);
+	for (unsigned long r = 0; r < M; ++r) {
+		T[Sampled[r]] = Y(r);
+	}
+	if (Transform == WALSH_HADAMARD_TRANSFORM) {
+		WalshHadamardTransform(T, N);
+	}
+	else {
+		CosineTransform(T, N, true);
+	}
+	X.resize(N, false);
+	for (unsigned long i = 0; i < N; ++i) {
+		X(Scramble[i]) = T[i];
+	}
+}
+
+PartialCosineProjection::PartialCosineProjection(unsigned long SideLength, unsigned long Rows,
+	unsigned int Seed)
+	: L(SideLength), M(Rows), Sampled(Rows) {
+	/*
+	* Function: PartialCosineProjection::PartialCosineProjection
+	* ----------------------------------------------------------
+	* Draw the kept coefficients from a Mersenne twister seeded with Seed.
+	*/
+	if (L == 0 || (L & (L - 1)) != 0) {
+		throw std::invalid_argument("PartialCosineProjection: SideLength must be a power of two");
+	}
+	if (M > L * L) {
+		throw std::invalid_argument("PartialCosineProjection: Rows must not exceed SideLength^2");
+	}
+	boost::mt19937 RNG(Seed);
+	SampleRows(RNG, L * L, Sampled);
+}
+
+unsigned long PartialCosineProjection::Rows() const {
+	return M;
+}
+
+unsigned long PartialCosineProjection::Cols() const {
+	return L * L;
+}
+
+const std::vector<unsigned long> &PartialCosineProjection::SampledRows() const {
+	return Sampled;
+}
+
+void PartialCosineProjection::Apply(const BoostDoubleVector &X, BoostDoubleVector &Y) const {
+	/*
+	* Function: PartialCosineProjection::Apply
+	* ----------------------------------------
+	* Y = the kept coefficients of the 2D DCT of X.
+	*/
+	unsigned long N = L * L;
+	if (TransformScratch.size() < N) {
+		TransformScratch.resize(N);
+	}
+	double *T = &TransformScratch[0];
+	std::copy(X.begin(), X.end(), T);
+	CosineTransform2D(T, L, false);
+	Y.resize(M, false);
+	for (unsigned long r = 0; r < M; ++r) {
+		Y(r) = T[Sampled[r]];
+	}
+}
+
+void PartialCosineProjection::ApplyTranspose(const BoostDoubleVector &Y, BoostDoubleVector &X) const {
+	/*
+	* Function: PartialCosineProjection::ApplyTranspose
+	* -------------------------------------------------
+	* X = the inverse 2D DCT of Y, placed at the kept coefficients.
+	*/
+	unsigned long N = L * L;
+	X.resize(N, false);
+	double *T = X.data().begin();
+	std::fill(T, T + N, 0.0);
+	for (unsigned long r = 0; r < M; ++r) {
+		T[Sampled[r]] = Y(r);
+	}
+	CosineTransform2D(T, L, true);
+}
+
+bool PartialCosineProjection::CosineDiagonal(unsigned long SideLength, BoostDoubleVector &Diagonal)
+	const {
+	/*
+	* Function: PartialCosineProjection::CosineDiagonal
+	* -------------------------------------------------
+	* A^T * A is the 0/1 mask of the kept coefficients.
+	*/
+	if (SideLength != L) {
+		return false;
+	}
+	Diagonal.resize(L * L, false);
+	Diagonal.clear();
+	for (unsigned long r = 0; r < M; ++r) {
+		Diagonal(Sampled[r]) = 1.0;
+	}
+	return true;
+}
+
+/* Implicit Gaussian Operator */
+// The columns generated at a time, by each thread
+static const unsigned long GaussianBlock = 256;
+
+GaussianProjection::GaussianProjection(unsigned long Rows, unsigned long Cols, uint64_t Seed,
+	double Scale) : M(Rows), N(Cols), Stream(Seed), Scale(Scale) {
+}
+
+unsigned long GaussianProjection::Rows() const {
+	return M;
+}
+
+unsigned long GaussianProjection::Cols() const {
+	return N;
+}
+
+uint64_t GaussianProjection::Seed() const {
+	return Stream;
+}
+
+void GaussianProjection::Generate(unsigned long r, unsigned long Begin, unsigned long Count,
+	double *Values) const {
+	/*
+	* Function: GaussianProjection::Generate
+	* --------------------------------------
+	* The entries Begin .. Begin+Count-1 of row r.
+	*/
+	GenerateGaussian(Stream, static_cast<uint64_t>(r) * N + Begin, Count, Values);
+	if (Scale != 1.0) {
+		for (unsigned long c = 0; c < Count; ++c) {
+			Values[c] *= Scale;
+		}
+	}
+}
+
+void GaussianProjection::Row(unsigned long r, BoostDoubleVector &Values) const {
+	Values.resize(N, false);
+	if (N > 0) {
+		Generate(r, 0, N, &Values(0));
+	}
+}
+
+void GaussianProjection::Apply(const BoostDoubleVector &X, BoostDoubleVector &Y) const {
+	/*
+	* Function: GaussianProjection::Apply
+	* -----------------------------------
+	* Y = A*X, each thread generating its rows a block of columns at a time.
+	*/
+	Y.resize(M, false);
+	const double *XData = X.data().begin();
+
+	#pragma omp parallel for num_threads(GetThreadCount()) schedule(static) if(M*N >= ParallelMinimumWork)
+	for (long Row = 0; Row < static_cast<long>(M); ++Row) {
+		double Entries[GaussianBlock];
+		double Sum = 0.0;
+		for (unsigned long Begin = 0; Begin < N; Begin += GaussianBlock) {
+			unsigned long Count = std::min(GaussianBlock, N - Begin);
+			Generate(Row, Begin, Count, Entries);
+			for (unsigned long c = 0; c < Count; ++c) {
+				Sum += Entries[c] * XData[Begin + c];
+			}
+		}
+		Y(Row) = Sum;
+	}
+}
+
+void GaussianProjection::ApplyTranspose(const BoostDoubleVector &Y, BoostDoubleVector &X) const {
+	/*
+	* Function: GaussianProjection::ApplyTranspose
+	* --------------------------------------------
+	* X = A^T*Y. Each thread owns a block of columns of X and generates that
+	* block of every row in turn, as DenseProjection sweeps it.
+	*/
+	X.resize(N, false);
+	double *XData = X.data().begin();
+
+	long Blocks = static_cast<long>((N + GaussianBlock - 1) / GaussianBlock);
+	#pragma omp parallel for num_threads(GetThreadCount()) schedule(static) if(M*N >= ParallelMinimumWork)
+	for (long b = 0; b < Blocks; ++b) {
+		double Entries[GaussianBlock];
+		unsigned long Begin = b * GaussianBlock;
+		unsigned long Count = std::min(GaussianBlock, N - Begin);
+		double *XBlock = XData + Begin;
+		std::fill(XBlock, XBlock + Count, 0.0);
+		for (unsigned long r = 0; r < M; ++r) {
+			Generate(r, Begin, Count, Entries);
+			double thisY = Y(r);
+			for (unsigned long c = 0; c < Count; ++c) {
+				XBlock[c] += Entries[c] * thisY;
+			}
+		}
+	}
+}
+
+bool GaussianProjection::SquaredColumnNorms(BoostDoubleVector &Norms) const {
+	/*
+	* Function: GaussianProjection::SquaredColumnNorms
+	* ------------------------------------------------
+	* Norms(c) = sum_r A(r, c)^2, accumulated row by row; one pass over the
+	* entries, like a product.
+	*/
+	Norms.resize(N, false);
+	double *NormData = Norms.data().begin();
+
+	long Blocks = static_cast<long>((N + GaussianBlock - 1) / GaussianBlock);
+	#pragma omp parallel for num_threads(GetThreadCount()) schedule(static) if(M*N >= ParallelMinimumWork)
+	for (long b = 0; b < Blocks; ++b) {
+		double Entries[GaussianBlock];
+		unsigned long Begin = b * GaussianBlock;
+		unsigned long Count = std::min(GaussianBlock, N - Begin);
+		double *NormBlock = NormData + Begin;
+		std::fill(NormBlock, NormBlock + Count, 0.0);
+		for (unsigned long r = 0; r < M; ++r) {
+			Generate(r, Begin, Count, Entries);
+			for (unsigned long c = 0; c < Count; ++c) {
+				NormBlock[c] += Entries[c] * Entries[c];
+			}
+		}
+	}
+	return true;
+}
+
+void AppendParallelBeamRows(double TiltAngle, unsigned long SideLength,
+	std::vector<unsigned long> &RowPtr, std::vector<unsigned long> &ColIndex,
+	std::vector<double> &Values) {
+	/*
+	* Function: AppendParallelBeamRows
+	* --------------------------------
+	* Append the L rows of one tilt angle of BuildParallelBeamProjection, one
+	* per detector bin, to CSR arrays.
+	*
+	* Input --
+	* TiltAngle: the tilt angle, in degrees
+	* SideLength: the side length L of both the image and the detector
+	* RowPtr, ColIndex, Values: CSR arrays; RowPtr must hold at least its
+	*                           leading 0, and gains one entry per row
+	*
+	* Output -- None.
+	*/
+	const double Pi = 3.14159265358979323846;
+	const double WeightTol = 0.000000000001;
+	unsigned long L = SideLength;
+	double c = 0.5 * (L - 1.0);
+
+	double theta = TiltAngle * Pi / 180.0;
+	double CosTheta = cos(theta);
+	double SinTheta = sin(theta);
+	bool StepColumns = (std::abs(SinTheta) >= std::abs(CosTheta));
+	double StepLength = StepColumns ? 1.0 / std::abs(SinTheta) : 1.0 / std::abs(CosTheta);
+
+	for (unsigned long d = 0; d < L; ++d) {
+		double s = d - c;
+
+		for (unsigned long k = 0; k < L; ++k) {
+			// Fractional position of the ray along the secondary axis
+			double Position;
+			if (StepColumns) {
+				double x = k - c;
+				Position = c - (s - x * CosTheta) / SinTheta;
+			}
+			else {
+				double y = c - k;
+				Position = (s - y * SinTheta) / CosTheta + c;
+			}
+
+			double Floor = floor(Position);
+			double Frac = Position - Floor;
+			long Lower = static_cast<long>(Floor);
+
+			for (long p = Lower; p <= Lower + 1; ++p) {
+				double Weight = StepLength * ((p == Lower) ? (1.0 - Frac) : Frac);
+				if (p < 0 || p >= static_cast<long>(L) || Weight < WeightTol) {
+					continue;
+				}
+				// Column-major pixel index
+				unsigned long Pixel = StepColumns ? (k * L + p) : (p * L + k);
+				ColIndex.push_back(Pixel);
+				Values.push_back(Weight);
+			}
+		}
+		RowPtr.push_back(Values.size());
+	}
+}
+
+SparseProjection BuildParallelBeamProjection(const BoostDoubleVector &TiltAngles,
+	unsigned long SideLength) {
+	/*
+	* Function: BuildParallelBeamProjection
+	* -------------------------------------
+	* Build the sparse parallel-beam system matrix for an (L x L) image using
+	* Joseph's method: each ray is stepped one pixel at a time along the image
+	* axis it is most aligned with, and the line integral is approximated by
+	* linearly interpolating between the two pixels straddling the ray on
+	* each step. Every ray therefore touches at most 2L pixels.
+	*
+	* Pixel (i, j) of the image is centred at x = j - c, y = c - i with
+	* c = (L - 1) / 2, and is rasterized column-major (index j*L + i) to
+	* match MatrixToVector. Detector bin d of the projection at angle theta
+	* measures the line x*cos(theta) + y*sin(theta) = d - c.
+	*
+	* Measurements are ordered as in MatrixToVector applied to an (L x O)
+	* sinogram, i.e. row (a*L + d) of the matrix is detector bin d at tilt
+	* angle a.
+	*
+	* Input --
+	* TiltAngles: an (O x 1) vector of tilt angles, in degrees
+	* SideLength: the side length L of both the image and the detector
+	*
+	* Output -- an ((L*O) x L^2) SparseProjection.
+	*/
+	unsigned long L = SideLength;
+	unsigned long O = TiltAngles.size();
+
+	std::vector<unsigned long> RowPtr;
+	std::vector<unsigned long> ColIndex;
+	std::vector<double> Values;
+	RowPtr.reserve(L * O + 1);
+	ColIndex.reserve(2 * L * L * O);
+	Values.reserve(2 * L * L * O);
+	RowPtr.push_back(0);
+
+	for (unsigned long a = 0; a < O; ++a) {
+		AppendParallelBeamRows(TiltAngles(a), L, RowPtr, ColIndex, Values);
+	}
+
+	return SparseProjection(L * O, L * L, RowPtr, ColIndex, Values);
+}
+
+BoostDoubleMatrix HalveSinogram(const BoostDoubleMatrix &Sinogram) {
+	/*
+	* Function: HalveSinogram
+	* -----------------------
+	* Coarse detector bin d of BuildParallelBeamProjection(TiltAngles, L/2)
+	* covers fine bins 2d and 2d+1, and its line integrals are measured in
+	* coarse pixels, twice the length of fine ones. Each coarse bin is
+	* therefore the mean of its two fine bins, halved, so that the coarse
+	* reconstruction has the intensities of the fine one.
+	*
+	* Input --
+	* Sinogram: an (L x O) sinogram, L even
+	*
+	* Output -- the (L/2 x O) sinogram.
+	*/
+	unsigned long L = Sinogram.size1() / 2, O = Sinogram.size2();
+	BoostDoubleMatrix Halved(L, O);
+	for (unsigned long a = 0; a < O; ++a) {
+		for (unsigned long d = 0; d < L; ++d) {
+			Halved(d, a) = 0.25 * (Sinogram(2 * d, a) + Sinogram(2 * d + 1, a));
+		}
+	}
+	return Halved;
+}
@@ -1,42 +1,393 @@
 #include <iostream>
+#include <cstdlib>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <exception>
+#include <memory>
 #include "ctvm.h"
 #include "ctvm_util.h"
+#include "ctvm_mpi.h"
+#include "ctvm_server.h"
+
+static void PrintOuterProgress(const TVAL3Progress &Progress, void *UserData){
+    // One status line per outer iteration; inner iterations are not shown.
+    if(Progress.Stage == OUTER_ITERATION){
+        std::cout<<"Outer Iter ["<<Progress.OuterIteration<<"] objective: "<<Progress.Objective
+            <<", outer stop: "<<Progress.Stop<<" ("<<Progress.ElapsedSeconds<<" s)"<<std::endl;
+    }
+}
+
+template <class Item>
+class BoundedQueue {
+    // A blocking FIFO holding at most Capacity items. Push waits while the
+    // queue is full and Pop waits while it is empty. After Close, Push
+    // drops its item and returns false, and Pop drains the remaining items
+    // and then returns false.
+public:
+    explicit BoundedQueue(size_t Capacity) : Capacity(Capacity), Closed(false) {}
+
+    bool Push(const Item &AnItem){
+        std::unique_lock<std::mutex> Guard(Lock);
+        NotFull.wait(Guard, [this](){ return Items.size() < Capacity || Closed; });
+        if(Closed){
+            return false;
+        }
+        Items.push_back(AnItem);
+        NotEmpty.notify_one();
+        return true;
+    }
+
+    bool Pop(Item &AnItem){
+        std::unique_lock<std::mutex> Guard(Lock);
+        NotEmpty.wait(Guard, [this](){ return !Items.empty() || Closed; });
+        if(Items.empty()){
+            return false;
+        }
+        AnItem = Items.front();
+        Items.pop_front();
+        NotFull.notify_one();
+        return true;
+    }
+
+    void Close(){
+        std::lock_guard<std::mutex> Guard(Lock);
+        Closed = true;
+        NotEmpty.notify_all();
+        NotFull.notify_all();
+    }
+
+private:
+    size_t Capacity;
+    bool Closed;
+    std::deque<Item> Items;
+    std::mutex Lock;
+    std::condition_variable NotEmpty, NotFull;
+};
+
+static int RecoverStack(const RawFile &Sinograms, const SparseProjection &Projection,
+    const char* RecoveredOutput){
+    // Reconstruct every slice of a raw sinogram stack into a raw volume. A
+    // reader thread fetches slice k+1 and a writer thread stores slice k-1
+    // while slice k reconstructs. Both queues hold one slice, so memory use
+    // does not depend on the number of slices.
+    using namespace std;
+    unsigned long L = Sinograms.Rows(), K = Sinograms.Slices();
+    BoundedQueue<BoostDoubleVector> Measurements(1);
+    BoundedQueue<BoostDoubleMatrix> Reconstructions(1);
+    exception_ptr ReadError, WriteError;
+
+    thread Reader([&](){
+        try{
+            unsigned long Next = 0;
+            while(Next < K && Measurements.Push(Sinograms.SliceVector(Next))){
+                ++Next;
+            }
+        }
+        catch(...){
+            ReadError = current_exception();
+        }
+        Measurements.Close();
+    });
+
+    thread Writer([&](){
+        try{
+            RawWriter Output(RecoveredOutput, L, L, K, BoostDoubleVector(), RAW_FLOAT64);
+            BoostDoubleMatrix Reconstruction;
+            while(Reconstructions.Pop(Reconstruction)){
+                Output.WriteSlice(Reconstruction);
+            }
+            Output.Close();
+        }
+        catch(...){
+            WriteError = current_exception();
+            // Stop the solver loop and the reader
+            Reconstructions.Close();
+        }
+    });
+
+    TVAL3Options Options;
+    TVAL3Profile Profile, SliceProfile;
+    Options.Profile = &SliceProfile;
+    BoostDoubleVector y;
+    unsigned long k = 0;
+    exception_ptr SolveError;
+    try{
+        while(Measurements.Pop(y)){
+            cout<<"Slice ["<<k<<"/"<<K<<"]..."<<flush;
+            chrono::steady_clock::time_point Start = chrono::steady_clock::now();
+            BoostDoubleMatrix Reconstruction = tval3_reconstruction(Projection, y, L, Options);
+            Profile.Add(SliceProfile);
+            cout<<"done. ("<<chrono::duration<double>(chrono::steady_clock::now() - Start).count()<<" s)"<<endl;
+            if(!Reconstructions.Push(Reconstruction)){
+                Measurements.Close();
+                break;
+            }
+            ++k;
+        }
+    }
+    catch(...){
+        // Stop the reader; both threads are joined before reporting
+        SolveError = current_exception();
+        Measurements.Close();
+        cout<<endl;
+    }
+    Reconstructions.Close();
+    Reader.join();
+    Writer.join();
+
+    if(SolveError || ReadError || WriteError){
+        try{
+            rethrow_exception(SolveError ? SolveError : (ReadError ? ReadError : WriteError));
+        }
+        catch(exception &error_){
+            cout<<error_.what()<<endl;
+        }
+        return 1;
+    }
+    if(Profile.Enabled){
+        cout<<"Profile: ";
+        WriteProfileJSON(Profile, cout);
+        cout<<endl;
+    }
+    return 0;
+}
+
+static int WriteResult(const BoostDoubleMatrix &Reconstruction, const char* RecoveredOutput){
+    // Raw output keeps the unnormalized reconstruction at full precision.
+    using namespace std;
+    if(IsRawFileName(RecoveredOutput)){
+        cout<<"Writing result to raw file ("<<RecoveredOutput<<")."<<endl;
+        try{
+            WriteRaw(RecoveredOutput, Reconstruction, BoostDoubleVector(), RAW_FLOAT64);
+        }
+        catch(exception &error_){
+            cout<<error_.what()<<endl;
+            return 1;
+        }
+    }
+    else{
+        cout<<"Writing result to image ("<<RecoveredOutput<<")."<<endl;
+        WriteImage(NormalizeMatrix(Reconstruction), RecoveredOutput);
+    }
+    return 0;
+}
+
+static int ServerMode(int argc, char **argv){
+    // ctvm-recover --serve <socket> [cached-operators], or --stop <socket>.
+    // The server keeps the most recently used operators and their solver
+    // workspaces (four by default) until a client stops it.
+    using namespace std;
+    string Mode = argv[1];
+    const char* SocketPath = argv[2];
+    try{
+        if(Mode == "--stop" && argc == 3){
+            StopReconstructionServer(SocketPath);
+            cout<<"Stopped the server on "<<SocketPath<<"."<<endl;
+            return 0;
+        }
+        if(Mode == "--serve" && argc <= 4){
+            unsigned long Capacity = (argc == 4) ? strtoul(argv[3], NULL, 10) : 4;
+            if(Capacity == 0){
+                cout<<"The server needs room for at least one cached operator."<<endl;
+                return 1;
+            }
+            ProjectionCache Cache(Capacity);
+            TVAL3Options Options;
+            ServeReconstructions(SocketPath, Cache, Options, &cout);
+            cout<<"Operator cache: "<<Cache.Hits()<<" hits, "<<Cache.Misses()<<" misses."<<endl;
+            return 0;
+        }
+    }
+    catch(exception &error_){
+        cout<<error_.what()<<endl;
+        return 1;
+    }
+    cout<<"Usage: ctvm-recover --serve <socket> [cached-operators]"<<endl;
+    cout<<"       ctvm-recover --stop <socket>"<<endl;
+    return 0;
+}
 
 int main(int argc, char **argv){
-/*
-	// Program: ctvm-recover <sinogram-image> <tilt-angles> <recovered-output> -----------
+    // Program: ctvm-recover <sinogram-image> <tilt-angles> <recovered-output> -----------
+    // Files ending in ".raw" are read and written in the raw binary format
+    // instead of as images; ".pgm" and ".pfm" images are converted without
+    // ImageMagick, and ".pfm" results keep float precision. The tilt angles
+    // stored in a raw sinogram are used when <tilt-angles> is "-". A raw
+    // sinogram with several slices is reconstructed slice by slice into a
+    // raw volume. Run on several MPI
+    // ranks (with mpirun, when built with CTVM_MPI), the ranks share the
+    // reconstruction of a single sinogram and rank 0 writes the result.
+    // With --connect <socket> first, a single sinogram is sent to a server
+    // started with --serve (see ServerMode) instead.
     using namespace std;
+#ifdef CTVM_MPI
+    MPISession Session(argc, argv);
+#endif
+
+    // Server Modes
+    bool Connecting = (argc > 1 && string(argv[1]) == "--connect");
+    if(argc >= 3 && !Connecting && (string(argv[1]) == "--serve" || string(argv[1]) == "--stop")){
+#ifdef CTVM_MPI
+        if(Session.Ranks() > 1){
+            cout<<"The reconstruction server runs on a single MPI rank."<<endl;
+            return 1;
+        }
+#endif
+        return ServerMode(argc, argv);
+    }
+    int First = Connecting ? 3 : 1;
 
-    // Test Inputs 
-    if(argc != 4){
+    // Test Inputs
+    if(argc != First + 3){
         cout<<"Usage: ctvm-recover <sinogram-image> <tilt-angles> <recovered-output>"<<endl;
+        cout<<"       ctvm-recover --connect <socket> <sinogram-image> <tilt-angles> <recovered-output>"<<endl;
+        cout<<"       ctvm-recover --serve <socket> [cached-operators]"<<endl;
+        cout<<"       ctvm-recover --stop <socket>"<<endl;
         return 0;
     }
 
-    // Get Filenames 
-    char* SinogramFile = argv[1];
-    char* TiltAngleFile = argv[2];
-    char* RecoveredOutput = argv[3];
+    // Get Filenames
+    char* ServerSocket = Connecting ? argv[2] : NULL;
+    char* SinogramFile = argv[First];
+    char* TiltAngleFile = argv[First + 1];
+    char* RecoveredOutput = argv[First + 2];
 
-    // Debugging 
+    // Debugging
     cout<<"SinogramFile: "<<SinogramFile<<endl;
     cout<<"TiltAngleFile: "<<TiltAngleFile<<endl;
     cout<<"RecoveredOutput: "<<RecoveredOutput<<endl;
     cout<<endl;
 
-    // Load Tilt Anlges 
+    Magick::InitializeMagick(*argv);
+
+    // Load Sinogram
+    // The sinogram is (L x O): one column of L detector bins per tilt angle.
+    cout<<"Loading Sinogram."<<endl;
+    BoostDoubleMatrix Sinogram;
+    BoostDoubleVector TiltAngles;
+    bool StoredAngles = (string(TiltAngleFile) == "-");
+    unique_ptr<RawFile> RawSinograms;
+    if(IsRawFileName(SinogramFile)){
+        try{
+            RawSinograms.reset(new RawFile(SinogramFile));
+        }
+        catch(exception &error_){
+            cout<<error_.what()<<endl;
+            return 1;
+        }
+        if(RawSinograms->Slices() == 0){
+            cout<<"Raw sinogram has no slices."<<endl;
+            return 1;
+        }
+        if(RawSinograms->Slices() > 1 && !IsRawFileName(RecoveredOutput)){
+            cout<<"A sinogram stack can only be recovered to a raw file."<<endl;
+            return 1;
+        }
+        // Only the dimensions are needed until the stack is streamed
+        Sinogram.resize(RawSinograms->Rows(), RawSinograms->Cols(), false);
+        TiltAngles = RawSinograms->TiltAngles();
+    }
+    else{
+        if(StoredAngles){
+            cout<<"Only raw sinograms store their tilt angles."<<endl;
+            return 1;
+        }
+        Sinogram = LoadImage(SinogramFile);
+    }
+
+    // Load Tilt Anlges
     cout<<"Loading Tilt Angles."<<endl;
-    BoostDoubleVector TiltAngles = ReadTiltAngles(TiltAngleFile);
+    if(!StoredAngles){
+        TiltAngles = ReadTiltAngles(TiltAngleFile);
+    }
     cout<<TiltAngles<<endl;
+    unsigned long L = Sinogram.size1();
+    if(Sinogram.size2() != TiltAngles.size()){
+        cout<<"Sinogram has "<<Sinogram.size2()<<" projections but "<<TiltAngles.size()
+            <<" tilt angles were given."<<endl;
+        return 1;
+    }
 
-    // Load Sinogram 
-    cout<<"Loading Sinogram."<<endl;
-    BoostDoubleMatrix Sinogram = LoadImage(SinogramFile);
+    // Reconstruct on Server
+    if(ServerSocket){
+        if(RawSinograms && RawSinograms->Slices() > 1){
+            cout<<"A sinogram stack cannot be recovered on a server."<<endl;
+            return 1;
+        }
+        if(RawSinograms){
+            Sinogram = RawSinograms->Slice(0);
+            RawSinograms.reset();
+        }
+        cout<<"Recovering on server ("<<ServerSocket<<")..."<<flush;
+        BoostDoubleMatrix Reconstruction;
+        bool CacheHit = false;
+        try{
+            Reconstruction = RequestReconstruction(ServerSocket, Sinogram, TiltAngles, &CacheHit);
+        }
+        catch(exception &error_){
+            cout<<endl<<error_.what()<<endl;
+            return 1;
+        }
+        cout<<"done. ["<<(CacheHit ? "cached" : "new")<<" operator]"<<endl;
+        return WriteResult(Reconstruction, RecoveredOutput);
+    }
+
+#ifdef CTVM_MPI
+    if(Session.Ranks() > 1){
+        if(RawSinograms && RawSinograms->Slices() > 1){
+            cout<<"A sinogram stack cannot be recovered on several MPI ranks."<<endl;
+            return 1;
+        }
+        if(RawSinograms){
+            Sinogram = RawSinograms->Slice(0);
+            RawSinograms.reset();
+        }
+        cout<<"Recovering on "<<Session.Ranks()<<" MPI ranks."<<endl;
+        TVAL3Options Options;
+        Options.Progress = (Session.Rank() == 0) ? PrintOuterProgress : NULL;
+        BoostDoubleMatrix Reconstruction;
+        try{
+            Reconstruction = tval3_mpi_reconstruction(Sinogram, TiltAngles, Options, MPI_COMM_WORLD);
+        }
+        catch(exception &error_){
+            cout<<error_.what()<<endl;
+            return 1;
+        }
+        return (Session.Rank() == 0) ? WriteResult(Reconstruction, RecoveredOutput) : 0;
+    }
+#endif
 
+    // Build Projection Operator
+    cout<<"Building parallel-beam projection ("<<L*TiltAngles.size()<<"x"<<L*L<<")..."<<flush;
+    SparseProjection Projection = BuildParallelBeamProjection(TiltAngles, L);
+    cout<<"done. ["<<Projection.NonZeros()<<" non-zeros]"<<endl;
+
+    // Stream Stack
+    if(RawSinograms && RawSinograms->Slices() > 1){
+        cout<<"Recovering "<<RawSinograms->Slices()<<" slices to raw file ("<<RecoveredOutput<<")."<<endl;
+        return RecoverStack(*RawSinograms, Projection, RecoveredOutput);
+    }
+    if(RawSinograms){
+        Sinogram = RawSinograms->Slice(0);
+        RawSinograms.reset();
+    }
 
     // Call Reconstruction
-    //BoostDoubleMatrix Reconstruction = tval3_reconstruction(Sinogram,TiltAngles);    
-    
-*/
-return 0;
-}
\ No newline at end of file
+    BoostDoubleVector Measurements = MatrixToVector(Sinogram);
+    TVAL3Options Options;
+    Options.Progress = PrintOuterProgress;
+    TVAL3Profile Profile;
+    Options.Profile = &Profile;
+    BoostDoubleMatrix Reconstruction = tval3_reconstruction(Projection, Measurements, L, Options);
+    if (Profile.Enabled) {
+        cout<<"Profile: ";
+        WriteProfileJSON(Profile, cout);
+        cout<<endl;
+    }
+
+    // Write Result
+    return WriteResult(Reconstruction, RecoveredOutput);
+}
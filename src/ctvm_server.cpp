@@ -0,0 +1,494 @@
+#include "ctvm_server.h"
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+static const char RequestMagic[8] = "CTVMREQ";
+static const char ReplyMagic[8] = "CTVMREP";
+static const uint32_t ServerByteOrder = 0x01020304;
+// The largest request served: a sinogram of 2^26 values (512 MiB), an
+// image of 2^24 pixels (4096 x 4096) and an operator of L^2 * O <= 2^27,
+// which bounds its non-zeros (about two per pixel per tilt angle)
+static const uint64_t MaximumServerMeasurements = uint64_t(1) << 26;
+static const uint64_t MaximumServerPixels = uint64_t(1) << 24;
+static const uint64_t MaximumServerRayPixels = uint64_t(1) << 27;
+// A connection that sends or takes nothing for this long is dropped
+static const long ServerTimeoutSeconds = 30;
+
+ProjectionCacheEntry::ProjectionCacheEntry(const BoostDoubleVector &TiltAngles,
+	unsigned long SideLength) : TiltAngles(TiltAngles), SideLength(SideLength),
+	Projection(BuildParallelBeamProjection(TiltAngles, SideLength)),
+	Workspace(Projection.Rows(), Projection.Cols()) {
+}
+
+ProjectionCache::ProjectionCache(unsigned long Capacity)
+	: MaximumEntries(std::max(Capacity, 1UL)), HitCount(0), MissCount(0) {
+}
+
+ProjectionCacheEntry &ProjectionCache::Acquire(const BoostDoubleVector &TiltAngles,
+	unsigned long SideLength, bool *Hit) {
+	/*
+	* Function: ProjectionCache::Acquire
+	* ----------------------------------
+	* Find the operator of a tilt-angle set and side length, building it on a
+	* miss.
+	*
+	* Input --
+	* TiltAngles: the tilt angles, in degrees
+	* SideLength: the side length L of the image
+	* Hit: set to whether the operator was cached; may be NULL
+	*
+	* Output -- the entry, now the most recently used.
+	*/
+	for (std::list<ProjectionCacheEntry>::iterator Entry = Entries.begin(); Entry != Entries.end(); ++Entry) {
+		if (Entry->SideLength == SideLength && Entry->TiltAngles.size() == TiltAngles.size()
+			&& std::equal(TiltAngles.begin(), TiltAngles.end(), Entry->TiltAngles.begin())) {
+			Entries.splice(Entries.begin(), Entries, Entry);
+			++HitCount;
+			if (Hit) {
+				*Hit = true;
+			}
+			return Entries.front();
+		}
+	}
+
+	// Evict first, so that the old and new operators are never both held
+	if (Entries.size() >= MaximumEntries) {
+		Entries.pop_back();
+	}
+	Entries.emplace_front(TiltAngles, SideLength);
+	++MissCount;
+	if (Hit) {
+		*Hit = false;
+	}
+	return Entries.front();
+}
+
+void ProjectionCache::Clear() {
+	Entries.clear();
+}
+
+unsigned long ProjectionCache::Capacity() const {
+	return MaximumEntries;
+}
+
+unsigned long ProjectionCache::Size() const {
+	return static_cast<unsigned long>(Entries.size());
+}
+
+unsigned long ProjectionCache::Hits() const {
+	return HitCount;
+}
+
+unsigned long ProjectionCache::Misses() const {
+	return MissCount;
+}
+
+#ifdef _WIN32
+void ServeReconstructions(const char* SocketPath, ProjectionCache &Cache,
+	const TVAL3Options &Options, std::ostream *Log) {
+	throw std::runtime_error("Reconstruction server sockets are not supported on Windows");
+}
+
+BoostDoubleMatrix RequestReconstruction(const char* SocketPath, const BoostDoubleMatrix &Sinogram,
+	const BoostDoubleVector &TiltAngles, bool *CacheHit) {
+	throw std::runtime_error("Reconstruction server sockets are not supported on Windows");
+}
+
+void StopReconstructionServer(const char* SocketPath) {
+	throw std::runtime_error("Reconstruction server sockets are not supported on Windows");
+}
+#else
+/* Socket Transfers */
+static bool SendAll(int Socket, const void *Data, size_t Bytes) {
+	/*
+	* Function: SendAll
+	* -----------------
+	* Write Bytes bytes to a socket, retrying short and interrupted writes.
+	*
+	* Output -- false if the peer has gone or the write failed.
+	*/
+	const char *Next = static_cast<const char *>(Data);
+	while (Bytes > 0) {
+#ifdef MSG_NOSIGNAL
+		ssize_t Sent = send(Socket, Next, Bytes, MSG_NOSIGNAL);
+#else
+		ssize_t Sent = send(Socket, Next, Bytes, 0);
+#endif
+		if (Sent < 0 && errno == EINTR) {
+			continue;
+		}
+		if (Sent <= 0) {
+			return false;
+		}
+		Next += Sent;
+		Bytes -= static_cast<size_t>(Sent);
+	}
+	return true;
+}
+
+static bool ReceiveAll(int Socket, void *Data, size_t Bytes) {
+	/*
+	* Function: ReceiveAll
+	* --------------------
+	* Read exactly Bytes bytes from a socket, retrying short and interrupted
+	* reads.
+	*
+	* Output -- false if the peer closed the connection first or the read
+	* failed.
+	*/
+	char *Next = static_cast<char *>(Data);
+	while (Bytes > 0) {
+		ssize_t Received = recv(Socket, Next, Bytes, 0);
+		if (Received < 0 && errno == EINTR) {
+			continue;
+		}
+		if (Received <= 0) {
+			return false;
+		}
+		Next += Received;
+		Bytes -= static_cast<size_t>(Received);
+	}
+	return true;
+}
+
+static void SocketError(const char* SocketPath, const char* Problem) {
+	/*
+	* Function: SocketError
+	* ---------------------
+	* Throw a std::runtime_error naming the socket, the problem and errno.
+	*/
+	throw std::runtime_error(std::string("Reconstruction server socket ") + SocketPath + ": " + Problem
+		+ " (" + std::strerror(errno) + ")");
+}
+
+static sockaddr_un SocketAddress(const char* SocketPath) {
+	/*
+	* Function: SocketAddress
+	* -----------------------
+	* Output -- the Unix domain address of SocketPath; a path too long for
+	* one is thrown as std::runtime_error.
+	*/
+	sockaddr_un Address;
+	std::memset(&Address, 0, sizeof(Address));
+	Address.sun_family = AF_UNIX;
+	if (std::strlen(SocketPath) >= sizeof(Address.sun_path)) {
+		throw std::runtime_error(std::string("Reconstruction server socket ") + SocketPath
+			+ ": the path is too long");
+	}
+	std::strcpy(Address.sun_path, SocketPath);
+	return Address;
+}
+
+static int Connect(const char* SocketPath) {
+	// A connected client socket, or a thrown std::runtime_error
+	sockaddr_un Address = SocketAddress(SocketPath);
+	int Socket = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (Socket < 0) {
+		SocketError(SocketPath, "could not be created");
+	}
+	if (connect(Socket, reinterpret_cast<sockaddr *>(&Address), sizeof(Address)) != 0) {
+		int Error = errno;
+		close(Socket);
+		errno = Error;
+		SocketError(SocketPath, "could not be connected to");
+	}
+	return Socket;
+}
+
+static ServerReply MakeReply(uint32_t Status) {
+	ServerReply Reply;
+	std::memset(&Reply, 0, sizeof(Reply));
+	std::memcpy(Reply.Magic, ReplyMagic, sizeof(ReplyMagic));
+	Reply.ByteOrder = ServerByteOrder;
+	Reply.Version = ServerProtocolVersion;
+	Reply.Status = Status;
+	return Reply;
+}
+
+static bool SendError(int Socket, const std::string &Message) {
+	ServerReply Reply = MakeReply(1);
+	Reply.MessageBytes = Message.size();
+	return SendAll(Socket, &Reply, sizeof(Reply)) && SendAll(Socket, Message.data(), Message.size());
+}
+
+/* Serving */
+static bool ServeConnection(int Socket, ProjectionCache &Cache, const TVAL3Options &Options,
+	std::ostream *Log, unsigned long &Served) {
+	/*
+	* Function: ServeConnection
+	* -------------------------
+	* Answer the requests of one connection until the client closes it, a
+	* request is malformed, or a stop request arrives.
+	*
+	* Input --
+	* Socket: the connected socket
+	* Cache: the operators and workspaces to reconstruct with
+	* Options: the solver options, its workspace and starts replaced per request
+	* Log: receives one line per request; may be NULL
+	* Served: the number of requests answered so far, updated
+	*
+	* Output -- true if the server was asked to stop.
+	*/
+	TVAL3Options RequestOptions = Options;
+	RequestOptions.InitialImage.resize(0, false);
+	RequestOptions.InitialState = NULL;
+	RequestOptions.FinalState = NULL;
+	BoostDoubleVector TiltAngles, Measurements;
+
+	ServerRequest Request;
+	while (ReceiveAll(Socket, &Request, sizeof(Request))) {
+		if (std::memcmp(Request.Magic, RequestMagic, sizeof(RequestMagic)) != 0
+			|| Request.ByteOrder != ServerByteOrder || Request.Version != ServerProtocolVersion) {
+			SendError(Socket, "not a reconstruction request of this version and byte order");
+			return false;
+		}
+		if (Request.Rows == 0 && Request.Cols == 0) {
+			ServerReply Reply = MakeReply(0);
+			SendAll(Socket, &Reply, sizeof(Reply));
+			if (Log) {
+				*Log << "Stop requested after " << Served << " reconstructions." << std::endl;
+			}
+			return true;
+		}
+		// Each factor is bounded before the products are formed
+		uint64_t Rows = Request.Rows, Cols = Request.Cols;
+		if (Rows == 0 || Cols == 0 || Rows > MaximumServerMeasurements || Cols > MaximumServerMeasurements / Rows
+			|| Rows > MaximumServerPixels / Rows || Cols > MaximumServerRayPixels / (Rows * Rows)) {
+			SendError(Socket, "the sinogram size is out of range");
+			return false;
+		}
+
+		unsigned long L = static_cast<unsigned long>(Rows), O = static_cast<unsigned long>(Cols);
+		try {
+			TiltAngles.resize(O, false);
+			Measurements.resize(L * O, false);
+		}
+		catch (std::exception &Error) {
+			SendError(Socket, Error.what());
+			return false;
+		}
+		if (!ReceiveAll(Socket, &TiltAngles(0), O * sizeof(double))
+			|| !ReceiveAll(Socket, &Measurements(0), L * O * sizeof(double))) {
+			return false;
+		}
+
+		ServerReply Reply = MakeReply(0);
+		BoostDoubleVector Values;
+		boost::posix_time::ptime Start = boost::posix_time::microsec_clock::universal_time();
+		try {
+			bool Hit = false;
+			ProjectionCacheEntry &Entry = Cache.Acquire(TiltAngles, L, &Hit);
+			RequestOptions.Workspace = &Entry.Workspace;
+			Values = MatrixToVector(tval3_reconstruction(Entry.Projection, Measurements, L, RequestOptions));
+			Reply.CacheHit = Hit ? 1 : 0;
+		}
+		catch (std::exception &Error) {
+			SendError(Socket, Error.what());
+			return false;
+		}
+		Reply.Seconds = 1e-6 * (boost::posix_time::microsec_clock::universal_time() - Start).total_microseconds();
+		Reply.Rows = L;
+		Reply.Cols = L;
+		++Served;
+		if (Log) {
+			*Log << "Request [" << Served << "] " << L << "x" << O << ": "
+				<< (Reply.CacheHit ? "cached" : "new") << " operator, " << Reply.Seconds << " s" << std::endl;
+		}
+
+		if (!SendAll(Socket, &Reply, sizeof(Reply))
+			|| !SendAll(Socket, &Values(0), Values.size() * sizeof(double))) {
+			return false;
+		}
+	}
+	return false;
+}
+
+void ServeReconstructions(const char* SocketPath, ProjectionCache &Cache,
+	const TVAL3Options &Options, std::ostream *Log) {
+	/*
+	* Function: ServeReconstructions
+	* ------------------------------
+	* Listen on SocketPath and serve each accepted connection in turn until
+	* one sends a stop request.
+	*
+	* Input --
+	* SocketPath: the path of the socket to create
+	* Cache: the operators and workspaces to reconstruct with
+	* Options: the solver options of every reconstruction
+	* Log: receives one line per request; may be NULL
+	*/
+	sockaddr_un Address = SocketAddress(SocketPath);
+
+	// Replace a socket left by a server that did not exit cleanly, but
+	// never another kind of file
+	struct stat Existing;
+	if (lstat(SocketPath, &Existing) == 0) {
+		if (!S_ISSOCK(Existing.st_mode)) {
+			errno = EEXIST;
+			SocketError(SocketPath, "exists and is not a socket");
+		}
+		unlink(SocketPath);
+	}
+
+	int Listener = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (Listener < 0) {
+		SocketError(SocketPath, "could not be created");
+	}
+	if (bind(Listener, reinterpret_cast<sockaddr *>(&Address), sizeof(Address)) != 0
+		|| listen(Listener, 16) != 0) {
+		int Error = errno;
+		close(Listener);
+		errno = Error;
+		SocketError(SocketPath, "could not be listened on");
+	}
+	if (Log) {
+		*Log << "Serving reconstructions on " << SocketPath << "." << std::endl;
+	}
+
+	unsigned long Served = 0;
+	bool Stop = false;
+	while (!Stop) {
+		int Connection = accept(Listener, NULL, NULL);
+		if (Connection < 0) {
+			if (errno == EINTR || errno == ECONNABORTED) {
+				continue;
+			}
+			int Error = errno;
+			close(Listener);
+			unlink(SocketPath);
+			errno = Error;
+			SocketError(SocketPath, "stopped accepting connections");
+		}
+		timeval Timeout;
+		Timeout.tv_sec = ServerTimeoutSeconds;
+		Timeout.tv_usec = 0;
+		setsockopt(Connection, SOL_SOCKET, SO_RCVTIMEO, &Timeout, sizeof(Timeout));
+		setsockopt(Connection, SOL_SOCKET, SO_SNDTIMEO, &Timeout, sizeof(Timeout));
+		try {
+			Stop = ServeConnection(Connection, Cache, Options, Log, Served);
+		}
+		catch (std::exception &Error) {
+			// A failure of one request must not take the server down
+			if (Log) {
+				*Log << "Request failed: " << Error.what() << std::endl;
+			}
+		}
+		close(Connection);
+	}
+	close(Listener);
+	unlink(SocketPath);
+}
+
+/* Client */
+static ServerReply ReceiveReply(int Socket, const char* SocketPath) {
+	/*
+	* Function: ReceiveReply
+	* ----------------------
+	* Read a reply header, closing the socket and throwing the server's
+	* error message, as std::runtime_error, on failure.
+	*/
+	ServerReply Reply;
+	std::string Problem;
+	if (!ReceiveAll(Socket, &Reply, sizeof(Reply))) {
+		Problem = "the server closed the connection";
+	}
+	else if (std::memcmp(Reply.Magic, ReplyMagic, sizeof(ReplyMagic)) != 0
+		|| Reply.ByteOrder != ServerByteOrder || Reply.Version != ServerProtocolVersion) {
+		Problem = "the reply is not of this version and byte order";
+	}
+	else if (Reply.Status != 0) {
+		Problem.resize(static_cast<size_t>(std::min<uint64_t>(Reply.MessageBytes, 4096)));
+		if (Problem.empty() || !ReceiveAll(Socket, &Problem[0], Problem.size())) {
+			Problem = "the request failed";
+		}
+	}
+	if (!Problem.empty()) {
+		close(Socket);
+		throw std::runtime_error(std::string("Reconstruction server ") + SocketPath + ": " + Problem);
+	}
+	return Reply;
+}
+
+BoostDoubleMatrix RequestReconstruction(const char* SocketPath, const BoostDoubleMatrix &Sinogram,
+	const BoostDoubleVector &TiltAngles, bool *CacheHit) {
+	/*
+	* Function: RequestReconstruction
+	* -------------------------------
+	* Reconstruct a sinogram on the server listening at SocketPath.
+	*
+	* Input --
+	* SocketPath: the path of the server socket
+	* Sinogram: the (L x O) sinogram, one column per tilt angle
+	* TiltAngles: the O tilt angles, in degrees
+	* CacheHit: set to whether the server had the operator cached; may be NULL
+	*
+	* Output -- the (L x L) reconstruction.
+	*/
+	if (Sinogram.size1() == 0 || Sinogram.size2() != TiltAngles.size()) {
+		throw std::invalid_argument("RequestReconstruction: the sinogram needs one column per tilt angle");
+	}
+	ServerRequest Request;
+	std::memcpy(Request.Magic, RequestMagic, sizeof(RequestMagic));
+	Request.ByteOrder = ServerByteOrder;
+	Request.Version = ServerProtocolVersion;
+	Request.Rows = Sinogram.size1();
+	Request.Cols = Sinogram.size2();
+	BoostDoubleVector Measurements = MatrixToVector(Sinogram);
+
+	int Socket = Connect(SocketPath);
+	if (!SendAll(Socket, &Request, sizeof(Request))
+		|| !SendAll(Socket, &TiltAngles(0), TiltAngles.size() * sizeof(double))
+		|| !SendAll(Socket, &Measurements(0), Measurements.size() * sizeof(double))) {
+		close(Socket);
+		SocketError(SocketPath, "the request could not be sent");
+	}
+	ServerReply Reply = ReceiveReply(Socket, SocketPath);
+	unsigned long L = Sinogram.size1();
+	if (Reply.Rows != L || Reply.Cols != L) {
+		close(Socket);
+		throw std::runtime_error(std::string("Reconstruction server ") + SocketPath
+			+ ": the reconstruction has the wrong size");
+	}
+	BoostDoubleVector Values(L * L);
+	bool Received = ReceiveAll(Socket, &Values(0), Values.size() * sizeof(double));
+	close(Socket);
+	if (!Received) {
+		throw std::runtime_error(std::string("Reconstruction server ") + SocketPath
+			+ ": the server closed the connection");
+	}
+	if (CacheHit) {
+		*CacheHit = (Reply.CacheHit != 0);
+	}
+	return VectorToMatrix(Values, L, L);
+}
+
+void StopReconstructionServer(const char* SocketPath) {
+	/*
+	* Function: StopReconstructionServer
+	* ----------------------------------
+	* Ask the server listening at SocketPath to stop, and wait for it to
+	* acknowledge.
+	*/
+	ServerRequest Request;
+	std::memset(&Request, 0, sizeof(Request));
+	std::memcpy(Request.Magic, RequestMagic, sizeof(RequestMagic));
+	Request.ByteOrder = ServerByteOrder;
+	Request.Version = ServerProtocolVersion;
+
+	int Socket = Connect(SocketPath);
+	if (!SendAll(Socket, &Request, sizeof(Request))) {
+		close(Socket);
+		SocketError(SocketPath, "the stop request could not be sent");
+	}
+	ReceiveReply(Socket, SocketPath);
+	close(Socket);
+}
+#endif
@@ -0,0 +1,708 @@
+#include "ctvm_tiled.h"
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+static const char TiledMagic[8] = "CTVMTIL";
+static const uint32_t TiledByteOrder = 0x01020304;
+
+/* Value and Index Encoding */
+static uint16_t FloatToHalf(float Value) {
+	/*
+	* Function: FloatToHalf
+	* ---------------------
+	* Round a float to the nearest IEEE half-precision value (ties to even).
+	* Values beyond the half range become infinities.
+	*/
+	uint32_t Bits;
+	std::memcpy(&Bits, &Value, sizeof(float));
+	uint16_t Sign = static_cast<uint16_t>((Bits >> 16) & 0x8000);
+	uint32_t Magnitude = Bits & 0x7FFFFFFF;
+
+	if (Magnitude >= 0x7F800000) {
+		// Infinity, or a quiet NaN
+		return Sign | 0x7C00 | (Magnitude > 0x7F800000 ? 0x0200 : 0);
+	}
+	if (Magnitude >= 0x477FF000) {
+		// 65520 and above round to infinity
+		return Sign | 0x7C00;
+	}
+	if (Magnitude < 0x38800000) {
+		// Below 2^-14 the half is subnormal: a multiple of 2^-24
+		float Scaled = std::fabs(Value) * 16777216.0f;
+		return Sign | static_cast<uint16_t>(std::lrint(Scaled));
+	}
+	// Round away the 13 extra mantissa bits, then rebias the exponent
+	uint32_t Rounded = Magnitude + 0x0FFF + ((Magnitude >> 13) & 1);
+	return Sign | static_cast<uint16_t>((Rounded - 0x38000000) >> 13);
+}
+
+static float HalfToFloat(uint16_t Half) {
+	/*
+	* Function: HalfToFloat
+	* ---------------------
+	* The float equal to an IEEE half-precision value.
+	*/
+	uint32_t Sign = static_cast<uint32_t>(Half & 0x8000) << 16;
+	uint32_t Exponent = (Half >> 10) & 0x1F;
+	uint32_t Mantissa = Half & 0x03FF;
+	uint32_t Bits;
+	if (Exponent == 0) {
+		float Value = Mantissa / 16777216.0f;
+		return Sign ? -Value : Value;
+	}
+	if (Exponent == 31) {
+		Bits = Sign | 0x7F800000 | (Mantissa << 13);
+	}
+	else {
+		Bits = Sign | ((Exponent + 112) << 23) | (Mantissa << 13);
+	}
+	float Value;
+	std::memcpy(&Value, &Bits, sizeof(float));
+	return Value;
+}
+
+static const float *HalfTable() {
+	/*
+	* Function: HalfTable
+	* -------------------
+	* Output -- the float value of every half, indexed by its bits.
+	*/
+	static const std::vector<float> Table = []() {
+		std::vector<float> Values(65536);
+		for (unsigned long h = 0; h < 65536; ++h) {
+			Values[h] = HalfToFloat(static_cast<uint16_t>(h));
+		}
+		return Values;
+	}();
+	return &Table[0];
+}
+
+static inline void PutVarint(uint64_t Value, std::vector<unsigned char> &Out) {
+	while (Value >= 0x80) {
+		Out.push_back(static_cast<unsigned char>(Value | 0x80));
+		Value >>= 7;
+	}
+	Out.push_back(static_cast<unsigned char>(Value));
+}
+
+static inline uint64_t GetVarint(const unsigned char *&In) {
+	// Most steps along a ray fit in one byte
+	if (*In < 0x80) {
+		return *In++;
+	}
+	uint64_t Value = 0;
+	int Shift = 0;
+	unsigned char Byte;
+	do {
+		Byte = *In++;
+		Value |= static_cast<uint64_t>(Byte & 0x7F) << Shift;
+		Shift += 7;
+	} while (Byte & 0x80);
+	return Value;
+}
+
+// Zigzag encoding maps signed steps of either sign to small unsigned values
+static inline uint64_t ZigZag(int64_t Step) {
+	return (static_cast<uint64_t>(Step) << 1) ^ static_cast<uint64_t>(Step >> 63);
+}
+
+static inline int64_t UnZigZag(uint64_t Code) {
+	return static_cast<int64_t>(Code >> 1) ^ -static_cast<int64_t>(Code & 1);
+}
+
+static void PutValue(double Value, uint32_t ValueType, std::vector<unsigned char> &Out) {
+	unsigned char Bytes[8];
+	switch (ValueType) {
+	case TILED_FLOAT16:
+	{
+		uint16_t Half = FloatToHalf(static_cast<float>(Value));
+		std::memcpy(Bytes, &Half, sizeof(uint16_t));
+		break;
+	}
+	case TILED_FLOAT32:
+	{
+		float Single = static_cast<float>(Value);
+		std::memcpy(Bytes, &Single, sizeof(float));
+		break;
+	}
+	default:
+		std::memcpy(Bytes, &Value, sizeof(double));
+		break;
+	}
+	Out.insert(Out.end(), Bytes, Bytes + ValueType);
+}
+
+template <int ValueBytes>
+static inline double GetValue(const unsigned char *In, const float *Halves);
+
+template <>
+inline double GetValue<TILED_FLOAT16>(const unsigned char *In, const float *Halves) {
+	uint16_t Half;
+	std::memcpy(&Half, In, sizeof(uint16_t));
+	return Halves[Half];
+}
+
+template <>
+inline double GetValue<TILED_FLOAT32>(const unsigned char *In, const float *Halves) {
+	float Single;
+	std::memcpy(&Single, In, sizeof(float));
+	return Single;
+}
+
+template <>
+inline double GetValue<TILED_FLOAT64>(const unsigned char *In, const float *Halves) {
+	double Value;
+	std::memcpy(&Value, In, sizeof(double));
+	return Value;
+}
+
+static inline uint64_t GetIndex(const unsigned char *&In, bool Delta, uint64_t Previous) {
+	if (Delta) {
+		return static_cast<uint64_t>(static_cast<int64_t>(Previous) + UnZigZag(GetVarint(In)));
+	}
+	uint32_t Index;
+	std::memcpy(&Index, In, sizeof(uint32_t));
+	In += sizeof(uint32_t);
+	return Index;
+}
+
+static void EncodeRows(const std::vector<uint64_t> &RowPtr, const std::vector<uint32_t> &Index,
+	const std::vector<double> &Values, uint32_t ValueType, bool Delta,
+	std::vector<unsigned char> &Encoded) {
+	/*
+	* Function: EncodeRows
+	* --------------------
+	* Encode CSR rows as a block: for each row its number of non-zeros, its
+	* values, then its indices.
+	*/
+	Encoded.clear();
+	for (unsigned long r = 0; r + 1 < RowPtr.size(); ++r) {
+		PutVarint(RowPtr[r + 1] - RowPtr[r], Encoded);
+		for (uint64_t k = RowPtr[r]; k < RowPtr[r + 1]; ++k) {
+			PutValue(Values[k], ValueType, Encoded);
+		}
+		int64_t Previous = 0;
+		for (uint64_t k = RowPtr[r]; k < RowPtr[r + 1]; ++k) {
+			if (Delta) {
+				PutVarint(ZigZag(static_cast<int64_t>(Index[k]) - Previous), Encoded);
+				Previous = Index[k];
+			}
+			else {
+				unsigned char Bytes[sizeof(uint32_t)];
+				std::memcpy(Bytes, &Index[k], sizeof(uint32_t));
+				Encoded.insert(Encoded.end(), Bytes, Bytes + sizeof(uint32_t));
+			}
+		}
+	}
+}
+
+static double DecodeValue(const unsigned char *In, uint32_t ValueType) {
+	switch (ValueType) {
+	case TILED_FLOAT16: return GetValue<TILED_FLOAT16>(In, HalfTable());
+	case TILED_FLOAT32: return GetValue<TILED_FLOAT32>(In, NULL);
+	default: return GetValue<TILED_FLOAT64>(In, NULL);
+	}
+}
+
+template <int ValueBytes, bool Delta>
+static void GatherBlock(const unsigned char *Data, uint64_t Count, const double *In,
+	const float *Halves, bool Squares, double *Out) {
+	/*
+	* Function: GatherBlock
+	* ---------------------
+	* Out[r] = sum_k A(r, k) * In[k] over the Count encoded rows of a block, or
+	* the sum of their squared values when Squares is set. Each row is summed
+	* in the order it was written.
+	*/
+	for (uint64_t r = 0; r < Count; ++r) {
+		uint64_t Entries = GetVarint(Data);
+		const unsigned char *Values = Data;
+		Data += Entries * ValueBytes;
+		double Sum = 0.0;
+		uint64_t Index = 0;
+		for (uint64_t k = 0; k < Entries; ++k) {
+			Index = GetIndex(Data, Delta, Index);
+			double Value = GetValue<ValueBytes>(Values + k * ValueBytes, Halves);
+			Sum += Squares ? Value * Value : Value * In[Index];
+		}
+		Out[r] = Sum;
+	}
+}
+
+/* Writer */
+static bool SeekFile(FILE *File, uint64_t Offset) {
+#ifdef _WIN32
+	return _fseeki64(File, static_cast<__int64>(Offset), SEEK_SET) == 0;
+#else
+	return fseeko(File, static_cast<off_t>(Offset), SEEK_SET) == 0;
+#endif
+}
+
+TiledProjectionWriter::TiledProjectionWriter(const char* FileName, unsigned long Rows,
+	unsigned long Cols, unsigned long BlockRows, TiledValueType ValueType, bool DeltaIndices,
+	unsigned long TransposeBytes)
+	: FileName(FileName), Output(NULL), BlockRows(BlockRows), TransposeBytes(TransposeBytes),
+	Appended(0), Position(sizeof(TiledHeader)) {
+	/*
+	* Function: TiledProjectionWriter::TiledProjectionWriter
+	* ------------------------------------------------------
+	* Create the file for an (Rows x Cols) matrix and reserve its header,
+	* which Close() fills in.
+	*/
+	std::memset(&Header, 0, sizeof(TiledHeader));
+	std::memcpy(Header.Magic, TiledMagic, sizeof(TiledMagic));
+	Header.ByteOrder = TiledByteOrder;
+	Header.Version = TiledFormatVersion;
+	Header.ValueType = ValueType;
+	Header.DeltaIndices = DeltaIndices ? 1 : 0;
+	Header.Rows = Rows;
+	Header.Cols = Cols;
+	if (BlockRows == 0) {
+		Fail("needs at least one row per block");
+	}
+	if (Rows > 4294967295UL) {
+		Fail("has too many rows for 32-bit indices");
+	}
+	if (Cols > 4294967295UL) {
+		Fail("has too many columns for 32-bit indices");
+	}
+	if (ValueType != TILED_FLOAT16 && ValueType != TILED_FLOAT32 && ValueType != TILED_FLOAT64) {
+		Fail("has an unknown value type");
+	}
+	ColumnCounts.assign(Cols, 0);
+	PendingPtr.push_back(0);
+
+	Output = std::fopen(FileName, "w+b");
+	if (!Output) {
+		Fail("could not be created");
+	}
+	if (std::fwrite(&Header, sizeof(TiledHeader), 1, Output) != 1) {
+		Fail("could not be written");
+	}
+}
+
+TiledProjectionWriter::~TiledProjectionWriter() {
+	if (Output) {
+		std::fclose(Output);
+	}
+}
+
+void TiledProjectionWriter::Fail(const char* Problem) {
+	/*
+	* Function: TiledProjectionWriter::Fail
+	* -------------------------------------
+	* Close the file and throw a std::runtime_error naming it and the problem.
+	*/
+	if (Output) {
+		std::fclose(Output);
+		Output = NULL;
+	}
+	throw std::runtime_error("Tiled projection file " + FileName + ": " + Problem);
+}
+
+void TiledProjectionWriter::AppendRows(const std::vector<unsigned long> &RowPointers,
+	const std::vector<unsigned long> &ColumnIndices, const std::vector<double> &Values) {
+	/*
+	* Function: TiledProjectionWriter::AppendRows
+	* -------------------------------------------
+	* Add the rows to the block being filled, writing each block as it
+	* completes.
+	*/
+	if (!Output) {
+		Fail("is closed");
+	}
+	for (unsigned long r = 0; r + 1 < RowPointers.size(); ++r) {
+		if (Appended >= Header.Rows) {
+			Fail("has more rows than declared");
+		}
+		for (unsigned long k = RowPointers[r]; k < RowPointers[r + 1]; ++k) {
+			if (ColumnIndices[k] >= Header.Cols) {
+				Fail("has a column index out of range");
+			}
+			PendingIndex.push_back(static_cast<uint32_t>(ColumnIndices[k]));
+			PendingValues.push_back(Values[k]);
+			++ColumnCounts[ColumnIndices[k]];
+		}
+		PendingPtr.push_back(PendingValues.size());
+		++Appended;
+		if (PendingPtr.size() - 1 == BlockRows) {
+			WriteBlock(Appended - BlockRows, BlockRows, RowDirectory);
+		}
+	}
+}
+
+void TiledProjectionWriter::WriteBlock(uint64_t First, uint64_t Count, std::vector<TiledBlock> &Blocks) {
+	/*
+	* Function: TiledProjectionWriter::WriteBlock
+	* -------------------------------------------
+	* Encode the pending rows as a block at the end of the file, record it in
+	* Blocks and start a new block.
+	*/
+	EncodeRows(PendingPtr, PendingIndex, PendingValues, Header.ValueType, Header.DeltaIndices != 0,
+		Encoded);
+	if (!SeekFile(Output, Position)
+		|| (!Encoded.empty() && std::fwrite(&Encoded[0], 1, Encoded.size(), Output) != Encoded.size())) {
+		Fail("could not be written");
+	}
+	TiledBlock Block = { First, Count, Position, Encoded.size() };
+	Blocks.push_back(Block);
+	Position += Encoded.size();
+	Header.NonZeros += PendingValues.size();
+
+	PendingPtr.assign(1, 0);
+	PendingIndex.clear();
+	PendingValues.clear();
+}
+
+void TiledProjectionWriter::WriteTranspose() {
+	/*
+	* Function: TiledProjectionWriter::WriteTranspose
+	* -----------------------------------------------
+	* Write the columns of the matrix as the blocks of its transpose. Columns
+	* are grouped into blocks of about the mean row block's non-zeros, and
+	* blocks into passes whose entries fit in TransposeBytes; each pass reads
+	* every row block back and keeps the entries of its own columns, so each
+	* column lists its rows in ascending order.
+	*/
+	uint64_t Cols = Header.Cols;
+	uint64_t Target = std::max<uint64_t>(1, Header.NonZeros / std::max<uint64_t>(1, RowDirectory.size()));
+	const uint64_t EntryBytes = sizeof(uint32_t) + sizeof(double);
+	uint64_t PassEntries = std::max<uint64_t>(1, TransposeBytes / EntryBytes);
+
+	std::vector<unsigned char> Buffer;
+	std::vector<uint64_t> Fill;
+	std::vector<uint32_t> PassRows;
+	std::vector<double> PassValues;
+	uint64_t c = 0;
+	while (c < Cols) {
+		// Choose the block boundaries of this pass
+		std::vector<uint64_t> Boundaries(1, c);
+		uint64_t Entries = 0, BlockEntries = 0;
+		while (c < Cols) {
+			// A pass takes at least one column with entries, even when that
+			// column alone is over the budget
+			if (Entries > 0 && Entries + ColumnCounts[c] > PassEntries) {
+				break;
+			}
+			Entries += ColumnCounts[c];
+			BlockEntries += ColumnCounts[c];
+			++c;
+			if (BlockEntries >= Target) {
+				Boundaries.push_back(c);
+				BlockEntries = 0;
+			}
+		}
+		if (Boundaries.back() != c) {
+			Boundaries.push_back(c);
+		}
+
+		// Bucket the entries of the pass's columns by column
+		uint64_t Begin = Boundaries.front(), End = c;
+		Fill.assign(End - Begin + 1, 0);
+		for (uint64_t j = Begin; j < End; ++j) {
+			Fill[j - Begin + 1] = Fill[j - Begin] + ColumnCounts[j];
+		}
+		std::vector<uint64_t> Starts(Fill);
+		PassRows.resize(Entries);
+		PassValues.resize(Entries);
+		for (unsigned long b = 0; b < RowDirectory.size(); ++b) {
+			const TiledBlock &Block = RowDirectory[b];
+			Buffer.resize(Block.Bytes);
+			if (!SeekFile(Output, Block.Offset)
+				|| (Block.Bytes > 0 && std::fread(&Buffer[0], 1, Block.Bytes, Output) != Block.Bytes)) {
+				Fail("could not be read back");
+			}
+			const unsigned char *Data = Buffer.empty() ? NULL : &Buffer[0];
+			for (uint64_t r = 0; r < Block.Count; ++r) {
+				uint64_t Count = GetVarint(Data);
+				const unsigned char *Values = Data;
+				Data += Count * Header.ValueType;
+				uint64_t Index = 0;
+				for (uint64_t k = 0; k < Count; ++k) {
+					Index = GetIndex(Data, Header.DeltaIndices != 0, Index);
+					if (Index >= Begin && Index < End) {
+						uint64_t Slot = Fill[Index - Begin]++;
+						PassRows[Slot] = static_cast<uint32_t>(Block.First + r);
+						PassValues[Slot] = DecodeValue(Values + k * Header.ValueType, Header.ValueType);
+					}
+				}
+			}
+		}
+
+		// Each block of columns becomes a block of rows of the transpose
+		for (unsigned long k = 0; k + 1 < Boundaries.size(); ++k) {
+			for (uint64_t j = Boundaries[k]; j < Boundaries[k + 1]; ++j) {
+				for (uint64_t n = Starts[j - Begin]; n < Starts[j - Begin + 1]; ++n) {
+					PendingIndex.push_back(PassRows[n]);
+					PendingValues.push_back(PassValues[n]);
+				}
+				PendingPtr.push_back(PendingValues.size());
+			}
+			WriteBlock(Boundaries[k], Boundaries[k + 1] - Boundaries[k], ColumnDirectory);
+		}
+	}
+	// The transpose holds the same non-zeros
+	Header.NonZeros /= 2;
+}
+
+void TiledProjectionWriter::Close() {
+	/*
+	* Function: TiledProjectionWriter::Close
+	* --------------------------------------
+	* Write the last row block, the transposed copy, the block directory and
+	* the header, and close the file, which must have received every row.
+	*/
+	if (!Output) {
+		Fail("is closed");
+	}
+	if (PendingPtr.size() > 1) {
+		WriteBlock(Appended - (PendingPtr.size() - 1), PendingPtr.size() - 1, RowDirectory);
+	}
+	if (Appended != Header.Rows) {
+		Fail("was closed before all rows were written");
+	}
+	WriteTranspose();
+
+	// The directory starts on an 8-byte boundary
+	Header.DirectoryOffset = (Position + 7) / 8 * 8;
+	Header.RowBlocks = RowDirectory.size();
+	Header.ColumnBlocks = ColumnDirectory.size();
+	std::vector<unsigned char> Directory(Header.DirectoryOffset - Position, 0);
+	for (int Part = 0; Part < 2; ++Part) {
+		const std::vector<TiledBlock> &Blocks = Part ? ColumnDirectory : RowDirectory;
+		const unsigned char *Bytes = reinterpret_cast<const unsigned char *>(Blocks.data());
+		Directory.insert(Directory.end(), Bytes, Bytes + Blocks.size() * sizeof(TiledBlock));
+	}
+	bool Written = SeekFile(Output, Position)
+		&& (Directory.empty() || std::fwrite(&Directory[0], 1, Directory.size(), Output) == Directory.size())
+		&& SeekFile(Output, 0) && std::fwrite(&Header, sizeof(TiledHeader), 1, Output) == 1;
+	FILE *File = Output;
+	Output = NULL;
+	if (std::fclose(File) != 0 || !Written) {
+		Fail("could not be written");
+	}
+}
+
+void WriteTiledProjection(const char* FileName, const SparseProjection &A, unsigned long BlockRows,
+	TiledValueType ValueType, bool DeltaIndices) {
+	/*
+	* Function: WriteTiledProjection
+	* ------------------------------
+	* Write a SparseProjection as a tiled projection file.
+	*
+	* Input --
+	* FileName: the output file
+	* A: the projection matrix
+	* BlockRows: the number of rows per block
+	* ValueType, DeltaIndices: the storage of the non-zeros
+	*/
+	TiledProjectionWriter Writer(FileName, A.Rows(), A.Cols(), BlockRows, ValueType, DeltaIndices);
+	Writer.AppendRows(A.RowPointers(), A.ColumnIndices(), A.NonZeroValues());
+	Writer.Close();
+}
+
+void WriteParallelBeamProjection(const char* FileName, const BoostDoubleVector &TiltAngles,
+	unsigned long SideLength, unsigned long AnglesPerBlock, TiledValueType ValueType,
+	bool DeltaIndices) {
+	/*
+	* Function: WriteParallelBeamProjection
+	* -------------------------------------
+	* Build the parallel-beam system matrix of BuildParallelBeamProjection
+	* straight into a tiled projection file, one block of tilt angles at a
+	* time, so that only one block is ever held in memory.
+	*
+	* Input --
+	* FileName: the output file
+	* TiltAngles: an (O x 1) vector of tilt angles, in degrees
+	* SideLength: the side length L of both the image and the detector
+	* AnglesPerBlock: the tilt angles per row block (of L rows each)
+	* ValueType, DeltaIndices: the storage of the non-zeros
+	*/
+	unsigned long L = SideLength, O = TiltAngles.size();
+	AnglesPerBlock = std::max(1UL, AnglesPerBlock);
+	TiledProjectionWriter Writer(FileName, L * O, L * L, L * AnglesPerBlock, ValueType, DeltaIndices);
+
+	std::vector<unsigned long> RowPtr;
+	std::vector<unsigned long> ColIndex;
+	std::vector<double> Values;
+	for (unsigned long a = 0; a < O; a += AnglesPerBlock) {
+		RowPtr.assign(1, 0);
+		ColIndex.clear();
+		Values.clear();
+		for (unsigned long k = a; k < std::min(O, a + AnglesPerBlock); ++k) {
+			AppendParallelBeamRows(TiltAngles(k), L, RowPtr, ColIndex, Values);
+		}
+		Writer.AppendRows(RowPtr, ColIndex, Values);
+	}
+	Writer.Close();
+}
+
+/* Reader */
+static void TiledError(const char* FileName, const char* Problem) {
+	throw std::runtime_error(std::string("Tiled projection file ") + FileName + ": " + Problem);
+}
+
+static bool ValidDirectory(const std::vector<TiledBlock> &Blocks, uint64_t Extent, uint64_t DataEnd) {
+	/*
+	* Function: ValidDirectory
+	* ------------------------
+	* Output -- true if the blocks cover 0 .. Extent-1 in order and each lies
+	* between the header and DataEnd.
+	*/
+	uint64_t Next = 0;
+	for (unsigned long b = 0; b < Blocks.size(); ++b) {
+		const TiledBlock &Block = Blocks[b];
+		if (Block.First != Next || Block.Count > Extent - Next || Block.Offset < sizeof(TiledHeader)
+			|| Block.Offset > DataEnd || Block.Bytes > DataEnd - Block.Offset) {
+			return false;
+		}
+		Next += Block.Count;
+	}
+	return Next == Extent;
+}
+
+TiledSparseProjection::TiledSparseProjection(const char* FileName)
+	: Mapping(FileName, "Tiled projection file") {
+	/*
+	* Function: TiledSparseProjection::TiledSparseProjection
+	* ------------------------------------------------------
+	* Map the file and validate its header and block directory.
+	*/
+	const unsigned char *Base = Mapping.Data();
+	uint64_t Length = Mapping.Size();
+	if (Length < sizeof(TiledHeader)) {
+		TiledError(FileName, "is too short for a header");
+	}
+	std::memcpy(&Header, Base, sizeof(TiledHeader));
+	if (std::memcmp(Header.Magic, TiledMagic, sizeof(TiledMagic)) != 0) {
+		TiledError(FileName, "is not a tiled projection file");
+	}
+	if (Header.ByteOrder != TiledByteOrder) {
+		TiledError(FileName, "was written with a different byte order");
+	}
+	if (Header.Version != TiledFormatVersion) {
+		TiledError(FileName, "has an unsupported format version");
+	}
+	if ((Header.ValueType != TILED_FLOAT16 && Header.ValueType != TILED_FLOAT32
+		&& Header.ValueType != TILED_FLOAT64) || Header.DeltaIndices > 1) {
+		TiledError(FileName, "has an unknown encoding");
+	}
+
+	uint64_t Blocks = Header.RowBlocks + Header.ColumnBlocks;
+	if (Header.DirectoryOffset > Length || Header.RowBlocks > Length || Header.ColumnBlocks > Length
+		|| Blocks > (Length - Header.DirectoryOffset) / sizeof(TiledBlock)) {
+		TiledError(FileName, "is truncated");
+	}
+	RowDirectory.resize(Header.RowBlocks);
+	ColumnDirectory.resize(Header.ColumnBlocks);
+	const unsigned char *Directory = Base + Header.DirectoryOffset;
+	if (!RowDirectory.empty()) {
+		std::memcpy(&RowDirectory[0], Directory, RowDirectory.size() * sizeof(TiledBlock));
+	}
+	if (!ColumnDirectory.empty()) {
+		std::memcpy(&ColumnDirectory[0], Directory + RowDirectory.size() * sizeof(TiledBlock),
+			ColumnDirectory.size() * sizeof(TiledBlock));
+	}
+	if (!ValidDirectory(RowDirectory, Header.Rows, Header.DirectoryOffset)
+		|| !ValidDirectory(ColumnDirectory, Header.Cols, Header.DirectoryOffset)) {
+		TiledError(FileName, "has a bad block directory");
+	}
+}
+
+unsigned long TiledSparseProjection::Rows() const {
+	return static_cast<unsigned long>(Header.Rows);
+}
+
+unsigned long TiledSparseProjection::Cols() const {
+	return static_cast<unsigned long>(Header.Cols);
+}
+
+unsigned long TiledSparseProjection::NonZeros() const {
+	return static_cast<unsigned long>(Header.NonZeros);
+}
+
+TiledValueType TiledSparseProjection::ValueType() const {
+	return static_cast<TiledValueType>(Header.ValueType);
+}
+
+bool TiledSparseProjection::DeltaIndices() const {
+	return Header.DeltaIndices != 0;
+}
+
+unsigned long TiledSparseProjection::RowBlocks() const {
+	return RowDirectory.size();
+}
+
+unsigned long TiledSparseProjection::ColumnBlocks() const {
+	return ColumnDirectory.size();
+}
+
+void TiledSparseProjection::Multiply(const std::vector<TiledBlock> &Blocks,
+	const BoostDoubleVector &In, BoostDoubleVector &Out, bool Squares) const {
+	/*
+	* Function: TiledSparseProjection::Multiply
+	* -----------------------------------------
+	* Gather every row of the blocks into Out, one block per thread at a time,
+	* prefetching one block per thread ahead.
+	*/
+	unsigned long Length = Blocks.empty() ? 0 : Blocks.back().First + Blocks.back().Count;
+	Out.resize(Length, false);
+	long Count = static_cast<long>(Blocks.size());
+	long Ahead = GetThreadCount();
+	for (long b = 0; b < std::min(Ahead, Count); ++b) {
+		Mapping.WillNeed(Blocks[b].Offset, Blocks[b].Bytes);
+	}
+
+	const unsigned char *Base = Mapping.Data();
+	const double *InData = In.data().begin();
+	double *OutData = Out.data().begin();
+	const float *Halves = (Header.ValueType == TILED_FLOAT16) ? HalfTable() : NULL;
+	uint32_t Encoding = Header.ValueType * 2 + Header.DeltaIndices;
+	#pragma omp parallel for num_threads(GetThreadCount()) schedule(dynamic, 1) if(NonZeros() >= ParallelMinimumWork)
+	for (long b = 0; b < Count; ++b) {
+		if (b + Ahead < Count) {
+			Mapping.WillNeed(Blocks[b + Ahead].Offset, Blocks[b + Ahead].Bytes);
+		}
+		const TiledBlock &Block = Blocks[b];
+		const unsigned char *Data = Base + Block.Offset;
+		double *Rows = OutData + Block.First;
+		switch (Encoding) {
+		case TILED_FLOAT16 * 2: GatherBlock<TILED_FLOAT16, false>(Data, Block.Count, InData, Halves, Squares, Rows); break;
+		case TILED_FLOAT16 * 2 + 1: GatherBlock<TILED_FLOAT16, true>(Data, Block.Count, InData, Halves, Squares, Rows); break;
+		case TILED_FLOAT32 * 2: GatherBlock<TILED_FLOAT32, false>(Data, Block.Count, InData, Halves, Squares, Rows); break;
+		case TILED_FLOAT32 * 2 + 1: GatherBlock<TILED_FLOAT32, true>(Data, Block.Count, InData, Halves, Squares, Rows); break;
+		case TILED_FLOAT64 * 2: GatherBlock<TILED_FLOAT64, false>(Data, Block.Count, InData, Halves, Squares, Rows); break;
+		default: GatherBlock<TILED_FLOAT64, true>(Data, Block.Count, InData, Halves, Squares, Rows); break;
+		}
+	}
+}
+
+void TiledSparseProjection::Apply(const BoostDoubleVector &X, BoostDoubleVector &Y) const {
+	/*
+	* Function: TiledSparseProjection::Apply
+	* --------------------------------------
+	* Y = A*X, streamed over the row blocks.
+	*/
+	Multiply(RowDirectory, X, Y, false);
+}
+
+void TiledSparseProjection::ApplyTranspose(const BoostDoubleVector &Y, BoostDoubleVector &X) const {
+	/*
+	* Function: TiledSparseProjection::ApplyTranspose
+	* -----------------------------------------------
+	* X = A^T*Y, streamed over the blocks of the transposed copy.
+	*/
+	Multiply(ColumnDirectory, Y, X, false);
+}
+
+bool TiledSparseProjection::SquaredColumnNorms(BoostDoubleVector &Norms) const {
+	/*
+	* Function: TiledSparseProjection::SquaredColumnNorms
+	* ---------------------------------------------------
+	* Sum the squared values of each row of the transposed copy, in one pass.
+	*/
+	// Only the values are read, so Norms can stand in for the input
+	Multiply(ColumnDirectory, Norms, Norms, true);
+	return true;
+}
@@ -1,7 +1,28 @@
 #include "ctvm_util.h"
-
-
-BoostDoubleVector GetRow(BoostDoubleMatrix AMatrix, unsigned int row) {
+#include <atomic>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Requested thread count; 0 defers to the OpenMP runtime default.
+static int ThreadCount = 0;
+
+
+BoostDoubleVector GetRow(const BoostDoubleMatrix &AMatrix, unsigned int row) {
 	/*
 	* Function: GetRow
 	* ------------------------------
@@ -12,10 +33,10 @@ BoostDoubleVector GetRow(BoostDoubleMatrix AMatrix, unsigned int row) {
 	*
 	* return -- A BoostDoubleVector
 	*/
-	return BoostDoubleVector(boost::numeric::ublas::matrix_row<BoostDoubleMatrix>(AMatrix, row));
+	return BoostDoubleVector(boost::numeric::ublas::matrix_row<const BoostDoubleMatrix>(AMatrix, row));
 }
 
-BoostDoubleVector GetCol(BoostDoubleMatrix AMatrix, unsigned int col) {
+BoostDoubleVector GetCol(const BoostDoubleMatrix &AMatrix, unsigned int col) {
 	/*
 	* Function: GetCol
 	* ------------------------------
@@ -26,11 +47,10 @@ BoostDoubleVector GetCol(BoostDoubleMatrix AMatrix, unsigned int col) {
 	*
 	* return -- A BoostDoubleVector
 	*/
-	BoostDoubleMatrix AMatrixTransp = trans(AMatrix);
-	return BoostDoubleVector(boost::numeric::ublas::matrix_row<BoostDoubleMatrix>(AMatrixTransp, col));
+	return BoostDoubleVector(boost::numeric::ublas::matrix_column<const BoostDoubleMatrix>(AMatrix, col));
 }
 
-void SetRow(BoostDoubleMatrix &AMatrix, BoostDoubleVector RowVect, unsigned int row) {
+void SetRow(BoostDoubleMatrix &AMatrix, const BoostDoubleVector &RowVect, unsigned int row) {
 	/*
 	* Function: SetRow
 	* ------------------------------
@@ -49,7 +69,7 @@ void SetRow(BoostDoubleMatrix &AMatrix, BoostDoubleVector RowVect, unsigned int
 	}
 }
 
-void SetCol(BoostDoubleMatrix &AMatrix, BoostDoubleVector ColVect, unsigned int col) {
+void SetCol(BoostDoubleMatrix &AMatrix, const BoostDoubleVector &ColVect, unsigned int col) {
 	/*
 	* Function: SetCol
 	* ------------------------------
@@ -68,41 +88,206 @@ void SetCol(BoostDoubleMatrix &AMatrix, BoostDoubleVector ColVect, unsigned int
 	}
 }
 
+BoostDoubleVector GetRow(const BoostGradientMatrix &AMatrix, unsigned int row) {
+	/*
+	* Function: GetRow
+	* ------------------------------
+	* BoostGradientMatrix (column-major) form of GetRow.
+	*/
+	return BoostDoubleVector(boost::numeric::ublas::matrix_row<const BoostGradientMatrix>(AMatrix, row));
+}
+
+BoostDoubleVector GetCol(const BoostGradientMatrix &AMatrix, unsigned int col) {
+	/*
+	* Function: GetCol
+	* ------------------------------
+	* BoostGradientMatrix (column-major) form of GetCol. The column is one
+	* contiguous gradient plane.
+	*/
+	return BoostDoubleVector(boost::numeric::ublas::matrix_column<const BoostGradientMatrix>(AMatrix, col));
+}
+
+void SetRow(BoostGradientMatrix &AMatrix, const BoostDoubleVector &RowVect, unsigned int row) {
+	/*
+	* Function: SetRow
+	* ------------------------------
+	* BoostGradientMatrix (column-major) form of SetRow.
+	*/
+	unsigned int cols = AMatrix.size2();
+
+	for (unsigned int i = 0; i < cols; ++i) {
+		AMatrix(row, i) = RowVect(i);
+	}
+}
+
+void SetCol(BoostGradientMatrix &AMatrix, const BoostDoubleVector &ColVect, unsigned int col) {
+	/*
+	* Function: SetCol
+	* ------------------------------
+	* BoostGradientMatrix (column-major) form of SetCol.
+	*/
+	unsigned int rows = AMatrix.size1();
+
+	for (unsigned int i = 0; i < rows; ++i) {
+		AMatrix(i, col) = ColVect(i);
+	}
+}
+
+
+/* Counter-Based Random Numbers */
+void Philox4x32(const uint32_t Counter[4], const uint32_t Key[2], uint32_t Output[4]) {
+	/*
+	* Function: Philox4x32
+	* --------------------
+	* The ten rounds of Philox4x32: each multiplies two of the words by the
+	* round constants, and mixes the halves of the products with the other
+	* words and the key, which is bumped by the Weyl constants between rounds.
+	*
+	* Input --
+	* Counter: the 128-bit counter, low word first
+	* Key: the 64-bit key, low word first
+	*
+	* Output -- Output, the four random words of the block.
+	*/
+	uint32_t C0 = Counter[0], C1 = Counter[1], C2 = Counter[2], C3 = Counter[3];
+	uint32_t K0 = Key[0], K1 = Key[1];
+	for (int Round = 0; Round < 10; ++Round) {
+		uint64_t P0 = static_cast<uint64_t>(0xD2511F53u) * C0;
+		uint64_t P1 = static_cast<uint64_t>(0xCD9E8D57u) * C2;
+		uint32_t Next0 = static_cast<uint32_t>(P1 >> 32) ^ C1 ^ K0;
+		uint32_t Next2 = static_cast<uint32_t>(P0 >> 32) ^ C3 ^ K1;
+		C1 = static_cast<uint32_t>(P1);
+		C3 = static_cast<uint32_t>(P0);
+		C0 = Next0;
+		C2 = Next2;
+		K0 += 0x9E3779B9u;
+		K1 += 0xBB67AE85u;
+	}
+	Output[0] = C0;
+	Output[1] = C1;
+	Output[2] = C2;
+	Output[3] = C3;
+}
+
+static void GaussianPair(uint64_t Seed, uint64_t Block, double &First, double &Second) {
+	/*
+	* Function: GaussianPair
+	* ----------------------
+	* The two normals of counter block Block: Box-Muller applied to the two
+	* 53-bit uniforms made of the four words, the first in (0, 1] so that
+	* its logarithm is finite.
+	*/
+	const uint32_t Counter[4] = { static_cast<uint32_t>(Block), static_cast<uint32_t>(Block >> 32), 0, 0 };
+	const uint32_t Key[2] = { static_cast<uint32_t>(Seed), static_cast<uint32_t>(Seed >> 32) };
+	uint32_t Words[4];
+	Philox4x32(Counter, Key, Words);
+	const double Unit = 1.0 / 9007199254740992.0;   // 2^-53
+	uint64_t A = (static_cast<uint64_t>(Words[0]) << 32) | Words[1];
+	uint64_t B = (static_cast<uint64_t>(Words[2]) << 32) | Words[3];
+	double U1 = ((A >> 11) + 1) * Unit;
+	double U2 = (B >> 11) * Unit;
+	double Radius = std::sqrt(-2.0 * std::log(U1));
+	double Angle = 6.283185307179586 * U2;
+	First = Radius * std::cos(Angle);
+	Second = Radius * std::sin(Angle);
+}
+
+void GenerateGaussian(uint64_t Seed, uint64_t First, unsigned long Count, double *Values) {
+	/*
+	* Function: GenerateGaussian
+	* --------------------------
+	* Fill Values with positions First .. First+Count-1 of the Gaussian
+	* stream of Seed, on the calling thread. A range starting or ending
+	* half-way through a block uses one of its two normals.
+	*/
+	uint64_t Position = First, End = First + Count;
+	double Even, Odd;
+	if (Position < End && (Position & 1)) {
+		GaussianPair(Seed, Position >> 1, Even, Odd);
+		*Values++ = Odd;
+		++Position;
+	}
+	for (; Position + 1 < End; Position += 2) {
+		GaussianPair(Seed, Position >> 1, Values[0], Values[1]);
+		Values += 2;
+	}
+	if (Position < End) {
+		GaussianPair(Seed, Position >> 1, Even, Odd);
+		*Values = Even;
+	}
+}
+
+void FillGaussian(uint64_t Seed, uint64_t First, unsigned long Count, double *Values) {
+	/*
+	* Function: FillGaussian
+	* ----------------------
+	* GenerateGaussian with the range split into chunks across the threads.
+	* Every position is generated from its own counter, so the split does
+	* not change the result.
+	*/
+	const long Chunk = 4096;
+	long Chunks = static_cast<long>((Count + Chunk - 1) / Chunk);
+#pragma omp parallel for num_threads(GetThreadCount()) schedule(static) if(Count >= ParallelMinimumWork)
+	for (long c = 0; c < Chunks; ++c) {
+		unsigned long Begin = static_cast<unsigned long>(c) * Chunk;
+		unsigned long Length = std::min<unsigned long>(Chunk, Count - Begin);
+		GenerateGaussian(Seed, First + Begin, Length, Values + Begin);
+	}
+}
+
+static uint64_t FreshRandomSeed() {
+	/*
+	* Function: FreshRandomSeed
+	* -------------------------
+	* A seed from the clock, in microseconds, mixed with a call count, so
+	* that calls within the same clock tick still get different seeds.
+	*/
+	static std::atomic<uint64_t> Calls(0);
+	uint64_t Call = ++Calls;
+	boost::posix_time::ptime Now = boost::posix_time::microsec_clock::universal_time();
+	boost::posix_time::ptime Epoch(boost::gregorian::date(1970, 1, 1));
+	uint64_t Microseconds = static_cast<uint64_t>((Now - Epoch).total_microseconds());
+	return Microseconds ^ (Call * 0x9E3779B97F4A7C15ULL);
+}
 
 BoostDoubleMatrix CreateRandomMatrix(int rows, int cols) {
 	/*
 	* Function: CreateRandomMatrix
 	* ------------------------------
 	* Allocates a matrix of the specified dimensionality and fills it with random
-	* entries drawn from a Normal distribution of variance 1.
+	* entries drawn from a Normal distribution of variance 1, from a fresh
+	* seed.
 	*
 	* rows: number of rows in generated matrix
 	* cols: number of columns in generated matrix
 	*
 	* return -- A random matrix of type `matrix<double>`
 	*/
-	/* Matrix Allocation */
-	BoostDoubleMatrix RandomMatrix(rows, cols);
-
-	/* Random Number Generation */
-	boost::posix_time::ptime CurrentTick = boost::posix_time::microsec_clock::local_time();
-	boost::mt19937 RNG(static_cast<unsigned int>(CurrentTick.time_of_day().total_milliseconds()));     // Set the integer RNG engine. Time Based Seed.
-	boost::normal_distribution<> NormDist(0.0, 1.0);  // Specify the distribution with zero mean and unit variance
-	boost::variate_generator<boost::mt19937&,
-		boost::normal_distribution<> > RandNormValue(RNG, NormDist);    // Finally, build the number generator itself.
+	return CreateRandomMatrix(rows, cols, FreshRandomSeed());
+}
 
-																		/* Loop and Assign */
-	for (unsigned long i = 0; i < RandomMatrix.size1(); ++i) {
-		for (unsigned long j = 0; j < RandomMatrix.size2(); ++j) {
-			RandomMatrix(i, j) = RandNormValue();
-		}
+BoostDoubleMatrix CreateRandomMatrix(int rows, int cols, uint64_t Seed) {
+	/*
+	* Function: CreateRandomMatrix
+	* ------------------------------
+	* Allocates a matrix of the specified dimensionality and fills it, in
+	* parallel, with the Gaussian stream of Seed, row by row; entry (i, j) is
+	* position i*cols + j of the stream.
+	*
+	* rows: number of rows in generated matrix
+	* cols: number of columns in generated matrix
+	* Seed: the stream
+	*
+	* return -- A random matrix of type `matrix<double>`
+	*/
+	BoostDoubleMatrix RandomMatrix(rows, cols);
+	if (rows > 0 && cols > 0) {
+		FillGaussian(Seed, 0, RandomMatrix.data().size(), &RandomMatrix.data()[0]);
 	}
-
-	/* Return Filled Random Matrix */
 	return RandomMatrix;
 }
 
-BoostDoubleVector SignVector(BoostDoubleVector AVector) {
+BoostDoubleVector SignVector(const BoostDoubleVector &AVector) {
 	/*
 	* Function: SignVector
 	* ------------------------------
@@ -110,18 +295,19 @@ BoostDoubleVector SignVector(BoostDoubleVector AVector) {
 	*
 	* return -- A BoostDoubleVector with each entry in {-1,+1}
 	*/
+	BoostDoubleVector Signs(AVector.size());
 	for (unsigned int i = 0; i< AVector.size(); ++i) {
 		if (AVector(i)<0.0) {
-			AVector(i) = -1.0;
+			Signs(i) = -1.0;
 		}
 		else {
-			AVector(i) = 1.0;
+			Signs(i) = 1.0;
 		}
 	}
-	return AVector;
+	return Signs;
 }
 
-BoostDoubleVector HadamardProduct(BoostDoubleVector A, BoostDoubleVector B) {
+BoostDoubleVector HadamardProduct(const BoostDoubleVector &A, const BoostDoubleVector &B) {
 	/*
 	* Function: HadamardProduct
 	* ------------------------------
@@ -139,7 +325,7 @@ BoostDoubleVector HadamardProduct(BoostDoubleVector A, BoostDoubleVector B) {
 	return C;
 }
 
-BoostDoubleVector AbsoluteValueVector(BoostDoubleVector AVector) {
+BoostDoubleVector AbsoluteValueVector(const BoostDoubleVector &AVector) {
 	/*
 	* Function: AbsoluteValueVector
 	* ------------------------------
@@ -147,13 +333,14 @@ BoostDoubleVector AbsoluteValueVector(BoostDoubleVector AVector) {
 	*
 	* return -- A BoostDoubleVector >= 0
 	*/
+	BoostDoubleVector AbsValues(AVector.size());
 	for (unsigned int i = 0; i< AVector.size(); ++i) {
-		AVector(i) = std::abs(AVector(i));
+		AbsValues(i) = std::abs(AVector(i));
 	}
-	return AVector;
+	return AbsValues;
 }
 
-BoostDoubleVector MaxVector(BoostDoubleVector A, BoostDoubleVector B) {
+BoostDoubleVector MaxVector(const BoostDoubleVector &A, const BoostDoubleVector &B) {
 	/*
 	* Function: MaxVector
 	* ------------------------------
@@ -170,7 +357,7 @@ BoostDoubleVector MaxVector(BoostDoubleVector A, BoostDoubleVector B) {
 	return C;
 }
 
-BoostDoubleVector MaxVector(BoostDoubleVector A, double B) {
+BoostDoubleVector MaxVector(const BoostDoubleVector &A, double B) {
 	/*
 	* Function: MaxVector
 	* ------------------------------
@@ -188,7 +375,7 @@ BoostDoubleVector MaxVector(BoostDoubleVector A, double B) {
 	return C;
 }
 
-BoostDoubleVector MakeUnitVector(BoostDoubleVector AVector) {
+BoostDoubleVector MakeUnitVector(const BoostDoubleVector &AVector) {
 	/*
 	* Function: MakeUnitVector
 	* ------------------------------
@@ -204,28 +391,32 @@ BoostDoubleVector CreateRandomVector(int length) {
 	* Function: CreateRandomVector
 	* ------------------------------
 	* Allocates a vector of the specified length and fills it with random
-	* entries drawn from a Normal distribution of variance 1.
+	* entries drawn from a Normal distribution of variance 1, from a fresh
+	* seed.
 	*
 	* length: number of elements in the generated vector
 	*
 	* return -- A random vector of type BoostDoubleVector
 	*/
-	/* Matrix Allocation */
-	BoostDoubleVector RandomVector(length);
-
-	/* Random Number Generation */
-	boost::posix_time::ptime CurrentTick = boost::posix_time::microsec_clock::local_time();
-	boost::mt19937 RNG(static_cast<unsigned int>(CurrentTick.time_of_day().total_milliseconds()));     // Set the integer RNG engine. Time Based Seed.
-	boost::normal_distribution<> NormDist(0.0, 1.0);  // Specify the distribution with zero mean and unit variance
-	boost::variate_generator<boost::mt19937&,
-		boost::normal_distribution<> > RandNormValue(RNG, NormDist);    // Finally, build the number generator itself.
+	return CreateRandomVector(length, FreshRandomSeed());
+}
 
-																		/* Loop and Assign */
-	for (unsigned long i = 0; i < RandomVector.size(); ++i) {
-		RandomVector(i) = RandNormValue();
+BoostDoubleVector CreateRandomVector(int length, uint64_t Seed) {
+	/*
+	* Function: CreateRandomVector
+	* ------------------------------
+	* Allocates a vector of the specified length and fills it, in parallel,
+	* with the first entries of the Gaussian stream of Seed.
+	*
+	* length: number of elements in the generated vector
+	* Seed: the stream
+	*
+	* return -- A random vector of type BoostDoubleVector
+	*/
+	BoostDoubleVector RandomVector(length);
+	if (length > 0) {
+		FillGaussian(Seed, 0, RandomVector.size(), &RandomVector(0));
 	}
-
-	/* Return Filled Random Matrix */
 	return RandomVector;
 }
 
@@ -234,7 +425,7 @@ BoostDoubleMatrix ImageToMatrix(Magick::Image AnImage) {
 	* Function: ImageToMatrix
 	* ---------------------------
 	* Convert from the Magick++ defined Image type to the BoostDoubleMatrix
-	* type.
+	* type, taking the gray intensity of each pixel.
 	*/
 	using namespace Magick;
 
@@ -242,27 +433,13 @@ BoostDoubleMatrix ImageToMatrix(Magick::Image AnImage) {
 	int rows = AnImage.rows();
 	int cols = AnImage.columns();
 
-	/* Convert to Grayscale */
-	AnImage.quantizeColorSpace(GRAYColorspace);
-	AnImage.quantizeColors(256);
-	AnImage.quantize();
-
 	/* Assignment to BoostDoubleMatrix */
-	BoostDoubleMatrix DBMImage(rows, cols);     // Allocate the matrix
-	Pixels View(AnImage);  // Specify the "view" into the image
-	PixelPacket *AllPixels = View.get(0, 0, cols, rows);   // Get the pointer to the pixel array
-
-														   /* Loop over Pixels */
-	for (int i = 0; i<rows; ++i) {
-		for (int j = 0; j< cols; ++j) {
-			// The entire image should be cast into grayscale, so all of the
-			// RGB components should be equal to the same values. Hence, we
-			// take the red pixel value.
-			// Additionally, it is necessary to increment the pixel pointer.
-			Quantum thisPixel = (*AllPixels++).red;
-			// Finally, we have to cast the Quantum type into a double.
-			DBMImage(i, j) = ColorGray::scaleQuantumToDouble(thisPixel);
-		}
+	// The intensities of the whole image are exported in one call, row by
+	// row, which is the storage order of the matrix. Nothing is quantized,
+	// so 16-bit and floating-point images keep their precision.
+	BoostDoubleMatrix DBMImage(rows, cols);
+	if (rows > 0 && cols > 0) {
+		AnImage.write(0, 0, cols, rows, "I", DoublePixel, &DBMImage.data()[0]);
 	}
 
 	return DBMImage;
@@ -275,11 +452,15 @@ BoostDoubleMatrix LoadImage(const char* ImageFileName) {
 	* Attempts to load an image file from the specified location using ImageMagick.
 	* Subsequently,
 	* the ImageMagick image file is convereted to a matrix<double> and returned.
+	* Netpbm files are read directly, with ReadNetpbm.
 	*
 	* return -- A random matrix of type `matrix<double>`.
 	*/
 	using namespace Magick;
 
+	if (IsNetpbmFileName(ImageFileName)) {
+		return ReadNetpbm(ImageFileName);
+	}
 
 	Image RunTimeImage;
 	try {
@@ -299,11 +480,16 @@ BoostDoubleMatrix LoadImage(const char* ImageFileName, int newRows, int newCols)
 	* Attempts to load an image file from the specified location using ImageMagick.
 	* Subsequently,
 	* the ImageMagick image file is convereted to a BoostMatrixDouble and returned.
+	* Netpbm files are read directly, with ReadNetpbm, and resampled with
+	* ResizeMatrix, so that PFM values are not quantized.
 	*
 	* return -- A random matrix of type BoostMatrixDouble.
 	*/
 	using namespace Magick;
 
+	if (IsNetpbmFileName(ImageFileName)) {
+		return ResizeMatrix(ReadNetpbm(ImageFileName), newRows, newCols);
+	}
 
 	Image RunTimeImage;
 	try {
@@ -320,47 +506,261 @@ BoostDoubleMatrix LoadImage(const char* ImageFileName, int newRows, int newCols)
 	return ImageToMatrix(RunTimeImage);
 }
 
-void WriteImage(BoostDoubleMatrix AMatrix, const char* OutputFile) {
+void WriteImage(const BoostDoubleMatrix &AMatrix, const char* OutputFile, ImageDepth Depth) {
 	/*
 	* Function: WriteImage
 	* ----------------------------
 	* Given a UBlas matrix as well as an output file name, attempt to write
-	* that matrix as an image. This assumes that the matrix is already scaled
-	* in the range [0,1].
+	* that matrix as an image with Depth bits per pixel. This assumes that
+	* the matrix is already scaled in the range [0,1]. Netpbm files are
+	* written directly: ".pfm" always as float32, ".pgm" with 8 or 16 bits.
 	*/
 	using namespace Magick;
 
+	size_t Length = std::strlen(OutputFile);
+	if (IsNetpbmFileName(OutputFile)) {
+		bool Float = std::strcmp(OutputFile + Length - 4, ".pfm") == 0;
+		WriteNetpbm(OutputFile, AMatrix, Float ? IMAGE_DEPTH_FLOAT
+			: (Depth == IMAGE_DEPTH_16 ? IMAGE_DEPTH_16 : IMAGE_DEPTH_8));
+		return;
+	}
+
 	int rows = AMatrix.size1();
 	int cols = AMatrix.size2();
 
 	/* Create Image */
-	Image OutputImage;                                // Specify the output file
-	OutputImage.size(Geometry(cols, rows));            // Specify image dimensions
-	Pixels OutputImageView(OutputImage);
+	// The whole image is imported in one call from the (row-major) matrix
+	// storage, as gray intensities.
+	Image OutputImage;
+	if (rows > 0 && cols > 0) {
+		OutputImage.read(cols, rows, "I", DoublePixel, &AMatrix.data()[0]);
+	}
+	OutputImage.type(GrayscaleType);
+	OutputImage.depth(Depth);
+	if (Depth == IMAGE_DEPTH_FLOAT) {
+		// Formats with floating-point samples (TIFF, MIFF, ...) store them
+		OutputImage.defineValue("quantum", "format", "floating-point");
+	}
 
-	/* Pixel Assignment Loop */
-	// This procedure is, I'm sure, one of the least efficient ways
-	// of accomplishing this task.
-	PixelPacket thisPixel;
-	for (int i = 0; i < rows; ++i) {
-		for (int j = 0; j < cols; ++j) {
-			thisPixel.red = ColorGray::scaleDoubleToQuantum(AMatrix(i, j));
-			thisPixel.green = ColorGray::scaleDoubleToQuantum(AMatrix(i, j));
-			thisPixel.blue = ColorGray::scaleDoubleToQuantum(AMatrix(i, j));
+	/* Write to Disk */
+	OutputImage.write(OutputFile);
+}
 
-			*(OutputImageView.get(j, i, 1, 1)) = thisPixel;
+/* Netpbm Images */
+static void NetpbmError(const char* ImageFileName, const char* Problem) {
+	/*
+	* Function: NetpbmError
+	* ---------------------
+	* Throw a std::runtime_error naming the image and the problem.
+	*/
+	throw std::runtime_error(std::string("Netpbm image ") + ImageFileName + ": " + Problem);
+}
+
+static bool NetpbmToken(const unsigned char *Data, size_t Length, size_t &Position, std::string &Token) {
+	/*
+	* Function: NetpbmToken
+	* ---------------------
+	* Read the next header field, skipping whitespace and comments. Position
+	* is left on the character after the field.
+	*
+	* Output -- false if the data ends before a field.
+	*/
+	while (Position < Length) {
+		if (Data[Position] == '#') {
+			while (Position < Length && Data[Position] != '\n') {
+				++Position;
+			}
+		}
+		else if (std::isspace(Data[Position])) {
+			++Position;
+		}
+		else {
+			break;
 		}
 	}
+	Token.clear();
+	while (Position < Length && !std::isspace(Data[Position]) && Data[Position] != '#') {
+		Token += static_cast<char>(Data[Position++]);
+	}
+	return !Token.empty();
+}
 
-	/* Final Update */
-	OutputImage.type(GrayscaleType);
-	OutputImageView.sync();
+static bool LittleEndianHost() {
+	uint16_t Probe = 1;
+	unsigned char First;
+	std::memcpy(&First, &Probe, 1);
+	return First == 1;
+}
 
-	/* Write to Disk */
-	OutputImage.write(OutputFile);
+BoostDoubleMatrix ReadNetpbm(const char* ImageFileName) {
+	/*
+	* Function: ReadNetpbm
+	* --------------------
+	* Read a binary PGM or a grayscale PFM image, mapped into memory, in a
+	* single pass over its pixels.
+	*
+	* Input --
+	* ImageFileName: the image file
+	*
+	* Output -- the image; PGM samples divided by the maximum value, PFM
+	* samples as stored.
+	*/
+	MappedFile Mapping(ImageFileName, "Netpbm image");
+	const unsigned char *Data = Mapping.Data();
+	size_t Length = Mapping.Size(), Position = 0;
+
+	std::string Magic, Width, Height, Maximum;
+	if (!NetpbmToken(Data, Length, Position, Magic) || (Magic != "P5" && Magic != "Pf")) {
+		NetpbmError(ImageFileName, "is not a binary PGM or grayscale PFM image");
+	}
+	bool Float = (Magic == "Pf");
+	if (!NetpbmToken(Data, Length, Position, Width) || !NetpbmToken(Data, Length, Position, Height)
+		|| !NetpbmToken(Data, Length, Position, Maximum) || Position >= Length) {
+		NetpbmError(ImageFileName, "has a truncated header");
+	}
+	// Exactly one whitespace character separates the header from the pixels
+	++Position;
+
+	char *End = NULL;
+	unsigned long Cols = std::strtoul(Width.c_str(), &End, 10);
+	bool BadHeader = (*End != '\0' || Cols == 0);
+	unsigned long Rows = std::strtoul(Height.c_str(), &End, 10);
+	BadHeader = BadHeader || *End != '\0' || Rows == 0;
+	double Scale = std::strtod(Maximum.c_str(), &End);
+	BadHeader = BadHeader || *End != '\0' || Scale == 0 || (!Float && (Scale < 1 || Scale > 65535
+		|| Scale != std::floor(Scale)));
+	if (BadHeader) {
+		NetpbmError(ImageFileName, "has a bad header");
+	}
+
+	// Each factor is checked by division, as the product may not fit
+	size_t SampleBytes = Float ? 4 : (Scale > 255 ? 2 : 1);
+	size_t Capacity = (Length - Position) / SampleBytes;
+	if (Rows > Capacity || Cols > Capacity / Rows) {
+		NetpbmError(ImageFileName, "is truncated");
+	}
+
+	BoostDoubleMatrix AMatrix(Rows, Cols);
+	const unsigned char *Samples = Data + Position;
+	double *Values = &AMatrix.data()[0];
+	size_t Count = static_cast<size_t>(Rows) * Cols;
+	if (Float) {
+		// Rows are stored bottom to top; a negative scale marks little-endian
+		// samples
+		bool Swap = (Scale < 0) != LittleEndianHost();
+		for (unsigned long i = 0; i < Rows; ++i) {
+			const unsigned char *Row = Samples + 4 * static_cast<size_t>(Rows - 1 - i) * Cols;
+			double *Out = Values + static_cast<size_t>(i) * Cols;
+			for (unsigned long j = 0; j < Cols; ++j) {
+				unsigned char Bytes[4];
+				std::memcpy(Bytes, Row + 4 * j, 4);
+				if (Swap) {
+					std::swap(Bytes[0], Bytes[3]);
+					std::swap(Bytes[1], Bytes[2]);
+				}
+				float Sample;
+				std::memcpy(&Sample, Bytes, 4);
+				Out[j] = Sample;
+			}
+		}
+	}
+	else if (SampleBytes == 2) {
+		// Big-endian 16-bit samples, top row first
+		for (size_t k = 0; k < Count; ++k) {
+			Values[k] = ((Samples[2 * k] << 8) | Samples[2 * k + 1]) / Scale;
+		}
+	}
+	else {
+		for (size_t k = 0; k < Count; ++k) {
+			Values[k] = Samples[k] / Scale;
+		}
+	}
+	return AMatrix;
 }
 
-BoostDoubleMatrix NormalizeMatrix(BoostDoubleMatrix AMatrix) {
+void WriteNetpbm(const char* ImageFileName, const BoostDoubleMatrix &AMatrix, ImageDepth Depth) {
+	/*
+	* Function: WriteNetpbm
+	* ---------------------
+	* Write an image as a binary PGM, with values in [0, 1] rounded to 8 or
+	* 16 bits, or as a grayscale PFM holding the values as float32, with one
+	* write.
+	*
+	* Input --
+	* ImageFileName: the image file
+	* AMatrix: the image
+	* Depth: IMAGE_DEPTH_FLOAT for PFM, IMAGE_DEPTH_8 or IMAGE_DEPTH_16 for PGM
+	*/
+	unsigned long Rows = AMatrix.size1(), Cols = AMatrix.size2();
+	if (Rows == 0 || Cols == 0) {
+		NetpbmError(ImageFileName, "cannot hold an empty image");
+	}
+	bool Float = (Depth == IMAGE_DEPTH_FLOAT);
+	unsigned long Maximum = (Depth == IMAGE_DEPTH_16) ? 65535 : 255;
+	char Header[64];
+	if (Float) {
+		std::snprintf(Header, sizeof(Header), "Pf\n%lu %lu\n%s\n", Cols, Rows,
+			LittleEndianHost() ? "-1.0" : "1.0");
+	}
+	else {
+		std::snprintf(Header, sizeof(Header), "P5\n%lu %lu\n%lu\n", Cols, Rows, Maximum);
+	}
+	size_t HeaderBytes = std::strlen(Header);
+	size_t SampleBytes = Float ? 4 : (Maximum > 255 ? 2 : 1);
+	size_t Count = static_cast<size_t>(Rows) * Cols;
+	std::vector<unsigned char> Contents(HeaderBytes + SampleBytes * Count);
+	std::memcpy(&Contents[0], Header, HeaderBytes);
+
+	unsigned char *Samples = &Contents[HeaderBytes];
+	const double *Values = &AMatrix.data()[0];
+	if (Float) {
+		// Rows bottom to top, in the byte order of the machine
+		for (unsigned long i = 0; i < Rows; ++i) {
+			unsigned char *Row = Samples + 4 * static_cast<size_t>(Rows - 1 - i) * Cols;
+			const double *In = Values + static_cast<size_t>(i) * Cols;
+			for (unsigned long j = 0; j < Cols; ++j) {
+				float Sample = static_cast<float>(In[j]);
+				std::memcpy(Row + 4 * j, &Sample, 4);
+			}
+		}
+	}
+	else {
+		for (size_t k = 0; k < Count; ++k) {
+			double Clamped = std::min(std::max(Values[k], 0.0), 1.0);
+			unsigned long Sample = static_cast<unsigned long>(Clamped * Maximum + 0.5);
+			if (SampleBytes == 2) {
+				Samples[2 * k] = static_cast<unsigned char>(Sample >> 8);
+				Samples[2 * k + 1] = static_cast<unsigned char>(Sample & 0xFF);
+			}
+			else {
+				Samples[k] = static_cast<unsigned char>(Sample);
+			}
+		}
+	}
+
+	FILE *Output = std::fopen(ImageFileName, "wb");
+	if (!Output) {
+		NetpbmError(ImageFileName, "could not be created");
+	}
+	bool Written = std::fwrite(&Contents[0], 1, Contents.size(), Output) == Contents.size();
+	Written = (std::fclose(Output) == 0) && Written;
+	if (!Written) {
+		NetpbmError(ImageFileName, "could not be written");
+	}
+}
+
+bool IsNetpbmFileName(const char* FileName) {
+	/*
+	* Function: IsNetpbmFileName
+	* --------------------------
+	* Output -- true if the file name ends in ".pgm" or ".pfm".
+	*/
+	size_t Size = std::strlen(FileName);
+	return Size >= 4 && (std::strcmp(FileName + Size - 4, ".pgm") == 0
+		|| std::strcmp(FileName + Size - 4, ".pfm") == 0);
+}
+
+BoostDoubleMatrix NormalizeMatrix(const BoostDoubleMatrix &AMatrix) {
 	/*
 	* Function: NormalizeMatrix
 	* ----------------------------
@@ -385,7 +785,7 @@ BoostDoubleMatrix NormalizeMatrix(BoostDoubleMatrix AMatrix) {
 }
 
 
-BoostDoubleVector MatrixToVector(BoostDoubleMatrix AMatrix) {
+BoostDoubleVector MatrixToVector(const BoostDoubleMatrix &AMatrix) {
 	/*
 	* Function: MatrixToVector
 	* ----------------------------
@@ -407,7 +807,7 @@ BoostDoubleVector MatrixToVector(BoostDoubleMatrix AMatrix) {
 	return AVector;
 }
 
-BoostDoubleMatrix VectorToMatrix(BoostDoubleVector AVector, unsigned long rows, unsigned long cols) {
+BoostDoubleMatrix VectorToMatrix(const BoostDoubleVector &AVector, unsigned long rows, unsigned long cols) {
 	/*
 	* Function: VectorToMatrix
 	* ----------------------------
@@ -426,7 +826,44 @@ BoostDoubleMatrix VectorToMatrix(BoostDoubleVector AVector, unsigned long rows,
 	return AMatrix;
 }
 
-BoostDoubleVector ReadTiltAngles(char* TiltAngleFile) {
+BoostDoubleMatrix ResizeMatrix(const BoostDoubleMatrix &AMatrix, unsigned long rows, unsigned long cols) {
+	/*
+	* Function: ResizeMatrix
+	* ----------------------------
+	* Resample a matrix to the specified dimensions by bilinear interpolation.
+	* Both grids span the same area, with entries at the centres of their
+	* cells, and samples beyond the outer centres are clamped. Unlike the
+	* resize of LoadImage, the values are not quantized.
+	*
+	* Input --
+	* AMatrix: the matrix to resample, not empty
+	* rows, cols: the dimensions of the result
+	*
+	* Output -- the (rows x cols) resampled matrix.
+	*/
+	BoostDoubleMatrix Resized(rows, cols);
+	unsigned long OldRows = AMatrix.size1(), OldCols = AMatrix.size2();
+	double RowScale = static_cast<double>(OldRows) / rows;
+	double ColScale = static_cast<double>(OldCols) / cols;
+
+	for (unsigned long j = 0; j < cols; ++j) {
+		double x = std::min(std::max((j + 0.5) * ColScale - 0.5, 0.0), OldCols - 1.0);
+		unsigned long j0 = static_cast<unsigned long>(x);
+		unsigned long j1 = std::min(j0 + 1, OldCols - 1);
+		double fx = x - j0;
+		for (unsigned long i = 0; i < rows; ++i) {
+			double y = std::min(std::max((i + 0.5) * RowScale - 0.5, 0.0), OldRows - 1.0);
+			unsigned long i0 = static_cast<unsigned long>(y);
+			unsigned long i1 = std::min(i0 + 1, OldRows - 1);
+			double fy = y - i0;
+			Resized(i, j) = (1 - fy) * ((1 - fx) * AMatrix(i0, j0) + fx * AMatrix(i0, j1))
+				+ fy * ((1 - fx) * AMatrix(i1, j0) + fx * AMatrix(i1, j1));
+		}
+	}
+	return Resized;
+}
+
+BoostDoubleVector ReadTiltAngles(const char* TiltAngleFile) {
 	using namespace std;
 	BoostDoubleVector TiltAngles(1000);
 
@@ -469,7 +906,7 @@ BoostDoubleVector ReadTiltAngles(char* TiltAngleFile) {
 }
 
 
-double MaximumEntry(BoostDoubleMatrix AMatrix) {
+double MaximumEntry(const BoostDoubleMatrix &AMatrix) {
 	/*  Function: MaximumEntry
 	----------------------
 	Return the maximal value in a given BoostDoubleMatrix
@@ -483,7 +920,7 @@ double MaximumEntry(BoostDoubleMatrix AMatrix) {
 	return MaxValue;
 }
 
-double MaximumEntry(BoostDoubleVector AVector) {
+double MaximumEntry(const BoostDoubleVector &AVector) {
 	/*  Function: MaximumEntry
 	----------------------
 	Return the maximal value in a given BoostDoubleVector
@@ -496,7 +933,7 @@ double MaximumEntry(BoostDoubleVector AVector) {
 }
 
 
-double MinimumEntry(BoostDoubleMatrix AMatrix) {
+double MinimumEntry(const BoostDoubleMatrix &AMatrix) {
 	/*  Function: MinimumEntry
 	----------------------
 	Return the minimum value in a given BoostDoubleMatrix
@@ -510,7 +947,7 @@ double MinimumEntry(BoostDoubleMatrix AMatrix) {
 	return MinValue;
 }
 
-double MinimumEntry(BoostDoubleVector AVector) {
+double MinimumEntry(const BoostDoubleVector &AVector) {
 	/*  Function: MinimumEntry
 	----------------------
 	Return the minimum value in a given BoostDoubleVector
@@ -562,7 +999,7 @@ int DownNeighbor(unsigned int Index, unsigned long SideLength) {
 	return ((Index + 1) % SideLength) ? (Index + 1) : -1;
 }
 
-double SquareNorm(BoostDoubleVector AVector) {
+double SquareNorm(const BoostDoubleVector &AVector) {
 	/*
 	* Function: SquareNorm
 	* -------------------------
@@ -576,3 +1013,496 @@ double SquareNorm(BoostDoubleVector AVector) {
 	double thisNorm = norm_2(AVector);
 	return thisNorm*thisNorm;
 }
+
+void SetThreadCount(int Threads) {
+	/*
+	* Function: SetThreadCount
+	* ------------------------
+	* Set the number of threads used by the parallel loops of the library.
+	*
+	* Input --
+	* Threads: the thread count, or 0 for the OpenMP default
+	*
+	* Output -- None.
+	*/
+	ThreadCount = (Threads > 0) ? Threads : 0;
+}
+
+int GetThreadCount() {
+	/*
+	* Function: GetThreadCount
+	* ------------------------
+	* Output -- the number of threads parallel loops will use; always 1 when
+	* the library is built without OpenMP.
+	*/
+#ifdef _OPENMP
+	return (ThreadCount > 0) ? ThreadCount : omp_get_max_threads();
+#else
+	return 1;
+#endif
+}
+
+double ParallelInnerProduct(const BoostDoubleVector &A, const BoostDoubleVector &B) {
+	/*
+	* Function: ParallelInnerProduct
+	* ------------------------------
+	* Deterministic parallel form of inner_prod(A, B). For vectors shorter than
+	* one reduction chunk the result is identical to inner_prod.
+	*
+	* Input --
+	* A, B: (N x 1) vectors
+	*
+	* Output -- the inner product.
+	*/
+	const double *AData = A.data().begin();
+	const double *BData = B.data().begin();
+	return DeterministicSum(A.size(), [AData, BData](unsigned long Begin, unsigned long End) {
+		double Sum = 0.0;
+		for (unsigned long i = Begin; i < End; ++i) {
+			Sum += AData[i] * BData[i];
+		}
+		return Sum;
+	});
+}
+
+static const char RawMagic[8] = "CTVMRAW";
+static const uint32_t RawByteOrder = 0x01020304;
+
+static void RawError(const char* RawFileName, const char* Problem) {
+	/*
+	* Function: RawError
+	* ------------------
+	* Throw a std::runtime_error naming the raw file and the problem.
+	*/
+	throw std::runtime_error(std::string("Raw file ") + RawFileName + ": " + Problem);
+}
+
+MappedFile::MappedFile(const char* FileName, const char* Description)
+	: Base(NULL), Length(0) {
+	/*
+	* Function: MappedFile::MappedFile
+	* --------------------------------
+	* Map the whole file read-only. An empty file has no mapping.
+	*/
+	std::string Prefix = std::string(Description) + " " + FileName + ": ";
+#ifdef _WIN32
+	FileHandle = CreateFileA(FileName, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL, NULL);
+	MappingHandle = NULL;
+	if (FileHandle == INVALID_HANDLE_VALUE) {
+		FileHandle = NULL;
+		throw std::runtime_error(Prefix + "could not be opened");
+	}
+	LARGE_INTEGER FileSize;
+	if (!GetFileSizeEx(FileHandle, &FileSize)) {
+		Release();
+		throw std::runtime_error(Prefix + "could not be sized");
+	}
+	Length = static_cast<size_t>(FileSize.QuadPart);
+	if (Length > 0) {
+		MappingHandle = CreateFileMappingA(FileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (MappingHandle) {
+			Base = static_cast<const unsigned char *>(MapViewOfFile(MappingHandle, FILE_MAP_READ, 0, 0, 0));
+		}
+		if (!Base) {
+			Release();
+			throw std::runtime_error(Prefix + "could not be mapped");
+		}
+	}
+#else
+	int Descriptor = open(FileName, O_RDONLY);
+	if (Descriptor < 0) {
+		throw std::runtime_error(Prefix + "could not be opened");
+	}
+	struct stat FileStatus;
+	if (fstat(Descriptor, &FileStatus) != 0) {
+		close(Descriptor);
+		throw std::runtime_error(Prefix + "could not be sized");
+	}
+	Length = static_cast<size_t>(FileStatus.st_size);
+	if (Length > 0) {
+		void *Mapping = mmap(NULL, Length, PROT_READ, MAP_SHARED, Descriptor, 0);
+		if (Mapping == MAP_FAILED) {
+			close(Descriptor);
+			throw std::runtime_error(Prefix + "could not be mapped");
+		}
+		Base = static_cast<const unsigned char *>(Mapping);
+	}
+	// The mapping stays valid once the descriptor is closed
+	close(Descriptor);
+#endif
+}
+
+MappedFile::~MappedFile() {
+	Release();
+}
+
+void MappedFile::Release() {
+	/*
+	* Function: MappedFile::Release
+	* -----------------------------
+	* Unmap the file and close its handles.
+	*/
+#ifdef _WIN32
+	if (Base) { UnmapViewOfFile(Base); }
+	if (MappingHandle) { CloseHandle(MappingHandle); }
+	if (FileHandle) { CloseHandle(FileHandle); }
+	MappingHandle = FileHandle = NULL;
+#else
+	if (Base) { munmap(const_cast<unsigned char *>(Base), Length); }
+#endif
+	Base = NULL;
+}
+
+const unsigned char *MappedFile::Data() const {
+	return Base;
+}
+
+size_t MappedFile::Size() const {
+	return Length;
+}
+
+void MappedFile::WillNeed(size_t Offset, size_t Count) const {
+	/*
+	* Function: MappedFile::WillNeed
+	* ------------------------------
+	* Ask the OS to start reading the bytes Offset .. Offset+Count-1 of the
+	* file, so that they are resident by the time they are touched. Only a
+	* hint: ranges past the end are clipped, and platforms without
+	* read-ahead advice ignore it.
+	*/
+	if (!Base || Offset >= Length || Count == 0) {
+		return;
+	}
+	Count = std::min(Count, Length - Offset);
+#ifdef _WIN32
+#if _WIN32_WINNT >= 0x0602
+	WIN32_MEMORY_RANGE_ENTRY Range;
+	Range.VirtualAddress = const_cast<unsigned char *>(Base + Offset);
+	Range.NumberOfBytes = Count;
+	PrefetchVirtualMemory(GetCurrentProcess(), 1, &Range, 0);
+#endif
+#else
+	// The advice must start on a page boundary
+	size_t Page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+	size_t Start = Offset - Offset % Page;
+	posix_madvise(const_cast<unsigned char *>(Base + Start), Count + (Offset - Start),
+		POSIX_MADV_WILLNEED);
+#endif
+}
+
+RawFile::RawFile(const char* RawFileName) : Mapping(RawFileName, "Raw file"), Base(Mapping.Data()) {
+	/*
+	* Function: RawFile::RawFile
+	* --------------------------
+	* Map the whole file read-only and validate its header against the
+	* file size.
+	*/
+	size_t Length = Mapping.Size();
+	const char *Problem = NULL;
+	if (Length < sizeof(RawHeader)) {
+		Problem = "is too short for a header";
+	}
+	else {
+		std::memcpy(&Header, Base, sizeof(RawHeader));
+		if (std::memcmp(Header.Magic, RawMagic, sizeof(RawMagic)) != 0) {
+			Problem = "is not a raw file";
+		}
+		else if (Header.ByteOrder != RawByteOrder) {
+			Problem = "was written with a different byte order";
+		}
+		else if (Header.Version != RawFormatVersion) {
+			Problem = "has an unsupported format version";
+		}
+		else if (Header.DataType != RAW_FLOAT32 && Header.DataType != RAW_FLOAT64) {
+			Problem = "has an unknown data type";
+		}
+		else if (Header.Angles > (Length - sizeof(RawHeader)) / sizeof(double)) {
+			Problem = "is truncated";
+		}
+		else if (Header.DataOffset < sizeof(RawHeader) + Header.Angles * sizeof(double)
+			|| Header.DataOffset % Header.DataType != 0) {
+			Problem = "has a bad data offset";
+		}
+		else if (Header.DataOffset > Length) {
+			Problem = "is truncated";
+		}
+		else {
+			// Each factor is checked against the stored values by division, so
+			// that a crafted size cannot wrap the product past the check
+			uint64_t Capacity = (Length - Header.DataOffset) / Header.DataType;
+			uint64_t Rows = Header.Rows, Cols = Header.Cols, Slices = Header.Slices;
+			if (Rows != 0 && Cols != 0 && Slices != 0 && (Rows > Capacity || Cols > Capacity / Rows
+				|| Slices > Capacity / (Rows * Cols))) {
+				Problem = "is truncated";
+			}
+		}
+	}
+	if (Problem) {
+		RawError(RawFileName, Problem);
+	}
+}
+
+unsigned long RawFile::Rows() const {
+	return static_cast<unsigned long>(Header.Rows);
+}
+
+unsigned long RawFile::Cols() const {
+	return static_cast<unsigned long>(Header.Cols);
+}
+
+unsigned long RawFile::Slices() const {
+	return static_cast<unsigned long>(Header.Slices);
+}
+
+RawDataType RawFile::DataType() const {
+	return static_cast<RawDataType>(Header.DataType);
+}
+
+BoostDoubleVector RawFile::TiltAngles() const {
+	/*
+	* Function: RawFile::TiltAngles
+	* -----------------------------
+	* Output -- the stored tilt angles; empty if the file has none.
+	*/
+	BoostDoubleVector Angles(Header.Angles);
+	if (Header.Angles > 0) {
+		std::memcpy(&Angles(0), Base + sizeof(RawHeader), Header.Angles * sizeof(double));
+	}
+	return Angles;
+}
+
+const void *RawFile::Data() const {
+	return Base + Header.DataOffset;
+}
+
+const float *RawFile::FloatData() const {
+	/*
+	* Function: RawFile::FloatData
+	* ----------------------------
+	* Output -- the stored values if they are float32, NULL otherwise.
+	*/
+	return (Header.DataType == RAW_FLOAT32) ? static_cast<const float *>(Data()) : NULL;
+}
+
+const double *RawFile::DoubleData() const {
+	/*
+	* Function: RawFile::DoubleData
+	* -----------------------------
+	* Output -- the stored values if they are float64, NULL otherwise.
+	*/
+	return (Header.DataType == RAW_FLOAT64) ? static_cast<const double *>(Data()) : NULL;
+}
+
+BoostDoubleVector RawFile::SliceVector(unsigned long k) const {
+	/*
+	* Function: RawFile::SliceVector
+	* ------------------------------
+	* Input -- k, the slice index, less than Slices().
+	* Output -- the (Rows*Cols x 1) rasterized slice k, converted to double.
+	*/
+	if (k >= Slices()) {
+		throw std::out_of_range("RawFile::SliceVector: no such slice");
+	}
+	unsigned long Count = Rows() * Cols();
+	BoostDoubleVector AVector(Count);
+	if (const float *Values = FloatData()) {
+		std::copy(Values + k * Count, Values + (k + 1) * Count, AVector.begin());
+	}
+	else {
+		const double *Values64 = DoubleData();
+		std::copy(Values64 + k * Count, Values64 + (k + 1) * Count, AVector.begin());
+	}
+	return AVector;
+}
+
+BoostDoubleMatrix RawFile::Slice(unsigned long k) const {
+	/*
+	* Function: RawFile::Slice
+	* ------------------------
+	* Input -- k, the slice index, less than Slices().
+	* Output -- slice k as a (Rows x Cols) matrix.
+	*/
+	return VectorToMatrix(SliceVector(k), Rows(), Cols());
+}
+
+static unsigned long PackRawPrefix(const BoostDoubleVector &TiltAngles, unsigned long Rows,
+	unsigned long Cols, unsigned long Slices, RawDataType DataType, std::vector<unsigned char> &Contents) {
+	/*
+	* Function: PackRawPrefix
+	* -----------------------
+	* Start the contents of a raw file: the header and the tilt angles.
+	*
+	* Output -- the data offset; Contents holds that many bytes.
+	*/
+	RawHeader Header;
+	std::memset(&Header, 0, sizeof(RawHeader));
+	std::memcpy(Header.Magic, RawMagic, sizeof(RawMagic));
+	Header.ByteOrder = RawByteOrder;
+	Header.Version = RawFormatVersion;
+	Header.DataType = DataType;
+	Header.Rows = Rows;
+	Header.Cols = Cols;
+	Header.Slices = Slices;
+	Header.Angles = TiltAngles.size();
+	Header.DataOffset = sizeof(RawHeader) + Header.Angles * sizeof(double);
+
+	Contents.resize(Header.DataOffset);
+	std::memcpy(&Contents[0], &Header, sizeof(RawHeader));
+	if (Header.Angles > 0) {
+		std::memcpy(&Contents[sizeof(RawHeader)], &TiltAngles(0), Header.Angles * sizeof(double));
+	}
+	return static_cast<unsigned long>(Header.DataOffset);
+}
+
+static void PackRawSlice(const BoostDoubleMatrix &AMatrix, RawDataType DataType, unsigned char *Values) {
+	/*
+	* Function: PackRawSlice
+	* ----------------------
+	* Store the matrix column by column as DataType values at Values.
+	*/
+	for (unsigned long j = 0; j < AMatrix.size2(); ++j) {
+		for (unsigned long i = 0; i < AMatrix.size1(); ++i) {
+			if (DataType == RAW_FLOAT32) {
+				float Value = static_cast<float>(AMatrix(i, j));
+				std::memcpy(Values, &Value, sizeof(float));
+			}
+			else {
+				double Value = AMatrix(i, j);
+				std::memcpy(Values, &Value, sizeof(double));
+			}
+			Values += DataType;
+		}
+	}
+}
+
+static void WriteRawBytes(const char* RawFileName, FILE *Output, const std::vector<unsigned char> &Contents) {
+	if (!Contents.empty() && std::fwrite(&Contents[0], 1, Contents.size(), Output) != Contents.size()) {
+		RawError(RawFileName, "could not be written");
+	}
+}
+
+void WriteRaw(const char* RawFileName, const std::vector<BoostDoubleMatrix> &Slices,
+	const BoostDoubleVector &TiltAngles, RawDataType DataType) {
+	/*
+	* Function: WriteRaw
+	* ------------------
+	* Write equally sized slices and their tilt angles as a raw file. The
+	* file contents are assembled in memory and written with one fwrite.
+	*
+	* Input --
+	* RawFileName: the output file
+	* Slices: the slices, all of the same dimensions
+	* TiltAngles: the tilt angles to store; may be empty
+	* DataType: the stored value type
+	*/
+	unsigned long Rows = Slices.empty() ? 0 : Slices[0].size1();
+	unsigned long Cols = Slices.empty() ? 0 : Slices[0].size2();
+	unsigned long SliceBytes = Rows * Cols * DataType;
+
+	std::vector<unsigned char> Contents;
+	unsigned long DataOffset = PackRawPrefix(TiltAngles, Rows, Cols, Slices.size(), DataType, Contents);
+	Contents.resize(DataOffset + Slices.size() * SliceBytes);
+	for (unsigned long k = 0; k < Slices.size(); ++k) {
+		if (Slices[k].size1() != Rows || Slices[k].size2() != Cols) {
+			RawError(RawFileName, "slices differ in size");
+		}
+		PackRawSlice(Slices[k], DataType, &Contents[0] + DataOffset + k * SliceBytes);
+	}
+
+	FILE *Output = std::fopen(RawFileName, "wb");
+	if (!Output) {
+		RawError(RawFileName, "could not be created");
+	}
+	bool Written = (Contents.empty() || std::fwrite(&Contents[0], 1, Contents.size(), Output) == Contents.size());
+	if (std::fclose(Output) != 0 || !Written) {
+		RawError(RawFileName, "could not be written");
+	}
+}
+
+void WriteRaw(const char* RawFileName, const BoostDoubleMatrix &AMatrix,
+	const BoostDoubleVector &TiltAngles, RawDataType DataType) {
+	/*
+	* Function: WriteRaw
+	* ------------------
+	* Write a single matrix, e.g. a sinogram or a reconstructed image, as a
+	* one-slice raw file.
+	*/
+	WriteRaw(RawFileName, std::vector<BoostDoubleMatrix>(1, AMatrix), TiltAngles, DataType);
+}
+
+bool IsRawFileName(const char* FileName) {
+	/*
+	* Function: IsRawFileName
+	* -----------------------
+	* Output -- true if the file name ends in ".raw", the extension chosen for
+	* raw files by ctvm-recover.
+	*/
+	size_t Size = std::strlen(FileName);
+	return Size >= 4 && std::strcmp(FileName + Size - 4, ".raw") == 0;
+}
+
+RawWriter::RawWriter(const char* RawFileName, unsigned long Rows, unsigned long Cols,
+	unsigned long Slices, const BoostDoubleVector &TiltAngles, RawDataType DataType)
+	: FileName(RawFileName), Output(NULL), Rows(Rows), Cols(Cols), Slices(Slices),
+	Written(0), DataType(DataType) {
+	/*
+	* Function: RawWriter::RawWriter
+	* ------------------------------
+	* Create the file and write its header and tilt angles.
+	*/
+	Output = std::fopen(RawFileName, "wb");
+	if (!Output) {
+		RawError(RawFileName, "could not be created");
+	}
+	PackRawPrefix(TiltAngles, Rows, Cols, Slices, DataType, Buffer);
+	try {
+		WriteRawBytes(RawFileName, Output, Buffer);
+	}
+	catch (...) {
+		std::fclose(Output);
+		throw;
+	}
+}
+
+RawWriter::~RawWriter() {
+	if (Output) {
+		std::fclose(Output);
+	}
+}
+
+void RawWriter::WriteSlice(const BoostDoubleMatrix &AMatrix) {
+	/*
+	* Function: RawWriter::WriteSlice
+	* -------------------------------
+	* Append the next slice with a single fwrite.
+	*/
+	if (!Output || Written >= Slices) {
+		RawError(FileName.c_str(), "has no slice left to write");
+	}
+	if (AMatrix.size1() != Rows || AMatrix.size2() != Cols) {
+		RawError(FileName.c_str(), "slices differ in size");
+	}
+	Buffer.resize(Rows * Cols * DataType);
+	if (!Buffer.empty()) {
+		PackRawSlice(AMatrix, DataType, &Buffer[0]);
+	}
+	WriteRawBytes(FileName.c_str(), Output, Buffer);
+	++Written;
+}
+
+void RawWriter::Close() {
+	/*
+	* Function: RawWriter::Close
+	* --------------------------
+	* Close the file, which must have received all of its slices.
+	*/
+	FILE *File = Output;
+	Output = NULL;
+	if (File && std::fclose(File) != 0) {
+		RawError(FileName.c_str(), "could not be written");
+	}
+	if (Written != Slices) {
+		RawError(FileName.c_str(), "was closed before all slices were written");
+	}
+}
@@ -0,0 +1,226 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cstdlib>
+#include <cmath>
+#include "ctvm.h"
+#include "ctvm_util.h"
+#include "ctvm_tiled.h"
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+// Program: benchmark [max-side-length] [max-nonzeros] ------------------------
+// Times the solver kernels and full reconstructions on (L x L) phantoms for
+// L = 32, 64, ... up to max-side-length (default 1024), and the projection-
+// dependent routines at several measurement rates M/N. Problems whose system
+// matrix would hold more than max-nonzeros entries (default 2^25) are skipped.
+//
+// Every row reports mean wall-clock seconds per call, throughput in pixels
+// per second, and the peak resident set size of the process so far.
+
+typedef std::chrono::steady_clock BenchmarkClock;
+
+double PeakRSSMegabytes() {
+	/*
+	* Function: PeakRSSMegabytes
+	* --------------------------
+	* Output -- the peak resident set size of this process, in megabytes.
+	*/
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS Counters;
+	GetProcessMemoryInfo(GetCurrentProcess(), &Counters, sizeof(Counters));
+	return Counters.PeakWorkingSetSize / (1024.0 * 1024.0);
+#else
+	struct rusage Usage;
+	getrusage(RUSAGE_SELF, &Usage);
+	return Usage.ru_maxrss / 1024.0; // ru_maxrss is in kilobytes
+#endif
+}
+
+template <class Function>
+double TimePerCall(Function Call, unsigned int MinimumCalls, double MinimumSeconds) {
+	/*
+	* Function: TimePerCall
+	* ---------------------
+	* Call the function until it has run at least MinimumCalls times and for at
+	* least MinimumSeconds, after one untimed warm-up call when repeating.
+	*
+	* Output -- the mean wall-clock seconds per call.
+	*/
+	if (MinimumCalls > 1) {
+		Call();
+	}
+
+	unsigned int Calls = 0;
+	double Elapsed = 0.0;
+	BenchmarkClock::time_point Start = BenchmarkClock::now();
+	do {
+		Call();
+		++Calls;
+		Elapsed = std::chrono::duration<double>(BenchmarkClock::now() - Start).count();
+	} while (Calls < MinimumCalls || Elapsed < MinimumSeconds);
+
+	return Elapsed / Calls;
+}
+
+void ReportRow(const char *Name, unsigned long L, double Rate, double Seconds) {
+	using namespace std;
+	cout << left << setw(30) << Name << right << setw(6) << L << setw(7);
+	if (Rate > 0) {
+		cout << fixed << setprecision(2) << Rate;
+	}
+	else {
+		cout << "-";
+	}
+	cout << scientific << setprecision(3) << setw(13) << Seconds
+		<< setw(13) << (L * L) / Seconds
+		<< fixed << setprecision(1) << setw(11) << PeakRSSMegabytes() << endl;
+}
+
+BoostDoubleVector Phantom(unsigned long L) {
+	/*
+	* Function: Phantom
+	* -----------------
+	* A rasterized (L x L) test image: two overlapping discs of different
+	* intensity on a zero background.
+	*/
+	BoostDoubleVector X(L * L);
+	double c = 0.5 * (L - 1.0);
+	for (unsigned long j = 0; j < L; ++j) {
+		for (unsigned long i = 0; i < L; ++i) {
+			double x = (j - c) / L, y = (i - c) / L;
+			double Value = (x*x + y*y < 0.16) ? 1.0 : 0.0;
+			Value += ((x - 0.1)*(x - 0.1) + y*y < 0.01) ? 0.5 : 0.0;
+			X(j * L + i) = Value;
+		}
+	}
+	return X;
+}
+
+int main(int argc, char **argv) {
+	using namespace std;
+	unsigned long MaxSideLength = (argc > 1) ? strtoul(argv[1], NULL, 10) : 1024;
+	double MaxNonZeros = (argc > 2) ? atof(argv[2]) : 33554432.0;
+	const double Rates[3] = { 0.1, 0.25, 0.5 };
+	const double MinimumSeconds = 0.2;
+	const double beta = 1024.0, mu = 1024.0;
+
+	cout << "CTVM Benchmark (" << GetThreadCount() << " threads)" << endl;
+	cout << left << setw(30) << "Benchmark" << right << setw(6) << "L" << setw(7) << "M/N"
+		<< setw(13) << "Wall [s]" << setw(13) << "Pixels/s" << setw(11) << "Peak [MB]" << endl;
+
+	for (unsigned long L = 32; L <= MaxSideLength; L *= 2) {
+		unsigned long N = L * L;
+		BoostDoubleVector X = Phantom(L);
+		BoostDoubleVector Image(N);
+		BoostGradientMatrix G(N, 2), Nu(N, 2), Shriked(N, 2);
+		for (unsigned long i = 0; i < N; ++i) {
+			Nu(i, HORZ) = 0.001 * ((i % 7) - 3.0);
+			Nu(i, VERT) = 0.001 * ((i % 5) - 2.0);
+		}
+		AllPixelGradients(X, L, G);
+
+		/* Image-space Kernels */
+		ReportRow("AllPixelGradients", L, 0, TimePerCall([&]() {
+			AllPixelGradients(X, L, G);
+		}, 3, MinimumSeconds));
+		ReportRow("PixelGradientAdjointSum", L, 0, TimePerCall([&]() {
+			PixelGradientAdjointSum(G, L, Image);
+		}, 3, MinimumSeconds));
+		ReportRow("ApplyShrike", L, 0, TimePerCall([&]() {
+			ApplyShrike(G, Nu, beta, ISOTROPIC, Shriked);
+		}, 3, MinimumSeconds));
+		ReportRow("ApplyGradientShrike", L, 0, TimePerCall([&]() {
+			ApplyGradientShrike(X, Nu, beta, ISOTROPIC, L, Shriked);
+		}, 3, MinimumSeconds));
+
+		/* Structured (Compressive-sensing) Operators */
+		for (int r = 0; r < 3; ++r) {
+			unsigned long M = static_cast<unsigned long>(Rates[r] * N + 0.5);
+			StructuredProjection Hadamard(WALSH_HADAMARD_TRANSFORM, M, N);
+			StructuredProjection Cosine(DCT_TRANSFORM, M, N);
+			BoostDoubleVector Measured, Adjoint;
+			BoostDoubleVector y = Hadamard.Project(X);
+			ReportRow("Apply + ApplyTranspose (WHT)", L, Rates[r], TimePerCall([&]() {
+				Hadamard.Apply(X, Measured);
+				Hadamard.ApplyTranspose(y, Adjoint);
+			}, 3, MinimumSeconds));
+			ReportRow("Apply + ApplyTranspose (DCT)", L, Rates[r], TimePerCall([&]() {
+				Cosine.Apply(X, Measured);
+				Cosine.ApplyTranspose(y, Adjoint);
+			}, 3, MinimumSeconds));
+		}
+
+		/* Projection-dependent Routines */
+		for (int r = 0; r < 3; ++r) {
+			unsigned long O = std::max(1UL, static_cast<unsigned long>(Rates[r] * L + 0.5));
+			double Rate = static_cast<double>(O) / L;
+			if (2.0 * L * L * O > MaxNonZeros) {
+				cout << left << setw(30) << "(skipped: too many non-zeros)" << right << setw(6) << L
+					<< setw(7) << fixed << setprecision(2) << Rate << endl;
+				continue;
+			}
+
+			BoostDoubleVector Angles(O);
+			for (unsigned long a = 0; a < O; ++a) {
+				Angles(a) = 180.0 * a / O;
+			}
+			SparseProjection *A = NULL;
+			ReportRow("BuildParallelBeamProjection", L, Rate, TimePerCall([&]() {
+				delete A;
+				A = new SparseProjection(BuildParallelBeamProjection(Angles, L));
+			}, 1, 0.0));
+
+			FloatSparseProjection AFloat(*A);
+			BoostDoubleVector y = A->Project(X);
+			BoostDoubleVector U = A->BackProject(y);
+			BoostDoubleVector Projected, BackProjected;
+
+			ReportRow("Apply + ApplyTranspose", L, Rate, TimePerCall([&]() {
+				A->Apply(X, Projected);
+				A->ApplyTranspose(y, BackProjected);
+			}, 3, MinimumSeconds));
+			ReportRow("Apply + ApplyTranspose (float)", L, Rate, TimePerCall([&]() {
+				AFloat.Apply(X, Projected);
+				AFloat.ApplyTranspose(y, BackProjected);
+			}, 3, MinimumSeconds));
+			WriteTiledProjection("ctvm_benchmark.tiled", *A, 8 * L, TILED_FLOAT16, true);
+			{
+				TiledSparseProjection ATiled("ctvm_benchmark.tiled");
+				ReportRow("Apply + ApplyTranspose (tiled)", L, Rate, TimePerCall([&]() {
+					ATiled.Apply(X, Projected);
+					ATiled.ApplyTranspose(y, BackProjected);
+				}, 3, MinimumSeconds));
+			}
+			std::remove("ctvm_benchmark.tiled");
+			BoostDoubleVector Lambda = BoostZeroVector(y.size());
+			BoostGradientMatrix W(N, 2);
+			ApplyGradientShrike(U, Nu, beta, ISOTROPIC, L, W);
+
+			ReportRow("Onestep_Direction", L, Rate, TimePerCall([&]() {
+				Onestep_Direction(*A, U, y, W, Nu, Lambda, beta, mu, L);
+			}, 3, MinimumSeconds));
+			ReportRow("Lagrangian", L, Rate, TimePerCall([&]() {
+				Lagrangian(*A, U, y, W, Nu, Lambda, beta, mu, L, ISOTROPIC);
+			}, 3, MinimumSeconds));
+			ReportRow("tval3_reconstruction", L, Rate, TimePerCall([&]() {
+				tval3_reconstruction(*A, y, L);
+			}, 1, 0.0));
+			ReportRow("tval3_reconstruction (float)", L, Rate, TimePerCall([&]() {
+				tval3_reconstruction(AFloat, y, L);
+			}, 1, 0.0));
+			BoostDoubleMatrix Sinogram = VectorToMatrix(y, L, O);
+			ReportRow("tval3_pyramid_reconstruction", L, Rate, TimePerCall([&]() {
+				tval3_pyramid_reconstruction(Sinogram, Angles, 3);
+			}, 1, 0.0));
+
+			delete A;
+		}
+	}
+
+	return 0;
+}
@@ -1,12 +1,17 @@
 #include <iostream>
 #include "ctvm.h"
 #include "ctvm_util.h"
+#include "ctvm_opencl.h"
+#include "ctvm_tiled.h"
+#include "ctvm_mpi.h"
+#include "ctvm_server.h"
 #include <boost/numeric/ublas/vector.hpp>
 #include <boost/numeric/ublas/matrix.hpp>
 #include <boost/numeric/ublas/matrix_proxy.hpp>
 #include <boost/numeric/ublas/io.hpp>
 #include <Magick++.h>
 #include <ctime>
+#include <thread>
 
 #define prefix "   * "
 
@@ -18,6 +23,30 @@ std::string ReportTime(clock_t elapsed) {
 	return "<" + std::string(std::to_string(GetSeconds(elapsed))) + " sec.>";
 }
 
+// O tilt angles evenly spaced over [0, 180) degrees
+BoostDoubleVector MakeTestAngles(unsigned long O) {
+	BoostDoubleVector Angles(O);
+	for (unsigned long a = 0; a < O; ++a) {
+		Angles(a) = 180.0 * a / O;
+	}
+	return Angles;
+}
+
+// A piecewise-constant (L x L) image, rasterised column by column: a bright
+// square on a dimmer disc, laid out for L = 32 and scaled with L
+BoostDoubleVector MakeTestPhantom(unsigned long L) {
+	BoostDoubleVector Phantom(L * L);
+	double Center = (L - 1) / 2.0, Scale = L / 32.0;
+	for (unsigned long j = 0; j < L; ++j) {
+		for (unsigned long i = 0; i < L; ++i) {
+			double x = (j - Center) / Scale, y = (i - Center) / Scale;
+			Phantom(j * L + i) = (x*x + y*y < 144) ? 1.0 : 0.0;
+			Phantom(j * L + i) += (fabs(x - 3) < 4 && fabs(y + 2) < 5) ? 1.0 : 0.0;
+		}
+	}
+	return Phantom;
+}
+
 void TestRandomMatrix() {
 	using namespace std;
 	cout << "Random Matrix Test" << endl;
@@ -33,6 +62,34 @@ void TestRandomMatrix() {
 	RandomMatrix = CreateRandomMatrix(1000, 1000);
 	t = clock() - t;
 	cout << "done. " << ReportTime(t) << endl;
+	BoostDoubleVector Entries = MatrixToVector(RandomMatrix);
+	double Mean = sum(Entries) / Entries.size();
+	double Variance = inner_prod(Entries, Entries) / Entries.size() - Mean * Mean;
+	cout << prefix << "Mean within 0.01 of 0, variance within 0.01 of 1: "
+		<< (fabs(Mean) < 0.01 && fabs(Variance - 1.0) < 0.01) << ". [1] Expected." << endl;
+	cout << prefix << "Unseeded calls differ: " << (norm_inf(CreateRandomVector(8) - CreateRandomVector(8)) > 0)
+		<< ". [1] Expected." << endl;
+
+	// Philox4x32-10 known-answer test (Random123), counter and key zero
+	const uint32_t Counter[4] = { 0, 0, 0, 0 }, Key[2] = { 0, 0 };
+	uint32_t Words[4];
+	Philox4x32(Counter, Key, Words);
+	cout << prefix << "Philox4x32 block: " << hex << Words[0] << " " << Words[1] << " " << Words[2] << " "
+		<< Words[3] << dec << ". [6627e8d5 e169c58d bc57ac4c 9b00dbd8] Expected." << endl;
+
+	// Seeded matrices are the same for every thread count, and any entry can
+	// be regenerated alone
+	BoostDoubleMatrix Seeded = CreateRandomMatrix(300, 301, 42);
+	SetThreadCount(1);
+	BoostDoubleMatrix SingleThread = CreateRandomMatrix(300, 301, 42);
+	SetThreadCount(0);
+	double Entry = 0.0;
+	GenerateGaussian(42, 123 * 301 + 45, 1, &Entry);
+	cout << prefix << "Seeded, one thread and regenerated entry differences: "
+		<< norm_inf(MatrixToVector(Seeded - SingleThread)) << ", " << fabs(Entry - Seeded(123, 45))
+		<< ". [0, 0] Expected." << endl;
+	cout << prefix << "Other seed differs: " << (norm_inf(MatrixToVector(CreateRandomMatrix(300, 301, 43) - Seeded)) > 0)
+		<< ". [1] Expected." << endl;
 
 	cout << prefix << "Passed." << endl << endl;
 }
@@ -169,10 +226,107 @@ void TestGradient() {
 	// G = [-2 -1; -2 0; 0 -1; 0 0]
 	// then the correct answer is a sum vector of
 	// [-3, -1, 1, 3]
-	BoostDoubleMatrix thisGradient = AllPixelGradients(MatrixToVector(GradTest), 2);
+	BoostGradientMatrix thisGradient = AllPixelGradients(MatrixToVector(GradTest), 2);
 	std::cout << "Adjoint Sum Test." << std::endl;
 	std::cout << "  Sum Vector = " << PixelGradientAdjointSum(thisGradient, 2) << std::endl;
 
+	/* Adjoint Identity Test */
+	// For any image X and gradient field G we need <D X, G> = <X, D^T G>.
+	// G must vanish where D does (last column horizontally, last row
+	// vertically), as the fields W and Nu do inside the solver.
+	cout << prefix << "Testing <DX,G> = <X,D^T G> for a [5x5] image" << endl;
+	BoostDoubleVector X(25);
+	BoostGradientMatrix G(25, 2);
+	for (unsigned long i = 0; i < 25; ++i) {
+		X(i) = (i * 7) % 11 - 5.0;
+		G(i, HORZ) = (i < 20) ? (i * 3) % 7 - 3.0 : 0.0;
+		G(i, VERT) = ((i + 1) % 5 != 0) ? (i * 5) % 13 - 6.0 : 0.0;
+	}
+	BoostGradientMatrix DX = AllPixelGradients(X, 5);
+	BoostDoubleVector DTG = PixelGradientAdjointSum(G, 5);
+	double LHS = 0.0;
+	for (unsigned long i = 0; i < 25; ++i) {
+		LHS += DX(i, HORZ) * G(i, HORZ) + DX(i, VERT) * G(i, VERT);
+	}
+	cout << prefix << "<DX,G> = " << LHS << ", <X,D^T G> = " << inner_prod(X, DTG) << endl;
+
+	/* Slab Test */
+	// Columns 0-1 and 2-4 as two slabs, each given its neighbouring column
+	double Dh[25], Dv[25], Adjoint[25];
+	const double *XData = X.data().begin(), *GData = G.data().begin();
+	ForwardDifferenceSlab(XData, XData + 10, 5, 2, Dh, Dv);
+	ForwardDifferenceSlab(XData + 10, NULL, 5, 3, Dh + 10, Dv + 10);
+	ForwardDifferenceAdjointSlab(GData, GData + 25, NULL, 5, 2, Adjoint);
+	ForwardDifferenceAdjointSlab(GData + 10, GData + 35, GData + 5, 5, 3, Adjoint + 10);
+	double SlabDiff = 0.0;
+	for (unsigned long i = 0; i < 25; ++i) {
+		SlabDiff = max(SlabDiff, max(abs(Dh[i] - DX(i, HORZ)), abs(Dv[i] - DX(i, VERT))));
+		SlabDiff = max(SlabDiff, abs(Adjoint[i] - DTG(i)));
+	}
+	cout << prefix << "Two-slab gradient and adjoint max difference: " << SlabDiff << ". [0] Expected." << endl;
+
+	cout << prefix << "Passed." << endl << endl;
+}
+
+void TestVoxelGradient() {
+	using namespace std;
+	cout << "Voxel Gradient Test" << endl;
+	cout << "-------------------" << endl;
+
+	/* Tiled Kernels vs. VoxelGradient */
+	// L = 21 splits each slice into tiles of 2 columns with a ragged last tile
+	unsigned long L = 21, S = L * L, Depth = 5, N = S * Depth;
+	BoostDoubleVector X(N);
+	for (unsigned long i = 0; i < N; ++i) {
+		X(i) = (i * 7) % 11 - 5.0 + 0.25 * ((i * 3) % 5);
+	}
+	BoostGradientMatrix DX = AllVoxelGradients(X, L);
+	double MaxDiff = 0.0;
+	for (unsigned long i = 0; i < N; ++i) {
+		BoostDoubleVector Gradient = VoxelGradient(X, i, L);
+		for (int c = 0; c < 3; ++c) {
+			MaxDiff = fmax(MaxDiff, std::abs(Gradient(c) - DX(i, c)));
+		}
+	}
+	cout << prefix << "AllVoxelGradients vs. VoxelGradient max difference: " << MaxDiff
+		<< ". [0] Expected." << endl;
+
+	/* Adjoint Identity Test */
+	// G vanishes where D does: last column, last row and last slice
+	BoostGradientMatrix G(N, 3);
+	for (unsigned long p = 0; p < N; ++p) {
+		unsigned long i = p % L, j = (p / L) % L, k = p / S;
+		G(p, HORZ) = (j + 1 < L) ? (p * 3) % 7 - 3.0 : 0.0;
+		G(p, VERT) = (i + 1 < L) ? (p * 5) % 13 - 6.0 : 0.0;
+		G(p, AXIAL) = (k + 1 < Depth) ? (p * 11) % 9 - 4.0 : 0.0;
+	}
+	BoostDoubleVector DTG = VoxelGradientAdjointSum(G, L);
+	double LHS = 0.0;
+	for (unsigned long p = 0; p < N; ++p) {
+		LHS += DX(p, HORZ) * G(p, HORZ) + DX(p, VERT) * G(p, VERT) + DX(p, AXIAL) * G(p, AXIAL);
+	}
+	cout << prefix << "<DX,G> - <X,D^T G>: " << LHS - inner_prod(X, DTG) << ". [0] Expected." << endl;
+
+	/* Single Slice vs. 2D Gradients */
+	BoostDoubleVector Image(S);
+	std::copy(X.begin(), X.begin() + S, Image.begin());
+	BoostGradientMatrix Voxel = AllVoxelGradients(Image, L);
+	BoostGradientMatrix Pixel = AllPixelGradients(Image, L);
+	BoostGradientMatrix PixelG(S, 2), VoxelG(S, 3);
+	for (unsigned long p = 0; p < S; ++p) {
+		PixelG(p, HORZ) = VoxelG(p, HORZ) = G(p, HORZ);
+		PixelG(p, VERT) = VoxelG(p, VERT) = G(p, VERT);
+		VoxelG(p, AXIAL) = 0.0;
+	}
+	double SliceDiff = 0.0;
+	for (unsigned long p = 0; p < S; ++p) {
+		SliceDiff = fmax(SliceDiff, std::abs(Voxel(p, HORZ) - Pixel(p, HORZ)));
+		SliceDiff = fmax(SliceDiff, std::abs(Voxel(p, VERT) - Pixel(p, VERT)));
+		SliceDiff = fmax(SliceDiff, std::abs(Voxel(p, AXIAL)));
+	}
+	SliceDiff = fmax(SliceDiff, norm_inf(VoxelGradientAdjointSum(VoxelG, L)
+		- PixelGradientAdjointSum(PixelG, L)));
+	cout << prefix << "Single slice vs. 2D max difference: " << SliceDiff << ". [0] Expected." << endl;
 	cout << prefix << "Passed." << endl << endl;
 }
 
@@ -197,7 +351,7 @@ void TestGradient(char* InputFile, char* OutputFile) {
 	/* Compute Gradients */
 	cout << prefix << "Computing gradients..." << flush;
 	t = clock();
-	BoostDoubleMatrix Gradients = AllPixelGradients(ImageVect, L);
+	BoostGradientMatrix Gradients = AllPixelGradients(ImageVect, L);
 	t = clock() - t;
 	cout << "done. " << ReportTime(t) << endl;
 
@@ -249,11 +403,11 @@ void TestShrike() {
 	t = clock() - t;
 	cout << "done. [" << Result << "]. " << ReportTime(t) << endl;
 
-	BoostDoubleMatrix G(3, 2);
+	BoostGradientMatrix G(3, 2);
 	SetRow(G, g, 0);
 	SetRow(G, g, 1);
 	SetRow(G, g, 2);
-	BoostDoubleMatrix Nu(3, 2);
+	BoostGradientMatrix Nu(3, 2);
 	SetRow(Nu, nu, 0);
 	SetRow(Nu, nu, 1);
 	SetRow(Nu, nu, 2);
@@ -262,7 +416,7 @@ void TestShrike() {
 
 	cout << prefix << "Testing ApplyShrike(Anisotropic) @ beta = 10..." << flush;
 	t = clock();
-	BoostDoubleMatrix Shriked = ApplyShrike(G, Nu, 10, ANISOTROPIC);
+	BoostGradientMatrix Shriked = ApplyShrike(G, Nu, 10, ANISOTROPIC);
 	t = clock() - t;
 	cout << "done. [" << Shriked << "]. " << ReportTime(t) << endl;
 
@@ -272,6 +426,32 @@ void TestShrike() {
 	t = clock() - t;
 	cout << "done. [" << Shriked << "]. " << ReportTime(t) << endl;
 
+	/* Fused Gradient Shrinkage */
+	// ApplyGradientShrike(U) must agree with ApplyShrike(AllPixelGradients(U)),
+	// including when ApplyShrike is evaluated in place.
+	cout << prefix << "Testing ApplyGradientShrike on a [4x4] image..." << endl;
+	BoostDoubleVector U(16);
+	BoostGradientMatrix UNu(16, 2);
+	for (unsigned long i = 0; i < 16; ++i) {
+		U(i) = (i * 5) % 7 - 0.5 * i;
+		UNu(i, HORZ) = (i < 12) ? (i % 3) - 1.0 : 0.0;
+		UNu(i, VERT) = ((i + 1) % 4 != 0) ? 0.5 * ((i % 5) - 2.0) : 0.0;
+	}
+	TVType Modes[2] = { ISOTROPIC, ANISOTROPIC };
+	for (int m = 0; m < 2; ++m) {
+		BoostGradientMatrix Unfused = AllPixelGradients(U, 4);
+		ApplyShrike(Unfused, UNu, 0.75, Modes[m], Unfused);
+		BoostGradientMatrix Fused;
+		ApplyGradientShrike(U, UNu, 0.75, Modes[m], 4, Fused);
+		double MaxDiff = 0.0;
+		for (unsigned long i = 0; i < 16; ++i) {
+			MaxDiff = fmax(MaxDiff, fabs(Fused(i, HORZ) - Unfused(i, HORZ)));
+			MaxDiff = fmax(MaxDiff, fabs(Fused(i, VERT) - Unfused(i, VERT)));
+		}
+		cout << prefix << ((Modes[m] == ISOTROPIC) ? "Isotropic" : "Anisotropic")
+			<< " max difference: " << MaxDiff << ". [0] Expected." << endl;
+	}
+
 	cout << prefix << "Passed." << endl << endl;
 }
 
@@ -308,10 +488,208 @@ void TestRasterization() {
 	cout << prefix << "Passed." << endl << endl;
 }
 
+void TestRawIO() {
+	using namespace std;
+	cout << "Raw File I/O Test" << endl;
+	cout << "-----------------" << endl;
+	const char *RawTestFile = "ctvm_test.raw";
+	unsigned long Rows = 5, Cols = 3, Slices = 2;
+	vector<BoostDoubleMatrix> Stack(Slices, BoostDoubleMatrix(Rows, Cols));
+	BoostDoubleVector Angles(Cols);
+	for (unsigned long k = 0; k < Slices; ++k) {
+		for (unsigned long j = 0; j < Cols; ++j) {
+			for (unsigned long i = 0; i < Rows; ++i) {
+				Stack[k](i, j) = 1.0 / (1 + i + 7 * j + 31 * k);
+			}
+			Angles(j) = 60.0 * j;
+		}
+	}
+
+	// float64 round trips exactly; float32 to single precision
+	RawDataType Types[2] = { RAW_FLOAT64, RAW_FLOAT32 };
+	for (int t = 0; t < 2; ++t) {
+		WriteRaw(RawTestFile, Stack, Angles, Types[t]);
+		RawFile Raw(RawTestFile);
+		double MaxDiff = 0.0;
+		for (unsigned long k = 0; k < Slices; ++k) {
+			MaxDiff = max(MaxDiff, static_cast<double>(norm_inf(Raw.SliceVector(k) - MatrixToVector(Stack[k]))));
+		}
+		cout << prefix << ((Types[t] == RAW_FLOAT64) ? "float64" : "float32") << " dimensions: "
+			<< Raw.Rows() << "x" << Raw.Cols() << "x" << Raw.Slices() << ". [5x3x2] Expected." << endl;
+		if (Types[t] == RAW_FLOAT64) {
+			cout << prefix << "Round-trip max difference: " << MaxDiff << ". [0] Expected." << endl;
+		}
+		else {
+			cout << prefix << "Round-trip max difference < 1e-7: " << (MaxDiff < 1e-7) << ". [1] Expected." << endl;
+		}
+		cout << prefix << "Tilt angles: " << Raw.TiltAngles() << ". [[3](0,60,120)] Expected." << endl;
+	}
+
+	// Slices are rasterized column by column in the mapped data
+	{
+		RawFile Raw(RawTestFile);
+		cout << prefix << "Mapped value (1,2) of slice 1 equals SliceVector: "
+			<< (Raw.FloatData()[Rows * Cols + 2 * Rows + 1] == static_cast<float>(Raw.SliceVector(1)(2 * Rows + 1)))
+			<< ". [1] Expected." << endl;
+	}
+
+	// Slice-by-slice writing produces the same file
+	{
+		RawWriter Writer(RawTestFile, Rows, Cols, Slices, Angles, RAW_FLOAT64);
+		for (unsigned long k = 0; k < Slices; ++k) {
+			Writer.WriteSlice(Stack[k]);
+		}
+		Writer.Close();
+		RawFile Raw(RawTestFile);
+		double MaxDiff = 0.0;
+		for (unsigned long k = 0; k < Slices; ++k) {
+			MaxDiff = max(MaxDiff, static_cast<double>(norm_inf(Raw.SliceVector(k) - MatrixToVector(Stack[k]))));
+		}
+		cout << prefix << "RawWriter slices: " << Raw.Slices() << ", max difference: " << MaxDiff
+			<< ". [2, 0] Expected." << endl;
+	}
+
+	// Truncated and foreign files are rejected
+	bool Rejected = false;
+	{
+		ofstream Truncated(RawTestFile, ios::binary);
+		Truncated << "CTVMRAW";
+	}
+	try {
+		RawFile Raw(RawTestFile);
+	}
+	catch (runtime_error &) {
+		Rejected = true;
+	}
+	cout << prefix << "Truncated file rejected: " << Rejected << ". [1] Expected." << endl;
+
+	// Header sizes whose products wrap around to 0 are rejected
+	uint64_t Wrapping[2][4] = { { 1024, 1024, uint64_t(1) << 44, 0 }, { 1, 1, 1, uint64_t(1) << 61 } };
+	int Wrapped = 0;
+	for (int h = 0; h < 2; ++h) {
+		WriteRaw(RawTestFile, Stack, BoostDoubleVector(), RAW_FLOAT64);
+		{
+			fstream Patched(RawTestFile, ios::binary | ios::in | ios::out);
+			Patched.seekp(offsetof(RawHeader, Rows));
+			Patched.write(reinterpret_cast<const char *>(Wrapping[h]), sizeof(Wrapping[h]));
+		}
+		try {
+			RawFile Raw(RawTestFile);
+		}
+		catch (runtime_error &) {
+			++Wrapped;
+		}
+	}
+	cout << prefix << "Wrapping slice and angle counts rejected: " << Wrapped << ". [2] Expected." << endl;
+	remove(RawTestFile);
+
+	cout << prefix << "Passed." << endl << endl;
+}
+
+void TestNetpbmIO() {
+	using namespace std;
+	cout << "Netpbm Image I/O Test" << endl;
+	cout << "---------------------" << endl;
+	const char *PGMTestFile = "ctvm_test.pgm";
+	const char *PFMTestFile = "ctvm_test.pfm";
+	unsigned long Rows = 6, Cols = 4;
+	BoostDoubleMatrix Image(Rows, Cols);
+	for (unsigned long i = 0; i < Rows; ++i) {
+		for (unsigned long j = 0; j < Cols; ++j) {
+			Image(i, j) = (1.0 + i + Rows * j) / (Rows * Cols + 1);
+		}
+	}
+
+	// PGM rounds to the nearest of 255 or 65535 levels, so the error is at
+	// most half a level
+	ImageDepth Depths[2] = { IMAGE_DEPTH_8, IMAGE_DEPTH_16 };
+	for (int d = 0; d < 2; ++d) {
+		WriteImage(Image, PGMTestFile, Depths[d]);
+		BoostDoubleMatrix Read = LoadImage(PGMTestFile);
+		double Level = (Depths[d] == IMAGE_DEPTH_8) ? 255.0 : 65535.0;
+		cout << prefix << Depths[d] << "-bit PGM dimensions: " << Read.size1() << "x" << Read.size2()
+			<< ", max error <= half a level: " << (norm_inf(MatrixToVector(Read - Image)) <= 0.5 / Level)
+			<< ". [6x4, 1] Expected." << endl;
+	}
+	// 8 bits unless the caller asks for more
+	WriteImage(Image, PGMTestFile, IMAGE_DEPTH_8);
+	BoostDoubleMatrix Explicit = LoadImage(PGMTestFile);
+	WriteImage(Image, PGMTestFile);
+	cout << prefix << "Default PGM depth matches 8 bits: "
+		<< (norm_inf(MatrixToVector(LoadImage(PGMTestFile) - Explicit)) == 0) << ". [1] Expected." << endl;
+
+	// PFM keeps float32 values, including those outside [0, 1], and its
+	// rows are stored bottom to top
+	BoostDoubleMatrix Unscaled = 3.0 * Image - BoostScalarDoubleMatrix(Rows, Cols, 1.0);
+	WriteImage(Unscaled, PFMTestFile);
+	BoostDoubleMatrix Read = LoadImage(PFMTestFile);
+	double MaxDiff = 0.0;
+	for (unsigned long i = 0; i < Rows; ++i) {
+		for (unsigned long j = 0; j < Cols; ++j) {
+			MaxDiff = max(MaxDiff, fabs(Read(i, j) - static_cast<float>(Unscaled(i, j))));
+		}
+	}
+	cout << prefix << "PFM dimensions: " << Read.size1() << "x" << Read.size2() << ", max difference from float32: "
+		<< MaxDiff << ". [6x4, 0] Expected." << endl;
+	{
+		ifstream PFM(PFMTestFile, ios::binary);
+		string Magic;
+		PFM >> Magic;
+		cout << prefix << "PFM magic: " << Magic << ". [Pf] Expected." << endl;
+	}
+	// Resized loads keep the unquantized PFM values
+	BoostDoubleMatrix Same = LoadImage(PFMTestFile, Rows, Cols);
+	BoostDoubleMatrix Doubled = LoadImage(PFMTestFile, 2 * Rows, 2 * Cols);
+	cout << prefix << "Resized PFM: difference at the same size " << norm_inf(MatrixToVector(Same - Read))
+		<< ", doubled " << Doubled.size1() << "x" << Doubled.size2() << " with values above 1: "
+		<< (norm_inf(MatrixToVector(Doubled)) > 1.0) << ". [0, 12x8, 1] Expected." << endl;
+
+	// Headers with comments are read, and truncated files rejected
+	{
+		ofstream Commented(PGMTestFile, ios::binary);
+		Commented << "P5\n# comment\n2 1 # width and height\n255\n";
+		Commented.put(static_cast<char>(0)).put(static_cast<char>(255));
+	}
+	Read = ReadNetpbm(PGMTestFile);
+	cout << prefix << "Commented PGM: " << Read(0, 0) << ", " << Read(0, 1) << ". [0, 1] Expected." << endl;
+	bool Rejected = false;
+	{
+		ofstream Truncated(PGMTestFile, ios::binary);
+		Truncated << "P5\n4 4\n65535\n";
+		Truncated.put('x');
+	}
+	try {
+		ReadNetpbm(PGMTestFile);
+	}
+	catch (runtime_error &) {
+		Rejected = true;
+	}
+	cout << prefix << "Truncated file rejected: " << Rejected << ". [1] Expected." << endl;
+	// Dimensions whose product wraps around are rejected too
+	Rejected = false;
+	{
+		ofstream Wrapping(PGMTestFile, ios::binary);
+		Wrapping << "P5\n2 9223372036854775808\n255\n";
+		Wrapping.put('x');
+	}
+	try {
+		ReadNetpbm(PGMTestFile);
+	}
+	catch (runtime_error &) {
+		Rejected = true;
+	}
+	cout << prefix << "Wrapping dimensions rejected: " << Rejected << ". [1] Expected." << endl;
+	remove(PGMTestFile);
+	remove(PFMTestFile);
+
+	cout << prefix << "Passed." << endl << endl;
+}
+
 void TestLagrangian() {
 	using namespace std;
 
-	BoostDoubleMatrix A(3, 4), W(4, 2), Nu(4, 2);
+	BoostDoubleMatrix A(3, 4);
+	BoostGradientMatrix W(4, 2), Nu(4, 2);
 	BoostDoubleVector U(4), B(3), Lambda(3);
 	double beta = 0.25;
 	double mu = 0.5;
@@ -371,8 +749,8 @@ void TestLagrangian() {
 
 	/* Calulating Langrangian on large dataset */
 	A = BoostDoubleMatrix(64 * 64, 128 * 128);
-	W = BoostDoubleMatrix(128 * 128, 2);
-	Nu = BoostDoubleMatrix(128 * 128, 2);
+	W = BoostGradientMatrix(128 * 128, 2);
+	Nu = BoostGradientMatrix(128 * 128, 2);
 	B = BoostDoubleVector(64 * 64);
 	Lambda = BoostDoubleVector(64 * 64);
 	U = BoostDoubleVector(128 * 128);
@@ -395,7 +773,8 @@ void TestLagrangian() {
 void TestOnestep_Direction() {
 	using namespace std;
 
-	BoostDoubleMatrix A(3, 4), W(4, 2), Nu(4, 2);
+	BoostDoubleMatrix A(3, 4);
+	BoostGradientMatrix W(4, 2), Nu(4, 2);
 	BoostDoubleVector U(4), B(3), Lambda(3);
 	double beta = 0.25;
 	double mu = 0.5;
@@ -452,7 +831,8 @@ void TestOnestep_Direction() {
 void TestU_Subfunction() {
 	using namespace std;
 
-	BoostDoubleMatrix A(3, 9), W(9, 2), Nu(9, 2);
+	BoostDoubleMatrix A(3, 9);
+	BoostGradientMatrix W(9, 2), Nu(9, 2);
 	BoostDoubleVector U(9), B(3), Lambda(3);
 	double beta = 0.3333;
 	double mu = sqrt(2);
@@ -521,6 +901,1110 @@ void TestU_Subfunction() {
 
 }
 
+void TestProjectionOperator() {
+	using namespace std;
+
+	BoostDoubleMatrix A(2, 3);
+	BoostDoubleVector X(3), Y(2);
+	clock_t t;
+
+	A(0, 0) = 1; A(0, 1) = 2; A(0, 2) = 3;
+	A(1, 0) = 4; A(1, 1) = 5; A(1, 2) = 6;
+	X(0) = 1; X(1) = 0; X(2) = -1;
+	Y(0) = 1; Y(1) = 1;
+
+	cout << "Projection Operator Test" << endl;
+	cout << "------------------------" << endl;
+	cout << prefix << "Set A = " << A << endl;
+	cout << prefix << "Set X = " << X << endl;
+	cout << prefix << "Set Y = " << Y << endl;
+
+	DenseProjection Op(A);
+	cout << prefix << "Applying dense operator A*X..." << flush;
+	t = clock();
+	BoostDoubleVector AX = Op.Project(X);
+	t = clock() - t;
+	cout << "done. [" << AX << "]. [(-2,-2)] Expected. " << ReportTime(t) << endl;
+
+	cout << prefix << "Applying dense operator A^T*Y..." << flush;
+	t = clock();
+	BoostDoubleVector AtY = Op.BackProject(Y);
+	t = clock() - t;
+	cout << "done. [" << AtY << "]. [(5,7,9)] Expected. " << ReportTime(t) << endl;
+
+	cout << prefix << "Passed." << endl << endl;
+}
+
+void TestParallelBeamProjection() {
+	using namespace std;
+
+	BoostDoubleMatrix Image(2, 2);
+	BoostDoubleVector TiltAngles(2);
+	clock_t t;
+
+	Image(0, 0) = 1; Image(0, 1) = 3;
+	Image(1, 0) = 2; Image(1, 1) = 4;
+	TiltAngles(0) = 0; TiltAngles(1) = 90;
+
+	cout << "Parallel-Beam Projection Test" << endl;
+	cout << "-----------------------------" << endl;
+	cout << prefix << "Set Image = " << Image << endl;
+	cout << prefix << "Set TiltAngles = " << TiltAngles << endl;
+
+	cout << prefix << "Building sparse projection..." << flush;
+	t = clock();
+	SparseProjection Projection = BuildParallelBeamProjection(TiltAngles, 2);
+	t = clock() - t;
+	cout << "done. [" << Projection.Rows() << "x" << Projection.Cols() << ", "
+		<< Projection.NonZeros() << " non-zeros]. " << ReportTime(t) << endl;
+
+	// Column sums at 0 degrees, row sums (bottom row first) at 90 degrees
+	BoostDoubleVector Sinogram = Projection.Project(MatrixToVector(Image));
+	cout << prefix << "Sinogram: " << Sinogram << ". [(3,7,6,4)] Expected." << endl;
+
+	// The transposed product must be the adjoint: <A*x, y> = <x, A^T*y>
+	BoostDoubleVector X = MatrixToVector(Image);
+	BoostDoubleVector Y(4); Y(0) = 1; Y(1) = -1; Y(2) = 0.5; Y(3) = 2;
+	cout << prefix << "<A*x, y> = " << inner_prod(Projection.Project(X), Y)
+		<< ", <x, A^T*y> = " << inner_prod(X, Projection.BackProject(Y)) << endl;
+
+	/* Larger Geometry */
+	BoostDoubleVector ManyAngles(180);
+	for (unsigned int i = 0; i < 180; ++i) {
+		ManyAngles(i) = i;
+	}
+	cout << prefix << "Building sparse projection for [128x128] at 180 angles..." << flush;
+	t = clock();
+	Projection = BuildParallelBeamProjection(ManyAngles, 128);
+	t = clock() - t;
+	cout << "done. [" << Projection.NonZeros() << " non-zeros]. " << ReportTime(t) << endl;
+
+	cout << prefix << "Passed." << endl << endl;
+}
+
+void TestThreadCount() {
+	using namespace std;
+	cout << "Thread Count Test" << endl;
+	cout << "-----------------" << endl;
+	// Results must not depend on the number of threads used.
+	unsigned long L = 192;
+	BoostDoubleVector Angles(90);
+	for (unsigned long i = 0; i < Angles.size(); ++i) {
+		Angles(i) = 2 * i;
+	}
+	SparseProjection Projection = BuildParallelBeamProjection(Angles, L);
+	BoostDoubleVector X(L * L), Y(Projection.Rows());
+	for (unsigned long i = 0; i < X.size(); ++i) {
+		X(i) = sin(0.01 * i);
+	}
+	for (unsigned long i = 0; i < Y.size(); ++i) {
+		Y(i) = cos(0.02 * i);
+	}
+	BoostGradientMatrix W(L * L, 2), Nu(L * L, 2);
+	for (unsigned long i = 0; i < L * L; ++i) {
+		W(i, HORZ) = 0.001 * (i % 17);  W(i, VERT) = -0.002 * (i % 5);
+		Nu(i, HORZ) = 0.003 * (i % 7);  Nu(i, VERT) = 0.001 * (i % 11);
+	}
+
+	BoostDoubleVector AX[2], ATY[2], Direction[2];
+	BoostGradientMatrix Shriked[2];
+	double Dot[2], Q[2];
+	int Threads[2] = { 1, 4 };
+	for (int t = 0; t < 2; ++t) {
+		SetThreadCount(Threads[t]);
+		cout << prefix << "Running with " << GetThreadCount() << " thread(s)." << endl;
+		Projection.Apply(X, AX[t]);
+		Projection.ApplyTranspose(Y, ATY[t]);
+		Direction[t] = TV_Direction(X, W, Nu, 16, L);
+		ApplyGradientShrike(X, Nu, 16, ISOTROPIC, L, Shriked[t]);
+		Dot[t] = ParallelInnerProduct(ATY[t], X);
+		Q[t] = TV_Subfunction(X, W, Nu, 16, L);
+	}
+	SetThreadCount(0);
+
+	cout << prefix << "Max |A*x| difference: " << norm_inf(AX[0] - AX[1]) << ". [0] Expected." << endl;
+	cout << prefix << "Max |A^T*y| difference: " << norm_inf(ATY[0] - ATY[1]) << ". [0] Expected." << endl;
+	cout << prefix << "Max |TV_Direction| difference: " << norm_inf(Direction[0] - Direction[1])
+		<< ". [0] Expected." << endl;
+	cout << prefix << "Max |ApplyGradientShrike| difference: " << norm_inf(Shriked[0] - Shriked[1])
+		<< ". [0] Expected." << endl;
+	cout << prefix << "Inner product difference: " << Dot[0] - Dot[1] << ". [0] Expected." << endl;
+	cout << prefix << "TV_Subfunction difference: " << Q[0] - Q[1] << ". [0] Expected." << endl;
+	cout << prefix << "Passed." << endl << endl;
+}
+
+void TestBatchReconstruction() {
+	using namespace std;
+	cout << "Batch Reconstruction Test" << endl;
+	cout << "-------------------------" << endl;
+	unsigned long L = 4, N = L * L, M = 12, K = 3;
+
+	/* Block Products */
+	BoostDoubleVector Angles(3);
+	Angles(0) = 0; Angles(1) = 60; Angles(2) = 120;
+	SparseProjection Sparse = BuildParallelBeamProjection(Angles, L);
+	BoostDoubleMatrix AMatrix(M, N);
+	for (unsigned long i = 0; i < M; ++i) {
+		for (unsigned long j = 0; j < N; ++j) {
+			AMatrix(i, j) = ((i * 7 + j * 3) % 11) / 11.0;
+		}
+	}
+	DenseProjection Dense(AMatrix);
+	BoostDoubleMatrix X(N, K), Y(M, K);
+	for (unsigned long i = 0; i < N * K; ++i) {
+		X(i % N, i / N) = sin(1.0 + i);
+	}
+	for (unsigned long i = 0; i < M * K; ++i) {
+		Y(i % M, i / M) = cos(1.0 + i);
+	}
+
+	const ProjectionOperator *Operators[2] = { &Sparse, &Dense };
+	const char *Names[2] = { "Sparse", "Dense" };
+	for (int o = 0; o < 2; ++o) {
+		BoostDoubleMatrix AX, ATY;
+		Operators[o]->ApplyBlock(X, AX);
+		Operators[o]->ApplyTransposeBlock(Y, ATY);
+		double MaxDiff = 0.0;
+		for (unsigned long k = 0; k < K; ++k) {
+			BoostDoubleVector x = boost::numeric::ublas::column(X, k);
+			BoostDoubleVector y = boost::numeric::ublas::column(Y, k);
+			MaxDiff = fmax(MaxDiff, norm_inf(Operators[o]->Project(x) - boost::numeric::ublas::column(AX, k)));
+			MaxDiff = fmax(MaxDiff, norm_inf(Operators[o]->BackProject(y) - boost::numeric::ublas::column(ATY, k)));
+		}
+		cout << prefix << Names[o] << " block product max difference: " << MaxDiff
+			<< ". [0] Expected." << endl;
+	}
+
+	/* Batch vs. Single Slice */
+	cout << prefix << "Reconstructing " << K << " slices as a batch..." << endl;
+	std::vector<BoostDoubleMatrix> Batch = tval3_batch_reconstruction(AMatrix, Y, L);
+	double MaxDiff = 0.0;
+	for (unsigned long k = 0; k < K; ++k) {
+		BoostDoubleVector y = boost::numeric::ublas::column(Y, k);
+		BoostDoubleMatrix Single = tval3_reconstruction(AMatrix, y, L);
+		MaxDiff = fmax(MaxDiff, norm_inf(Single - Batch[k]));
+	}
+	cout << prefix << "Batch vs. single max difference: " << MaxDiff << ". [0] Expected." << endl;
+	cout << prefix << "Passed." << endl << endl;
+}
+
+void TestVolumeReconstruction() {
+	using namespace std;
+	cout << "Volume Reconstruction Test" << endl;
+	cout << "--------------------------" << endl;
+	unsigned long L = 8, N = L * L, K = 3;
+	BoostDoubleVector Angles(4);
+	for (unsigned long a = 0; a < 4; ++a) {
+		Angles(a) = 45.0 * a;
+	}
+	SparseProjection Projection = BuildParallelBeamProjection(Angles, L);
+	unsigned long M = Projection.Rows();
+
+	/* Slice Stack Operator */
+	SliceStackProjection Stack(Projection, K);
+	BoostDoubleVector X(N * K), Y(M * K);
+	for (unsigned long i = 0; i < N * K; ++i) {
+		X(i) = sin(1.0 + i);
+	}
+	for (unsigned long i = 0; i < M * K; ++i) {
+		Y(i) = cos(1.0 + i);
+	}
+	BoostDoubleVector AX = Stack.Project(X), ATY = Stack.BackProject(Y);
+	double MaxDiff = 0.0;
+	for (unsigned long k = 0; k < K; ++k) {
+		BoostDoubleVector x(N), y(M);
+		std::copy(X.begin() + k*N, X.begin() + (k + 1)*N, x.begin());
+		std::copy(Y.begin() + k*M, Y.begin() + (k + 1)*M, y.begin());
+		BoostDoubleVector Ax = Projection.Project(x), ATy = Projection.BackProject(y);
+		for (unsigned long r = 0; r < M; ++r) {
+			MaxDiff = fmax(MaxDiff, std::abs(AX(k*M + r) - Ax(r)));
+		}
+		for (unsigned long p = 0; p < N; ++p) {
+			MaxDiff = fmax(MaxDiff, std::abs(ATY(k*N + p) - ATy(p)));
+		}
+	}
+	cout << prefix << "Slice stack vs. per-slice products max difference: " << MaxDiff
+		<< ". [0] Expected." << endl;
+
+	/* One Slice vs. 2D */
+	BoostDoubleVector Phantom(N);
+	for (unsigned long p = 0; p < N; ++p) {
+		Phantom(p) = ((p % L) > 2 && (p % L) < 6 && (p / L) > 1 && (p / L) < 5) ? 1.0 : 0.0;
+	}
+	BoostDoubleVector y = Projection.Project(Phantom);
+	BoostDoubleMatrix Measurements(M, 1);
+	boost::numeric::ublas::column(Measurements, 0) = y;
+	std::vector<BoostDoubleMatrix> Volume = tval3_volume_reconstruction(Projection, Measurements, L);
+	BoostDoubleMatrix Single = tval3_reconstruction(Projection, y, L);
+	cout << prefix << "Single-slice volume vs. 2D max difference: " << norm_inf(Volume[0] - Single)
+		<< ". [0] Expected." << endl;
+
+	/* Identical Slices */
+	BoostDoubleMatrix Stacked(M, K);
+	for (unsigned long k = 0; k < K; ++k) {
+		boost::numeric::ublas::column(Stacked, k) = y;
+	}
+	Volume = tval3_volume_reconstruction(Projection, Stacked, L);
+	double SliceDiff = 0.0;
+	for (unsigned long k = 1; k < K; ++k) {
+		SliceDiff = fmax(SliceDiff, norm_inf(Volume[k] - Volume[0]));
+	}
+	cout << prefix << "Slices of a constant volume max difference: " << SliceDiff
+		<< ". [0] Expected." << endl;
+	cout << prefix << "Passed." << endl << endl;
+}
+
+void TestTVAL3Options() {
+	using namespace std;
+	cout << "TVAL3 Options Test" << endl;
+	cout << "------------------" << endl;
+	unsigned long L = 4, N = L * L, M = 12;
+	BoostDoubleMatrix A(M, N);
+	BoostDoubleVector y(M);
+	for (unsigned long i = 0; i < M; ++i) {
+		for (unsigned long j = 0; j < N; ++j) {
+			A(i, j) = ((i * 5 + j * 3) % 7) / 7.0;
+		}
+		y(i) = sin(1.0 + i);
+	}
+
+	/* Defaults */
+	TVAL3Options Options;
+	BoostDoubleMatrix Default = tval3_reconstruction(A, y, L);
+	BoostDoubleMatrix WithOptions = tval3_reconstruction(A, y, L, Options);
+	cout << prefix << "Default options max difference: " << norm_inf(Default - WithOptions)
+		<< ". [0] Expected." << endl;
+
+	/* Nonnegativity, anisotropic TV and reduced iteration caps */
+	Options.Nonnegative = true;
+	Options.GradNorm = ANISOTROPIC;
+	Options.MaxOuterIterations = 2;
+	Options.MaxInnerIterations = 2;
+	BoostDoubleMatrix Nonnegative = tval3_reconstruction(A, y, L, Options);
+	cout << prefix << "Nonnegative minimum entry: " << MinimumEntry(Nonnegative)
+		<< ". [>= 0] Expected." << endl;
+
+	/* Warm start */
+	TVAL3Options WarmStart;
+	WarmStart.InitialImage = MatrixToVector(Default);
+	BoostDoubleMatrix Warm = tval3_reconstruction(A, y, L, WarmStart);
+	cout << prefix << "Warm start differs from cold start: " << (norm_inf(Warm - Default) > 0)
+		<< ". [1] Expected." << endl;
+
+	/* Resuming from a returned state */
+	TVAL3Options Cold;
+	Cold.OuterTolerance = 0;
+	Cold.Coefficient = 1.5;
+	Cold.MaxOuterIterations = 5;
+	BoostDoubleMatrix Straight = tval3_reconstruction(A, y, L, Cold);
+	TVAL3State State;
+	Cold.MaxOuterIterations = 2;
+	Cold.FinalState = &State;
+	tval3_reconstruction(A, y, L, Cold);
+	Cold.MaxOuterIterations = 3;
+	Cold.InitialState = &State;
+	BoostDoubleMatrix Resumed = tval3_reconstruction(A, y, L, Cold);
+	cout << prefix << "2 + 3 resumed vs 5 outer iterations max difference: "
+		<< norm_inf(MatrixToVector(Resumed) - MatrixToVector(Straight)) << ". [0] Expected." << endl;
+	/* Reused workspace */
+	// Successive problems of different sizes share one workspace.
+	TVAL3Workspace Shared(0, 0);
+	TVAL3Options Reuse;
+	Reuse.Workspace = &Shared;
+	double ReuseDiff = norm_inf(MatrixToVector(tval3_reconstruction(A, y, L, Reuse)) - MatrixToVector(Default));
+	BoostDoubleMatrix Small(M, 9);
+	for (unsigned long i = 0; i < M; ++i) {
+		for (unsigned long j = 0; j < 9; ++j) {
+			Small(i, j) = A(i, j);
+		}
+	}
+	ReuseDiff = fmax(ReuseDiff, norm_inf(MatrixToVector(tval3_reconstruction(Small, y, 3, Reuse))
+		- MatrixToVector(tval3_reconstruction(Small, y, 3))));
+	ReuseDiff = fmax(ReuseDiff, norm_inf(MatrixToVector(tval3_reconstruction(A, y, L, Reuse)) - MatrixToVector(Default)));
+	cout << prefix << "Shared workspace max difference: " << ReuseDiff << ". [0] Expected." << endl;
+
+	/* Step size rules */
+	// On a parallel-beam phantom the undamped Barzilai-Borwein steps fit the
+	// data better than the damped default after the same iterations.
+	unsigned long PL = 32, PO = 16;
+	BoostDoubleVector Angles = MakeTestAngles(PO);
+	SparseProjection Projection = BuildParallelBeamProjection(Angles, PL);
+	BoostDoubleVector Disc(PL * PL);
+	for (unsigned long j = 0; j < PL; ++j) {
+		for (unsigned long i = 0; i < PL; ++i) {
+			Disc(j * PL + i) = ((i - 16.0)*(i - 16.0) + (j - 16.0)*(j - 16.0) < 64) ? 1.0 : 0.0;
+		}
+	}
+	BoostDoubleVector DiscData = Projection.Project(Disc);
+	TVAL3StepSize Rules[4] = { DAMPED_BB_STEP, SHORT_BB_STEP, LONG_BB_STEP, ALTERNATING_BB_STEP };
+	double Misfit[4];
+	for (int r = 0; r < 4; ++r) {
+		TVAL3Options Rule;
+		Rule.StepSize = Rules[r];
+		BoostDoubleMatrix U = tval3_reconstruction(Projection, DiscData, PL, Rule);
+		Misfit[r] = norm_2(Projection.Project(MatrixToVector(U)) - DiscData);
+	}
+	cout << prefix << "Data misfit, damped/short/long/alternating BB: " << Misfit[0] << "/" << Misfit[1]
+		<< "/" << Misfit[2] << "/" << Misfit[3] << endl;
+	cout << prefix << "Undamped steps below damped: "
+		<< (Misfit[1] < Misfit[0] && Misfit[2] < Misfit[0] && Misfit[3] < Misfit[0]) << ". [1] Expected." << endl;
+
+	cout << prefix << "State after resuming: " << State.OuterIterations << " outer iterations, beta "
+		<< State.Beta << ". [5, " << 1024.0 * pow(1.5, 5) << "] Expected." << endl;
+	cout << prefix << "Passed." << endl << endl;
+}
+
+struct ProgressCounts {
+	unsigned int Outer, Inner, Armijo;
+	double LastElapsed;
+	bool Monotone;
+};
+
+void CountProgress(const TVAL3Progress &Progress, void *UserData) {
+	ProgressCounts *Counts = static_cast<ProgressCounts*>(UserData);
+	switch (Progress.Stage) {
+	case OUTER_ITERATION: Counts->Outer++; break;
+	case INNER_ITERATION: Counts->Inner++; break;
+	case ARMIJO_TRIAL: Counts->Armijo++; break;
+	}
+	Counts->Monotone = Counts->Monotone && (Progress.ElapsedSeconds >= Counts->LastElapsed);
+	Counts->LastElapsed = Progress.ElapsedSeconds;
+}
+
+void TestProgressCallback() {
+	using namespace std;
+	cout << "Progress Callback Test" << endl;
+	cout << "----------------------" << endl;
+	unsigned long L = 4, N = L * L, M = 12;
+	BoostDoubleMatrix A(M, N);
+	BoostDoubleVector y(M);
+	for (unsigned long i = 0; i < M; ++i) {
+		for (unsigned long j = 0; j < N; ++j) {
+			A(i, j) = ((i * 5 + j * 3) % 7) / 7.0;
+		}
+		y(i) = sin(1.0 + i);
+	}
+
+	ProgressCounts Counts = { 0, 0, 0, 0.0, true };
+	TVAL3Options Options;
+	Options.MaxOuterIterations = 3;
+	Options.OuterTolerance = 0.0;
+	Options.Progress = CountProgress;
+	Options.ProgressData = &Counts;
+	tval3_reconstruction(A, y, L, Options);
+	cout << prefix << "Outer reports: " << Counts.Outer << ". [3] Expected." << endl;
+	cout << prefix << "Inner reports: " << Counts.Inner << ". [<= 15] Expected." << endl;
+	cout << prefix << "Armijo reports: " << Counts.Armijo << ". [<= 75] Expected." << endl;
+	cout << prefix << "Elapsed time non-decreasing: " << Counts.Monotone << ". [1] Expected." << endl;
+
+	// Batch slices run on separate threads and report nothing
+	ProgressCounts BatchCounts = { 0, 0, 0, 0.0, true };
+	Options.ProgressData = &BatchCounts;
+	BoostDoubleMatrix Y(M, 2);
+	boost::numeric::ublas::column(Y, 0) = y;
+	boost::numeric::ublas::column(Y, 1) = 2.0 * y;
+	tval3_batch_reconstruction(A, Y, L, Options);
+	cout << prefix << "Batch reports: " << (BatchCounts.Outer + BatchCounts.Inner + BatchCounts.Armijo)
+		<< ". [0] Expected." << endl;
+	cout << prefix << "Passed." << endl << endl;
+}
+
+void TestProfile() {
+	using namespace std;
+	cout << "Solver Profile Test" << endl;
+	cout << "-------------------" << endl;
+	unsigned long L = 4, N = L * L, M = 12;
+	BoostDoubleMatrix A(M, N);
+	BoostDoubleVector y(M);
+	for (unsigned long i = 0; i < M; ++i) {
+		for (unsigned long j = 0; j < N; ++j) {
+			A(i, j) = ((i * 5 + j * 3) % 7) / 7.0;
+		}
+		y(i) = sin(1.0 + i);
+	}
+
+	ProgressCounts Counts = { 0, 0, 0, 0.0, true };
+	TVAL3Profile Profile;
+	TVAL3Options Options;
+	Options.MaxOuterIterations = 3;
+	Options.OuterTolerance = 0.0;
+	Options.Progress = CountProgress;
+	Options.ProgressData = &Counts;
+	Options.Profile = &Profile;
+	tval3_reconstruction(A, y, L, Options);
+	if (!Profile.Enabled) {
+		cout << prefix << "Library built without CTVM_PROFILE; profile untouched: "
+			<< (Profile.OuterIterations == 0) << ". [1] Expected." << endl;
+		cout << prefix << "Passed." << endl << endl;
+		return;
+	}
+
+	// One A and one A^T per outer and inner iteration, plus the back-projection
+	cout << prefix << "Outer iterations: " << Profile.OuterIterations << ". [" << Counts.Outer
+		<< "] Expected." << endl;
+	cout << prefix << "Inner iterations: " << Profile.InnerIterations << ". [" << Counts.Inner
+		<< "] Expected." << endl;
+	cout << prefix << "Armijo trials: " << Profile.ArmijoTrials << ". [" << Counts.Armijo
+		<< "] Expected." << endl;
+	cout << prefix << "Armijo backtracks: " << Profile.ArmijoBacktracks << ". ["
+		<< Counts.Armijo - Counts.Inner << "] Expected." << endl;
+	cout << prefix << "Applications of A: " << Profile.Applications << ". ["
+		<< Counts.Outer + Counts.Inner << "] Expected." << endl;
+	cout << prefix << "Applications of A^T: " << Profile.TransposeApplications << ". ["
+		<< 1 + Counts.Outer + Counts.Inner << "] Expected." << endl;
+	cout << prefix << "Line searches timed: " << Profile.PhaseCalls[LINE_SEARCH_PHASE] << ". ["
+		<< Counts.Inner << "] Expected." << endl;
+	double PhaseTotal = 0.0;
+	for (int Phase = 0; Phase < TVAL3_PHASE_COUNT; ++Phase) {
+		PhaseTotal += Profile.PhaseSeconds[Phase];
+	}
+	cout << prefix << "Phase times within total: " << (PhaseTotal <= Profile.TotalSeconds)
+		<< ". [1] Expected." << endl;
+	cout << prefix << "JSON: ";
+	WriteProfileJSON(Profile, cout);
+	cout << endl;
+	cout << prefix << "Passed." << endl << endl;
+}
+
+void TestFloatProjection() {
+	using namespace std;
+	cout << "Single-precision Projection Test" << endl;
+	cout << "--------------------------------" << endl;
+	unsigned long L = 32, N = L * L, O = 16;
+	BoostDoubleVector Angles = MakeTestAngles(O);
+	SparseProjection Projection = BuildParallelBeamProjection(Angles, L);
+	FloatSparseProjection FloatProjection(Projection);
+	BoostDoubleVector X(N);
+	for (unsigned long i = 0; i < N; ++i) {
+		X(i) = sin(0.1 * i) + 1.0;
+	}
+
+	// Each non-zero is rounded once; the sums are still accumulated in double
+	BoostDoubleVector Y = Projection.Project(X);
+	BoostDoubleVector Z = Projection.BackProject(Y);
+	double ApplyError = norm_inf(FloatProjection.Project(X) - Y) / norm_inf(Y);
+	double TransposeError = norm_inf(FloatProjection.BackProject(Y) - Z) / norm_inf(Z);
+	cout << prefix << "Non-zeros: " << FloatProjection.NonZeros() << ". ["
+		<< Projection.NonZeros() << "] Expected." << endl;
+	cout << prefix << "Apply relative error < 1e-6: " << (ApplyError < 1e-6)
+		<< ". [1] Expected." << endl;
+	cout << prefix << "ApplyTranspose relative error < 1e-6: " << (TransposeError < 1e-6)
+		<< ". [1] Expected." << endl;
+
+	BoostDoubleMatrix Double = tval3_reconstruction(Projection, Y, L);
+	BoostDoubleMatrix Single = tval3_reconstruction(FloatProjection, Y, L);
+	double ReconstructionError = norm_inf(Single - Double) / norm_inf(Double);
+	cout << prefix << "Reconstruction relative difference < 1e-4: " << (ReconstructionError < 1e-4)
+		<< ". [1] Expected." << endl;
+	cout << prefix << "Passed." << endl << endl;
+}
+
+void TestStructuredProjection() {
+	using namespace std;
+	cout << "Structured Projection Test" << endl;
+	cout << "--------------------------" << endl;
+	unsigned long L = 32, N = L * L, M = N / 4;
+	BoostDoubleVector X(N), Y(M);
+	for (unsigned long i = 0; i < N; ++i) {
+		X(i) = sin(0.1 * i) + 1.0;
+	}
+	for (unsigned long r = 0; r < M; ++r) {
+		Y(r) = cos(0.3 * r);
+	}
+	// A piecewise-constant image: a bright square on a dimmer disc
+	BoostDoubleVector Phantom = MakeTestPhantom(L);
+
+	const char *Names[2] = { "Walsh-Hadamard", "DCT" };
+	StructuredTransform Transforms[2] = { WALSH_HADAMARD_TRANSFORM, DCT_TRANSFORM };
+	for (int t = 0; t < 2; ++t) {
+		StructuredProjection A(Transforms[t], M, N, 7);
+		cout << prefix << Names[t] << ": " << A.Rows() << "x" << A.Cols() << ". ["
+			<< M << "x" << N << "] Expected." << endl;
+
+		// Adjoint pairing, and orthonormal rows: A*A^T*y = y
+		double Forward = inner_prod(A.Project(X), Y), Backward = inner_prod(X, A.BackProject(Y));
+		double Orthonormality = norm_inf(A.Project(A.BackProject(Y)) - Y);
+		cout << prefix << Names[t] << " <A*x, y> = <x, A^T*y>: "
+			<< (fabs(Forward - Backward) < 1e-10 * fabs(Forward)) << ". [1] Expected." << endl;
+		cout << prefix << Names[t] << " A*A^T = I: " << (Orthonormality < 1e-12)
+			<< ". [1] Expected." << endl;
+
+		// The same seed gives the same operator
+		StructuredProjection Again(Transforms[t], M, N, 7);
+		cout << prefix << Names[t] << " seeded: " << (Again.SampledRows() == A.SampledRows()
+			&& Again.Permutation() == A.Permutation()) << ". [1] Expected." << endl;
+
+		// The solver must see the same operator as the explicit (M x N) matrix
+		BoostDoubleMatrix Explicit(M, N);
+		BoostDoubleVector Basis = BoostZeroVector(N), Column;
+		for (unsigned long i = 0; i < N; ++i) {
+			Basis(i) = 1.0;
+			A.Apply(Basis, Column);
+			column(Explicit, i) = Column;
+			Basis(i) = 0.0;
+		}
+		BoostDoubleVector Measured = A.Project(Phantom);
+		BoostDoubleMatrix Fast = tval3_reconstruction(A, Measured, L);
+		BoostDoubleMatrix Dense = tval3_reconstruction(DenseProjection(Explicit), Measured, L);
+		double Difference = norm_inf(Fast - Dense) / norm_inf(Dense);
+		cout << prefix << Names[t] << " reconstruction matches explicit matrix: "
+			<< (Difference < 1e-8) << ". [1] Expected." << endl;
+	}
+
+	bool Thrown = false;
+	try {
+		StructuredProjection NotPowerOfTwo(DCT_TRANSFORM, 10, 1000);
+	}
+	catch (const std::invalid_argument &) {
+		Thrown = true;
+	}
+	cout << prefix << "Non-power-of-two length rejected: " << Thrown << ". [1] Expected." << endl;
+	cout << prefix << "Passed." << endl << endl;
+}
+
+void TestGaussianProjection() {
+	using namespace std;
+	cout << "Implicit Gaussian Projection Test" << endl;
+	cout << "---------------------------------" << endl;
+	unsigned long L = 16, N = L * L, M = 600;
+	BoostDoubleVector X(N), Y(M);
+	for (unsigned long i = 0; i < N; ++i) {
+		X(i) = sin(0.1 * i) + 1.0;
+	}
+	for (unsigned long r = 0; r < M; ++r) {
+		Y(r) = cos(0.3 * r);
+	}
+
+	// The operator is the seeded random matrix, product for product
+	GaussianProjection A(M, N, 11);
+	BoostDoubleMatrix Stored = CreateRandomMatrix(M, N, 11);
+	DenseProjection Dense(Stored);
+	BoostDoubleVector Norms, DenseNorms, Row;
+	A.SquaredColumnNorms(Norms);
+	Dense.SquaredColumnNorms(DenseNorms);
+	A.Row(321, Row);
+	cout << prefix << "Apply, ApplyTranspose, SquaredColumnNorms max differences: "
+		<< norm_inf(A.Project(X) - Dense.Project(X)) << ", " << norm_inf(A.BackProject(Y) - Dense.BackProject(Y))
+		<< ", " << norm_inf(Norms - DenseNorms) << ". [0, 0, 0] Expected." << endl;
+	cout << prefix << "Regenerated row max difference: " << norm_inf(Row - row(Stored, 321))
+		<< ". [0] Expected." << endl;
+
+	// Scaled entries, and the same products on one thread
+	GaussianProjection Scaled(M, N, 11, 1.0 / sqrt(static_cast<double>(M)));
+	double ScaleError = norm_inf(Scaled.Project(X) * sqrt(static_cast<double>(M)) - Dense.Project(X))
+		/ norm_inf(Dense.Project(X));
+	SetThreadCount(1);
+	BoostDoubleVector SingleThread = A.BackProject(Y);
+	SetThreadCount(0);
+	cout << prefix << "Scaled relative error < 1e-12: " << (ScaleError < 1e-12) << ". [1] Expected." << endl;
+	cout << prefix << "Single-thread ApplyTranspose max difference: " << norm_inf(SingleThread - A.BackProject(Y))
+		<< ". [0] Expected." << endl;
+
+	// The solver sees the same operator as the stored matrix
+	BoostDoubleVector Measured = A.Project(X);
+	TVAL3Options Options;
+	Options.MaxOuterIterations = 3;
+	BoostDoubleMatrix Implicit = tval3_reconstruction(A, Measured, L, Options);
+	BoostDoubleMatrix Explicit = tval3_reconstruction(Dense, Measured, L, Options);
+	cout << prefix << "Reconstruction max difference from stored matrix: " << norm_inf(Implicit - Explicit)
+		<< ". [0] Expected." << endl;
+	cout << prefix << "Passed." << endl << endl;
+}
+
+void TestExactUStep() {
+	using namespace std;
+	cout << "Exact U-Step Test" << endl;
+	cout << "-----------------" << endl;
+	unsigned long L = 32, N = L * L, M = 3 * N / 8;
+	BoostDoubleVector Phantom = MakeTestPhantom(L), Y(M);
+	for (unsigned long r = 0; r < M; ++r) {
+		Y(r) = cos(0.3 * r);
+	}
+
+	PartialCosineProjection A(L, M, 7);
+	double Forward = inner_prod(A.Project(Phantom), Y), Backward = inner_prod(Phantom, A.BackProject(Y));
+	cout << prefix << "<A*x, y> = <x, A^T*y>: " << (fabs(Forward - Backward) < 1e-10 * fabs(Forward))
+		<< ". [1] Expected." << endl;
+	cout << prefix << "A*A^T = I: " << (norm_inf(A.Project(A.BackProject(Y)) - Y) < 1e-12)
+		<< ". [1] Expected." << endl;
+
+	// One exact step minimises the u-subproblem for the W it was taken with
+	BoostDoubleVector b = A.Project(Phantom);
+	BoostDoubleVector U = A.BackProject(b);
+	BoostGradientMatrix W(N, 2), Nu(N, 2);
+	BoostDoubleVector Lambda(M);
+	for (unsigned long i = 0; i < N; ++i) {
+		Nu(i, HORZ) = 0.01 * sin(1.0 * i);
+		Nu(i, VERT) = 0.01 * cos(1.0 * i);
+	}
+	for (unsigned long r = 0; r < M; ++r) {
+		Lambda(r) = 0.1 * sin(0.7 * r);
+	}
+	TVAL3Options Options;
+	Options.UStep = EXACT_U_STEP;
+	Options.MaxInnerIterations = 1;
+	TVAL3Workspace Work(M, N);
+	Alternating_Minimisation(A, U, b, W, Nu, Lambda, 32.0, 64.0, L, Options, Work);
+	double Q = U_Subfunction(A, U, b, W, Nu, Lambda, 32.0, 64.0, L);
+	bool Minimum = true;
+	for (unsigned long i = 0; i < N; i += 37) {
+		for (int Sign = -1; Sign <= 1; Sign += 2) {
+			BoostDoubleVector V = U;
+			V(i) += Sign * 1e-3;
+			Minimum = Minimum && (U_Subfunction(A, V, b, W, Nu, Lambda, 32.0, 64.0, L) > Q);
+		}
+	}
+	cout << prefix << "Exact step is a minimum: " << Minimum << ". [1] Expected." << endl;
+
+	// With continuation-free penalties the exact step recovers the phantom
+	Options = TVAL3Options();
+	Options.Mu = 64.0;
+	Options.Beta = 8.0;
+	Options.MaxOuterIterations = 50;
+	Options.OuterTolerance = 1e-4;
+	Options.UStep = EXACT_U_STEP;
+	BoostDoubleMatrix Exact = tval3_reconstruction(A, b, L, Options);
+	double Error = norm_2(MatrixToVector(Exact) - Phantom) / norm_2(Phantom);
+	cout << prefix << "Exact reconstruction relative error < 1e-3: " << (Error < 1e-3)
+		<< ". [1] Expected." << endl;
+
+	// Operators without a DCT diagonal fall back to the gradient step
+	StructuredProjection Scrambled(DCT_TRANSFORM, M, N, 7);
+	BoostDoubleVector c = Scrambled.Project(Phantom);
+	BoostDoubleMatrix Fallback = tval3_reconstruction(Scrambled, c, L, Options);
+	Options.UStep = GRADIENT_U_STEP;
+	BoostDoubleMatrix Gradient = tval3_reconstruction(Scrambled, c, L, Options);
+	cout << prefix << "Fallback matches gradient step: " << (norm_inf(Fallback - Gradient) == 0)
+		<< ". [1] Expected." << endl;
+	cout << prefix << "Passed." << endl << endl;
+}
+
+void TestConjugateGradientUStep() {
+	using namespace std;
+	cout << "Conjugate-gradient U-Step Test" << endl;
+	cout << "------------------------------" << endl;
+	unsigned long L = 32, N = L * L, O = 16;
+	BoostDoubleVector Angles = MakeTestAngles(O);
+	BoostDoubleVector Phantom = MakeTestPhantom(L);
+	SparseProjection A = BuildParallelBeamProjection(Angles, L);
+	BoostDoubleVector y = A.Project(Phantom);
+
+	// The sparse column norms match the explicit matrix
+	BoostDoubleMatrix Explicit(A.Rows(), N);
+	BoostDoubleVector Basis = BoostZeroVector(N), Column;
+	for (unsigned long i = 0; i < N; ++i) {
+		Basis(i) = 1.0;
+		A.Apply(Basis, Column);
+		column(Explicit, i) = Column;
+		Basis(i) = 0.0;
+	}
+	BoostDoubleVector SparseNorms, DenseNorms;
+	DenseProjection ExplicitA(Explicit);
+	bool Listed = A.SquaredColumnNorms(SparseNorms) && ExplicitA.SquaredColumnNorms(DenseNorms);
+	cout << prefix << "Squared column norms: " << (Listed && norm_inf(SparseNorms - DenseNorms) < 1e-12)
+		<< ". [1] Expected." << endl;
+
+	// Solved to convergence, the preconditioned u-step is the exact one
+	PartialCosineProjection C(L, 3 * N / 8, 7);
+	BoostDoubleMatrix CExplicit(C.Rows(), N);
+	for (unsigned long i = 0; i < N; ++i) {
+		Basis(i) = 1.0;
+		C.Apply(Basis, Column);
+		column(CExplicit, i) = Column;
+		Basis(i) = 0.0;
+	}
+	BoostDoubleVector c = C.Project(Phantom);
+	TVAL3Options Options;
+	Options.Mu = 64.0;
+	Options.Beta = 8.0;
+	Options.MaxOuterIterations = 3;
+	Options.MaxInnerIterations = 3;
+	Options.UStep = EXACT_U_STEP;
+	BoostDoubleMatrix Exact = tval3_reconstruction(C, c, L, Options);
+	Options.UStep = PCG_U_STEP;
+	Options.MaxCGIterations = 1000;
+	Options.CGTolerance = 1e-12;
+	BoostDoubleMatrix Converged = tval3_reconstruction(DenseProjection(CExplicit), c, L, Options);
+	cout << prefix << "Converged PCG matches exact step: "
+		<< (norm_inf(Converged - Exact) / norm_inf(Exact) < 1e-8) << ". [1] Expected." << endl;
+
+	// From a zero start, ten CG iterations per step recover the phantom; the
+	// gradient step needs the back-projection to start from
+	Options = TVAL3Options();
+	Options.Mu = 64.0;
+	Options.Beta = 8.0;
+	Options.MaxOuterIterations = 20;
+	BoostDoubleMatrix Gradient = tval3_reconstruction(A, y, L, Options);
+	Options.UStep = PCG_U_STEP;
+	Options.InitialImage = BoostZeroVector(N);
+	TVAL3Profile Profile;
+	Options.Profile = &Profile;
+	BoostDoubleMatrix Preconditioned = tval3_reconstruction(A, y, L, Options);
+	double GradientError = norm_2(MatrixToVector(Gradient) - Phantom) / norm_2(Phantom);
+	double Error = norm_2(MatrixToVector(Preconditioned) - Phantom) / norm_2(Phantom);
+	cout << prefix << "PCG reconstruction relative error < 1e-3: " << (Error < 1e-3)
+		<< ". [1] Expected." << endl;
+	cout << prefix << "PCG error below gradient step error: " << (Error < GradientError)
+		<< ". [1] Expected." << endl;
+#ifdef CTVM_PROFILE
+	cout << prefix << "CG iterations <= 10 per inner iteration: "
+		<< (Profile.CGIterations <= 10 * Profile.InnerIterations) << ". [1] Expected." << endl;
+#endif
+	cout << prefix << "Passed." << endl << endl;
+}
+
+void TestPyramidReconstruction() {
+	using namespace std;
+	cout << "Pyramid Reconstruction Test" << endl;
+	cout << "---------------------------" << endl;
+	unsigned long L = 64, O = 32;
+	BoostDoubleVector Angles = MakeTestAngles(O);
+	BoostDoubleMatrix Phantom(L, L);
+	for (unsigned long j = 0; j < L; ++j) {
+		for (unsigned long i = 0; i < L; ++i) {
+			double x = (j - 31.5) / L, y = (i - 31.5) / L;
+			Phantom(i, j) = (x*x + y*y < 0.16) ? 1.0 : 0.0;
+			Phantom(i, j) += ((x - 0.1)*(x - 0.1) + y*y < 0.01) ? 0.5 : 0.0;
+		}
+	}
+	SparseProjection Projection = BuildParallelBeamProjection(Angles, L);
+	BoostDoubleMatrix Sinogram = VectorToMatrix(Projection.Project(MatrixToVector(Phantom)), L, O);
+
+	BoostDoubleMatrix Constant = BoostScalarDoubleMatrix(4, 4, 2.5);
+	cout << prefix << "Resized constant: " << norm_inf(ResizeMatrix(Constant, 8, 8)
+		- BoostScalarDoubleMatrix(8, 8, 2.5)) << ". [0] Expected." << endl;
+
+	// The binned sinogram is what the coarse geometry measures of the
+	// resized phantom, up to interpolation
+	SparseProjection Coarse = BuildParallelBeamProjection(Angles, L / 2);
+	BoostDoubleMatrix CoarseSinogram = VectorToMatrix(
+		Coarse.Project(MatrixToVector(ResizeMatrix(Phantom, L / 2, L / 2))), L / 2, O);
+	double Binning = norm_inf(HalveSinogram(Sinogram) - CoarseSinogram) / norm_inf(CoarseSinogram);
+	cout << prefix << "Halved sinogram relative difference < 0.05: " << (Binning < 0.05)
+		<< ". [1] Expected." << endl;
+
+	// The coarse levels give the full-resolution level a far better start
+	// than the back-projection
+	BoostDoubleMatrix Single = tval3_pyramid_reconstruction(Sinogram, Angles, 1);
+	BoostDoubleMatrix Pyramid = tval3_pyramid_reconstruction(Sinogram, Angles, 3);
+	double SingleError = norm_frobenius(Single - Phantom) / norm_frobenius(Phantom);
+	double PyramidError = norm_frobenius(Pyramid - Phantom) / norm_frobenius(Phantom);
+	cout << prefix << "Single level matches tval3_reconstruction: "
+		<< (norm_inf(Single - tval3_reconstruction(Projection, MatrixToVector(Sinogram), L)) == 0)
+		<< ". [1] Expected." << endl;
+	cout << prefix << "Pyramid relative error < 0.5: " << (PyramidError < 0.5) << ". [1] Expected." << endl;
+	cout << prefix << "Pyramid error below single-level error: " << (PyramidError < SingleError)
+		<< ". [1] Expected." << endl;
+	cout << prefix << "Passed." << endl << endl;
+}
+
+void RecordOuterStop(const TVAL3Progress &Progress, void *UserData) {
+	if (Progress.Stage == OUTER_ITERATION) {
+		*static_cast<double*>(UserData) = Progress.Stop;
+	}
+}
+
+void TestActiveSet() {
+	using namespace std;
+	cout << "Active Set Test" << endl;
+	cout << "---------------" << endl;
+	unsigned long L = 64, N = L * L, O = 32;
+	BoostDoubleVector Angles = MakeTestAngles(O);
+	// A small object in a mostly empty field
+	BoostDoubleVector X(N);
+	for (unsigned long j = 0; j < L; ++j) {
+		for (unsigned long i = 0; i < L; ++i) {
+			double x = (j - 40.0) / L, y = (i - 24.0) / L;
+			X(j * L + i) = (x*x + y*y < 0.01) ? 1.0 : 0.0;
+		}
+	}
+	SparseProjection A = BuildParallelBeamProjection(Angles, L);
+	BoostDoubleVector y = A.Project(X);
+
+	std::vector<unsigned long> Columns;
+	BoostDoubleVector Masked = BoostZeroVector(N);
+	for (unsigned long p = 0; p < N; p += 7) {
+		Columns.push_back(p);
+		Masked(p) = X(p) + 0.01 * p;
+	}
+	BoostDoubleVector Restricted, Full;
+	A.ApplyColumns(Masked, Columns, Restricted);
+	cout << prefix << "ApplyColumns error < 1e-12: " << (norm_inf(Restricted - A.Project(Masked))
+		< 1e-12) << ". [1] Expected." << endl;
+	A.ApplyTransposeColumns(y, Columns, Restricted);
+	Full = A.BackProject(y);
+	double TransposeError = 0.0;
+	for (unsigned long k = 0; k < Columns.size(); ++k) {
+		TransposeError = std::max(TransposeError, fabs(Restricted(Columns[k]) - Full(Columns[k])));
+	}
+	cout << prefix << "ApplyTransposeColumns error: " << TransposeError << ". [0] Expected." << endl;
+
+	// Start from the least-squares multiple of the back-projection
+	BoostDoubleVector Start = A.BackProject(y), AStart = A.Project(Start);
+	Start *= inner_prod(y, AStart) / inner_prod(AStart, AStart);
+
+	TVAL3Options Options;
+	Options.Mu = 64.0;
+	Options.Beta = 8.0;
+	Options.InitialImage = Start;
+	Options.MaxOuterIterations = 1;
+	double Stop = 0.0;
+	Options.RelativeTolerance = true;
+	Options.Progress = RecordOuterStop;
+	Options.ProgressData = &Stop;
+	BoostDoubleVector Plain = MatrixToVector(tval3_reconstruction(A, y, L, Options));
+	cout << prefix << "Relative change reported: " << (fabs(Stop - norm_2(Plain - Start)
+		/ norm_2(Plain)) < 1e-12) << ". [1] Expected." << endl;
+	Options.Progress = NULL;
+
+	// While every tile is active the solver takes the same steps
+	TVAL3State Final;
+	TVAL3Workspace Work(0, 0);
+	Options.ActiveTileSize = 16;
+	Options.TileTolerance = 1e6;
+	Options.MaxOuterIterations = 10;
+	Options.Workspace = &Work;
+	Options.FinalState = &Final;
+	BoostDoubleVector Frozen = MatrixToVector(tval3_reconstruction(A, y, L, Options));
+	cout << prefix << "First outer iteration unchanged: " << norm_inf(Frozen - Plain)
+		<< ". [0] Expected." << endl;
+	cout << prefix << "Stopped once every tile froze, outer iterations: " << Final.OuterIterations
+		<< ". [2] Expected." << endl;
+
+	// Tiles away from the object converge first and are frozen
+	Options.TileTolerance = 0.1;
+	Options.OuterTolerance = 0.0;
+	BoostDoubleVector Active = MatrixToVector(tval3_reconstruction(A, y, L, Options));
+	unsigned long FrozenTiles = 0;
+	for (unsigned long t = 0; t < Work.ActiveTiles.size(); ++t) {
+		FrozenTiles += !Work.ActiveTiles[t];
+	}
+	cout << prefix << "Frozen tiles > 8 of 16: " << (FrozenTiles > 8) << ". [1] Expected." << endl;
+	cout << prefix << "Relative error below the start: " << (norm_2(Active - X) < norm_2(Start - X))
+		<< ". [1] Expected." << endl;
+	cout << prefix << "Passed." << endl << endl;
+}
+
+void TestTiledProjection() {
+	using namespace std;
+	cout << "Tiled Projection File Test" << endl;
+	cout << "--------------------------" << endl;
+	const char *TiledTestFile = "ctvm_test.tiled";
+	unsigned long L = 32, N = L * L, O = 12;
+	BoostDoubleVector Angles = MakeTestAngles(O);
+	SparseProjection Projection = BuildParallelBeamProjection(Angles, L);
+	BoostDoubleVector X(N);
+	for (unsigned long i = 0; i < N; ++i) {
+		X(i) = sin(0.1 * i) + 1.0;
+	}
+	BoostDoubleVector Y = Projection.Project(X);
+	BoostDoubleVector Z = Projection.BackProject(Y);
+	BoostDoubleVector Norms, TiledNorms;
+	Projection.SquaredColumnNorms(Norms);
+
+	// float64 files reproduce the products exactly, with either index encoding
+	for (int Delta = 1; Delta >= 0; --Delta) {
+		WriteTiledProjection(TiledTestFile, Projection, 5 * L, TILED_FLOAT64, Delta != 0);
+		TiledSparseProjection Tiled(TiledTestFile);
+		Tiled.SquaredColumnNorms(TiledNorms);
+		cout << prefix << (Delta ? "Delta" : "32-bit") << " indices: " << Tiled.Rows() << "x" << Tiled.Cols()
+			<< ", " << Tiled.NonZeros() << " non-zeros, " << Tiled.RowBlocks() << " row blocks. ["
+			<< Projection.Rows() << "x" << Projection.Cols() << ", " << Projection.NonZeros()
+			<< " non-zeros, 3 row blocks] Expected." << endl;
+		cout << prefix << "Apply, ApplyTranspose, SquaredColumnNorms max differences: "
+			<< norm_inf(Tiled.Project(X) - Y) << ", " << norm_inf(Tiled.BackProject(Y) - Z) << ", "
+			<< norm_inf(TiledNorms - Norms) << ". [0, 0, 0] Expected." << endl;
+	}
+
+	// Writing one angle at a time, with a transpose buffer too small for one
+	// pass, gives the same matrix
+	unsigned long PlainSize, HalfSize;
+	{
+		ifstream Plain(TiledTestFile, ios::binary | ios::ate);
+		PlainSize = static_cast<unsigned long>(Plain.tellg());
+	}
+	{
+		TiledProjectionWriter Writer(TiledTestFile, L * O, N, 2 * L, TILED_FLOAT64, true, 4096);
+		std::vector<unsigned long> RowPtr, ColIndex;
+		std::vector<double> Values;
+		for (unsigned long a = 0; a < O; ++a) {
+			RowPtr.assign(1, 0);
+			ColIndex.clear();
+			Values.clear();
+			AppendParallelBeamRows(Angles(a), L, RowPtr, ColIndex, Values);
+			Writer.AppendRows(RowPtr, ColIndex, Values);
+		}
+		Writer.Close();
+		TiledSparseProjection Tiled(TiledTestFile);
+		cout << prefix << "Streamed column blocks > 1: " << (Tiled.ColumnBlocks() > 1)
+			<< ", max differences: " << norm_inf(Tiled.Project(X) - Y) << ", "
+			<< norm_inf(Tiled.BackProject(Y) - Z) << ". [1, 0, 0] Expected." << endl;
+	}
+
+	// Row indices are stored in 32 bits, so larger matrices are refused
+	bool TooManyRows = false;
+	try {
+		TiledProjectionWriter Writer(TiledTestFile, 4294967296UL, N, 2 * L);
+	}
+	catch (runtime_error &) {
+		TooManyRows = true;
+	}
+	cout << prefix << "Rows past 32-bit indices rejected: " << TooManyRows << ". [1] Expected." << endl;
+
+	// float16 values keep about three digits in about half the space
+	{
+		WriteParallelBeamProjection(TiledTestFile, Angles, L, 4, TILED_FLOAT16, false);
+		TiledSparseProjection Tiled(TiledTestFile);
+		ifstream Half(TiledTestFile, ios::binary | ios::ate);
+		HalfSize = static_cast<unsigned long>(Half.tellg());
+		double ApplyError = norm_inf(Tiled.Project(X) - Y) / norm_inf(Y);
+		double TransposeError = norm_inf(Tiled.BackProject(Y) - Z) / norm_inf(Z);
+		cout << prefix << "float16 relative errors < 1e-3: " << (ApplyError < 1e-3 && TransposeError < 1e-3)
+			<< ". [1] Expected." << endl;
+		cout << prefix << "float16 file smaller than float64: " << (HalfSize < PlainSize)
+			<< ". [1] Expected." << endl;
+	}
+
+	// Foreign files are rejected
+	bool Rejected = false;
+	{
+		ofstream Foreign(TiledTestFile, ios::binary);
+		Foreign << string(sizeof(TiledHeader), 'x');
+	}
+	try {
+		TiledSparseProjection Tiled(TiledTestFile);
+	}
+	catch (runtime_error &) {
+		Rejected = true;
+	}
+	cout << prefix << "Foreign file rejected: " << Rejected << ". [1] Expected." << endl;
+	remove(TiledTestFile);
+
+	cout << prefix << "Passed." << endl << endl;
+}
+
+void TestReconstructionServer() {
+	using namespace std;
+	cout << "Reconstruction Server Test" << endl;
+	cout << "--------------------------" << endl;
+	unsigned long L = 24, O = 10;
+	BoostDoubleVector Angles(O), OtherAngles(O), ThirdAngles(O);
+	for (unsigned long a = 0; a < O; ++a) {
+		Angles(a) = 180.0 * a / O;
+		OtherAngles(a) = Angles(a) + 1.0;
+		ThirdAngles(a) = Angles(a) + 2.0;
+	}
+
+	// Operators are built once per key and the least recently used evicted
+	ProjectionCache Cache(2);
+	bool FirstHit = true, SecondHit = false;
+	ProjectionCacheEntry *First = &Cache.Acquire(Angles, L, &FirstHit);
+	ProjectionCacheEntry *Second = &Cache.Acquire(Angles, L, &SecondHit);
+	cout << prefix << "Repeated key hits, same entry: " << (!FirstHit && SecondHit && First == Second)
+		<< ". [1] Expected." << endl;
+	Cache.Acquire(OtherAngles, L);
+	Cache.Acquire(Angles, L / 2);
+	bool Hit = true;
+	Cache.Acquire(OtherAngles, L, &Hit);
+	cout << prefix << "Recently used entry kept: " << Hit << ". [1] Expected." << endl;
+	Cache.Acquire(Angles, L, &Hit);
+	cout << prefix << "Least recently used entry evicted: " << !Hit << ". [1] Expected." << endl;
+	cout << prefix << "Size, hits, misses: " << Cache.Size() << ", " << Cache.Hits() << ", " << Cache.Misses()
+		<< ". [2, 2, 4] Expected." << endl;
+
+#ifndef _WIN32
+	// Served reconstructions equal direct ones, on a new and a cached operator
+	const char *ServerTestSocket = "ctvm_test.sock";
+	SparseProjection Projection = BuildParallelBeamProjection(ThirdAngles, L);
+	BoostDoubleVector X(L * L);
+	for (unsigned long i = 0; i < L * L; ++i) {
+		X(i) = sin(0.1 * i) + 1.0;
+	}
+	BoostDoubleMatrix Sinogram = VectorToMatrix(Projection.Project(X), L, O);
+	TVAL3Options Options;
+	Options.MaxOuterIterations = 3;
+	BoostDoubleMatrix Direct = tval3_reconstruction(Projection, MatrixToVector(Sinogram), L, Options);
+
+	ProjectionCache ServerCache(2);
+	thread Server([&]() { ServeReconstructions(ServerTestSocket, ServerCache, Options); });
+	BoostDoubleMatrix Served, Cached;
+	bool NewHit = true, CachedHit = false;
+	for (int Attempt = 0; Attempt < 100; ++Attempt) {
+		// Wait for the server to start listening
+		try {
+			Served = RequestReconstruction(ServerTestSocket, Sinogram, ThirdAngles, &NewHit);
+			break;
+		}
+		catch (runtime_error &) {
+			this_thread::sleep_for(chrono::milliseconds(20));
+		}
+	}
+	Cached = RequestReconstruction(ServerTestSocket, Sinogram, ThirdAngles, &CachedHit);
+	bool Rejected = false;
+	try {
+		RequestReconstruction(ServerTestSocket, Sinogram, BoostDoubleVector(O - 1, 0.0));
+	}
+	catch (invalid_argument &) {
+		Rejected = true;
+	}
+	// A request beyond the size budget fails alone; the server carries on
+	bool Oversized = false;
+	try {
+		RequestReconstruction(ServerTestSocket, BoostDoubleMatrix(1024, 200, 0.0), BoostDoubleVector(200, 0.0));
+	}
+	catch (runtime_error &) {
+		Oversized = true;
+	}
+	BoostDoubleMatrix After = RequestReconstruction(ServerTestSocket, Sinogram, ThirdAngles);
+	StopReconstructionServer(ServerTestSocket);
+	Server.join();
+	cout << prefix << "Oversized request rejected, next one served: " << Oversized << ", "
+		<< (norm_inf(After - Direct) == 0) << ". [1, 1] Expected." << endl;
+	cout << prefix << "New then cached operator: " << !NewHit << ", " << CachedHit << ". [1, 1] Expected." << endl;
+	cout << prefix << "Max differences from tval3_reconstruction: " << norm_inf(Served - Direct) << ", "
+		<< norm_inf(Cached - Direct) << ". [0, 0] Expected." << endl;
+	cout << prefix << "Mismatched tilt angles rejected: " << Rejected << ". [1] Expected." << endl;
+	ifstream Removed(ServerTestSocket);
+	cout << prefix << "Socket removed on stop: " << !Removed.good() << ". [1] Expected." << endl;
+#endif
+
+	cout << prefix << "Passed." << endl << endl;
+}
+
+#ifdef CTVM_OPENCL
+void TestOpenCLProjection() {
+	using namespace std;
+	cout << "OpenCL Projection Test" << endl;
+	cout << "----------------------" << endl;
+	unsigned long L = 32, N = L * L, O = 16;
+	BoostDoubleVector Angles = MakeTestAngles(O);
+	SparseProjection Projection = BuildParallelBeamProjection(Angles, L);
+	OpenCLProjection Device(Projection);
+	cout << prefix << "Device: " << Device.DeviceName() << endl;
+	BoostDoubleVector X(N);
+	for (unsigned long i = 0; i < N; ++i) {
+		X(i) = sin(0.1 * i) + 1.0;
+	}
+
+	// The device accumulates in single precision
+	BoostDoubleVector Y = Projection.Project(X);
+	BoostDoubleVector Z = Projection.BackProject(Y);
+	double ApplyError = norm_inf(Device.Project(X) - Y) / norm_inf(Y);
+	double TransposeError = norm_inf(Device.BackProject(Y) - Z) / norm_inf(Z);
+	cout << prefix << "Apply relative error < 1e-5: " << (ApplyError < 1e-5)
+		<< ". [1] Expected." << endl;
+	cout << prefix << "ApplyTranspose relative error < 1e-5: " << (TransposeError < 1e-5)
+		<< ". [1] Expected." << endl;
+
+	BoostDoubleMatrix Host = tval3_reconstruction(Projection, Y, L);
+	BoostDoubleMatrix OnDevice = tval3_reconstruction(Device, Y, L);
+	double ReconstructionError = norm_inf(OnDevice - Host) / norm_inf(Host);
+	cout << prefix << "Reconstruction relative difference < 1e-3: " << (ReconstructionError < 1e-3)
+		<< ". [1] Expected." << endl;
+	cout << prefix << "Passed." << endl << endl;
+}
+#endif
+
 void TestReconstruction(int argc, char **argv) {
 	using namespace std;
 	clock_t t;
@@ -575,20 +2059,95 @@ void TestReconstruction(int argc, char **argv) {
 	cout << "done." << endl;
 }
 
+#ifdef CTVM_MPI
+void TestMPIReconstruction() {
+	using namespace std;
+	int Rank = 0, Ranks = 1;
+	MPI_Comm_rank(MPI_COMM_WORLD, &Rank);
+	MPI_Comm_size(MPI_COMM_WORLD, &Ranks);
+	cout << "MPI Reconstruction Test" << endl;
+	cout << "-----------------------" << endl;
+	cout << prefix << "Rank " << Rank << " of " << Ranks << endl;
+	unsigned long L = 32, N = L * L, O = 12;
+	BoostDoubleVector Angles = MakeTestAngles(O);
+
+	// The shares cover the angles and columns in order
+	unsigned long Angle = 0, Column = 0;
+	for (int r = 0; r < 5; ++r) {
+		MPIPartition Share = PartitionReconstruction(L, O, r, 5);
+		Angle = (Share.AngleBegin == Angle) ? Share.AngleEnd : O + 1;
+		Column = (Share.ColumnBegin == Column) ? Share.ColumnEnd : L + 1;
+	}
+	cout << prefix << "Five-rank partition ends: " << Angle << ", " << Column << ". [" << O << ", " << L
+		<< "] Expected." << endl;
+
+	SparseProjection Projection = BuildParallelBeamProjection(Angles, L);
+	BoostDoubleVector X(N);
+	for (unsigned long i = 0; i < N; ++i) {
+		X(i) = sin(0.1 * i) + 1.0;
+	}
+	BoostDoubleVector Y = Projection.Project(X);
+	TVAL3Options Options;
+	Options.MaxOuterIterations = 8;
+	BoostDoubleMatrix Serial = tval3_reconstruction(Projection, Y, L, Options);
+	BoostDoubleMatrix Distributed = tval3_mpi_reconstruction(VectorToMatrix(Y, L, O), Angles, Options,
+		MPI_COMM_WORLD);
+	// The ranks only change the order of the sums
+	double Difference = norm_inf(Distributed - Serial) / norm_inf(Serial);
+	cout << prefix << "Relative difference from tval3_reconstruction < 1e-10: " << (Difference < 1e-10)
+		<< ". [1] Expected." << endl;
+	cout << prefix << "Passed." << endl << endl;
+}
+#endif
+
 int main(int argc, char **argv) {
 	using namespace std;
+#ifdef CTVM_MPI
+	MPISession Session(argc, argv);
+	if (Session.Rank() > 0) {
+		// The other ranks only join rank 0 in the distributed test
+		TestMPIReconstruction();
+		return 0;
+	}
+#endif
 	cout << endl;
 
 	if (argc < 3) {
 		TestRasterization();
+		TestRawIO();
+		TestNetpbmIO();
 		TestRandomMatrix();
 		TestNormalization();
 		TestNeighborCheck();
 		TestGradient();
+		TestVoxelGradient();
 		TestShrike();
 		TestLagrangian();
 		TestOnestep_Direction();
 		TestU_Subfunction();
+		TestProjectionOperator();
+		TestParallelBeamProjection();
+		TestThreadCount();
+		TestBatchReconstruction();
+		TestVolumeReconstruction();
+		TestTVAL3Options();
+		TestProgressCallback();
+		TestProfile();
+		TestFloatProjection();
+		TestStructuredProjection();
+		TestGaussianProjection();
+		TestExactUStep();
+		TestConjugateGradientUStep();
+		TestPyramidReconstruction();
+		TestActiveSet();
+		TestTiledProjection();
+		TestReconstructionServer();
+#ifdef CTVM_OPENCL
+		TestOpenCLProjection();
+#endif
+#ifdef CTVM_MPI
+		TestMPIReconstruction();
+#endif
 	}
 
 	if (argc == 3) {